@@ -0,0 +1,409 @@
+#include "allergen-head.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+#ifdef SLM_HAVE_GGML_OPT
+#include "llama/ggml-alloc.h"
+#include "llama/ggml-backend.h"
+#include "llama/ggml-cpu.h"
+#include "llama/ggml-opt.h"
+#endif
+
+static const char HEAD_MAGIC[8] = {'S', 'L', 'M', 'H', 'E', 'A', 'D', '1'};
+
+std::string HeadTrainReport::toString() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "BACKEND=%s;SAMPLES=%d;TRAIN=%d;VAL=%d;EPOCHS=%d;TRAIN_MS=%.1f;TRAIN_LOSS=%.5f;VAL_LOSS=%.5f",
+             backend.c_str(), samples, train_samples, val_samples, epochs, train_ms, train_loss, val_loss);
+    return buf;
+}
+
+std::string HeadPrediction::formatted() const {
+    if (!ok) {
+        return "ERROR|" + error;
+    }
+    char buf[160];
+    snprintf(buf, sizeof(buf), "HEAD_MS=%.2f;EMBED_MS=%.2f;HEAD_US=%.1f;PROMPT_TOKENS=%d;LABELS=HEAD|",
+             embed_ms + head_us / 1000.0, embed_ms, head_us, prompt_tokens);
+    return buf + allergenMaskToString(mask);
+}
+
+static float sigmoid(float z) {
+    return 1.0f / (1.0f + std::exp(-z));
+}
+
+// ===============================================================
+// TRAINING
+// Both trainers see standardized features, rows [0, n_train) for
+// training and [n_train, n_train + n_val) for the val loss, and
+// leave standardized-space weights in w (ALLERGEN_COUNT x n_embd)
+// and b.
+// ===============================================================
+#ifdef SLM_HAVE_GGML_OPT
+static ggml_opt_optimizer_params headOptimizerParams(void* userdata) {
+    const HeadConfig* config = static_cast<const HeadConfig*>(userdata);
+    ggml_opt_optimizer_params params = ggml_opt_get_default_optimizer_params(nullptr);
+    params.adamw.alpha = config->learning_rate;
+    params.adamw.wd = config->weight_decay;
+    return params;
+}
+
+static void trainGgmlOpt(const std::vector<float>& x, const std::vector<float>& y, int n_embd,
+                         int n_train, int n_val, int batch, const HeadConfig& config,
+                         std::vector<float>& w, std::vector<float>& b, HeadTrainReport& report) {
+    const int64_t ndata = n_train + n_val;
+    ggml_opt_dataset_t dataset = ggml_opt_dataset_init(GGML_TYPE_F32, GGML_TYPE_F32, n_embd, ALLERGEN_COUNT, ndata, 1);
+    memcpy(ggml_get_data_f32(ggml_opt_dataset_data(dataset)), x.data(), ndata * n_embd * sizeof(float));
+    memcpy(ggml_get_data_f32(ggml_opt_dataset_labels(dataset)), y.data(), ndata * ALLERGEN_COUNT * sizeof(float));
+
+    ggml_backend_t cpu = ggml_backend_cpu_init();
+    ggml_backend_cpu_set_n_threads(cpu, config.n_threads);
+    ggml_backend_sched_t sched = ggml_backend_sched_new(&cpu, nullptr, 1, GGML_DEFAULT_GRAPH_SIZE, false, true);
+
+    // Parameters and inputs, allocated once
+    ggml_init_params static_params = {4 * ggml_tensor_overhead(), nullptr, true};
+    ggml_context* ctx_static = ggml_init(static_params);
+    ggml_tensor* inputs = ggml_new_tensor_2d(ctx_static, GGML_TYPE_F32, n_embd, batch);
+    ggml_set_input(inputs);
+    ggml_tensor* weight = ggml_new_tensor_2d(ctx_static, GGML_TYPE_F32, n_embd, ALLERGEN_COUNT);
+    ggml_tensor* bias = ggml_new_tensor_1d(ctx_static, GGML_TYPE_F32, ALLERGEN_COUNT);
+    ggml_set_param(weight);
+    ggml_set_param(bias);
+    ggml_backend_buffer_t buffer = ggml_backend_alloc_ctx_tensors(ctx_static, cpu);
+    ggml_backend_tensor_set(weight, w.data(), 0, ggml_nbytes(weight));
+    ggml_backend_tensor_set(bias, b.data(), 0, ggml_nbytes(bias));
+
+    // Forward graph, reallocated by ggml-opt
+    ggml_init_params compute_params = {GGML_DEFAULT_GRAPH_SIZE * ggml_tensor_overhead() + 3 * ggml_graph_overhead(),
+                                       nullptr, true};
+    ggml_context* ctx_compute = ggml_init(compute_params);
+    ggml_tensor* outputs = ggml_sigmoid(ctx_compute,
+                                        ggml_add(ctx_compute, ggml_mul_mat(ctx_compute, weight, inputs), bias));
+    ggml_set_output(outputs);
+
+    ggml_opt_params params = ggml_opt_default_params(sched, GGML_OPT_LOSS_TYPE_MEAN_SQUARED_ERROR);
+    params.ctx_compute = ctx_compute;
+    params.inputs = inputs;
+    params.outputs = outputs;
+    params.optimizer = GGML_OPT_OPTIMIZER_TYPE_ADAMW;
+    params.get_opt_pars = headOptimizerParams;
+    params.get_opt_pars_ud = const_cast<HeadConfig*>(&config);
+    ggml_opt_context_t opt = ggml_opt_init(params);
+
+    ggml_opt_result_t result_train = ggml_opt_result_init();
+    ggml_opt_result_t result_val = ggml_opt_result_init();
+    for (int epoch = 0; epoch < config.epochs; epoch++) {
+        ggml_opt_result_reset(result_train);
+        ggml_opt_result_reset(result_val);
+        ggml_opt_dataset_shuffle(opt, dataset, n_train);
+        ggml_opt_epoch(opt, dataset, result_train, n_val > 0 ? result_val : nullptr, n_train, nullptr, nullptr);
+        ggml_opt_result_loss(result_train, &report.train_loss, nullptr);
+        if (n_val > 0) {
+            ggml_opt_result_loss(result_val, &report.val_loss, nullptr);
+        }
+        report.epoch_loss.push_back(report.train_loss);
+    }
+
+    ggml_backend_tensor_get(weight, w.data(), 0, ggml_nbytes(weight));
+    ggml_backend_tensor_get(bias, b.data(), 0, ggml_nbytes(bias));
+
+    ggml_opt_result_free(result_val);
+    ggml_opt_result_free(result_train);
+    ggml_opt_free(opt);
+    ggml_free(ctx_compute);
+    ggml_backend_buffer_free(buffer);
+    ggml_free(ctx_static);
+    ggml_backend_sched_free(sched);
+    ggml_backend_free(cpu);
+    ggml_opt_dataset_free(dataset);
+    report.backend = "ggml-opt";
+}
+#else
+// Mean squared error over batch x ALLERGEN_COUNT sigmoid outputs,
+// as GGML_OPT_LOSS_TYPE_MEAN_SQUARED_ERROR, with AdamW at ggml-opt's
+// default moments
+static double referenceLoss(const std::vector<float>& x, const std::vector<float>& y, int n_embd,
+                            int from, int to, const std::vector<float>& w, const std::vector<float>& b) {
+    double loss = 0.0;
+    for (int s = from; s < to; s++) {
+        for (int k = 0; k < ALLERGEN_COUNT; k++) {
+            float z = b[k];
+            for (int j = 0; j < n_embd; j++) {
+                z += w[static_cast<size_t>(k) * n_embd + j] * x[static_cast<size_t>(s) * n_embd + j];
+            }
+            float d = sigmoid(z) - y[static_cast<size_t>(s) * ALLERGEN_COUNT + k];
+            loss += d * d;
+        }
+    }
+    return to > from ? loss / ((to - from) * ALLERGEN_COUNT) : 0.0;
+}
+
+static void trainReference(const std::vector<float>& x, const std::vector<float>& y, int n_embd,
+                           int n_train, int n_val, int batch, const HeadConfig& config,
+                           std::vector<float>& w, std::vector<float>& b, HeadTrainReport& report) {
+    const float beta1 = 0.9f, beta2 = 0.999f, eps = 1e-8f;
+    std::vector<float> params(w);
+    params.insert(params.end(), b.begin(), b.end());
+    std::vector<float> grad(params.size()), m(params.size(), 0.0f), v(params.size(), 0.0f);
+    std::vector<int> order(n_train);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 rng(config.seed);
+    long step = 0;
+
+    for (int epoch = 0; epoch < config.epochs; epoch++) {
+        std::shuffle(order.begin(), order.end(), rng);
+        double epoch_loss = 0.0;
+        for (int start = 0; start + batch <= n_train; start += batch) {
+            std::fill(grad.begin(), grad.end(), 0.0f);
+            for (int i = start; i < start + batch; i++) {
+                const float* row = &x[static_cast<size_t>(order[i]) * n_embd];
+                for (int k = 0; k < ALLERGEN_COUNT; k++) {
+                    const float* wk = &params[static_cast<size_t>(k) * n_embd];
+                    float z = params[static_cast<size_t>(ALLERGEN_COUNT) * n_embd + k];
+                    for (int j = 0; j < n_embd; j++) {
+                        z += wk[j] * row[j];
+                    }
+                    float p = sigmoid(z);
+                    float d = p - y[static_cast<size_t>(order[i]) * ALLERGEN_COUNT + k];
+                    epoch_loss += d * d;
+                    float dz = 2.0f * d * p * (1.0f - p) / (batch * ALLERGEN_COUNT);
+                    float* gk = &grad[static_cast<size_t>(k) * n_embd];
+                    for (int j = 0; j < n_embd; j++) {
+                        gk[j] += dz * row[j];
+                    }
+                    grad[static_cast<size_t>(ALLERGEN_COUNT) * n_embd + k] += dz;
+                }
+            }
+            step++;
+            const float bc1 = 1.0f - std::pow(beta1, static_cast<float>(step));
+            const float bc2 = 1.0f - std::pow(beta2, static_cast<float>(step));
+            for (size_t p = 0; p < params.size(); p++) {
+                m[p] = beta1 * m[p] + (1.0f - beta1) * grad[p];
+                v[p] = beta2 * v[p] + (1.0f - beta2) * grad[p] * grad[p];
+                params[p] -= config.learning_rate * ((m[p] / bc1) / (std::sqrt(v[p] / bc2) + eps)
+                                                     + config.weight_decay * params[p]);
+            }
+        }
+        report.train_loss = epoch_loss / ((n_train / batch) * batch * ALLERGEN_COUNT);
+        report.epoch_loss.push_back(report.train_loss);
+    }
+
+    std::copy(params.begin(), params.begin() + w.size(), w.begin());
+    std::copy(params.begin() + w.size(), params.end(), b.begin());
+    report.val_loss = referenceLoss(x, y, n_embd, n_train, n_train + n_val, w, b);
+    report.backend = "reference";
+}
+#endif
+
+bool AllergenHead::train(const std::vector<float>& features, const std::vector<AllergenMask>& masks, int n_embd,
+                         const HeadConfig& config, HeadTrainReport& report, std::string& error) {
+    const int samples = static_cast<int>(masks.size());
+    if (n_embd <= 0 || features.size() != static_cast<size_t>(samples) * n_embd) {
+        error = "Feature matrix does not match the labels";
+        return false;
+    }
+    const int batch = std::max(1, std::min(config.batch, samples));
+    int n_val = static_cast<int>(samples * std::max(0.0f, config.val_split)) / batch * batch;
+    const int n_train = (samples - n_val) / batch * batch;
+    if (n_train == 0) {
+        error = "Not enough labeled items to train";
+        return false;
+    }
+
+    SLM_TRACE_SCOPE("head_train");
+    const int64_t t0 = traceNowUs();
+    report = HeadTrainReport();
+    report.samples = samples;
+    report.train_samples = n_train;
+    report.val_samples = n_val;
+    report.epochs = config.epochs;
+
+    std::vector<int> order(samples);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(config.seed));
+
+    // Standardize with the training rows' statistics
+    std::vector<double> mean(n_embd, 0.0), sd(n_embd, 0.0);
+    for (int i = 0; i < n_train; i++) {
+        const float* row = &features[static_cast<size_t>(order[i]) * n_embd];
+        for (int j = 0; j < n_embd; j++) {
+            mean[j] += row[j];
+            sd[j] += static_cast<double>(row[j]) * row[j];
+        }
+    }
+    for (int j = 0; j < n_embd; j++) {
+        mean[j] /= n_train;
+        sd[j] = std::sqrt(std::max(sd[j] / n_train - mean[j] * mean[j], 0.0)) + 1e-6;
+    }
+
+    std::vector<float> x(static_cast<size_t>(n_train + n_val) * n_embd);
+    std::vector<float> y(static_cast<size_t>(n_train + n_val) * ALLERGEN_COUNT);
+    for (int i = 0; i < n_train + n_val; i++) {
+        const float* row = &features[static_cast<size_t>(order[i]) * n_embd];
+        for (int j = 0; j < n_embd; j++) {
+            x[static_cast<size_t>(i) * n_embd + j] = static_cast<float>((row[j] - mean[j]) / sd[j]);
+        }
+        for (int k = 0; k < ALLERGEN_COUNT; k++) {
+            y[static_cast<size_t>(i) * ALLERGEN_COUNT + k] = (masks[order[i]] >> k) & 1u ? 1.0f : 0.0f;
+        }
+    }
+
+    std::vector<float> w(static_cast<size_t>(ALLERGEN_COUNT) * n_embd), b(ALLERGEN_COUNT, 0.0f);
+    std::mt19937 rng(config.seed);
+    std::normal_distribution<float> init(0.0f, 1.0f / std::sqrt(static_cast<float>(n_embd)));
+    for (float& value : w) {
+        value = init(rng);
+    }
+
+#ifdef SLM_HAVE_GGML_OPT
+    trainGgmlOpt(x, y, n_embd, n_train, n_val, batch, config, w, b, report);
+#else
+    trainReference(x, y, n_embd, n_train, n_val, batch, config, w, b, report);
+#endif
+
+    // Fold the standardization into W and b
+    m_n_embd = n_embd;
+    m_threshold = config.threshold;
+    m_weights.assign(w.size(), 0.0f);
+    m_bias.assign(ALLERGEN_COUNT, 0.0f);
+    for (int k = 0; k < ALLERGEN_COUNT; k++) {
+        double shift = 0.0;
+        for (int j = 0; j < n_embd; j++) {
+            const size_t at = static_cast<size_t>(k) * n_embd + j;
+            m_weights[at] = static_cast<float>(w[at] / sd[j]);
+            shift += w[at] * mean[j] / sd[j];
+        }
+        m_bias[k] = static_cast<float>(b[k] - shift);
+    }
+
+    report.train_ms = (traceNowUs() - t0) / 1000.0;
+    LOGI("Allergen head trained: %s", report.toString().c_str());
+    return true;
+}
+
+AllergenMask AllergenHead::predict(const float* embedding, float* probs) const {
+    AllergenMask mask = 0;
+    for (int k = 0; k < ALLERGEN_COUNT; k++) {
+        const float* wk = &m_weights[static_cast<size_t>(k) * m_n_embd];
+        float z = m_bias[k];
+        for (int j = 0; j < m_n_embd; j++) {
+            z += wk[j] * embedding[j];
+        }
+        float p = sigmoid(z);
+        if (probs != nullptr) {
+            probs[k] = p;
+        }
+        if (p >= m_threshold) {
+            mask |= 1u << k;
+        }
+    }
+    return mask;
+}
+
+// ===============================================================
+// HEAD FILE
+// magic, n_embd, label count, threshold, model description, then
+// W (label-major) and b as little-endian float32
+// ===============================================================
+bool AllergenHead::save(const std::string& path, const std::string& model_desc, std::string& error) const {
+    if (!ready()) {
+        error = "Head not trained";
+        return false;
+    }
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        error = "Cannot write " + tmp;
+        return false;
+    }
+    const int32_t header[2] = {m_n_embd, ALLERGEN_COUNT};
+    const uint32_t desc_len = static_cast<uint32_t>(model_desc.size());
+    bool ok = fwrite(HEAD_MAGIC, sizeof(HEAD_MAGIC), 1, f) == 1
+              && fwrite(header, sizeof(header), 1, f) == 1
+              && fwrite(&m_threshold, sizeof(m_threshold), 1, f) == 1
+              && fwrite(&desc_len, sizeof(desc_len), 1, f) == 1
+              && fwrite(model_desc.data(), 1, desc_len, f) == desc_len
+              && fwrite(m_weights.data(), sizeof(float), m_weights.size(), f) == m_weights.size()
+              && fwrite(m_bias.data(), sizeof(float), m_bias.size(), f) == m_bias.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool AllergenHead::load(const std::string& path, const std::string& model_desc, std::string& error) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        error = "Cannot open " + path;
+        return false;
+    }
+    char magic[sizeof(HEAD_MAGIC)];
+    int32_t header[2] = {0, 0};
+    float threshold = 0.5f;
+    uint32_t desc_len = 0;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, HEAD_MAGIC, sizeof(magic)) == 0
+              && fread(header, sizeof(header), 1, f) == 1 && fread(&threshold, sizeof(threshold), 1, f) == 1
+              && fread(&desc_len, sizeof(desc_len), 1, f) == 1 && desc_len < 4096
+              && header[0] > 0 && header[1] == ALLERGEN_COUNT;
+    std::string desc(ok ? desc_len : 0, '\0');
+    std::vector<float> weights(ok ? static_cast<size_t>(header[0]) * ALLERGEN_COUNT : 0), bias(ALLERGEN_COUNT);
+    ok = ok && fread(&desc[0], 1, desc_len, f) == desc_len
+         && fread(weights.data(), sizeof(float), weights.size(), f) == weights.size()
+         && fread(bias.data(), sizeof(float), bias.size(), f) == bias.size();
+    fclose(f);
+    if (!ok) {
+        error = "Not an allergen head file: " + path;
+        return false;
+    }
+    if (!model_desc.empty() && desc != model_desc) {
+        error = "Head was trained on " + desc + ", not " + model_desc;
+        return false;
+    }
+
+    m_n_embd = header[0];
+    m_threshold = threshold;
+    m_weights.swap(weights);
+    m_bias.swap(bias);
+    return true;
+}
+
+// ===============================================================
+// INFERENCE
+// ===============================================================
+HeadPrediction runHeadPrediction(EngineSession& session, const AllergenHead& head,
+                                 const std::string& ingredients) {
+    SLM_TRACE_SCOPE("head_predict");
+    HeadPrediction out;
+    if (!head.ready()) {
+        out.error = "Head not loaded";
+        return out;
+    }
+
+    std::vector<float> embedding;
+    const int64_t t0 = traceNowUs();
+    if (!embedIngredients(session, ingredients, embedding, out.prompt_tokens, out.error)) {
+        return out;
+    }
+    if (static_cast<int>(embedding.size()) != head.nEmbd()) {
+        out.error = "Head expects n_embd " + std::to_string(head.nEmbd());
+        return out;
+    }
+    const int64_t t1 = traceNowUs();
+    out.mask = head.predict(embedding.data(), out.probs);
+    out.embed_ms = (t1 - t0) / 1000.0;
+    out.head_us = static_cast<double>(traceNowUs() - t1);
+    out.ok = true;
+    return out;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "allergen-labels.h"
+#include "slm-engine.h"
+
+// ===============================================================
+// ALLERGEN CLASSIFICATION HEAD
+// A linear layer with 9 sigmoid outputs over the model's mean-pooled
+// hidden states, trained on the device. Hidden states of the labeled
+// items are extracted once; training then never touches the model.
+// At inference one prefill of the ingredient text plus a 9 x n_embd
+// matrix-vector product replaces the generation loop.
+//
+// Training runs on ggml-opt (AdamW, mean squared error on the
+// sigmoid outputs) on the CPU backend. Builds against the mock
+// backend have no ggml, so they train the same objective with a
+// plain C++ AdamW loop instead.
+//
+// Features are standardized for training and the scaling is folded
+// back into the weights before saving, so the head file holds only
+// W, b and a threshold (~55 KB for n_embd = 1536).
+// ===============================================================
+
+struct HeadConfig {
+    int epochs = 40;
+    int batch = 16;             // datapoints per optimizer step
+    float learning_rate = 2e-3f;
+    float weight_decay = 1e-4f;
+    float val_split = 0.1f;     // tail of the training items held out for the val loss
+    float threshold = 0.5f;     // sigmoid output that counts as a label
+    int n_threads = 4;
+    unsigned seed = 1;
+};
+
+struct HeadTrainReport {
+    std::string backend;        // "ggml-opt" or "reference"
+    int samples = 0;
+    int train_samples = 0;
+    int val_samples = 0;
+    int epochs = 0;
+    double train_ms = 0.0;
+    double train_loss = 0.0;    // last epoch
+    double val_loss = 0.0;
+    std::vector<double> epoch_loss;
+
+    // "BACKEND=..;SAMPLES=..;TRAIN=..;VAL=..;EPOCHS=..;TRAIN_MS=..;TRAIN_LOSS=..;VAL_LOSS=.."
+    std::string toString() const;
+};
+
+class AllergenHead {
+public:
+    // features: samples x n_embd, row-major
+    bool train(const std::vector<float>& features, const std::vector<AllergenMask>& masks, int n_embd,
+               const HeadConfig& config, HeadTrainReport& report, std::string& error);
+
+    // model_desc (llama_model_desc) is stored so a head is not loaded
+    // against another model with the same n_embd
+    bool save(const std::string& path, const std::string& model_desc, std::string& error) const;
+    bool load(const std::string& path, const std::string& model_desc, std::string& error);
+    bool ready() const { return m_n_embd > 0; }
+    int nEmbd() const { return m_n_embd; }
+    float threshold() const { return m_threshold; }
+
+    // probs (optional) receives the ALLERGEN_COUNT sigmoid outputs
+    AllergenMask predict(const float* embedding, float* probs = nullptr) const;
+
+private:
+    int m_n_embd = 0;
+    float m_threshold = 0.5f;
+    std::vector<float> m_weights;   // ALLERGEN_COUNT rows of n_embd
+    std::vector<float> m_bias;
+};
+
+struct HeadPrediction {
+    bool ok = false;
+    std::string error;
+    AllergenMask mask = 0;
+    float probs[ALLERGEN_COUNT] = {};
+    int prompt_tokens = 0;
+    double embed_ms = 0.0;      // tokenize + prefill
+    double head_us = 0.0;       // matrix-vector product
+
+    // "HEAD_MS=..;EMBED_MS=..;HEAD_US=..;PROMPT_TOKENS=..;LABELS=HEAD|labels" or "ERROR|reason"
+    std::string formatted() const;
+};
+
+HeadPrediction runHeadPrediction(EngineSession& session, const AllergenHead& head,
+                                 const std::string& ingredients);
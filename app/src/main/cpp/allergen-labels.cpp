@@ -0,0 +1,89 @@
+#include "allergen-labels.h"
+
+#include <algorithm>
+#include <vector>
+
+const char* const ALLERGEN_LABELS[ALLERGEN_COUNT] = {
+        "milk", "egg", "peanut", "tree nut", "wheat",
+        "soy", "fish", "shellfish", "sesame"
+};
+
+int allergenIndex(const std::string& label) {
+    for (int i = 0; i < ALLERGEN_COUNT; i++) {
+        if (label == ALLERGEN_LABELS[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static std::string trimCopy(const std::string& s) {
+    size_t start = s.find_first_not_of(" \n\r\t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \n\r\t");
+    return s.substr(start, end - start + 1);
+}
+
+static void replaceAll(std::string& s, const std::string& from, const std::string& to) {
+    size_t pos = 0;
+    while ((pos = s.find(from, pos)) != std::string::npos) {
+        s.replace(pos, from.length(), to);
+        pos += to.length();
+    }
+}
+
+AllergenMask parseAllergenList(const std::string& text) {
+    std::string lowered = text;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : static_cast<char>(c);
+    });
+    replaceAll(lowered, "tree-nut", "tree nut");
+    replaceAll(lowered, "treenut", "tree nut");
+
+    AllergenMask mask = 0;
+    size_t start = 0;
+    while (start <= lowered.length()) {
+        size_t comma = lowered.find(',', start);
+        if (comma == std::string::npos) {
+            comma = lowered.length();
+        }
+
+        std::string entry = trimCopy(lowered.substr(start, comma - start));
+        if (entry == "none") {
+            return 0;
+        }
+
+        int idx = allergenIndex(entry);
+        if (idx >= 0) {
+            mask |= static_cast<AllergenMask>(1u << idx);
+        }
+        start = comma + 1;
+    }
+    return mask;
+}
+
+std::string allergenMaskToString(AllergenMask mask) {
+    std::vector<std::string> labels;
+    for (int i = 0; i < ALLERGEN_COUNT; i++) {
+        if (mask & (1u << i)) {
+            labels.emplace_back(ALLERGEN_LABELS[i]);
+        }
+    }
+
+    if (labels.empty()) {
+        return "none";
+    }
+
+    std::sort(labels.begin(), labels.end());
+
+    std::string out;
+    for (size_t i = 0; i < labels.size(); i++) {
+        if (i > 0) {
+            out += ", ";
+        }
+        out += labels[i];
+    }
+    return out;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// ===============================================================
+// ALLERGEN LABEL SET
+// The 9 categories used by the prompt, MetricsCalculator and the
+// ground truth column. Bit i of an AllergenMask is ALLERGEN_LABELS[i].
+// ===============================================================
+
+typedef uint16_t AllergenMask;
+
+constexpr int ALLERGEN_COUNT = 9;
+constexpr AllergenMask ALLERGEN_MASK_ALL = (1u << ALLERGEN_COUNT) - 1;
+
+extern const char* const ALLERGEN_LABELS[ALLERGEN_COUNT];
+
+// Index of a canonical label ("tree nut", "milk", ...), or -1
+int allergenIndex(const std::string& label);
+
+// Same normalisation MainActivity applies to raw model output:
+// lowercase, "tree-nut"/"treenut" -> "tree nut", comma split,
+// unknown entries dropped, any "none" -> empty mask
+AllergenMask parseAllergenList(const std::string& text);
+
+// Alphabetically sorted, comma joined ("egg, milk"), or "none"
+std::string allergenMaskToString(AllergenMask mask);
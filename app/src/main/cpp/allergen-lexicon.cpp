@@ -0,0 +1,605 @@
+#include "allergen-lexicon.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <sstream>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SLM_LEXICON_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SLM_LEXICON_SSE2 1
+#endif
+
+// ===============================================================
+// BYTE CLASSES
+// After normalisation only lowercase letters, digits, ' ' and
+// "other" (apostrophes, UTF-8 bytes) remain, so the DFA needs 38
+// columns instead of 256.
+// ===============================================================
+static constexpr int CLASS_OTHER = 0;
+static constexpr int CLASS_SPACE = 37;
+static constexpr int CLASS_COUNT = 38;
+
+static const char LEXICON_DELIMITERS[] = ",;:()[]{}/\\.&-_*+\"!?|%#=<>";
+
+struct ByteTables {
+    uint8_t normalized[256];
+    uint8_t cls[256];
+
+    ByteTables() {
+        for (int c = 0; c < 256; c++) {
+            uint8_t out = static_cast<uint8_t>(c);
+            if (c >= 'A' && c <= 'Z') {
+                out = static_cast<uint8_t>(c | 0x20);
+            }
+            if (c <= 0x20 || (c != 0 && std::strchr(LEXICON_DELIMITERS, c) != nullptr)) {
+                out = ' ';
+            }
+            normalized[c] = out;
+
+            if (c >= 'a' && c <= 'z') {
+                cls[c] = static_cast<uint8_t>(1 + (c - 'a'));
+            } else if (c >= '0' && c <= '9') {
+                cls[c] = static_cast<uint8_t>(27 + (c - '0'));
+            } else if (c == ' ') {
+                cls[c] = CLASS_SPACE;
+            } else {
+                cls[c] = CLASS_OTHER;
+            }
+        }
+    }
+};
+
+static const ByteTables& byteTables() {
+    static const ByteTables tables;
+    return tables;
+}
+
+// ===============================================================
+// SIMD NORMALISATION
+// ===============================================================
+void normalizeIngredientText(const char* src, size_t len, char* dst) {
+    const auto* in = reinterpret_cast<const uint8_t*>(src);
+    auto* out = reinterpret_cast<uint8_t*>(dst);
+    size_t i = 0;
+
+#if defined(SLM_LEXICON_NEON)
+    const uint8x16_t upper_lo = vdupq_n_u8('A');
+    const uint8x16_t upper_hi = vdupq_n_u8('Z');
+    const uint8x16_t case_bit = vdupq_n_u8(0x20);
+    const uint8x16_t space = vdupq_n_u8(' ');
+
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(in + i);
+        uint8x16_t is_upper = vandq_u8(vcgeq_u8(v, upper_lo), vcleq_u8(v, upper_hi));
+        uint8x16_t lowered = vorrq_u8(v, vandq_u8(is_upper, case_bit));
+
+        uint8x16_t is_delim = vcleq_u8(v, space);
+        for (const char* d = LEXICON_DELIMITERS; *d; d++) {
+            is_delim = vorrq_u8(is_delim, vceqq_u8(v, vdupq_n_u8(static_cast<uint8_t>(*d))));
+        }
+
+        vst1q_u8(out + i, vbslq_u8(is_delim, space, lowered));
+    }
+#elif defined(SLM_LEXICON_SSE2)
+    const __m128i upper_lo = _mm_set1_epi8('A' - 1);
+    const __m128i upper_hi = _mm_set1_epi8('Z' + 1);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i space = _mm_set1_epi8(' ');
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(v, upper_lo), _mm_cmplt_epi8(v, upper_hi));
+        __m128i lowered = _mm_or_si128(v, _mm_and_si128(is_upper, case_bit));
+
+        // unsigned v <= 0x20
+        __m128i is_delim = _mm_cmpeq_epi8(_mm_min_epu8(v, space), v);
+        for (const char* d = LEXICON_DELIMITERS; *d; d++) {
+            is_delim = _mm_or_si128(is_delim, _mm_cmpeq_epi8(v, _mm_set1_epi8(*d)));
+        }
+
+        __m128i blended = _mm_or_si128(_mm_and_si128(is_delim, space),
+                                       _mm_andnot_si128(is_delim, lowered));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), blended);
+    }
+#endif
+
+    const ByteTables& tables = byteTables();
+    for (; i < len; i++) {
+        out[i] = tables.normalized[in[i]];
+    }
+}
+
+// Normalise, collapse delimiter runs and trim: the form stored in the trie
+static std::string canonicalPhrase(const std::string& phrase) {
+    std::string norm(phrase.size(), ' ');
+    normalizeIngredientText(phrase.data(), phrase.size(), &norm[0]);
+
+    std::string out;
+    bool prev_space = true;
+    for (char c : norm) {
+        bool is_space = (c == ' ');
+        if (is_space && prev_space) {
+            continue;
+        }
+        out += c;
+        prev_space = is_space;
+    }
+    while (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+    return out;
+}
+
+// ===============================================================
+// BUILT-IN DICTIONARY
+// ===============================================================
+const std::vector<LexiconEntry>& defaultLexiconEntries() {
+    static const std::vector<LexiconEntry> entries = [] {
+        enum { MILK, EGG, PEANUT, TREE_NUT, WHEAT, SOY, FISH, SHELLFISH, SESAME };
+        const LexiconKind S = LexiconKind::STRONG;
+        const LexiconKind W = LexiconKind::WEAK;
+        const LexiconKind B = LexiconKind::BLOCK;
+        const LexiconKind C = LexiconKind::CAUTION;
+
+        return std::vector<LexiconEntry>{
+                // milk
+                {"milk", MILK, S}, {"whole milk", MILK, S}, {"skim milk", MILK, S},
+                {"milk powder", MILK, S}, {"milk solids", MILK, S}, {"whey", MILK, S},
+                {"whey powder", MILK, S}, {"whey protein", MILK, S}, {"casein", MILK, S},
+                {"caseinate", MILK, S}, {"sodium caseinate", MILK, S}, {"lactose", MILK, S},
+                {"butter", MILK, S}, {"buttermilk", MILK, S}, {"cream", MILK, S},
+                {"cheese", MILK, S}, {"yogurt", MILK, S}, {"yoghurt", MILK, S},
+                {"ghee", MILK, S}, {"lactalbumin", MILK, S}, {"curd", MILK, W},
+                {"dairy", MILK, W}, {"margarine", MILK, W},
+                // egg
+                {"egg", EGG, S}, {"eggs", EGG, S}, {"egg white", EGG, S},
+                {"egg yolk", EGG, S}, {"albumen", EGG, S}, {"ovalbumin", EGG, S},
+                {"mayonnaise", EGG, S}, {"meringue", EGG, S}, {"lysozyme", EGG, W},
+                {"albumin", EGG, W},
+                // peanut
+                {"peanut", PEANUT, S}, {"peanuts", PEANUT, S}, {"peanut butter", PEANUT, S},
+                {"peanut oil", PEANUT, S}, {"groundnut", PEANUT, S}, {"groundnuts", PEANUT, S},
+                {"arachis oil", PEANUT, S},
+                // tree nut
+                {"almond", TREE_NUT, S}, {"almonds", TREE_NUT, S}, {"almond milk", TREE_NUT, S},
+                {"almond flour", TREE_NUT, S}, {"cashew", TREE_NUT, S}, {"cashews", TREE_NUT, S},
+                {"walnut", TREE_NUT, S}, {"walnuts", TREE_NUT, S}, {"pecan", TREE_NUT, S},
+                {"pecans", TREE_NUT, S}, {"hazelnut", TREE_NUT, S}, {"hazelnuts", TREE_NUT, S},
+                {"pistachio", TREE_NUT, S}, {"pistachios", TREE_NUT, S},
+                {"macadamia", TREE_NUT, S}, {"brazil nut", TREE_NUT, S},
+                {"brazil nuts", TREE_NUT, S}, {"pine nut", TREE_NUT, S},
+                {"pine nuts", TREE_NUT, S}, {"praline", TREE_NUT, S}, {"marzipan", TREE_NUT, S},
+                {"nut", TREE_NUT, W}, {"nuts", TREE_NUT, W}, {"mixed nuts", TREE_NUT, W},
+                // wheat
+                {"wheat", WHEAT, S}, {"wheat flour", WHEAT, S}, {"whole wheat", WHEAT, S},
+                {"wheat starch", WHEAT, S}, {"wheat gluten", WHEAT, S}, {"semolina", WHEAT, S},
+                {"durum", WHEAT, S}, {"spelt", WHEAT, S}, {"farina", WHEAT, S},
+                {"couscous", WHEAT, S}, {"bulgur", WHEAT, S}, {"seitan", WHEAT, S},
+                {"flour", WHEAT, W}, {"gluten", WHEAT, W}, {"breadcrumbs", WHEAT, W},
+                {"bread", WHEAT, W}, {"pasta", WHEAT, W}, {"noodles", WHEAT, W},
+                // soy
+                {"soy", SOY, S}, {"soya", SOY, S}, {"soybean", SOY, S},
+                {"soybeans", SOY, S}, {"soy lecithin", SOY, S}, {"soya lecithin", SOY, S},
+                {"soy sauce", SOY, S}, {"soy protein", SOY, S}, {"soy milk", SOY, S},
+                {"tofu", SOY, S}, {"edamame", SOY, S}, {"miso", SOY, S},
+                {"tempeh", SOY, S}, {"lecithin", SOY, W},
+                // fish
+                {"fish", FISH, S}, {"fish sauce", FISH, S}, {"anchovy", FISH, S},
+                {"anchovies", FISH, S}, {"salmon", FISH, S}, {"tuna", FISH, S},
+                {"cod", FISH, S}, {"sardine", FISH, S}, {"sardines", FISH, S},
+                {"mackerel", FISH, S}, {"tilapia", FISH, S}, {"haddock", FISH, S},
+                {"trout", FISH, S}, {"pollock", FISH, S}, {"bonito", FISH, S},
+                // shellfish
+                {"shellfish", SHELLFISH, S}, {"shrimp", SHELLFISH, S}, {"shrimps", SHELLFISH, S},
+                {"prawn", SHELLFISH, S}, {"prawns", SHELLFISH, S}, {"crab", SHELLFISH, S},
+                {"lobster", SHELLFISH, S}, {"crayfish", SHELLFISH, S}, {"scallop", SHELLFISH, S},
+                {"scallops", SHELLFISH, S}, {"clam", SHELLFISH, S}, {"clams", SHELLFISH, S},
+                {"mussel", SHELLFISH, S}, {"mussels", SHELLFISH, S}, {"oyster", SHELLFISH, S},
+                {"oysters", SHELLFISH, S}, {"oyster sauce", SHELLFISH, S},
+                // sesame
+                {"sesame", SESAME, S}, {"sesame oil", SESAME, S}, {"sesame seed", SESAME, S},
+                {"sesame seeds", SESAME, S}, {"tahini", SESAME, S}, {"gingelly", SESAME, S},
+                // look-alikes that must not fire the shorter marker inside them
+                {"cocoa butter", -1, B}, {"shea butter", -1, B}, {"coconut milk", -1, B},
+                {"coconut cream", -1, B}, {"oat milk", -1, B}, {"rice milk", -1, B},
+                {"cream of tartar", -1, B}, {"egg plant", -1, B}, {"nutmeg", -1, B},
+                {"coconut", -1, B}, {"coconut flour", -1, B}, {"rice flour", -1, B},
+                {"corn flour", -1, B}, {"sunflower lecithin", -1, B},
+                {"butternut", -1, B}, {"butter beans", -1, B},
+                // precautionary wording
+                {"may contain", -1, C}, {"traces of", -1, C}, {"trace of", -1, C},
+                {"free from", -1, C}, {"free", -1, C}, {"dairy free", -1, C},
+                {"gluten free", -1, C}, {"non dairy", -1, C}, {"substitute", -1, C},
+                {"alternative", -1, C}, {"imitation", -1, C}
+        };
+    }();
+    return entries;
+}
+
+// ===============================================================
+// AUTOMATON
+// ===============================================================
+AllergenLexicon::AllergenLexicon() {
+    build(defaultLexiconEntries());
+}
+
+void AllergenLexicon::build(const std::vector<LexiconEntry>& entries) {
+    const ByteTables& tables = byteTables();
+
+    m_entries.clear();
+    m_pattern_len.clear();
+    m_max_len = 0;
+
+    std::vector<std::array<int32_t, CLASS_COUNT>> go(1);
+    go[0].fill(-1);
+    std::vector<std::vector<int32_t>> outputs(1);
+
+    for (const LexiconEntry& entry : entries) {
+        std::string phrase = canonicalPhrase(entry.phrase);
+        if (phrase.empty()) {
+            continue;
+        }
+
+        int id = static_cast<int>(m_entries.size());
+        m_entries.push_back({phrase, entry.label, entry.kind});
+        m_pattern_len.push_back(static_cast<uint32_t>(phrase.size()));
+        m_max_len = std::max(m_max_len, static_cast<uint32_t>(phrase.size()));
+
+        int32_t state = 0;
+        for (unsigned char c : phrase) {
+            int cls = tables.cls[c];
+            if (go[state][cls] < 0) {
+                go[state][cls] = static_cast<int32_t>(go.size());
+                go.emplace_back();
+                go.back().fill(-1);
+                outputs.emplace_back();
+            }
+            state = go[state][cls];
+        }
+        outputs[state].push_back(id);
+    }
+
+    // BFS: fail links, then fold them into a dense transition table
+    const size_t n_states = go.size();
+    std::vector<int32_t> fail(n_states, 0);
+    m_delta.assign(n_states * CLASS_COUNT, 0);
+
+    std::queue<int32_t> queue;
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        int32_t child = go[0][c];
+        if (child >= 0) {
+            fail[child] = 0;
+            m_delta[c] = child;
+            queue.push(child);
+        }
+    }
+
+    while (!queue.empty()) {
+        int32_t s = queue.front();
+        queue.pop();
+
+        const std::vector<int32_t>& inherited = outputs[fail[s]];
+        outputs[s].insert(outputs[s].end(), inherited.begin(), inherited.end());
+
+        for (int c = 0; c < CLASS_COUNT; c++) {
+            int32_t child = go[s][c];
+            if (child >= 0) {
+                fail[child] = m_delta[fail[s] * CLASS_COUNT + c];
+                m_delta[s * CLASS_COUNT + c] = child;
+                queue.push(child);
+            } else {
+                m_delta[s * CLASS_COUNT + c] = m_delta[fail[s] * CLASS_COUNT + c];
+            }
+        }
+    }
+
+    m_out_offset.assign(n_states, 0);
+    m_out.clear();
+    for (size_t s = 0; s < n_states; s++) {
+        m_out_offset[s] = static_cast<uint32_t>(m_out.size());
+        m_out.insert(m_out.end(), outputs[s].begin(), outputs[s].end());
+        m_out.push_back(-1);
+    }
+}
+
+bool AllergenLexicon::loadFromFile(const std::string& path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Cannot open " + path;
+        return false;
+    }
+
+    std::vector<LexiconEntry> entries;
+    std::string line;
+    int line_no = 0;
+
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::stringstream ss(line);
+        std::string label, phrase, kind;
+        std::getline(ss, label, '\t');
+        std::getline(ss, phrase, '\t');
+        std::getline(ss, kind, '\t');
+
+        if (phrase.empty()) {
+            error = "Line " + std::to_string(line_no) + ": missing phrase";
+            return false;
+        }
+
+        LexiconEntry entry{phrase, -1, LexiconKind::STRONG};
+        if (kind.empty() || kind == "strong") {
+            entry.kind = LexiconKind::STRONG;
+        } else if (kind == "weak") {
+            entry.kind = LexiconKind::WEAK;
+        } else if (kind == "block") {
+            entry.kind = LexiconKind::BLOCK;
+        } else if (kind == "caution") {
+            entry.kind = LexiconKind::CAUTION;
+        } else {
+            error = "Line " + std::to_string(line_no) + ": unknown kind '" + kind + "'";
+            return false;
+        }
+
+        if (entry.kind == LexiconKind::STRONG || entry.kind == LexiconKind::WEAK) {
+            entry.label = allergenIndex(label);
+            if (entry.label < 0) {
+                error = "Line " + std::to_string(line_no) + ": unknown label '" + label + "'";
+                return false;
+            }
+        }
+
+        entries.push_back(entry);
+    }
+
+    if (entries.empty()) {
+        error = "No entries in " + path;
+        return false;
+    }
+
+    build(entries);
+    return true;
+}
+
+LexiconScan AllergenLexicon::scan(const std::string& ingredients) const {
+    auto t_start = std::chrono::steady_clock::now();
+
+    LexiconScan result;
+    const size_t len = ingredients.size();
+    if (len == 0 || m_entries.empty()) {
+        return result;
+    }
+
+    thread_local std::vector<char> norm;
+    norm.resize(len);
+    normalizeIngredientText(ingredients.data(), len, norm.data());
+
+    // Delimiter runs are collapsed on the fly, so a match start is
+    // recovered from the positions of the last m_max_len consumed bytes
+    uint32_t ring_size = 1;
+    while (ring_size < m_max_len + 1) {
+        ring_size <<= 1;
+    }
+    thread_local std::vector<uint32_t> ring;
+    ring.resize(ring_size);
+    const uint32_t ring_mask = ring_size - 1;
+
+    const ByteTables& tables = byteTables();
+    std::vector<LexiconHit> candidates;
+    std::vector<LexiconHit> cautions;
+
+    int32_t state = 0;
+    bool prev_space = true;
+    uint32_t consumed = 0;
+
+    for (uint32_t i = 0; i < len; i++) {
+        int cls = tables.cls[static_cast<unsigned char>(norm[i])];
+        bool is_space = (cls == CLASS_SPACE);
+        if (is_space && prev_space) {
+            continue;
+        }
+        prev_space = is_space;
+
+        ring[consumed & ring_mask] = i;
+        consumed++;
+        state = m_delta[state * CLASS_COUNT + cls];
+
+        for (uint32_t o = m_out_offset[state]; m_out[o] >= 0; o++) {
+            int id = m_out[o];
+            uint32_t start = ring[(consumed - m_pattern_len[id]) & ring_mask];
+
+            bool left_ok = (start == 0 || norm[start - 1] == ' ');
+            bool right_ok = (i + 1 == len || norm[i + 1] == ' ');
+            if (!left_ok || !right_ok) {
+                continue;
+            }
+
+            LexiconHit hit{start, i + 1, id};
+            if (m_entries[id].kind == LexiconKind::CAUTION) {
+                cautions.push_back(hit);
+            } else {
+                candidates.push_back(hit);
+            }
+        }
+    }
+
+    // Leftmost-longest: "peanut butter" wins over "butter",
+    // "cocoa butter" (BLOCK) swallows it without a label
+    std::sort(candidates.begin(), candidates.end(), [](const LexiconHit& a, const LexiconHit& b) {
+        if (a.start != b.start) return a.start < b.start;
+        return a.end > b.end;
+    });
+
+    uint32_t last_end = 0;
+    for (const LexiconHit& hit : candidates) {
+        if (hit.start < last_end) {
+            continue;
+        }
+        last_end = hit.end;
+
+        const LexiconEntry& entry = m_entries[hit.entry];
+        if (entry.kind == LexiconKind::BLOCK) {
+            continue;
+        }
+
+        AllergenMask bit = static_cast<AllergenMask>(1u << entry.label);
+        if (entry.kind == LexiconKind::STRONG) {
+            result.strong_mask |= bit;
+            result.strong_hits++;
+        } else {
+            result.weak_mask |= bit;
+        }
+        result.hits.push_back(hit);
+    }
+
+    if (!cautions.empty()) {
+        result.cautionary = true;
+        result.hits.insert(result.hits.end(), cautions.begin(), cautions.end());
+        std::sort(result.hits.begin(), result.hits.end(), [](const LexiconHit& a, const LexiconHit& b) {
+            return a.start < b.start;
+        });
+    }
+
+    auto t_end = std::chrono::steady_clock::now();
+    result.scan_us = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
+    return result;
+}
+
+// ===============================================================
+// GATING POLICY
+// ===============================================================
+LexiconDecision decideLexiconGate(const LexiconScan& scan, const LexiconGatePolicy& policy) {
+    if (scan.cautionary) {
+        return policy.hint_on_weak ? LexiconDecision::HINT : LexiconDecision::FULL;
+    }
+
+    if (scan.mask() == 0) {
+        return policy.trust_empty ? LexiconDecision::TRUST : LexiconDecision::FULL;
+    }
+
+    AllergenMask weak_only = scan.weak_mask & ~scan.strong_mask;
+    if (policy.trust_strong && weak_only == 0 && scan.strong_hits >= policy.min_strong_hits) {
+        return LexiconDecision::TRUST;
+    }
+
+    return policy.hint_on_weak ? LexiconDecision::HINT : LexiconDecision::FULL;
+}
+
+const char* lexiconDecisionName(LexiconDecision decision) {
+    switch (decision) {
+        case LexiconDecision::TRUST: return "TRUST";
+        case LexiconDecision::HINT:  return "HINT";
+        case LexiconDecision::FULL:  return "FULL";
+    }
+    return "FULL";
+}
+
+std::string formatLexiconHints(const AllergenLexicon& lexicon, const LexiconScan& scan,
+                               const std::string& ingredients) {
+    std::vector<std::string> seen;
+    std::string out;
+
+    for (const LexiconHit& hit : scan.hits) {
+        const LexiconEntry& entry = lexicon.entries()[hit.entry];
+        if (entry.label < 0) {
+            continue;
+        }
+
+        std::string item = ingredients.substr(hit.start, hit.end - hit.start)
+                           + " (" + ALLERGEN_LABELS[entry.label] + ")";
+        if (std::find(seen.begin(), seen.end(), item) != seen.end()) {
+            continue;
+        }
+        seen.push_back(item);
+
+        if (!out.empty()) {
+            out += ", ";
+        }
+        out += item;
+    }
+    return out;
+}
+
+std::string formatLexiconEvidence(const AllergenLexicon& lexicon, const LexiconScan& scan,
+                                  const std::string& ingredients) {
+    std::stringstream ss;
+    bool first = true;
+
+    for (const LexiconHit& hit : scan.hits) {
+        const LexiconEntry& entry = lexicon.entries()[hit.entry];
+        if (!first) {
+            ss << ",";
+        }
+        first = false;
+
+        ss << (entry.label >= 0 ? ALLERGEN_LABELS[entry.label] : "caution")
+           << (entry.kind == LexiconKind::WEAK ? "?" : "")
+           << ":" << ingredients.substr(hit.start, hit.end - hit.start)
+           << "@" << hit.start << "-" << hit.end;
+    }
+    return ss.str();
+}
+
+// ===============================================================
+// GATE STATISTICS
+// ===============================================================
+void LexiconGateStats::record(LexiconDecision decision, long scan_us, long model_ms) {
+    items++;
+    scan_us_total += scan_us;
+
+    switch (decision) {
+        case LexiconDecision::TRUST:
+            trusted++;
+            break;
+        case LexiconDecision::HINT:
+            hinted++;
+            model_ms_hint += model_ms;
+            break;
+        case LexiconDecision::FULL:
+            full++;
+            model_ms_full += model_ms;
+            break;
+    }
+}
+
+double LexiconGateStats::meanFullModelMs() const {
+    if (full > 0) {
+        return static_cast<double>(model_ms_full) / full;
+    }
+    if (hinted > 0) {
+        return static_cast<double>(model_ms_hint) / hinted;
+    }
+    return 0.0;
+}
+
+double LexiconGateStats::estimatedModelMsSaved() const {
+    return trusted * meanFullModelMs();
+}
+
+std::string LexiconGateStats::toString() const {
+    double spent = static_cast<double>(model_ms_full + model_ms_hint);
+    double saved = estimatedModelMsSaved();
+    double saved_pct = (spent + saved) > 0 ? 100.0 * saved / (spent + saved) : 0.0;
+
+    std::stringstream ss;
+    ss << "ITEMS=" << items
+       << ";TRUSTED=" << trusted
+       << ";HINTED=" << hinted
+       << ";FULL=" << full
+       << ";SCAN_US=" << scan_us_total
+       << ";MODEL_MS_FULL=" << model_ms_full
+       << ";MODEL_MS_HINT=" << model_ms_hint
+       << ";EST_MODEL_MS_SAVED=" << static_cast<long>(saved)
+       << ";EST_MODEL_TIME_SAVED_PCT=" << static_cast<long>(saved_pct);
+    return ss.str();
+}
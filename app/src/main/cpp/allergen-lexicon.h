@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "allergen-labels.h"
+
+// ===============================================================
+// INGREDIENT LEXICON FAST PATH
+// Aho-Corasick automaton over an allergen synonym dictionary.
+// One pass over the (SIMD-normalised) ingredient string yields a
+// candidate label mask plus the evidence span for every hit.
+// ===============================================================
+
+enum class LexiconKind : uint8_t {
+    STRONG,   // unambiguous marker ("whey", "soy lecithin")
+    WEAK,     // usually but not always the allergen ("flour", "lecithin")
+    BLOCK,    // shadows shorter hits inside it ("cocoa butter", "coconut milk")
+    CAUTION   // precautionary wording ("may contain", "free from")
+};
+
+struct LexiconEntry {
+    std::string phrase;
+    int label;          // index into ALLERGEN_LABELS, -1 for BLOCK/CAUTION
+    LexiconKind kind;
+};
+
+struct LexiconHit {
+    uint32_t start;     // byte offsets into the original ingredient string
+    uint32_t end;
+    int entry;          // index into the dictionary
+};
+
+struct LexiconScan {
+    AllergenMask strong_mask = 0;
+    AllergenMask weak_mask = 0;
+    int strong_hits = 0;
+    bool cautionary = false;
+    std::vector<LexiconHit> hits;   // resolved, non-overlapping, in text order
+    long scan_us = 0;
+
+    AllergenMask mask() const { return strong_mask | weak_mask; }
+};
+
+enum class LexiconDecision {
+    TRUST,   // answer from the lexicon, skip the model
+    HINT,    // run the model with the lexicon hits in the prompt
+    FULL     // run the plain predictAllergens path
+};
+
+struct LexiconGatePolicy {
+    bool trust_strong = true;    // strong-only hits with no caution -> TRUST
+    bool trust_empty = false;    // no hits at all -> TRUST "none"
+    bool hint_on_weak = true;    // weak or cautionary hits -> HINT instead of FULL
+    int min_strong_hits = 1;
+};
+
+class AllergenLexicon {
+public:
+    AllergenLexicon();
+
+    // Replace the built-in dictionary with a TSV file:
+    //   <label or -> <TAB> <phrase> <TAB> strong|weak|block|caution
+    bool loadFromFile(const std::string& path, std::string& error);
+    void build(const std::vector<LexiconEntry>& entries);
+
+    LexiconScan scan(const std::string& ingredients) const;
+
+    const std::vector<LexiconEntry>& entries() const { return m_entries; }
+    size_t stateCount() const { return m_out_offset.size(); }
+
+private:
+    std::vector<LexiconEntry> m_entries;
+    std::vector<uint32_t> m_pattern_len;     // normalised length per entry
+    std::vector<int32_t> m_delta;            // dense DFA: state * CLASS_COUNT + class
+    std::vector<uint32_t> m_out_offset;      // per state, into m_out
+    std::vector<int32_t> m_out;              // entry ids, terminated per state by -1
+    uint32_t m_max_len = 0;
+};
+
+const std::vector<LexiconEntry>& defaultLexiconEntries();
+
+// Lowercase ASCII and map every delimiter byte to ' ', length preserving
+void normalizeIngredientText(const char* src, size_t len, char* dst);
+
+LexiconDecision decideLexiconGate(const LexiconScan& scan, const LexiconGatePolicy& policy);
+const char* lexiconDecisionName(LexiconDecision decision);
+
+// "whey (milk), soy lecithin (soy)" for the HINT prompt
+std::string formatLexiconHints(const AllergenLexicon& lexicon, const LexiconScan& scan,
+                               const std::string& ingredients);
+
+// "milk:whey@12-16,soy:soy lecithin@30-42" for logs and results
+std::string formatLexiconEvidence(const AllergenLexicon& lexicon, const LexiconScan& scan,
+                                  const std::string& ingredients);
+
+// ===============================================================
+// GATE STATISTICS
+// Model time of HINT/FULL items is measured; the time a TRUST item
+// would have cost is estimated from the mean of FULL items.
+// ===============================================================
+struct LexiconGateStats {
+    long items = 0;
+    long trusted = 0;
+    long hinted = 0;
+    long full = 0;
+    long scan_us_total = 0;
+    long model_ms_full = 0;
+    long model_ms_hint = 0;
+
+    void record(LexiconDecision decision, long scan_us, long model_ms);
+    double meanFullModelMs() const;
+    double estimatedModelMsSaved() const;
+    std::string toString() const;
+};
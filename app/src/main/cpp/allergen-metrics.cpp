@@ -0,0 +1,307 @@
+#include "allergen-metrics.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <sstream>
+
+#include "slm-trace.h"
+
+// ===============================================================
+// INGREDIENT EVIDENCE
+// ===============================================================
+
+// Same keywords as MetricsCalculator.checkHallucinations, in
+// ALLERGEN_LABELS order
+static const char* const EVIDENCE_KEYWORDS[ALLERGEN_COUNT][9] = {
+        {"milk", "cream", "butter", "whey", "casein", "lactose"},
+        {"egg", "albumin", "mayonnaise"},
+        {"peanut", "groundnut"},
+        {"nut", "almond", "cashew", "walnut", "pecan", "pistachio", "hazelnut", "macadamia"},
+        {"wheat", "flour", "gluten", "semolina"},
+        {"soy", "soya", "lecithin", "tofu", "edamame"},
+        {"fish", "anchov", "sardine", "tuna", "salmon"},
+        {"shellfish", "shrimp", "crab", "lobster", "prawn", "clam", "oyster"},
+        {"sesame", "tahini"},
+};
+
+AllergenMask ingredientEvidenceMask(const std::string& ingredients) {
+    std::string lowered = ingredients;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : static_cast<char>(c);
+    });
+
+    AllergenMask mask = 0;
+    for (int label = 0; label < ALLERGEN_COUNT; label++) {
+        for (const char* keyword : EVIDENCE_KEYWORDS[label]) {
+            if (keyword == nullptr) {
+                break;
+            }
+            if (lowered.find(keyword) != std::string::npos) {
+                mask |= static_cast<AllergenMask>(1u << label);
+                break;
+            }
+        }
+    }
+    return mask;
+}
+
+// ===============================================================
+// PER ITEM
+// ===============================================================
+static double ratio(long num, long den) {
+    return den > 0 ? static_cast<double>(num) / den : 0.0;
+}
+
+ItemMetrics computeItemMetrics(AllergenMask truth, AllergenMask predicted, AllergenMask evidence) {
+    ItemMetrics m;
+    m.truth = truth & ALLERGEN_MASK_ALL;
+    m.predicted = predicted & ALLERGEN_MASK_ALL;
+    m.evidence = evidence & ALLERGEN_MASK_ALL;
+
+    m.tp = __builtin_popcount(m.predicted & m.truth);
+    m.fp = __builtin_popcount(m.predicted & ~m.truth & ALLERGEN_MASK_ALL);
+    m.fn = __builtin_popcount(~m.predicted & m.truth & ALLERGEN_MASK_ALL);
+    m.tn = ALLERGEN_COUNT - m.tp - m.fp - m.fn;
+
+    m.precision = ratio(m.tp, m.tp + m.fp);
+    m.recall = ratio(m.tp, m.tp + m.fn);
+    m.f1 = ratio(2 * m.tp, 2 * m.tp + m.fp + m.fn);
+    m.accuracy = ratio(m.tp + m.tn, ALLERGEN_COUNT);
+    m.hamming_loss = ratio(m.fp + m.fn, ALLERGEN_COUNT);
+    m.fnr = ratio(m.fn, m.tp + m.fn);
+
+    m.exact_match = m.predicted == m.truth;
+    m.hallucinated = m.predicted & ~m.evidence & ALLERGEN_MASK_ALL;
+    m.over_predicted = m.predicted & ~m.truth & ALLERGEN_MASK_ALL;
+    m.abstention = m.predicted == 0;
+    m.abstention_correct = m.abstention && m.truth == 0;
+    return m;
+}
+
+// Like allergenMaskToString, but empty rather than "none"
+static std::string labelList(AllergenMask mask) {
+    return mask == 0 ? std::string() : allergenMaskToString(mask);
+}
+
+std::string ItemMetrics::toString() const {
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "TP=%d;FP=%d;FN=%d;TN=%d;PRECISION=%.6f;RECALL=%.6f;F1=%.6f;ACCURACY=%.6f"
+             ";EXACT=%d;HAMMING=%.6f;FNR=%.6f;ABSTAIN=%d;ABSTAIN_CORRECT=%d"
+             ";TRUTH_MASK=%d;PRED_MASK=%d;EVIDENCE_MASK=%d;HALLUCINATED=",
+             tp, fp, fn, tn, precision, recall, f1, accuracy,
+             exact_match ? 1 : 0, hamming_loss, fnr, abstention ? 1 : 0, abstention_correct ? 1 : 0,
+             truth, predicted, evidence);
+    return buf + labelList(hallucinated) + ";OVER_PREDICTED=" + labelList(over_predicted);
+}
+
+// ===============================================================
+// RUN SUMMARY
+// ===============================================================
+
+// Byte i of SPREAD[x] is bit i of x, so adding SPREAD[] values counts
+// eight labels at once; a byte lane overflows after 255 items
+static const std::array<uint64_t, 256>& spreadTable() {
+    static const std::array<uint64_t, 256> table = []() {
+        std::array<uint64_t, 256> t{};
+        for (int x = 0; x < 256; x++) {
+            for (int bit = 0; bit < 8; bit++) {
+                if (x & (1 << bit)) {
+                    t[x] |= 1ull << (8 * bit);
+                }
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+// 9-bit popcount; __builtin_popcount is a libcall on baseline x86-64
+static const std::array<uint8_t, 512>& popcountTable() {
+    static const std::array<uint8_t, 512> table = []() {
+        std::array<uint8_t, 512> t{};
+        for (int x = 0; x < 512; x++) {
+            t[x] = static_cast<uint8_t>(__builtin_popcount(x));
+        }
+        return t;
+    }();
+    return table;
+}
+
+static void flushLanes(uint64_t lanes, long high, long* counts) {
+    for (int bit = 0; bit < 8; bit++) {
+        counts[bit] += static_cast<long>((lanes >> (8 * bit)) & 0xff);
+    }
+    counts[8] += high;
+}
+
+static_assert(ALLERGEN_COUNT == 9, "lane layout assumes 8 spread labels plus one");
+
+MetricsSummary computeMetricsSummary(const AllergenMask* truth, const AllergenMask* predicted,
+                                     const AllergenMask* evidence, size_t n) {
+    const int64_t t0 = traceNowUs();
+    const std::array<uint64_t, 256>& spread = spreadTable();
+    const std::array<uint8_t, 512>& bits = popcountTable();
+
+    MetricsSummary s;
+    s.items = static_cast<long>(n);
+
+    // Item count per (tp, fp, fn); each is 0..9
+    std::array<uint32_t, 1000> histogram{};
+    // Locals, not s.*: stores to the histogram would otherwise force
+    // every counter back to memory on each item
+    long exact = 0, over = 0, abstain = 0, abstain_correct = 0, hallucinated = 0;
+
+    for (size_t block = 0; block < n; block += 255) {
+        const size_t end = std::min(n, block + 255);
+        uint64_t lane_tp = 0, lane_fp = 0, lane_fn = 0;
+        long high_tp = 0, high_fp = 0, high_fn = 0;
+
+        for (size_t i = block; i < end; i++) {
+            const unsigned t = truth[i] & ALLERGEN_MASK_ALL;
+            const unsigned p = predicted[i] & ALLERGEN_MASK_ALL;
+            const unsigned both = t & p;
+            const unsigned only_p = p & ~t;
+            const unsigned only_t = t & ~p;
+
+            lane_tp += spread[both & 0xff];
+            lane_fp += spread[only_p & 0xff];
+            lane_fn += spread[only_t & 0xff];
+            high_tp += both >> 8;
+            high_fp += only_p >> 8;
+            high_fn += only_t >> 8;
+
+            histogram[bits[both] * 100 + bits[only_p] * 10 + bits[only_t]]++;
+            exact += t == p;
+            over += only_p != 0;
+            abstain += p == 0;
+            abstain_correct += (p | t) == 0;
+            if (evidence != nullptr) {
+                hallucinated += (p & ~evidence[i] & ALLERGEN_MASK_ALL) != 0;
+            }
+        }
+
+        flushLanes(lane_tp, high_tp, s.tp);
+        flushLanes(lane_fp, high_fp, s.fp);
+        flushLanes(lane_fn, high_fn, s.fn);
+    }
+
+    s.exact_matches = exact;
+    s.over_prediction_items = over;
+    s.abstentions = abstain;
+    s.abstentions_correct = abstain_correct;
+    s.hallucination_items = hallucinated;
+    for (int label = 0; label < ALLERGEN_COUNT; label++) {
+        s.tn[label] = s.items - s.tp[label] - s.fp[label] - s.fn[label];
+    }
+
+    if (n > 0) {
+        double sum_precision = 0.0, sum_recall = 0.0, sum_f1 = 0.0, sum_fnr = 0.0;
+        for (int cell = 0; cell < 1000; cell++) {
+            const double count = histogram[cell];
+            if (count == 0) {
+                continue;
+            }
+            const int tp = cell / 100, fp = (cell / 10) % 10, fn = cell % 10;
+            sum_precision += count * ratio(tp, tp + fp);
+            sum_recall += count * ratio(tp, tp + fn);
+            sum_f1 += count * ratio(2 * tp, 2 * tp + fp + fn);
+            sum_fnr += count * ratio(fn, tp + fn);
+        }
+        s.mean_precision = sum_precision / n;
+        s.mean_recall = sum_recall / n;
+        s.mean_f1 = sum_f1 / n;
+        s.mean_fnr = sum_fnr / n;
+        s.hamming_loss = static_cast<double>(s.totalFp() + s.totalFn()) / (static_cast<double>(n) * ALLERGEN_COUNT);
+        s.mean_accuracy = 1.0 - s.hamming_loss;
+    }
+
+    s.compute_us = static_cast<double>(traceNowUs() - t0);
+    return s;
+}
+
+long MetricsSummary::totalTp() const {
+    long total = 0;
+    for (long v : tp) {
+        total += v;
+    }
+    return total;
+}
+
+long MetricsSummary::totalFp() const {
+    long total = 0;
+    for (long v : fp) {
+        total += v;
+    }
+    return total;
+}
+
+long MetricsSummary::totalFn() const {
+    long total = 0;
+    for (long v : fn) {
+        total += v;
+    }
+    return total;
+}
+
+double MetricsSummary::microPrecision() const {
+    return ratio(totalTp(), totalTp() + totalFp());
+}
+
+double MetricsSummary::microRecall() const {
+    return ratio(totalTp(), totalTp() + totalFn());
+}
+
+double MetricsSummary::microF1() const {
+    return ratio(2 * totalTp(), 2 * totalTp() + totalFp() + totalFn());
+}
+
+double MetricsSummary::labelF1(int label) const {
+    return ratio(2 * tp[label], 2 * tp[label] + fp[label] + fn[label]);
+}
+
+double MetricsSummary::macroF1() const {
+    double sum = 0.0;
+    int labels = 0;
+    for (int label = 0; label < ALLERGEN_COUNT; label++) {
+        if (tp[label] + fp[label] + fn[label] > 0) {
+            sum += labelF1(label);
+            labels++;
+        }
+    }
+    return labels > 0 ? sum / labels : 0.0;
+}
+
+std::string MetricsSummary::toString() const {
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "ITEMS=%ld;EMR=%.6f;MICRO_P=%.6f;MICRO_R=%.6f;MICRO_F1=%.6f;MACRO_F1=%.6f;MEAN_F1=%.6f"
+             ";MEAN_PRECISION=%.6f;MEAN_RECALL=%.6f;MEAN_ACCURACY=%.6f;MEAN_FNR=%.6f;HAMMING_LOSS=%.6f"
+             ";HALLUCINATION_RATE=%.6f;OVER_PREDICTION_RATE=%.6f;ABSTENTIONS=%ld;ABSTENTION_ACCURACY=%.6f",
+             items, ratio(exact_matches, items), microPrecision(), microRecall(), microF1(), macroF1(), mean_f1,
+             mean_precision, mean_recall, mean_accuracy, mean_fnr, hamming_loss,
+             ratio(hallucination_items, items), ratio(over_prediction_items, items),
+             abstentions, ratio(abstentions_correct, abstentions));
+
+    std::stringstream ss;
+    ss << buf;
+    auto column = [&](const char* key, const long* values) {
+        ss << ";" << key << "=";
+        for (int label = 0; label < ALLERGEN_COUNT; label++) {
+            ss << (label ? "," : "") << values[label];
+        }
+    };
+    column("LABEL_TP", tp);
+    column("LABEL_FP", fp);
+    column("LABEL_FN", fn);
+
+    ss << ";LABEL_F1=";
+    for (int label = 0; label < ALLERGEN_COUNT; label++) {
+        snprintf(buf, sizeof(buf), "%s%.4f", label ? "," : "", labelF1(label));
+        ss << buf;
+    }
+    snprintf(buf, sizeof(buf), ";COMPUTE_US=%.0f", compute_us);
+    ss << buf;
+    return ss.str();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "allergen-labels.h"
+
+// ===============================================================
+// ALLERGEN METRICS
+// MetricsCalculator's per-item quality metrics and the dashboard's
+// per-run aggregates, computed on AllergenMask pairs. Per-item
+// counts are popcounts. Run totals are a single pass: per-label
+// counts are summed SWAR-style (each label bit spread into its own
+// byte lane, flushed every 255 items) and the per-item means come
+// from a histogram over (tp, fp, fn), which has only 1000 cells.
+// ===============================================================
+
+struct ItemMetrics {
+    int tp = 0;
+    int fp = 0;
+    int fn = 0;
+    int tn = 0;
+    double precision = 0.0;     // 0 when nothing was predicted
+    double recall = 0.0;        // 0 when the ground truth is empty
+    double f1 = 0.0;
+    double accuracy = 0.0;
+    double hamming_loss = 0.0;
+    double fnr = 0.0;
+    bool exact_match = false;
+    AllergenMask truth = 0;
+    AllergenMask predicted = 0;
+    AllergenMask evidence = 0;
+    AllergenMask hallucinated = 0;      // predicted without keyword evidence
+    AllergenMask over_predicted = 0;    // predicted but not in the ground truth
+    bool abstention = false;            // predicted "none"
+    bool abstention_correct = false;    // ... and the ground truth is "none"
+
+    // "TP=..;FP=..;FN=..;TN=..;PRECISION=..;RECALL=..;F1=..;ACCURACY=..;
+    //  EXACT=0|1;HAMMING=..;FNR=..;ABSTAIN=0|1;ABSTAIN_CORRECT=0|1;
+    //  TRUTH_MASK=..;PRED_MASK=..;EVIDENCE_MASK=..;
+    //  HALLUCINATED=egg, milk;OVER_PREDICTED=.." (lists empty when none)
+    std::string toString() const;
+};
+
+// Labels whose keywords (MetricsCalculator's hallucination table)
+// occur in the ingredient text
+AllergenMask ingredientEvidenceMask(const std::string& ingredients);
+
+ItemMetrics computeItemMetrics(AllergenMask truth, AllergenMask predicted, AllergenMask evidence);
+
+struct MetricsSummary {
+    long items = 0;
+    long tp[ALLERGEN_COUNT] = {};
+    long fp[ALLERGEN_COUNT] = {};
+    long fn[ALLERGEN_COUNT] = {};
+    long tn[ALLERGEN_COUNT] = {};
+    long exact_matches = 0;
+    long hallucination_items = 0;       // items with at least one hallucinated label
+    long over_prediction_items = 0;
+    long abstentions = 0;
+    long abstentions_correct = 0;
+    double mean_precision = 0.0;        // per-item means, as the dashboard shows them
+    double mean_recall = 0.0;
+    double mean_f1 = 0.0;
+    double mean_accuracy = 0.0;
+    double mean_fnr = 0.0;
+    double hamming_loss = 0.0;
+    double compute_us = 0.0;
+
+    long totalTp() const;
+    long totalFp() const;
+    long totalFn() const;
+    double microPrecision() const;
+    double microRecall() const;
+    double microF1() const;
+    double labelF1(int label) const;
+    // Mean label F1 over labels that occur in the truth or the predictions
+    double macroF1() const;
+
+    // "ITEMS=..;EMR=..;MICRO_P=..;MICRO_R=..;MICRO_F1=..;MACRO_F1=..;MEAN_F1=..;
+    //  MEAN_PRECISION=..;MEAN_RECALL=..;MEAN_ACCURACY=..;MEAN_FNR=..;HAMMING_LOSS=..;
+    //  HALLUCINATION_RATE=..;OVER_PREDICTION_RATE=..;ABSTENTIONS=..;ABSTENTION_ACCURACY=..;
+    //  LABEL_TP=a,b,..;LABEL_FP=..;LABEL_FN=..;LABEL_F1=..;COMPUTE_US=.."
+    // with LABEL_* in ALLERGEN_LABELS order
+    std::string toString() const;
+};
+
+// evidence may be null, in which case hallucination_items stays 0
+MetricsSummary computeMetricsSummary(const AllergenMask* truth, const AllergenMask* predicted,
+                                     const AllergenMask* evidence, size_t n);
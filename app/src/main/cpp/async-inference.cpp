@@ -0,0 +1,237 @@
+#include "async-inference.h"
+
+#include <chrono>
+#include <cstdio>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+const char* inferenceEventName(InferenceEventType type) {
+    switch (type) {
+        case InferenceEventType::FIRST_TOKEN: return "FIRST_TOKEN";
+        case InferenceEventType::TOKEN:       return "TOKEN";
+        case InferenceEventType::DONE:        return "DONE";
+        case InferenceEventType::CANCELLED:   return "CANCELLED";
+    }
+    return "?";
+}
+
+std::string InferenceEvent::toString() const {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "HANDLE=%ld;EVENT=%s;INDEX=%d;SINCE_SUBMIT_MS=%.1f|",
+             handle, inferenceEventName(type), index, since_submit_us / 1000.0);
+    return buf + text;
+}
+
+// ===============================================================
+// EVENT RING
+// ===============================================================
+static size_t roundUpPow2(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+EventRing::EventRing(size_t capacity)
+        : m_slots(roundUpPow2(capacity)), m_mask(roundUpPow2(capacity) - 1) {}
+
+bool EventRing::push(InferenceEvent&& event) {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+        return false;
+    }
+    m_slots[tail & m_mask] = std::move(event);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool EventRing::pop(InferenceEvent& event) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = std::move(m_slots[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool EventRing::empty() const {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+// ===============================================================
+// WORKER
+// ===============================================================
+bool AsyncInference::start(Runner runner) {
+    if (running()) {
+        return true;
+    }
+    m_runner = std::move(runner);
+    m_stop = false;
+    m_thread = std::thread(&AsyncInference::run, this);
+    return true;
+}
+
+void AsyncInference::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_cancel_handle = m_running_handle.load();
+    m_work.notify_all();
+    m_thread.join();
+}
+
+long AsyncInference::submit(const std::string& ingredients, const PredictionOptions& options) {
+    if (!running()) {
+        return -1;
+    }
+    Request request;
+    request.ingredients = ingredients;
+    request.options = options;
+    request.submit_us = traceNowUs();
+    long handle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        handle = m_next_handle++;
+        request.handle = handle;
+        m_queue.push_back(std::move(request));
+    }
+    m_work.notify_one();
+    return handle;
+}
+
+bool AsyncInference::cancel(long handle) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+        if (it->handle == handle) {
+            long long submit_us = it->submit_us;
+            m_queue.erase(it);
+            InferenceEvent event;
+            event.handle = handle;
+            event.type = InferenceEventType::CANCELLED;
+            event.t_us = traceNowUs();
+            event.since_submit_us = event.t_us - submit_us;
+            // The worker may publish concurrently; hand the event to it
+            m_cancelled.push_back(std::move(event));
+            m_work.notify_one();
+            return true;
+        }
+    }
+    if (m_running_handle.load() == handle) {
+        // Stops at the next token; the caller may touch the session
+        // once this returns
+        m_cancel_handle = handle;
+        m_idle.wait(lock, [this, handle]() { return m_running_handle.load() != handle; });
+        return true;
+    }
+    return false;
+}
+
+size_t AsyncInference::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size() + (m_running_handle.load() != 0 ? 1 : 0);
+}
+
+// Single producer: only the worker thread calls this
+void AsyncInference::publish(InferenceEvent&& event, bool must_deliver) {
+    while (!m_events.push(std::move(event))) {
+        // A cancelled request's consumer may be waiting in cancel()
+        if (!must_deliver || m_stop || m_cancel_handle.load() == event.handle) {
+            m_dropped++;
+            return;
+        }
+        // Consumer fell behind; completion events are never dropped
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard<std::mutex> lock(m_wake_mutex);
+    m_wake.notify_one();
+}
+
+void AsyncInference::run() {
+    traceSetThreadName("inference_worker");
+
+    while (true) {
+        Request request;
+        std::vector<InferenceEvent> cancelled;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work.wait(lock, [this]() { return m_stop || !m_queue.empty() || !m_cancelled.empty(); });
+            cancelled.swap(m_cancelled);
+            if (m_stop) {
+                return;
+            }
+            if (!m_queue.empty()) {
+                request = std::move(m_queue.front());
+                m_queue.pop_front();
+                m_running_handle = request.handle;
+            }
+        }
+        for (InferenceEvent& event : cancelled) {
+            publish(std::move(event), true);
+        }
+        if (request.handle == 0) {
+            continue;
+        }
+
+        SLM_TRACE_SCOPE("async_request", request.handle);
+        const long handle = request.handle;
+        const long long submit_us = request.submit_us;
+
+        PredictionOptions options = request.options;
+        auto caller_on_token = options.on_token;
+        options.on_token = [&](int index, const std::string& piece, long long t_us) {
+            InferenceEvent event;
+            event.handle = handle;
+            event.type = index == 0 ? InferenceEventType::FIRST_TOKEN : InferenceEventType::TOKEN;
+            event.index = index;
+            event.t_us = t_us;
+            event.since_submit_us = t_us - submit_us;
+            event.text = piece;
+            publish(std::move(event), index == 0);
+
+            if (caller_on_token && !caller_on_token(index, piece, t_us)) {
+                return false;
+            }
+            return m_cancel_handle.load() != handle;
+        };
+
+        std::string result = m_runner(request.ingredients, options);
+
+        InferenceEvent done;
+        done.handle = handle;
+        done.type = m_cancel_handle.load() == handle ? InferenceEventType::CANCELLED : InferenceEventType::DONE;
+        done.t_us = traceNowUs();
+        done.since_submit_us = done.t_us - submit_us;
+        done.text = std::move(result);
+        // Before publishing: a cancel() waiting here may be the consumer
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running_handle = 0;
+        }
+        m_idle.notify_all();
+        publish(std::move(done), true);
+    }
+}
+
+// ===============================================================
+// CONSUMER
+// ===============================================================
+bool AsyncInference::poll(InferenceEvent& event) {
+    return m_events.pop(event);
+}
+
+bool AsyncInference::wait(InferenceEvent& event, int timeout_ms) {
+    if (m_events.pop(event)) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(m_wake_mutex);
+    m_wake.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return !m_events.empty(); });
+    return m_events.pop(event);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "slm-engine.h"
+
+// ===============================================================
+// ASYNC INFERENCE
+// submit() queues a request and returns a handle at once; one
+// persistent worker thread runs the requests in order and publishes
+// FIRST_TOKEN / TOKEN / DONE events on a single-producer single-
+// consumer ring, so the decode loop never blocks on (or calls into)
+// the consumer. The consumer polls, optionally sleeping until an
+// event is published.
+// ===============================================================
+
+enum class InferenceEventType { FIRST_TOKEN, TOKEN, DONE, CANCELLED };
+
+const char* inferenceEventName(InferenceEventType type);
+
+struct InferenceEvent {
+    long handle = 0;
+    InferenceEventType type = InferenceEventType::TOKEN;
+    int index = -1;             // token index (TOKEN / FIRST_TOKEN)
+    long long t_us = 0;         // traceNowUs() at publication
+    long long since_submit_us = 0;
+    std::string text;           // token piece, or the full result for DONE
+
+    // "HANDLE=..;EVENT=..;INDEX=..;SINCE_SUBMIT_MS=..|text"
+    std::string toString() const;
+};
+
+// Lock-free bounded SPSC ring: push on the worker, pop on the consumer
+class EventRing {
+public:
+    explicit EventRing(size_t capacity = 1024);
+
+    bool push(InferenceEvent&& event);
+    bool pop(InferenceEvent& event);
+    bool empty() const;
+
+private:
+    std::vector<InferenceEvent> m_slots;
+    const size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head{0};  // next pop (consumer)
+    alignas(64) std::atomic<size_t> m_tail{0};  // next push (producer)
+};
+
+class AsyncInference {
+public:
+    // Runs one request to its formatted result string, calling
+    // options.on_token for every token
+    using Runner = std::function<std::string(const std::string& ingredients, const PredictionOptions& options)>;
+
+    ~AsyncInference() { stop(); }
+
+    bool start(Runner runner);
+    void stop();                 // drops queued requests, waits for the running one
+    bool running() const { return m_thread.joinable(); }
+
+    // Handle > 0, or -1 when the worker is not running
+    long submit(const std::string& ingredients, const PredictionOptions& options = PredictionOptions());
+    // Queued: removed; running: generation stops at the next token and
+    // this waits until the runner has returned. Either way a CANCELLED
+    // event is published
+    bool cancel(long handle);
+
+    // Consumer side (one thread)
+    bool poll(InferenceEvent& event);
+    bool wait(InferenceEvent& event, int timeout_ms);
+
+    long droppedTokenEvents() const { return m_dropped.load(); }
+    size_t pending() const;
+
+private:
+    struct Request {
+        long handle = 0;
+        std::string ingredients;
+        PredictionOptions options;
+        long long submit_us = 0;
+    };
+
+    void run();
+    void publish(InferenceEvent&& event, bool must_deliver);
+
+    Runner m_runner;
+    std::thread m_thread;
+
+    mutable std::mutex m_mutex;          // request queue and running handle changes
+    std::condition_variable m_work;
+    std::condition_variable m_idle;      // running request finished
+    std::deque<Request> m_queue;
+    std::vector<InferenceEvent> m_cancelled;    // published by the worker (single producer)
+    std::atomic<bool> m_stop{false};
+    long m_next_handle = 1;
+    std::atomic<long> m_running_handle{0};
+    std::atomic<long> m_cancel_handle{0};
+
+    EventRing m_events;
+    std::atomic<long> m_dropped{0};
+    std::mutex m_wake_mutex;             // sleeping consumers only
+    std::condition_variable m_wake;
+};
@@ -0,0 +1,311 @@
+#include "bench-harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+#include "slm-log.h"
+
+// ===============================================================
+// STATISTICS
+// ===============================================================
+
+// Linear interpolation between closest ranks
+double percentileOf(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    double rank = p * (values.size() - 1);
+    size_t lo = static_cast<size_t>(rank);
+    size_t hi = std::min(lo + 1, values.size() - 1);
+    double frac = rank - lo;
+    return values[lo] + (values[hi] - values[lo]) * frac;
+}
+
+static double medianAbsoluteDeviation(const std::vector<double>& values, double median) {
+    std::vector<double> deviations;
+    deviations.reserve(values.size());
+    for (double v : values) {
+        deviations.push_back(std::fabs(v - median));
+    }
+    return percentileOf(deviations, 0.5);
+}
+
+std::vector<bool> flagOutliersMad(const std::vector<double>& values, double threshold) {
+    std::vector<bool> flags(values.size(), false);
+    if (values.size() < 3) {
+        return flags;
+    }
+
+    double median = percentileOf(values, 0.5);
+    double mad = medianAbsoluteDeviation(values, median);
+    // Both scales estimate the standard deviation
+    double scale = mad / 0.6745;
+    if (mad <= 0.0) {
+        // More than half the values are identical (timer resolution,
+        // cached answers): fall back to the mean absolute deviation
+        double sum = 0.0;
+        for (double v : values) {
+            sum += std::fabs(v - median);
+        }
+        scale = 1.253314 * sum / values.size();
+        if (scale <= 0.0) {
+            return flags;
+        }
+    }
+
+    for (size_t i = 0; i < values.size(); i++) {
+        flags[i] = std::fabs(values[i] - median) / scale > threshold;
+    }
+    return flags;
+}
+
+// Percentile-method bootstrap CI for percentile p
+static void bootstrapCi(const std::vector<double>& values, double p, const HarnessConfig& config,
+                        std::mt19937& rng, double& lo, double& hi) {
+    if (config.bootstrap <= 0 || values.size() < 2) {
+        lo = hi = percentileOf(values, p);
+        return;
+    }
+
+    std::uniform_int_distribution<size_t> pick(0, values.size() - 1);
+    std::vector<double> estimates;
+    estimates.reserve(config.bootstrap);
+    std::vector<double> resample(values.size());
+
+    for (int b = 0; b < config.bootstrap; b++) {
+        for (double& v : resample) {
+            v = values[pick(rng)];
+        }
+        estimates.push_back(percentileOf(resample, p));
+    }
+
+    double alpha = (1.0 - config.confidence) / 2.0;
+    lo = percentileOf(estimates, alpha);
+    hi = percentileOf(estimates, 1.0 - alpha);
+}
+
+MetricSummary summarizeMetric(const std::vector<double>& values, const HarnessConfig& config) {
+    MetricSummary s;
+    s.n = static_cast<long>(values.size());
+    if (values.empty()) {
+        return s;
+    }
+
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+    s.mean = sum / values.size();
+
+    double sq = 0.0;
+    for (double v : values) {
+        sq += (v - s.mean) * (v - s.mean);
+    }
+    s.stddev = values.size() > 1 ? std::sqrt(sq / (values.size() - 1)) : 0.0;
+
+    s.median = percentileOf(values, 0.5);
+    s.mad = medianAbsoluteDeviation(values, s.median);
+    s.p50 = s.median;
+    s.p90 = percentileOf(values, 0.90);
+    s.p99 = percentileOf(values, 0.99);
+
+    // Same seed per metric: CIs are reproducible for a given sample
+    std::mt19937 rng(config.seed);
+    bootstrapCi(values, 0.50, config, rng, s.p50_lo, s.p50_hi);
+    bootstrapCi(values, 0.90, config, rng, s.p90_lo, s.p90_hi);
+    bootstrapCi(values, 0.99, config, rng, s.p99_lo, s.p99_hi);
+
+    for (bool flag : flagOutliersMad(values, config.outlier_threshold)) {
+        s.outliers += flag ? 1 : 0;
+    }
+    return s;
+}
+
+std::string MetricSummary::toString(const std::string& prefix) const {
+    std::stringstream ss;
+    const char* sep = "";
+    auto put = [&](const char* name, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", value);
+        ss << sep << prefix << "_" << name << "=" << buf;
+        sep = ";";
+    };
+
+    ss << prefix << "_N=" << n;
+    sep = ";";
+    put("MEAN", mean);
+    put("SD", stddev);
+    put("MAD", mad);
+    put("P50", p50);
+    put("P50_LO", p50_lo);
+    put("P50_HI", p50_hi);
+    put("P90", p90);
+    put("P90_LO", p90_lo);
+    put("P90_HI", p90_hi);
+    put("P99", p99);
+    put("P99_LO", p99_lo);
+    put("P99_HI", p99_hi);
+    ss << ";" << prefix << "_OUTLIERS=" << outliers;
+    return ss.str();
+}
+
+// ===============================================================
+// SAMPLES
+// ===============================================================
+void PhaseSamples::add(const PredictionOutput& run) {
+    if (!run.ok) {
+        return;
+    }
+
+    // Non-overlapping phases: prefill is the prompt decode alone and
+    // decode starts after it, so prompt build and tokenize (prep) are
+    // counted against neither throughput
+    double total_ms = run.total_us / 1000.0;
+    double prefill = run.prefill_decode_us / 1000.0;
+    double decode = run.gen_us / 1000.0;
+
+    latency_ms.push_back(total_ms);
+    if (run.ttft_us >= 0) {
+        ttft_ms.push_back(run.ttft_us / 1000.0);
+    }
+    prep_ms.push_back(run.prep_us / 1000.0);
+    prefill_ms.push_back(prefill);
+    decode_ms.push_back(decode);
+    if (prefill > 0.0 && run.prompt_tokens > 0) {
+        prefill_tps.push_back(run.prompt_tokens * 1000.0 / prefill);
+    }
+    if (decode > 0.0 && run.generated_tokens > 0) {
+        decode_tps.push_back(run.generated_tokens * 1000.0 / decode);
+    }
+}
+
+void PhaseSamples::append(const PhaseSamples& other) {
+    auto cat = [](std::vector<double>& a, const std::vector<double>& b) {
+        a.insert(a.end(), b.begin(), b.end());
+    };
+    cat(latency_ms, other.latency_ms);
+    cat(ttft_ms, other.ttft_ms);
+    cat(prep_ms, other.prep_ms);
+    cat(prefill_ms, other.prefill_ms);
+    cat(decode_ms, other.decode_ms);
+    cat(prefill_tps, other.prefill_tps);
+    cat(decode_tps, other.decode_tps);
+}
+
+// ===============================================================
+// HARNESS
+// ===============================================================
+static double coefficientOfVariation(const std::vector<double>& values) {
+    if (values.size() < 2) {
+        return INFINITY;
+    }
+    double mean = 0.0;
+    for (double v : values) mean += v;
+    mean /= values.size();
+    if (mean <= 0.0) {
+        return INFINITY;
+    }
+    double sq = 0.0;
+    for (double v : values) sq += (v - mean) * (v - mean);
+    return std::sqrt(sq / (values.size() - 1)) / mean;
+}
+
+HarnessItem BenchHarness::measure(const std::function<PredictionOutput()>& run) {
+    HarnessItem item;
+
+    // Warmup: discard runs until the last window of latencies is flat
+    std::vector<double> warm;
+    const int window = std::max(2, m_config.steady_window);
+    while (item.warmup_runs < m_config.warmup_max) {
+        PredictionOutput out = run();
+        item.warmup_runs++;
+        if (!out.ok) {
+            item.failures++;
+            continue;
+        }
+        warm.push_back(out.total_us / 1000.0);
+
+        if (item.warmup_runs >= m_config.warmup_min && static_cast<int>(warm.size()) >= window) {
+            std::vector<double> tail(warm.end() - window, warm.end());
+            if (coefficientOfVariation(tail) <= m_config.steady_cv) {
+                item.steady = true;
+                break;
+            }
+        }
+    }
+    if (m_config.warmup_max <= 0) {
+        item.steady = true;     // warmup disabled: nothing to wait for
+    }
+
+    for (int rep = 0; rep < m_config.repetitions; rep++) {
+        PredictionOutput out = run();
+        if (!out.ok) {
+            item.failures++;
+        }
+        item.samples.add(out);
+        item.runs.push_back(out);
+    }
+
+    // Outlier flags against this item's own repetitions
+    std::vector<double> valid = item.samples.latency_ms;
+    std::vector<bool> flags = flagOutliersMad(valid, m_config.outlier_threshold);
+    item.outlier.assign(item.runs.size(), false);
+    for (size_t i = 0, v = 0; i < item.runs.size(); i++) {
+        if (item.runs[i].ok) {
+            item.outlier[i] = flags[v++];
+        }
+    }
+
+    if (valid.size() >= 4) {
+        size_t half = valid.size() / 2;
+        std::vector<double> first(valid.begin(), valid.begin() + half);
+        std::vector<double> second(valid.end() - half, valid.end());
+        double median = percentileOf(valid, 0.5);
+        if (median > 0.0) {
+            item.drift = (percentileOf(second, 0.5) - percentileOf(first, 0.5)) / median;
+        }
+    }
+
+    m_items++;
+    m_steady_items += item.steady ? 1 : 0;
+    m_failures += item.failures;
+    for (bool flag : item.outlier) {
+        m_outliers += flag ? 1 : 0;
+    }
+    m_samples.append(item.samples);
+
+    LOGI("Harness: warmup=%d steady=%d reps=%zu outliers=%ld drift=%.3f",
+         item.warmup_runs, item.steady ? 1 : 0, item.runs.size(),
+         static_cast<long>(std::count(item.outlier.begin(), item.outlier.end(), true)), item.drift);
+    return item;
+}
+
+void BenchHarness::reset() {
+    m_samples.clear();
+    m_items = 0;
+    m_steady_items = 0;
+    m_outliers = 0;
+    m_failures = 0;
+}
+
+std::string BenchHarness::summaryString() const {
+    std::stringstream ss;
+    ss << "SCHEMA=" << BENCH_SCHEMA_VERSION
+       << ";ITEMS=" << m_items
+       << ";STEADY_ITEMS=" << m_steady_items
+       << ";FAILURES=" << m_failures
+       << ";ITEM_OUTLIERS=" << m_outliers
+       << ";REPS=" << m_config.repetitions
+       << ";" << summarizeMetric(m_samples.latency_ms, m_config).toString("LATENCY_MS")
+       << ";" << summarizeMetric(m_samples.ttft_ms, m_config).toString("TTFT_MS")
+       << ";" << summarizeMetric(m_samples.prep_ms, m_config).toString("PREP_MS")
+       << ";" << summarizeMetric(m_samples.prefill_ms, m_config).toString("PREFILL_MS")
+       << ";" << summarizeMetric(m_samples.decode_ms, m_config).toString("DECODE_MS")
+       << ";" << summarizeMetric(m_samples.prefill_tps, m_config).toString("PREFILL_TPS")
+       << ";" << summarizeMetric(m_samples.decode_tps, m_config).toString("DECODE_TPS");
+    return ss.str();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "slm-engine.h"
+
+// ===============================================================
+// BENCHMARK HARNESS
+// Warmup until latency settles, then N measured repetitions per item.
+// Every repetition is kept (a retry never overwrites a measurement);
+// outliers are flagged by MAD and percentiles get bootstrap CIs.
+// ===============================================================
+
+// Bumped whenever a field of the emitted results changes meaning
+constexpr int BENCH_SCHEMA_VERSION = 3;
+
+struct HarnessConfig {
+    int warmup_min = 1;             // always run at least this many
+    int warmup_max = 5;             // give up waiting for steady state
+    int repetitions = 5;            // measured runs per item
+    int steady_window = 3;          // last K warmup latencies ...
+    double steady_cv = 0.05;        // ... must have CV at or below this
+    double outlier_threshold = 3.5; // modified z-score (Iglewicz-Hoaglin)
+    int bootstrap = 1000;           // resamples for the CIs, 0 = off
+    double confidence = 0.95;
+    unsigned seed = 1;
+};
+
+struct MetricSummary {
+    long n = 0;
+    double mean = 0.0;
+    double stddev = 0.0;
+    double median = 0.0;
+    double mad = 0.0;               // median absolute deviation
+    double p50 = 0.0, p90 = 0.0, p99 = 0.0;
+    double p50_lo = 0.0, p50_hi = 0.0;
+    double p90_lo = 0.0, p90_hi = 0.0;
+    double p99_lo = 0.0, p99_hi = 0.0;
+    long outliers = 0;
+
+    // "PREFIX_P50=..;PREFIX_P50_LO=..;..." for the JNI result strings
+    std::string toString(const std::string& prefix) const;
+};
+
+// One series per phase; throughput series skip runs without tokens
+struct PhaseSamples {
+    std::vector<double> latency_ms;
+    std::vector<double> ttft_ms;
+    std::vector<double> prep_ms;
+    std::vector<double> prefill_ms;
+    std::vector<double> decode_ms;
+    std::vector<double> prefill_tps;
+    std::vector<double> decode_tps;
+
+    void add(const PredictionOutput& run);
+    void append(const PhaseSamples& other);
+    void clear() { *this = PhaseSamples(); }
+};
+
+struct HarnessItem {
+    int warmup_runs = 0;
+    bool steady = false;            // warmup reached the CV target
+    int failures = 0;               // failed runs, warmup included
+    std::vector<PredictionOutput> runs;     // measured repetitions, in order
+    std::vector<bool> outlier;              // latency outlier flag per run
+    PhaseSamples samples;
+    double drift = 0.0;             // (median 2nd half - median 1st half) / median
+};
+
+double percentileOf(std::vector<double> values, double p);
+
+// modified z = 0.6745 * |x - median| / MAD above threshold; when MAD
+// is 0 the scale is 1.253314 * mean absolute deviation instead
+std::vector<bool> flagOutliersMad(const std::vector<double>& values, double threshold);
+
+MetricSummary summarizeMetric(const std::vector<double>& values, const HarnessConfig& config);
+
+class BenchHarness {
+public:
+    explicit BenchHarness(const HarnessConfig& config = HarnessConfig()) : m_config(config) {}
+
+    void setConfig(const HarnessConfig& config) { m_config = config; }
+    const HarnessConfig& config() const { return m_config; }
+
+    // run() performs one complete prediction of the item
+    HarnessItem measure(const std::function<PredictionOutput()>& run);
+
+    // All measured repetitions of all items since the last reset
+    const PhaseSamples& samples() const { return m_samples; }
+    long items() const { return m_items; }
+    long steadyItems() const { return m_steady_items; }
+    long outliers() const { return m_outliers; }
+    long failures() const { return m_failures; }
+    void reset();
+
+    // SCHEMA=..;ITEMS=..;LATENCY_P50=..;... over samples()
+    std::string summaryString() const;
+
+private:
+    HarnessConfig m_config;
+    PhaseSamples m_samples;
+    long m_items = 0;
+    long m_steady_items = 0;
+    long m_outliers = 0;
+    long m_failures = 0;
+};
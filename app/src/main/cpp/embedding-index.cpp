@@ -0,0 +1,412 @@
+#include "embedding-index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SLM_INDEX_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SLM_INDEX_SSE2 1
+#endif
+
+// ===============================================================
+// FILE LAYOUT
+// One header page, then fixed-stride rows: int8 codes (zero padded
+// to a multiple of 16), float scale, uint16 mask, 2 bytes padding.
+// ===============================================================
+static const char INDEX_MAGIC[8] = {'S', 'L', 'M', 'K', 'N', 'N', '0', '1'};
+static const size_t HEADER_BYTES = 4096;
+static const uint32_t MIN_CAPACITY = 256;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t dim;
+    uint32_t stride;
+    uint32_t rows;
+    uint32_t reserved;
+};
+
+static size_t paddedDim(int dim) {
+    return (static_cast<size_t>(dim) + 15) & ~static_cast<size_t>(15);
+}
+
+std::string KnnPrediction::toString() const {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "KNN_NEIGHBORS=%zu;TOP_SIM=%.4f;SCAN_US=%.1f",
+             neighbors.size(), top_similarity, scan_us);
+    return buf;
+}
+
+std::string EmbeddingIndexStats::toString() const {
+    char buf[192];
+    snprintf(buf, sizeof(buf), "ROWS=%u;DIM=%d;MAPPED_KB=%.1f;INSERTS=%ld;INSERT_MEAN_US=%.2f;QUERIES=%ld;QUERY_MEAN_US=%.2f",
+             rows, dim, mapped_kb, inserts, inserts > 0 ? insert_us / inserts : 0.0,
+             queries, queries > 0 ? query_us / queries : 0.0);
+    return buf;
+}
+
+// ===============================================================
+// QUANTISATION / DOT PRODUCT
+// ===============================================================
+float quantizeEmbedding(const float* x, int dim, int8_t* codes) {
+    double norm = 0.0;
+    float max_abs = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        norm += static_cast<double>(x[i]) * x[i];
+        max_abs = std::max(max_abs, std::fabs(x[i]));
+    }
+    if (norm <= 0.0 || max_abs <= 0.0f) {
+        memset(codes, 0, dim);
+        return 0.0f;
+    }
+    // Unit length, then [-127, 127]: the scale maps codes back
+    const float inv_norm = static_cast<float>(1.0 / std::sqrt(norm));
+    const float scale = max_abs * inv_norm / 127.0f;
+    for (int i = 0; i < dim; i++) {
+        codes[i] = static_cast<int8_t>(std::lround(x[i] * inv_norm / scale));
+    }
+    return scale;
+}
+
+int32_t dotInt8(const int8_t* a, const int8_t* b, int dim) {
+    int32_t sum = 0;
+    int i = 0;
+
+#if defined(SLM_INDEX_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= dim; i += 16) {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+        // |code| <= 127, so a product fits int16 and a pair int32
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+    }
+#if defined(__aarch64__)
+    sum = vaddvq_s32(acc);
+#else
+    int32x2_t pair = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    sum = vget_lane_s32(vpadd_s32(pair, pair), 0);
+#endif
+#elif defined(SLM_INDEX_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 16 <= dim; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        // Sign-extend to int16, then multiply-add adjacent pairs to int32
+        __m128i sa = _mm_cmplt_epi8(va, zero);
+        __m128i sb = _mm_cmplt_epi8(vb, zero);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(va, sa), _mm_unpacklo_epi8(vb, sb)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(va, sa), _mm_unpackhi_epi8(vb, sb)));
+    }
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+    for (; i < dim; i++) {
+        sum += static_cast<int32_t>(a[i]) * b[i];
+    }
+    return sum;
+}
+
+// ===============================================================
+// MAPPING
+// ===============================================================
+bool EmbeddingIndex::open(const std::string& path, int dim, std::string& error) {
+    close();
+    if (dim <= 0) {
+        error = "Embedding size must be positive";
+        return false;
+    }
+    m_path = path;
+    m_dim = dim;
+    m_stride = paddedDim(dim) + 8;
+    m_stats = EmbeddingIndexStats();
+
+    if (path.empty()) {
+        if (!reserve(MIN_CAPACITY, error)) {
+            return false;
+        }
+    } else {
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        struct stat st {};
+        if (m_fd < 0 || fstat(m_fd, &st) != 0) {
+            error = "Cannot open " + path;
+            close();
+            return false;
+        }
+
+        if (st.st_size == 0) {
+            if (!reserve(MIN_CAPACITY, error)) {
+                close();
+                return false;
+            }
+        } else {
+            m_map_bytes = static_cast<size_t>(st.st_size);
+            void* map = m_map_bytes >= HEADER_BYTES
+                        ? mmap(nullptr, m_map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0) : MAP_FAILED;
+            if (map == MAP_FAILED) {
+                error = "Not an embedding index: " + path;
+                m_map_bytes = 0;
+                close();
+                return false;
+            }
+            m_map = static_cast<uint8_t*>(map);
+            m_capacity = static_cast<uint32_t>((m_map_bytes - HEADER_BYTES) / m_stride);
+
+            const IndexHeader* header = reinterpret_cast<const IndexHeader*>(m_map);
+            if (memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header->stride != m_stride
+                || header->rows > m_capacity) {
+                error = "Not an embedding index: " + path;
+                close();
+                return false;
+            }
+            if (static_cast<int>(header->dim) != dim) {
+                error = "Index holds " + std::to_string(header->dim) + "-d embeddings, model has "
+                        + std::to_string(dim);
+                close();
+                return false;
+            }
+            m_stats.rows = header->rows;
+            m_rows = header->rows;
+            return true;
+        }
+    }
+
+    IndexHeader* header = reinterpret_cast<IndexHeader*>(m_map);
+    memcpy(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header->dim = static_cast<uint32_t>(dim);
+    header->stride = static_cast<uint32_t>(m_stride);
+    header->rows = 0;
+    m_rows = 0;
+    return true;
+}
+
+void EmbeddingIndex::close() {
+    if (m_map != nullptr) {
+        std::string error;
+        if (!flush(error)) {
+            LOGW("Embedding index: %s", error.c_str());
+        }
+        munmap(m_map, m_map_bytes);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    m_map = nullptr;
+    m_map_bytes = 0;
+    m_capacity = 0;
+    m_rows = 0;
+}
+
+bool EmbeddingIndex::reserve(uint32_t rows, std::string& error) {
+    if (rows <= m_capacity) {
+        return true;
+    }
+    const uint32_t capacity = std::max({MIN_CAPACITY, m_capacity * 2, rows});
+    const size_t bytes = HEADER_BYTES + static_cast<size_t>(capacity) * m_stride;
+
+    if (m_fd >= 0 && ftruncate(m_fd, static_cast<off_t>(bytes)) != 0) {
+        error = "Cannot grow " + m_path;
+        return false;
+    }
+    void* map;
+    if (m_map == nullptr) {
+        map = m_fd >= 0 ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0)
+                        : mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        map = mremap(m_map, m_map_bytes, bytes, MREMAP_MAYMOVE);
+    }
+    if (map == MAP_FAILED) {
+        error = "Cannot map " + std::to_string(bytes / 1024) + " KB for the index";
+        return false;
+    }
+    m_map = static_cast<uint8_t*>(map);
+    m_map_bytes = bytes;
+    m_capacity = capacity;
+    return true;
+}
+
+uint8_t* EmbeddingIndex::row(uint32_t index) const {
+    return m_map + HEADER_BYTES + static_cast<size_t>(index) * m_stride;
+}
+
+uint32_t EmbeddingIndex::rows() const {
+    return __atomic_load_n(&m_rows, __ATOMIC_ACQUIRE);
+}
+
+AllergenMask EmbeddingIndex::maskAt(uint32_t index) const {
+    uint16_t mask;
+    memcpy(&mask, row(index) + paddedDim(m_dim) + 4, sizeof(mask));
+    return mask;
+}
+
+float EmbeddingIndex::scaleAt(uint32_t index) const {
+    float scale;
+    memcpy(&scale, row(index) + paddedDim(m_dim), sizeof(scale));
+    return scale;
+}
+
+float EmbeddingIndex::quantizeQuery(const float* query, std::vector<int8_t>& codes) const {
+    codes.assign(paddedDim(m_dim), 0);
+    return quantizeEmbedding(query, m_dim, codes.data());
+}
+
+float EmbeddingIndex::similarity(const int8_t* codes, float scale, uint32_t index) const {
+    const int32_t dot = dotInt8(codes, reinterpret_cast<const int8_t*>(row(index)), static_cast<int>(paddedDim(m_dim)));
+    return dot * scale * scaleAt(index);
+}
+
+float EmbeddingIndex::similarity(uint32_t a, uint32_t b) const {
+    return similarity(reinterpret_cast<const int8_t*>(row(a)), scaleAt(a), b);
+}
+
+// ===============================================================
+// UPDATES
+// ===============================================================
+bool EmbeddingIndex::insert(const float* embedding, AllergenMask mask, std::string& error) {
+    if (!isOpen()) {
+        error = "Index not open";
+        return false;
+    }
+    const int64_t t0 = traceNowUs();
+    const uint32_t n = rows();
+    if (!reserve(n + 1, error)) {
+        return false;
+    }
+
+    uint8_t* dst = row(n);
+    const size_t pad = paddedDim(m_dim);
+    memset(dst, 0, m_stride);
+    float scale = quantizeEmbedding(embedding, m_dim, reinterpret_cast<int8_t*>(dst));
+    uint16_t stored = static_cast<uint16_t>(mask & ALLERGEN_MASK_ALL);
+    memcpy(dst + pad, &scale, sizeof(scale));
+    memcpy(dst + pad + 4, &stored, sizeof(stored));
+
+    // Publish the row only once it is complete; the header follows
+    // with the next flush
+    __atomic_store_n(&m_rows, n + 1, __ATOMIC_RELEASE);
+    m_stats.inserts++;
+    m_stats.insert_us += static_cast<double>(traceNowUs() - t0);
+    return true;
+}
+
+bool EmbeddingIndex::clear(std::string& error) {
+    if (!isOpen()) {
+        error = "Index not open";
+        return false;
+    }
+    m_rows = 0;
+    return flush(error);
+}
+
+// Rows first, then the header that counts them, so a reopened file
+// never counts a row whose bytes did not reach the disk
+bool EmbeddingIndex::flush(std::string& error) {
+    if (m_map == nullptr) {
+        return true;
+    }
+    if (m_fd >= 0 && msync(m_map + HEADER_BYTES, m_map_bytes - HEADER_BYTES, MS_SYNC) != 0) {
+        error = "msync failed for " + m_path;
+        return false;
+    }
+    reinterpret_cast<IndexHeader*>(m_map)->rows = rows();
+    if (m_fd >= 0 && msync(m_map, HEADER_BYTES, MS_SYNC) != 0) {
+        error = "msync failed for " + m_path;
+        return false;
+    }
+    return true;
+}
+
+// ===============================================================
+// QUERIES
+// ===============================================================
+std::vector<KnnNeighbor> EmbeddingIndex::search(const float* query, int k) const {
+    std::vector<KnnNeighbor> best;
+    const uint32_t n = rows();
+    if (n == 0 || k <= 0) {
+        return best;
+    }
+
+    std::vector<int8_t> q;
+    const float q_scale = quantizeQuery(query, q);
+    best.reserve(k + 1);
+
+    for (uint32_t r = 0; r < n; r++) {
+        const float sim = similarity(q.data(), q_scale, r);
+        if (static_cast<int>(best.size()) == k && sim <= best.back().similarity) {
+            continue;
+        }
+        // k is small: insertion into the sorted list
+        KnnNeighbor neighbor;
+        neighbor.row = r;
+        neighbor.similarity = sim;
+        auto at = std::upper_bound(best.begin(), best.end(), sim,
+                                   [](float s, const KnnNeighbor& b) { return s > b.similarity; });
+        best.insert(at, neighbor);
+        if (static_cast<int>(best.size()) > k) {
+            best.pop_back();
+        }
+    }
+    for (KnnNeighbor& neighbor : best) {
+        neighbor.mask = maskAt(neighbor.row);
+    }
+    return best;
+}
+
+KnnPrediction EmbeddingIndex::predict(const float* query, const KnnConfig& config) const {
+    SLM_TRACE_SCOPE("knn_predict");
+    const int64_t t0 = traceNowUs();
+    KnnPrediction out;
+    std::vector<KnnNeighbor> nearest = search(query, config.k);
+    if (!nearest.empty()) {
+        out.top_similarity = nearest.front().similarity;
+    }
+
+    double total = 0.0;
+    double votes[ALLERGEN_COUNT] = {};
+    for (const KnnNeighbor& neighbor : nearest) {
+        if (neighbor.similarity < config.min_similarity) {
+            break;
+        }
+        const double weight = std::max(neighbor.similarity, 1e-6f);
+        total += weight;
+        for (int label = 0; label < ALLERGEN_COUNT; label++) {
+            if (neighbor.mask & (1u << label)) {
+                votes[label] += weight;
+            }
+        }
+        out.neighbors.push_back(neighbor);
+    }
+    for (int label = 0; label < ALLERGEN_COUNT && total > 0.0; label++) {
+        if (votes[label] / total >= config.vote) {
+            out.mask |= 1u << label;
+        }
+    }
+
+    out.scan_us = static_cast<double>(traceNowUs() - t0);
+    m_stats.queries++;
+    m_stats.query_us += out.scan_us;
+    return out;
+}
+
+EmbeddingIndexStats EmbeddingIndex::stats() const {
+    EmbeddingIndexStats s = m_stats;
+    s.rows = rows();
+    s.dim = m_dim;
+    s.mapped_kb = m_map_bytes / 1024.0;
+    return s;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "allergen-labels.h"
+
+// ===============================================================
+// EMBEDDING INDEX
+// Flat nearest-neighbour index over pooled ingredient embeddings,
+// each stored with its ground-truth AllergenMask. Vectors are L2
+// normalised and quantised to int8 with one float scale per vector,
+// so cosine similarity is an int8 dot product times two scales; a
+// query scans every row with NEON / SSE2 (scalar elsewhere).
+//
+// The rows live in one file (or anonymous memory when no path is
+// given) that is mapped as a whole: opening a built index is a
+// single mmap, and inserts append in place, growing the mapping by
+// doubling. In memory a row is counted only once it is complete.
+// The header's row count is updated by flush / close after the rows
+// are synced, so after a crash the file holds the rows of the last
+// flush and never a partial one.
+// ===============================================================
+
+struct KnnConfig {
+    int k = 5;
+    float min_similarity = 0.0f;    // neighbours below this do not vote
+    float vote = 0.5f;              // label predicted at this similarity-weighted share
+};
+
+struct KnnNeighbor {
+    uint32_t row = 0;
+    float similarity = 0.0f;
+    AllergenMask mask = 0;
+};
+
+struct KnnPrediction {
+    AllergenMask mask = 0;
+    std::vector<KnnNeighbor> neighbors;     // voting neighbours, most similar first
+    float top_similarity = 0.0f;            // best row, voting or not
+    double scan_us = 0.0;
+
+    bool empty() const { return neighbors.empty(); }
+    // "KNN_NEIGHBORS=..;TOP_SIM=..;SCAN_US=.."
+    std::string toString() const;
+};
+
+struct EmbeddingIndexStats {
+    uint32_t rows = 0;
+    int dim = 0;
+    double mapped_kb = 0.0;
+    long inserts = 0;
+    double insert_us = 0.0;     // totals since open
+    long queries = 0;
+    double query_us = 0.0;
+
+    // "ROWS=..;DIM=..;MAPPED_KB=..;INSERTS=..;INSERT_MEAN_US=..;QUERIES=..;QUERY_MEAN_US=.."
+    std::string toString() const;
+};
+
+class EmbeddingIndex {
+public:
+    EmbeddingIndex() = default;
+    EmbeddingIndex(const EmbeddingIndex&) = delete;
+    EmbeddingIndex& operator=(const EmbeddingIndex&) = delete;
+    ~EmbeddingIndex() { close(); }
+
+    // Maps path, creating it for dim or reopening it (same dim
+    // required); an empty path keeps the index in memory
+    bool open(const std::string& path, int dim, std::string& error);
+    // Syncs a file-backed index and unmaps
+    void close();
+    bool isOpen() const { return m_map != nullptr; }
+    // Drops every row
+    bool clear(std::string& error);
+
+    bool insert(const float* embedding, AllergenMask mask, std::string& error);
+    // Syncs the rows, then the header row count; rows inserted since
+    // are lost on a crash
+    bool flush(std::string& error);
+
+    int dim() const { return m_dim; }
+    uint32_t rows() const;
+    AllergenMask maskAt(uint32_t row) const;
+
+    float scaleAt(uint32_t row) const;
+
+    // Query codes padded like a row; returns the query scale
+    float quantizeQuery(const float* query, std::vector<int8_t>& codes) const;
+    // Cosine of a quantised query, or of another row, with row
+    float similarity(const int8_t* codes, float scale, uint32_t row) const;
+    float similarity(uint32_t a, uint32_t b) const;
+
+    // The k most similar rows, most similar first
+    std::vector<KnnNeighbor> search(const float* query, int k) const;
+    // Similarity-weighted vote of the k nearest masks
+    KnnPrediction predict(const float* query, const KnnConfig& config) const;
+
+    EmbeddingIndexStats stats() const;
+
+private:
+    bool reserve(uint32_t rows, std::string& error);
+    uint8_t* row(uint32_t index) const;
+
+    std::string m_path;
+    int m_fd = -1;
+    int m_dim = 0;
+    size_t m_stride = 0;        // codes padded to 16, then scale and mask
+    uint8_t* m_map = nullptr;
+    size_t m_map_bytes = 0;
+    uint32_t m_capacity = 0;
+    uint32_t m_rows = 0;        // complete rows; the header has the flushed count
+
+    mutable EmbeddingIndexStats m_stats;
+};
+
+// L2-normalises x and writes int8 codes; returns the dequantisation scale
+float quantizeEmbedding(const float* x, int dim, int8_t* codes);
+// Sum of a[i] * b[i] over dim int8 values
+int32_t dotInt8(const int8_t* a, const int8_t* b, int dim);
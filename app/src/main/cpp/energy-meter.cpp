@@ -0,0 +1,311 @@
+#include "energy-meter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+// ===============================================================
+// SYSFS
+// ===============================================================
+static std::vector<std::string> listDir(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return names;
+    }
+    while (dirent* entry = readdir(d)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static std::string readLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+static bool readInt64Fd(int fd, long long& value) {
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    value = atoll(buf);
+    return true;
+}
+
+bool parseEnergySource(const std::string& name, EnergySource& source) {
+    if (name == "auto") {
+        source = EnergySource::AUTO;
+    } else if (name == "battery") {
+        source = EnergySource::BATTERY;
+    } else if (name == "rapl") {
+        source = EnergySource::RAPL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* energySourceName(EnergySource source) {
+    switch (source) {
+        case EnergySource::AUTO:    return "auto";
+        case EnergySource::BATTERY: return "battery";
+        case EnergySource::RAPL:    return "rapl";
+    }
+    return "?";
+}
+
+// ===============================================================
+// METER
+// ===============================================================
+
+// First supply of type Battery exposing both current_now and voltage_now
+bool EnergyMeter::openBattery(const std::string& root) {
+    const std::string dir = root + "/class/power_supply";
+    for (const std::string& name : listDir(dir)) {
+        std::string base = dir + "/" + name;
+        if (readLine(base + "/type") != "Battery") {
+            continue;
+        }
+        int current = open((base + "/current_now").c_str(), O_RDONLY | O_CLOEXEC);
+        int voltage = open((base + "/voltage_now").c_str(), O_RDONLY | O_CLOEXEC);
+        if (current >= 0 && voltage >= 0) {
+            m_current_fd = current;
+            m_voltage_fd = voltage;
+            m_description = name;
+            return true;
+        }
+        if (current >= 0) close(current);
+        if (voltage >= 0) close(voltage);
+    }
+    return false;
+}
+
+// Package-level zones only (intel-rapl:N); subzones are part of them
+bool EnergyMeter::openRapl(const std::string& root) {
+    const std::string dir = root + "/class/powercap";
+    for (const std::string& name : listDir(dir)) {
+        if (name.compare(0, 11, "intel-rapl:") != 0 || name.find(':', 11) != std::string::npos) {
+            continue;
+        }
+        std::string base = dir + "/" + name;
+        RaplZone zone;
+        zone.fd = open((base + "/energy_uj").c_str(), O_RDONLY | O_CLOEXEC);
+        long long value = 0;
+        if (zone.fd < 0 || !readInt64Fd(zone.fd, value)) {
+            if (zone.fd >= 0) close(zone.fd);
+            continue;           // usually root-only on recent kernels
+        }
+        zone.last_uj = static_cast<uint64_t>(value);
+        zone.max_range_uj = strtoull(readLine(base + "/max_energy_range_uj").c_str(), nullptr, 10);
+        m_rapl.push_back(zone);
+
+        std::string label = readLine(base + "/name");
+        m_description += (m_description.empty() ? "" : ",") + (label.empty() ? name : label);
+    }
+    return !m_rapl.empty();
+}
+
+bool EnergyMeter::start(const EnergyMeterConfig& config, std::string& error) {
+    stop();
+    closeFiles();
+    m_config = config;
+    m_samples.clear();
+
+    bool opened = false;
+    if (config.source != EnergySource::RAPL && openBattery(config.sysfs_root)) {
+        m_source = EnergySource::BATTERY;
+        opened = true;
+    } else if (config.source != EnergySource::BATTERY && openRapl(config.sysfs_root)) {
+        m_source = EnergySource::RAPL;
+        opened = true;
+    }
+    if (!opened) {
+        error = std::string("No readable ") + energySourceName(config.source) +
+                " energy source under " + config.sysfs_root;
+        return false;
+    }
+
+    LOGI("Energy meter: %s (%s) every %d ms",
+         energySourceName(m_source), m_description.c_str(), config.interval_ms);
+
+    m_samples.push_back(readSample(nullptr));
+    m_stop = false;
+    m_sample_now = false;
+    m_thread = std::thread(&EnergyMeter::run, this);
+    return true;
+}
+
+void EnergyMeter::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void EnergyMeter::closeFiles() {
+    if (m_current_fd >= 0) close(m_current_fd);
+    if (m_voltage_fd >= 0) close(m_voltage_fd);
+    m_current_fd = m_voltage_fd = -1;
+    for (const RaplZone& zone : m_rapl) {
+        close(zone.fd);
+    }
+    m_rapl.clear();
+    m_description.clear();
+}
+
+EnergySample EnergyMeter::readSample(const EnergySample* prev) {
+    EnergySample sample;
+    sample.t_us = traceNowUs();
+    const double dt = prev != nullptr ? (sample.t_us - prev->t_us) / 1e6 : 0.0;
+
+    if (m_source == EnergySource::BATTERY) {
+        long long current_ua = 0, voltage_uv = 0;
+        readInt64Fd(m_current_fd, current_ua);
+        readInt64Fd(m_voltage_fd, voltage_uv);
+        // Sign of current_now differs between vendors; magnitude is what we draw
+        sample.power_w = std::fabs(static_cast<double>(current_ua)) * 1e-6 * voltage_uv * 1e-6;
+        if (prev != nullptr) {
+            sample.energy_j = prev->energy_j + 0.5 * (prev->power_w + sample.power_w) * dt;
+        }
+        return sample;
+    }
+
+    double delta_j = 0.0;
+    for (RaplZone& zone : m_rapl) {
+        long long value = 0;
+        if (!readInt64Fd(zone.fd, value)) {
+            continue;
+        }
+        uint64_t now = static_cast<uint64_t>(value);
+        uint64_t diff = now >= zone.last_uj ? now - zone.last_uj
+                                            : zone.max_range_uj - zone.last_uj + now;   // wrapped
+        zone.last_uj = now;
+        delta_j += diff * 1e-6;
+    }
+    if (prev != nullptr) {
+        sample.energy_j = prev->energy_j + delta_j;
+        sample.power_w = dt > 0.0 ? delta_j / dt : 0.0;
+    }
+    return sample;
+}
+
+void EnergyMeter::run() {
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+
+    const auto interval = std::chrono::milliseconds(std::max(1, m_config.interval_ms));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        m_wake.wait_for(lock, interval, [this]() { return m_stop || m_sample_now; });
+        m_sample_now = false;
+        EnergySample prev = m_samples.back();
+        lock.unlock();
+        EnergySample sample = readSample(&prev);
+        lock.lock();
+
+        m_samples.push_back(sample);
+        while (m_samples.size() > m_config.max_samples) {
+            m_samples.pop_front();
+        }
+        m_sampled.notify_all();
+    }
+    m_sampled.notify_all();
+}
+
+// ===============================================================
+// WINDOWS
+// ===============================================================
+
+// Caller holds m_mutex; clamps outside the sampled range
+double EnergyMeter::energyAt(int64_t t_us) const {
+    if (m_samples.empty()) {
+        return 0.0;
+    }
+    auto hi = std::lower_bound(m_samples.begin(), m_samples.end(), t_us,
+                               [](const EnergySample& s, int64_t t) { return s.t_us < t; });
+    if (hi == m_samples.begin()) {
+        return hi->energy_j;
+    }
+    if (hi == m_samples.end()) {
+        return m_samples.back().energy_j;
+    }
+    auto lo = hi - 1;
+    double span = static_cast<double>(hi->t_us - lo->t_us);
+    double frac = span > 0.0 ? (t_us - lo->t_us) / span : 0.0;
+    return lo->energy_j + (hi->energy_j - lo->energy_j) * frac;
+}
+
+EnergyWindow EnergyMeter::window(int64_t from_us, int64_t to_us) {
+    EnergyWindow w;
+    if (to_us <= from_us) {
+        return w;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_thread.joinable() && !m_stop && m_samples.back().t_us < to_us) {
+        m_sample_now = true;
+        m_wake.notify_all();
+        m_sampled.wait_for(lock, std::chrono::seconds(1),
+                           [this, to_us]() { return m_stop || m_samples.back().t_us >= to_us; });
+    }
+    w.joules = std::max(0.0, energyAt(to_us) - energyAt(from_us));
+    w.seconds = (to_us - from_us) / 1e6;
+    for (const EnergySample& s : m_samples) {
+        if (s.t_us >= from_us && s.t_us <= to_us) {
+            w.samples++;
+        }
+    }
+    return w;
+}
+
+void EnergyTotals::add(const EnergyWindow& window, int generated_tokens) {
+    items++;
+    output_tokens += generated_tokens;
+    joules += window.joules;
+    seconds += window.seconds;
+}
+
+std::string EnergyTotals::toString() const {
+    char buf[192];
+    snprintf(buf, sizeof(buf), "ENERGY_ITEMS=%ld;ENERGY_J=%.3f;J_PER_ITEM=%.4f;J_PER_TOKEN=%.4f;AVG_W=%.3f",
+             items, joules,
+             items > 0 ? joules / items : 0.0,
+             output_tokens > 0 ? joules / output_tokens : 0.0,
+             seconds > 0.0 ? joules / seconds : 0.0);
+    return buf;
+}
+
+std::string energyItemString(const EnergyWindow& window, int generated_tokens) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "ENERGY_J=%.4f;J_PER_TOKEN=%.4f;AVG_W=%.3f",
+             window.joules,
+             generated_tokens > 0 ? window.joules / generated_tokens : 0.0,
+             window.avgWatts());
+    return buf;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ===============================================================
+// ENERGY METER
+// Background thread turning sysfs power readings into a cumulative
+// energy curve stamped with traceNowUs(), so the energy of any
+// prediction window is the difference of two interpolated points.
+//   battery: power_supply current_now x voltage_now, integrated
+//            (phones; only meaningful while discharging)
+//   rapl:    powercap intel-rapl package energy_uj counters (hosts)
+// The sysfs root is injectable so a fake tree works in tests.
+// ===============================================================
+
+enum class EnergySource { AUTO, BATTERY, RAPL };
+
+struct EnergyMeterConfig {
+    std::string sysfs_root = "/sys";
+    EnergySource source = EnergySource::AUTO;   // AUTO: battery first, then RAPL
+    int interval_ms = 50;
+    size_t max_samples = 262144;
+};
+
+struct EnergySample {
+    int64_t t_us = 0;
+    double energy_j = 0.0;      // cumulative since start
+    double power_w = 0.0;       // instantaneous (battery) or since the last sample (rapl)
+};
+
+struct EnergyWindow {
+    double joules = 0.0;
+    double seconds = 0.0;
+    int samples = 0;            // raw samples inside the window
+
+    double avgWatts() const { return seconds > 0.0 ? joules / seconds : 0.0; }
+};
+
+// Per model/config accumulation over predicted items
+struct EnergyTotals {
+    long items = 0;
+    long output_tokens = 0;
+    double joules = 0.0;
+    double seconds = 0.0;
+
+    void add(const EnergyWindow& window, int generated_tokens);
+
+    // "ENERGY_ITEMS=..;ENERGY_J=..;J_PER_ITEM=..;J_PER_TOKEN=..;AVG_W=.."
+    std::string toString() const;
+};
+
+bool parseEnergySource(const std::string& name, EnergySource& source);
+const char* energySourceName(EnergySource source);
+
+// "ENERGY_J=..;J_PER_TOKEN=..;AVG_W=.." for one item
+std::string energyItemString(const EnergyWindow& window, int generated_tokens);
+
+class EnergyMeter {
+public:
+    ~EnergyMeter() { stop(); closeFiles(); }
+
+    bool start(const EnergyMeterConfig& config, std::string& error);
+    void stop();
+    bool running() const { return m_thread.joinable(); }
+
+    // Resolved source and the supply/zones it reads
+    EnergySource source() const { return m_source; }
+    const std::string& description() const { return m_description; }
+
+    // Energy between two traceNowUs() stamps, linearly interpolated
+    // on the cumulative curve. When to_us is past the last sample the
+    // meter samples once more first, so an item that just ended keeps
+    // its tail instead of being clamped to that sample
+    EnergyWindow window(int64_t from_us, int64_t to_us);
+
+private:
+    struct RaplZone {
+        int fd = -1;
+        uint64_t max_range_uj = 0;
+        uint64_t last_uj = 0;
+    };
+
+    bool openBattery(const std::string& root);
+    bool openRapl(const std::string& root);
+    void run();
+    EnergySample readSample(const EnergySample* prev);
+    double energyAt(int64_t t_us) const;
+    void closeFiles();
+
+    EnergyMeterConfig m_config;
+    EnergySource m_source = EnergySource::AUTO;
+    std::string m_description;
+    int m_current_fd = -1;
+    int m_voltage_fd = -1;
+    std::vector<RaplZone> m_rapl;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_sampled;
+    bool m_stop = false;
+    bool m_sample_now = false;
+    std::deque<EnergySample> m_samples;
+    std::thread m_thread;
+};
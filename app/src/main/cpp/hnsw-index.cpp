@@ -0,0 +1,539 @@
+#include "hnsw-index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+// ===============================================================
+// FILE LAYOUT
+// uint32 words: a 16-word header, the level of each node, each
+// node's offset into the upper-layer block, layer 0 link lists
+// (count + 2m ids per node), then the upper-layer lists (count + m
+// ids per node and level above 0).
+// ===============================================================
+static const char HNSW_MAGIC[8] = {'S', 'L', 'M', 'H', 'N', 'S', 'W', '1'};
+static const int HEADER_WORDS = 16;
+static const int LEVEL_CAP = 15;
+
+enum HeaderWord {
+    H_ROWS = 2,
+    H_M,
+    H_M0,
+    H_MAX_LEVEL,
+    H_ENTRY,
+    H_DIM,
+    H_UPPER_WORDS,
+    H_FINGERPRINT,
+};
+
+struct GraphLayout {
+    uint32_t rows = 0;
+    uint32_t m = 0;
+    uint32_t m0 = 0;
+    size_t levels = 0;          // word offsets
+    size_t upper_offsets = 0;
+    size_t level0 = 0;
+    size_t upper = 0;
+    size_t words = 0;           // whole image
+};
+
+static GraphLayout layoutOf(uint32_t rows, uint32_t m, uint32_t m0, uint32_t upper_words) {
+    GraphLayout l;
+    l.rows = rows;
+    l.m = m;
+    l.m0 = m0;
+    l.levels = HEADER_WORDS;
+    l.upper_offsets = l.levels + rows;
+    l.level0 = l.upper_offsets + rows;
+    l.upper = l.level0 + static_cast<size_t>(rows) * (1 + m0);
+    l.words = l.upper + upper_words;
+    return l;
+}
+
+static const uint32_t* linkList(const uint32_t* words, const GraphLayout& l, uint32_t node, int level) {
+    if (level == 0) {
+        return words + l.level0 + static_cast<size_t>(node) * (1 + l.m0);
+    }
+    return words + l.upper + words[l.upper_offsets + node] + static_cast<size_t>(level - 1) * (1 + l.m);
+}
+
+// Ties the graph to the rows it was built over
+static uint32_t rowFingerprint(const EmbeddingIndex& index, uint32_t rows) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t r = 0; r < rows; r++) {
+        float scale = index.scaleAt(r);
+        uint32_t bits;
+        memcpy(&bits, &scale, sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    return hash;
+}
+
+std::string HnswBuildReport::toString() const {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "ROWS=%u;THREADS=%d;LEVELS=%d;DEGREE_MEAN=%.2f;BUILD_MS=%.1f",
+             rows, threads, max_level + 1, degree_mean, build_ms);
+    return buf;
+}
+
+// ===============================================================
+// LAYER SEARCH
+// Shared by build (similarity to a row, lists copied under the
+// node lock) and queries (similarity to the quantised query)
+// ===============================================================
+typedef std::pair<float, uint32_t> Scored;
+
+// Per-thread visited marks; a new tag per search avoids clearing
+struct VisitedSet {
+    std::vector<uint32_t> marks;
+    uint32_t tag = 0;
+
+    void next(uint32_t rows) {
+        if (marks.size() < rows) {
+            marks.assign(rows, 0);
+            tag = 0;
+        }
+        if (++tag == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            tag = 1;
+        }
+    }
+    bool visit(uint32_t node) {
+        if (marks[node] == tag) {
+            return false;
+        }
+        marks[node] = tag;
+        return true;
+    }
+};
+
+typedef std::function<float(uint32_t)> SimilarityFn;
+typedef std::function<void(uint32_t, int, std::vector<uint32_t>&)> NeighborsFn;
+
+// Greedy walk to the most similar node on one level
+static Scored greedyStep(Scored current, int level, const SimilarityFn& similarity, const NeighborsFn& neighbors) {
+    std::vector<uint32_t> links;
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        neighbors(current.second, level, links);
+        for (uint32_t nb : links) {
+            float s = similarity(nb);
+            if (s > current.first) {
+                current = Scored(s, nb);
+                moved = true;
+            }
+        }
+    }
+    return current;
+}
+
+// Best-first search keeping the ef most similar nodes; most similar first
+static std::vector<Scored> searchLayer(Scored entry, int ef, int level, VisitedSet& visited,
+                                       const SimilarityFn& similarity, const NeighborsFn& neighbors) {
+    std::priority_queue<Scored> candidates;
+    std::priority_queue<Scored, std::vector<Scored>, std::greater<Scored>> results;
+    visited.visit(entry.second);
+    candidates.push(entry);
+    results.push(entry);
+
+    std::vector<uint32_t> links;
+    while (!candidates.empty()) {
+        Scored current = candidates.top();
+        if (static_cast<int>(results.size()) >= ef && current.first < results.top().first) {
+            break;
+        }
+        candidates.pop();
+        neighbors(current.second, level, links);
+        for (uint32_t nb : links) {
+            if (!visited.visit(nb)) {
+                continue;
+            }
+            float s = similarity(nb);
+            if (static_cast<int>(results.size()) < ef || s > results.top().first) {
+                candidates.push(Scored(s, nb));
+                results.push(Scored(s, nb));
+                if (static_cast<int>(results.size()) > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Scored> out(results.size());
+    for (size_t i = out.size(); i-- > 0;) {
+        out[i] = results.top();
+        results.pop();
+    }
+    return out;
+}
+
+// ===============================================================
+// BUILD
+// ===============================================================
+struct HnswBuilder {
+    const EmbeddingIndex& index;
+    uint32_t* words;
+    GraphLayout layout;
+    int ef_construction;
+    std::vector<std::mutex> locks;
+    std::mutex entry_lock;
+    uint32_t entry = 0;         // under entry_lock
+    int max_level = 0;
+
+    HnswBuilder(const EmbeddingIndex& index, uint32_t* words, const GraphLayout& layout, int ef)
+        : index(index), words(words), layout(layout), ef_construction(ef), locks(layout.rows) {}
+
+    uint32_t* links(uint32_t node, int level) {
+        return const_cast<uint32_t*>(linkList(words, layout, node, level));
+    }
+
+    void copyLinks(uint32_t node, int level, std::vector<uint32_t>& out) {
+        std::lock_guard<std::mutex> lock(locks[node]);
+        const uint32_t* list = links(node, level);
+        out.assign(list + 1, list + 1 + list[0]);
+    }
+
+    // Keeps a candidate only if it is closer to the base than to every
+    // neighbour kept so far, which spreads links across directions
+    void selectNeighbors(std::vector<Scored>& candidates, size_t max) const {
+        std::vector<Scored> kept;
+        for (const Scored& c : candidates) {
+            if (kept.size() >= max) {
+                break;
+            }
+            bool diverse = true;
+            for (const Scored& k : kept) {
+                if (index.similarity(c.second, k.second) > c.first) {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse) {
+                kept.push_back(c);
+            }
+        }
+        candidates.swap(kept);
+    }
+
+    void connect(uint32_t node, int level, const std::vector<Scored>& selected) {
+        {
+            std::lock_guard<std::mutex> lock(locks[node]);
+            uint32_t* list = links(node, level);
+            list[0] = static_cast<uint32_t>(selected.size());
+            for (size_t i = 0; i < selected.size(); i++) {
+                list[1 + i] = selected[i].second;
+            }
+        }
+
+        const uint32_t cap = level == 0 ? layout.m0 : layout.m;
+        for (const Scored& s : selected) {
+            std::lock_guard<std::mutex> lock(locks[s.second]);
+            uint32_t* list = links(s.second, level);
+            if (list[0] < cap) {
+                list[1 + list[0]++] = node;
+                continue;
+            }
+            // Full: re-select among the old links and the new node
+            std::vector<Scored> candidates;
+            candidates.emplace_back(s.first, node);
+            for (uint32_t i = 0; i < list[0]; i++) {
+                candidates.emplace_back(index.similarity(s.second, list[1 + i]), list[1 + i]);
+            }
+            std::sort(candidates.begin(), candidates.end(), std::greater<Scored>());
+            selectNeighbors(candidates, cap);
+            list[0] = static_cast<uint32_t>(candidates.size());
+            for (size_t i = 0; i < candidates.size(); i++) {
+                list[1 + i] = candidates[i].second;
+            }
+        }
+    }
+
+    void insert(uint32_t node, VisitedSet& visited) {
+        const int level = static_cast<int>(words[layout.levels + node]);
+
+        // A node that raises the top level keeps the entry lock until
+        // it is linked, so no other insert starts from a stale entry
+        std::unique_lock<std::mutex> global(entry_lock);
+        const int top = max_level;
+        Scored current(0.0f, entry);
+        if (level <= top) {
+            global.unlock();
+        }
+
+        SimilarityFn similarity = [&](uint32_t r) { return index.similarity(node, r); };
+        NeighborsFn neighbors = [&](uint32_t r, int l, std::vector<uint32_t>& out) { copyLinks(r, l, out); };
+        current.first = similarity(current.second);
+        for (int l = top; l > level; l--) {
+            current = greedyStep(current, l, similarity, neighbors);
+        }
+        for (int l = std::min(level, top); l >= 0; l--) {
+            visited.next(layout.rows);
+            visited.visit(node);
+            std::vector<Scored> candidates = searchLayer(current, ef_construction, l, visited, similarity, neighbors);
+            current = candidates.front();
+            selectNeighbors(candidates, layout.m);
+            connect(node, l, candidates);
+        }
+
+        if (level > top) {
+            entry = node;
+            max_level = level;
+        }
+    }
+};
+
+bool HnswIndex::build(const EmbeddingIndex& index, const HnswConfig& config, HnswBuildReport& report,
+                      std::string& error) {
+    SLM_TRACE_SCOPE("hnsw_build");
+    close();
+    const uint32_t n = index.rows();
+    if (n == 0) {
+        error = "Embedding index is empty";
+        return false;
+    }
+    const int64_t t0 = traceNowUs();
+    const uint32_t m = static_cast<uint32_t>(std::max(2, config.m));
+
+    // Levels up front: geometric with ratio 1/m
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<double> uniform(std::nextafter(0.0, 1.0), 1.0);
+    const double level_mult = 1.0 / std::log(static_cast<double>(m));
+    std::vector<uint32_t> levels(n), offsets(n);
+    uint32_t upper_words = 0;
+    for (uint32_t r = 0; r < n; r++) {
+        levels[r] = static_cast<uint32_t>(std::min(LEVEL_CAP, static_cast<int>(-std::log(uniform(rng)) * level_mult)));
+        offsets[r] = upper_words;
+        upper_words += levels[r] * (1 + m);
+    }
+
+    GraphLayout layout = layoutOf(n, m, 2 * m, upper_words);
+    m_storage.assign(layout.words, 0);
+    uint32_t* words = m_storage.data();
+    memcpy(words, HNSW_MAGIC, sizeof(HNSW_MAGIC));
+    words[H_ROWS] = n;
+    words[H_M] = m;
+    words[H_M0] = 2 * m;
+    words[H_DIM] = static_cast<uint32_t>(index.dim());
+    words[H_UPPER_WORDS] = upper_words;
+    words[H_FINGERPRINT] = rowFingerprint(index, n);
+    std::copy(levels.begin(), levels.end(), words + layout.levels);
+    std::copy(offsets.begin(), offsets.end(), words + layout.upper_offsets);
+
+    HnswBuilder builder(index, words, layout, std::max(config.ef_construction, config.m));
+    builder.entry = 0;
+    builder.max_level = static_cast<int>(levels[0]);
+
+    std::atomic<uint32_t> next(1);
+    auto work = [&]() {
+        VisitedSet visited;
+        for (uint32_t node = next++; node < n; node = next++) {
+            builder.insert(node, visited);
+        }
+    };
+    const int threads = std::max(1, std::min(config.n_threads, static_cast<int>(n)));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    words[H_MAX_LEVEL] = static_cast<uint32_t>(builder.max_level);
+    words[H_ENTRY] = builder.entry;
+    m_words = words;
+    m_word_count = layout.words;
+
+    uint64_t degree = 0;
+    for (uint32_t r = 0; r < n; r++) {
+        degree += links(r, 0)[0];
+    }
+    report.rows = n;
+    report.threads = threads;
+    report.max_level = builder.max_level;
+    report.degree_mean = static_cast<double>(degree) / n;
+    report.build_ms = (traceNowUs() - t0) / 1000.0;
+    LOGI("HNSW built: %s", report.toString().c_str());
+    return true;
+}
+
+// ===============================================================
+// FILE
+// ===============================================================
+bool HnswIndex::save(const std::string& path, std::string& error) const {
+    if (!ready()) {
+        error = "HNSW graph not built";
+        return false;
+    }
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        error = "Cannot write " + tmp;
+        return false;
+    }
+    bool ok = fwrite(m_words, sizeof(uint32_t), m_word_count, f) == m_word_count;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+// Every level, upper-layer offset, link count and link id of a mapped
+// image lies inside it, so search never reads past the mapping
+static bool validGraph(const uint32_t* words, const GraphLayout& l) {
+    const uint32_t max_level = words[H_MAX_LEVEL];
+    if (l.rows == 0 || l.m == 0 || l.m0 == 0 || max_level > static_cast<uint32_t>(LEVEL_CAP)
+        || words[H_ENTRY] >= l.rows || words[l.levels + words[H_ENTRY]] != max_level) {
+        return false;
+    }
+    const uint64_t upper_words = words[H_UPPER_WORDS];
+    for (uint32_t node = 0; node < l.rows; node++) {
+        const uint32_t level = words[l.levels + node];
+        if (level > max_level
+            || words[l.upper_offsets + node] + static_cast<uint64_t>(level) * (1 + l.m) > upper_words) {
+            return false;
+        }
+        for (uint32_t lv = 0; lv <= level; lv++) {
+            const uint32_t* list = linkList(words, l, node, static_cast<int>(lv));
+            if (list[0] > (lv == 0 ? l.m0 : l.m)) {
+                return false;
+            }
+            for (uint32_t i = 1; i <= list[0]; i++) {
+                if (list[i] >= l.rows) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool HnswIndex::load(const std::string& path, std::string& error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st {};
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        error = "Cannot open " + path;
+        return false;
+    }
+    const size_t bytes = static_cast<size_t>(st.st_size);
+    void* map = bytes >= HEADER_WORDS * sizeof(uint32_t) ? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0)
+                                                         : MAP_FAILED;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = "Not an HNSW graph: " + path;
+        return false;
+    }
+
+    const uint32_t* words = static_cast<const uint32_t*>(map);
+    GraphLayout layout = layoutOf(words[H_ROWS], words[H_M], words[H_M0], words[H_UPPER_WORDS]);
+    if (memcmp(words, HNSW_MAGIC, sizeof(HNSW_MAGIC)) != 0 || layout.words * sizeof(uint32_t) != bytes
+        || !validGraph(words, layout)) {
+        munmap(map, bytes);
+        error = "Not an HNSW graph: " + path;
+        return false;
+    }
+    m_map = map;
+    m_map_bytes = bytes;
+    m_words = words;
+    m_word_count = layout.words;
+    return true;
+}
+
+void HnswIndex::close() {
+    if (m_map != nullptr) {
+        munmap(m_map, m_map_bytes);
+    }
+    m_map = nullptr;
+    m_map_bytes = 0;
+    m_storage.clear();
+    m_storage.shrink_to_fit();
+    m_words = nullptr;
+    m_word_count = 0;
+}
+
+uint32_t HnswIndex::rows() const {
+    return ready() ? header(H_ROWS) : 0;
+}
+
+int HnswIndex::maxLevel() const {
+    return ready() ? static_cast<int>(header(H_MAX_LEVEL)) : 0;
+}
+
+bool HnswIndex::matches(const EmbeddingIndex& index) const {
+    return ready() && index.isOpen() && header(H_DIM) == static_cast<uint32_t>(index.dim())
+           && rows() <= index.rows() && header(H_FINGERPRINT) == rowFingerprint(index, rows());
+}
+
+const uint32_t* HnswIndex::links(uint32_t node, int level) const {
+    return linkList(m_words, layoutOf(rows(), header(H_M), header(H_M0), header(H_UPPER_WORDS)), node, level);
+}
+
+// ===============================================================
+// QUERIES
+// ===============================================================
+std::vector<KnnNeighbor> HnswIndex::search(const EmbeddingIndex& index, const float* query, int k, int ef) const {
+    SLM_TRACE_SCOPE("hnsw_search");
+    if (!ready() || header(H_DIM) != static_cast<uint32_t>(index.dim()) || rows() > index.rows()) {
+        return index.search(query, k);
+    }
+    std::vector<KnnNeighbor> best;
+    if (k <= 0) {
+        return best;
+    }
+
+    std::vector<int8_t> codes;
+    const float scale = index.quantizeQuery(query, codes);
+    SimilarityFn similarity = [&](uint32_t r) { return index.similarity(codes.data(), scale, r); };
+    NeighborsFn neighbors = [&](uint32_t r, int level, std::vector<uint32_t>& out) {
+        const uint32_t* list = links(r, level);
+        out.assign(list + 1, list + 1 + list[0]);
+    };
+
+    Scored current(0.0f, header(H_ENTRY));
+    current.first = similarity(current.second);
+    for (int l = maxLevel(); l > 0; l--) {
+        current = greedyStep(current, l, similarity, neighbors);
+    }
+    thread_local VisitedSet visited;
+    visited.next(rows());
+    std::vector<Scored> found = searchLayer(current, std::max(ef, k), 0, visited, similarity, neighbors);
+
+    // Rows appended since the build
+    for (uint32_t r = rows(); r < index.rows(); r++) {
+        found.emplace_back(similarity(r), r);
+    }
+    std::sort(found.begin(), found.end(), std::greater<Scored>());
+    found.resize(std::min(found.size(), static_cast<size_t>(k)));
+
+    for (const Scored& s : found) {
+        KnnNeighbor neighbor;
+        neighbor.row = s.second;
+        neighbor.similarity = s.first;
+        neighbor.mask = index.maskAt(s.second);
+        best.push_back(neighbor);
+    }
+    return best;
+}
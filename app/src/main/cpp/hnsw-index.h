@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "embedding-index.h"
+
+// ===============================================================
+// HNSW GRAPH
+// Hierarchical navigable small-world graph over the rows of an
+// EmbeddingIndex, for catalogs where the flat scan stops being
+// cheap. The graph stores only links; similarities come from the
+// index's int8 rows, so the vectors exist once.
+//
+// Build inserts rows from several threads, locking one node's link
+// list at a time; levels are drawn up front from the seed so the
+// layout (not the exact links) is reproducible. The serialized file
+// is the in-memory image, so loading is a read-only mmap.
+//
+// Rows appended to the index after the build are not in the graph;
+// search scans them linearly and merges, so incremental inserts keep
+// working until the next rebuild.
+// ===============================================================
+
+struct HnswConfig {
+    int m = 16;                     // links per node on upper layers, 2m on layer 0
+    int ef_construction = 100;
+    int ef_search = 64;             // candidate list; raised to k when smaller
+    int n_threads = 4;
+    unsigned seed = 1;
+};
+
+struct HnswBuildReport {
+    uint32_t rows = 0;
+    int threads = 0;
+    int max_level = 0;
+    double degree_mean = 0.0;       // layer 0 links per node
+    double build_ms = 0.0;
+
+    // "ROWS=..;THREADS=..;LEVELS=..;DEGREE_MEAN=..;BUILD_MS=.."
+    std::string toString() const;
+};
+
+class HnswIndex {
+public:
+    HnswIndex() = default;
+    HnswIndex(const HnswIndex&) = delete;
+    HnswIndex& operator=(const HnswIndex&) = delete;
+    ~HnswIndex() { close(); }
+
+    // Links every row of index
+    bool build(const EmbeddingIndex& index, const HnswConfig& config, HnswBuildReport& report,
+               std::string& error);
+    bool save(const std::string& path, std::string& error) const;
+    // Maps a saved graph read-only
+    bool load(const std::string& path, std::string& error);
+    void close();
+
+    bool ready() const { return m_words != nullptr; }
+    uint32_t rows() const;
+    int maxLevel() const;
+    size_t bytes() const { return m_word_count * sizeof(uint32_t); }
+    // Built over these rows of index (same dim and row scales)
+    bool matches(const EmbeddingIndex& index) const;
+
+    // The k most similar rows of index, most similar first. Falls
+    // back to the exact scan on a dim or row count mismatch only; the
+    // row fingerprint costs a pass over the index, so callers check
+    // matches() once after load or build
+    std::vector<KnnNeighbor> search(const EmbeddingIndex& index, const float* query, int k, int ef) const;
+
+private:
+    uint32_t header(int word) const { return m_words[word]; }
+    const uint32_t* links(uint32_t node, int level) const;
+
+    std::vector<uint32_t> m_storage;    // built image
+    void* m_map = nullptr;              // or the loaded file
+    size_t m_map_bytes = 0;
+    const uint32_t* m_words = nullptr;
+    size_t m_word_count = 0;
+};
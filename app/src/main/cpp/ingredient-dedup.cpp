@@ -0,0 +1,106 @@
+#include "ingredient-dedup.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+#include "allergen-lexicon.h"
+#include "slm-trace.h"
+
+// ===============================================================
+// CANONICAL FORM
+// ===============================================================
+// Normalised entry with whitespace runs collapsed and trimmed
+static std::string canonicalEntry(const char* begin, size_t len) {
+    std::string norm(len, ' ');
+    normalizeIngredientText(begin, len, &norm[0]);
+
+    std::string out;
+    out.reserve(len);
+    bool prev_space = true;
+    for (char c : norm) {
+        bool is_space = (c == ' ');
+        if (is_space && prev_space) {
+            continue;
+        }
+        out += c;
+        prev_space = is_space;
+    }
+    if (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+    return out;
+}
+
+std::string canonicalIngredients(const std::string& text, const DedupOptions& options) {
+    std::vector<std::string> entries;
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= text.size(); i++) {
+        const char c = i < text.size() ? text[i] : ',';
+        if (c == '(' || c == '[' || c == '{') {
+            depth++;
+        } else if ((c == ')' || c == ']' || c == '}') && depth > 0) {
+            depth--;
+        } else if ((c == ',' || c == ';') && (depth == 0 || i == text.size())) {
+            std::string entry = canonicalEntry(text.data() + start, i - start);
+            if (!entry.empty()) {
+                entries.push_back(std::move(entry));
+            }
+            start = i + 1;
+        }
+    }
+    if (options.ignore_order) {
+        std::sort(entries.begin(), entries.end());
+    }
+
+    std::string out;
+    for (const std::string& entry : entries) {
+        if (!out.empty()) {
+            out += ',';
+        }
+        out += entry;
+    }
+    return out;
+}
+
+// ===============================================================
+// PLAN
+// ===============================================================
+double DedupPlan::dedupRatio() const {
+    return items() > 0 ? 1.0 - static_cast<double>(groups()) / items() : 0.0;
+}
+
+uint32_t DedupPlan::largestGroup() const {
+    return group_size.empty() ? 0 : *std::max_element(group_size.begin(), group_size.end());
+}
+
+std::string DedupPlan::toString() const {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "ITEMS=%zu;GROUPS=%zu;DEDUP_RATIO=%.4f;LARGEST_GROUP=%u;PLAN_US=%.0f",
+             items(), groups(), dedupRatio(), largestGroup(), plan_us);
+    return buf;
+}
+
+DedupPlan planDedup(const std::vector<std::string>& ingredients, const DedupOptions& options) {
+    SLM_TRACE_SCOPE("dedup_plan");
+    const int64_t t0 = traceNowUs();
+    DedupPlan plan;
+    plan.group.resize(ingredients.size());
+
+    std::unordered_map<std::string, uint32_t> groups;
+    groups.reserve(ingredients.size());
+    for (size_t i = 0; i < ingredients.size(); i++) {
+        auto inserted = groups.emplace(canonicalIngredients(ingredients[i], options),
+                                       static_cast<uint32_t>(plan.representative.size()));
+        if (inserted.second) {
+            plan.representative.push_back(static_cast<uint32_t>(i));
+            plan.group_size.push_back(0);
+        }
+        plan.group[i] = inserted.first->second;
+        plan.group_size[inserted.first->second]++;
+    }
+
+    plan.plan_us = static_cast<double>(traceNowUs() - t0);
+    return plan;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ===============================================================
+// INGREDIENT DEDUPLICATION
+// Planning pass over a dataset before inference: items whose
+// ingredient text is the same after canonicalisation form a group,
+// inference runs once per group and the result is fanned out to
+// every member. Catalogs repeat the same recipe under many products,
+// so this cuts work in proportion without changing any item's
+// prediction.
+//
+// Canonical form: the list is split into entries at top-level ','
+// and ';' (not inside brackets), each entry is case folded with
+// punctuation and whitespace runs reduced to single spaces (the
+// lexicon's normalisation), and empty entries are dropped. With
+// ignore_order the entries are sorted, so reordered lists match.
+// ===============================================================
+
+struct DedupOptions {
+    bool ignore_order = false;      // "salt, sugar" groups with "sugar, salt"
+};
+
+std::string canonicalIngredients(const std::string& text, const DedupOptions& options);
+
+struct DedupPlan {
+    std::vector<uint32_t> group;            // per item
+    std::vector<uint32_t> representative;   // per group: its first item
+    std::vector<uint32_t> group_size;
+    double plan_us = 0.0;
+
+    size_t items() const { return group.size(); }
+    size_t groups() const { return representative.size(); }
+    // Share of items that need no inference of their own
+    double dedupRatio() const;
+    uint32_t largestGroup() const;
+
+    // "ITEMS=..;GROUPS=..;DEDUP_RATIO=..;LARGEST_GROUP=..;PLAN_US=.."
+    std::string toString() const;
+};
+
+DedupPlan planDedup(const std::vector<std::string>& ingredients, const DedupOptions& options);
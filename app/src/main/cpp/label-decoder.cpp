@@ -0,0 +1,214 @@
+#include "label-decoder.h"
+
+#include <cctype>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+static std::string tokenPiece(const llama_vocab* vocab, llama_token token) {
+    char buf[256];
+    int n = llama_token_to_piece(vocab, token, buf, sizeof(buf), 0, false);
+    if (n >= 0) {
+        return std::string(buf, n);
+    }
+    std::string piece(-n, '\0');
+    n = llama_token_to_piece(vocab, token, &piece[0], piece.size(), 0, false);
+    return n >= 0 ? piece.substr(0, n) : std::string();
+}
+
+static uint8_t classifyPiece(const std::string& piece) {
+    uint8_t cls = 0;
+    bool only_separators = true;
+    bool only_blank = true;
+    for (unsigned char c : piece) {
+        if (std::isalpha(c)) cls |= TOKEN_ALPHA;
+        if (c == ',') cls |= TOKEN_COMMA;
+        if (c == '\n') cls |= TOKEN_NEWLINE;
+        if (c == '<') cls |= TOKEN_MARKER;
+
+        const bool blank = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        only_blank = only_blank && blank;
+        only_separators = only_separators && (blank || c == ',');
+    }
+    if (only_blank) {
+        cls |= TOKEN_BLANK;
+    } else if (only_separators) {
+        cls |= TOKEN_SEPARATOR;
+    }
+    return cls;
+}
+
+// ===============================================================
+// BUILD
+// ===============================================================
+void LabelDecoder::insert(const std::string& spelling, int label) {
+    llama_token ids[32];
+    int n = llama_tokenize(m_vocab, spelling.c_str(), spelling.length(), ids, 32, false, false);
+    if (n <= 0) {
+        return;
+    }
+
+    int node = 0;
+    for (int i = 0; i < n; i++) {
+        int child = -1;
+        for (const auto& edge : m_nodes[node].next) {
+            if (edge.first == ids[i]) {
+                child = edge.second;
+                break;
+            }
+        }
+        if (child < 0) {
+            child = static_cast<int>(m_nodes.size());
+            m_nodes[node].next.emplace_back(ids[i], child);
+            m_nodes.emplace_back();
+        }
+        node = child;
+    }
+    m_nodes[node].label = label;
+}
+
+bool LabelDecoder::build(const llama_vocab* vocab) {
+    SLM_TRACE_SCOPE("label_decoder_build");
+    const int64_t t0 = traceNowUs();
+
+    m_vocab = vocab;
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    m_class.assign(n_vocab, 0);
+    for (llama_token id = 0; id < n_vocab; id++) {
+        m_class[id] = classifyPiece(tokenPiece(vocab, id));
+    }
+
+    m_nodes.assign(1, Node());
+    std::vector<std::pair<std::string, int>> spellings;
+    for (int i = 0; i < ALLERGEN_COUNT; i++) {
+        spellings.emplace_back(ALLERGEN_LABELS[i], i);
+    }
+    spellings.emplace_back("none", LABEL_NONE);
+    // parseAllergenList rewrites these before matching
+    spellings.emplace_back("tree-nut", allergenIndex("tree nut"));
+    spellings.emplace_back("treenut", allergenIndex("tree nut"));
+
+    for (const auto& s : spellings) {
+        std::string lower = s.first;
+        std::string capital = lower;
+        std::string title = lower;
+        std::string upper = lower;
+        capital[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(capital[0])));
+        for (size_t i = 0; i < title.size(); i++) {
+            if (i == 0 || title[i - 1] == ' ' || title[i - 1] == '-') {
+                title[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(title[i])));
+            }
+        }
+        for (char& c : upper) {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        for (const std::string& form : {lower, capital, title, upper}) {
+            insert(form, s.second);
+            insert(" " + form, s.second);
+        }
+    }
+
+    m_build_ms = (traceNowUs() - t0) / 1000.0;
+    LOGI("Label decoder: %d tokens classified, %zu trie nodes, %.1f ms",
+         n_vocab, m_nodes.size(), m_build_ms);
+    return true;
+}
+
+// ===============================================================
+// PARSE
+// ===============================================================
+void LabelDecoder::closeSegment(LabelParseState& state) const {
+    if (state.node == 0) {
+        return;     // empty segment (",," or leading comma)
+    }
+    const int label = m_nodes[state.node].label;
+    if (label < 0) {
+        state.miss = true;
+    } else if (label == LABEL_NONE) {
+        state.none = true;
+    } else {
+        state.mask |= static_cast<AllergenMask>(1u << label);
+    }
+    state.node = 0;
+}
+
+void LabelDecoder::push(LabelParseState& state, llama_token token) const {
+    state.tokens.push_back(token);
+    if (state.miss) {
+        return;
+    }
+
+    const uint8_t cls = tokenClass(token);
+    if (cls & TOKEN_SEPARATOR) {
+        closeSegment(state);
+        return;
+    }
+    // Whitespace around a label is trimmed; inside one it is a miss
+    if ((cls & TOKEN_BLANK) && (state.node == 0 || m_nodes[state.node].label >= 0)) {
+        return;
+    }
+
+    state.content = true;
+    for (const auto& edge : m_nodes[state.node].next) {
+        if (edge.first == token) {
+            state.node = edge.second;
+            return;
+        }
+    }
+    state.miss = true;
+}
+
+// A segment of the free text (between commas or lines) that is just
+// "none", ignoring case and surrounding punctuation ("None.", "NONE")
+static bool saysNone(const std::string& text) {
+    const char* const trim = " \r\t.!;:*\"'`";
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find_first_of(",\n", start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string segment = text.substr(start, end - start);
+        size_t first = segment.find_first_not_of(trim);
+        if (first != std::string::npos) {
+            segment = segment.substr(first, segment.find_last_not_of(trim) - first + 1);
+            for (char& c : segment) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            if (segment == "none") {
+                return true;
+            }
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+AllergenMask LabelDecoder::finish(LabelParseState& state, bool& fallback) const {
+    if (!state.miss) {
+        closeSegment(state);
+    }
+    fallback = state.miss;
+    if (!fallback) {
+        return state.none ? 0 : state.mask;
+    }
+
+    std::string text = detokenize(state.tokens);
+    for (const char* marker : {"<|im_end|>", "<end_of_turn>", "<start_of_turn>"}) {
+        size_t pos = text.find(marker);
+        if (pos != std::string::npos) {
+            text.erase(pos);
+        }
+    }
+    state.none = saysNone(text);
+    state.content = text.find_first_not_of(" \n\r\t,") != std::string::npos;
+    return parseAllergenList(text);
+}
+
+std::string LabelDecoder::detokenize(const std::vector<llama_token>& tokens) const {
+    std::string text;
+    for (llama_token token : tokens) {
+        text += tokenPiece(m_vocab, token);
+    }
+    return text;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "allergen-labels.h"
+#include "llama/llama.h"
+
+// ===============================================================
+// TOKEN LABEL DECODER
+// Maps generated token ids straight to an AllergenMask. At load
+// every vocab piece is classified once (letters, comma, newline,
+// '<', blank), and the spellings the model emits for each label and
+// for "none" (" milk", "Milk", " tree nut", "tree-nut", ...) are
+// tokenized into a trie over token ids. Per generated token that is
+// one table lookup and one trie step. A comma token ends a segment,
+// which must then sit on a label node; whitespace around a label is
+// skipped, as parseAllergenList trims it.
+//
+// Anything the trie does not cover (a plural, a piece that merges a
+// label with its comma) marks the parse as missed; finish() then
+// detokenizes the ids and runs parseAllergenList, so the mask always
+// equals what the string path would produce.
+// ===============================================================
+
+enum TokenClass : uint8_t {
+    TOKEN_ALPHA = 1,        // has an ASCII letter
+    TOKEN_COMMA = 2,
+    TOKEN_NEWLINE = 4,
+    TOKEN_MARKER = 8,       // has '<', the start of an end-of-turn marker
+    TOKEN_BLANK = 16,       // whitespace only, or renders as nothing
+    TOKEN_SEPARATOR = 32,   // commas and whitespace only, at least one comma
+};
+
+struct LabelParseState {
+    int node = 0;                       // trie position in the current segment
+    bool miss = false;                  // left the trie; finish() re-parses the text
+    bool none = false;                  // a "none" segment: the answer is the empty mask
+    bool content = false;               // anything besides whitespace and commas
+    AllergenMask mask = 0;
+    std::vector<llama_token> tokens;    // every pushed id, for the fallback
+};
+
+class LabelDecoder {
+public:
+    // Classifies the vocab and tokenizes the label spellings
+    bool build(const llama_vocab* vocab);
+    bool ready() const { return m_vocab != nullptr; }
+
+    uint8_t tokenClass(llama_token token) const {
+        return token >= 0 && token < static_cast<llama_token>(m_class.size()) ? m_class[token] : 0;
+    }
+
+    void push(LabelParseState& state, llama_token token) const;
+    // Closes the last segment; fallback is set when the ids were
+    // re-parsed as text
+    AllergenMask finish(LabelParseState& state, bool& fallback) const;
+
+    // Raw text of the ids, as the string path would have built it
+    std::string detokenize(const std::vector<llama_token>& tokens) const;
+
+    size_t trieNodes() const { return m_nodes.size(); }
+    double buildMs() const { return m_build_ms; }
+
+private:
+    static constexpr int LABEL_NONE = ALLERGEN_COUNT;   // terminal for "none"
+
+    struct Node {
+        std::vector<std::pair<llama_token, int>> next;
+        int label = -1;                 // ALLERGEN_LABELS index, LABEL_NONE or -1
+    };
+
+    void insert(const std::string& spelling, int label);
+    void closeSegment(LabelParseState& state) const;
+
+    const llama_vocab* m_vocab = nullptr;
+    std::vector<uint8_t> m_class;       // per token id
+    std::vector<Node> m_nodes;          // [0] is the root
+    double m_build_ms = 0.0;
+};
@@ -0,0 +1,138 @@
+#include "lora-adapters.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+static std::string adapterMeta(const llama_adapter_lora* adapter, const char* key) {
+    char buf[256];
+    return llama_adapter_meta_val_str(adapter, key, buf, sizeof(buf)) >= 0 ? std::string(buf) : std::string();
+}
+
+std::string LoraAdapterInfo::toString() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf), ";TYPE=%s;ALPHA=%.2f;META_KEYS=%d;FILE_MB=%.1f;LOAD_MS=%.1f",
+             type.c_str(), alpha, meta_keys, file_mb, load_ms);
+    return "ID=" + id + ";NAME=" + name + buf;
+}
+
+int LoraAdapters::find(const std::string& id) const {
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        if (m_entries[i].info.id == id) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool LoraAdapters::has(const std::string& id) const {
+    return find(id) >= 0;
+}
+
+bool LoraAdapters::load(llama_model* model, const std::string& id, const std::string& path,
+                        LoraAdapterInfo& info, std::string& error) {
+    if (model == nullptr) {
+        error = "Model not loaded";
+        return false;
+    }
+    if (id.empty() || has(id)) {
+        error = id.empty() ? "Adapter id must not be empty" : "Adapter '" + id + "' already loaded";
+        return false;
+    }
+
+    SLM_TRACE_SCOPE("lora_load");
+    const int64_t t0 = traceNowUs();
+    llama_adapter_lora* adapter = llama_adapter_lora_init(model, path.c_str());
+    if (adapter == nullptr) {
+        error = "Cannot load adapter " + path;
+        return false;
+    }
+
+    info = LoraAdapterInfo();
+    info.id = id;
+    info.path = path;
+    info.load_ms = (traceNowUs() - t0) / 1000.0;
+    info.name = adapterMeta(adapter, "general.name");
+    if (info.name.empty()) {
+        size_t slash = path.find_last_of('/');
+        info.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+    info.type = adapterMeta(adapter, "adapter.type");
+    info.alpha = static_cast<float>(atof(adapterMeta(adapter, "adapter.lora.alpha").c_str()));
+    info.meta_keys = llama_adapter_meta_count(adapter);
+    struct stat st {};
+    if (stat(path.c_str(), &st) == 0) {
+        info.file_mb = st.st_size / (1024.0 * 1024.0);
+    }
+
+    m_entries.push_back({info, adapter});
+    LOGI("LoRA adapter: %s", info.toString().c_str());
+    return true;
+}
+
+bool LoraAdapters::activate(llama_context* ctx, const std::string& id, float scale,
+                            bool& switched, double& switch_ms, std::string& error) {
+    switched = false;
+    switch_ms = 0.0;
+    const int target = id.empty() ? -1 : find(id);
+    if (!id.empty() && target < 0) {
+        error = "Unknown adapter '" + id + "'";
+        return false;
+    }
+    if (target == m_active && (target < 0 || scale == m_scale)) {
+        return true;
+    }
+
+    SLM_TRACE_SCOPE("lora_switch");
+    const int64_t t0 = traceNowUs();
+    if (m_active >= 0) {
+        llama_rm_adapter_lora(ctx, m_entries[m_active].adapter);
+        m_active = -1;
+    }
+    if (target >= 0) {
+        if (llama_set_adapter_lora(ctx, m_entries[target].adapter, scale) != 0) {
+            error = "llama_set_adapter_lora failed for '" + id + "'";
+            return false;
+        }
+        m_active = target;
+        m_scale = scale;
+    }
+    switch_ms = (traceNowUs() - t0) / 1000.0;
+    switched = true;
+    return true;
+}
+
+bool LoraAdapters::reapply(llama_context* ctx) {
+    if (m_active < 0) {
+        return true;
+    }
+    return llama_set_adapter_lora(ctx, m_entries[m_active].adapter, m_scale) == 0;
+}
+
+const std::string& LoraAdapters::activeId() const {
+    static const std::string base;
+    return m_active >= 0 ? m_entries[m_active].info.id : base;
+}
+
+const LoraAdapterInfo* LoraAdapters::activeInfo() const {
+    return m_active >= 0 ? &m_entries[m_active].info : nullptr;
+}
+
+std::vector<LoraAdapterInfo> LoraAdapters::list() const {
+    std::vector<LoraAdapterInfo> out;
+    for (const Entry& entry : m_entries) {
+        out.push_back(entry.info);
+    }
+    return out;
+}
+
+void LoraAdapters::freeAll() {
+    for (Entry& entry : m_entries) {
+        llama_adapter_lora_free(entry.adapter);
+    }
+    m_entries.clear();
+    m_active = -1;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "llama/llama.h"
+
+// ===============================================================
+// LORA ADAPTERS
+// Adapters loaded once against the session's base model and
+// switched per request. A switch is llama_rm_adapter_lora on the old
+// adapter plus llama_set_adapter_lora on the new one: no weights are
+// reloaded, so it costs what building the next graph costs. The base
+// model is the empty id. Adapters are freed before their model.
+// ===============================================================
+
+struct LoraAdapterInfo {
+    std::string id;
+    std::string path;
+    std::string name;           // general.name, else the file name
+    std::string type;           // adapter.type: "lora", "alora"
+    float alpha = 0.0f;         // adapter.lora.alpha, 0 when absent
+    int meta_keys = 0;
+    double file_mb = 0.0;
+    double load_ms = 0.0;
+
+    // "ID=..;NAME=..;TYPE=..;ALPHA=..;META_KEYS=..;FILE_MB=..;LOAD_MS=.."
+    std::string toString() const;
+};
+
+class LoraAdapters {
+public:
+    // Loads path under a new id
+    bool load(llama_model* model, const std::string& id, const std::string& path,
+              LoraAdapterInfo& info, std::string& error);
+    bool has(const std::string& id) const;
+
+    // Makes id (empty = base model) the only adapter on ctx, at scale.
+    // switched is false when it already was; switch_ms covers the
+    // llama_rm / llama_set calls
+    bool activate(llama_context* ctx, const std::string& id, float scale,
+                  bool& switched, double& switch_ms, std::string& error);
+    // Puts the active adapter on a new context for the same model
+    bool reapply(llama_context* ctx);
+
+    const std::string& activeId() const;
+    float activeScale() const { return m_active >= 0 ? m_scale : 0.0f; }
+    const LoraAdapterInfo* activeInfo() const;
+    std::vector<LoraAdapterInfo> list() const;
+
+    // Before llama_model_free; the context must not use them anymore
+    void freeAll();
+
+private:
+    struct Entry {
+        LoraAdapterInfo info;
+        llama_adapter_lora* adapter = nullptr;
+    };
+
+    int find(const std::string& id) const;
+
+    std::vector<Entry> m_entries;
+    int m_active = -1;
+    float m_scale = 1.0f;
+};
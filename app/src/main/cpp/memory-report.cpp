@@ -0,0 +1,141 @@
+#include "memory-report.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// ===============================================================
+// /proc
+// ===============================================================
+
+// "Key:   1234 kB" -> 1234 when the line starts with key
+static bool parseKbLine(const std::string& line, const char* key, long& value) {
+    size_t len = strlen(key);
+    if (line.compare(0, len, key) != 0) {
+        return false;
+    }
+    value = atol(line.c_str() + len);
+    return true;
+}
+
+// smaps mapping headers start with "start-end perms ..."; field lines
+// start with a "Name:" key
+static bool isMappingHeader(const std::string& line) {
+    size_t space = line.find(' ');
+    return space != std::string::npos && line.find('-') < space && line[space - 1] != ':';
+}
+
+MemorySnapshot readMemorySnapshot(const std::string& model_path) {
+    MemorySnapshot snap;
+    std::string line;
+
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    while (std::getline(rollup, line)) {
+        snap.ok = true;
+        if (parseKbLine(line, "Rss:", snap.rss_kb)) continue;
+        if (parseKbLine(line, "Pss:", snap.pss_kb)) continue;
+        if (parseKbLine(line, "Anonymous:", snap.anon_kb)) continue;
+        parseKbLine(line, "Swap:", snap.swap_kb);
+    }
+
+    std::ifstream status("/proc/self/status");
+    while (std::getline(status, line)) {
+        if (parseKbLine(line, "VmHWM:", snap.hwm_kb)) {
+            break;
+        }
+    }
+
+    if (model_path.empty()) {
+        return snap;
+    }
+
+    const std::string target = mappedFileName(model_path);
+    std::ifstream smaps("/proc/self/smaps");
+    bool in_model = false;
+    long value = 0;
+    while (std::getline(smaps, line)) {
+        if (isMappingHeader(line)) {
+            in_model = mapsLineNames(line, target);
+        } else if (in_model) {
+            if (parseKbLine(line, "Size:", value)) {
+                snap.model_size_kb += value;
+            } else if (parseKbLine(line, "Rss:", value)) {
+                snap.model_rss_kb += value;
+            }
+        }
+    }
+    return snap;
+}
+
+std::string mappedFileName(const std::string& path) {
+    char resolved[PATH_MAX];
+    return realpath(path.c_str(), resolved) != nullptr ? resolved : path;
+}
+
+bool mapsLineNames(const std::string& line, const std::string& mapped_name) {
+    // "start-end perms offset dev inode   path"
+    size_t slash = line.find('/');
+    return slash != std::string::npos && line.compare(slash, std::string::npos, mapped_name) == 0;
+}
+
+double readMemAvailableMb() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    long kb = 0;
+    while (std::getline(meminfo, line)) {
+        if (parseKbLine(line, "MemAvailable:", kb)) {
+            return kb / 1024.0;
+        }
+    }
+    return -1.0;
+}
+
+// ===============================================================
+// KV SIZING
+// ===============================================================
+double kvTypeBytes(ggml_type type) {
+    switch (type) {
+        case GGML_TYPE_F32:    return 4.0;
+        case GGML_TYPE_F16:
+        case GGML_TYPE_BF16:   return 2.0;
+        case GGML_TYPE_Q8_0:   return 34.0 / 32.0;
+        case GGML_TYPE_Q5_1:   return 24.0 / 32.0;
+        case GGML_TYPE_Q5_0:   return 22.0 / 32.0;
+        case GGML_TYPE_Q4_1:   return 20.0 / 32.0;
+        case GGML_TYPE_Q4_0:
+        case GGML_TYPE_IQ4_NL: return 18.0 / 32.0;
+        default:               return 2.0;
+    }
+}
+
+double estimateKvCacheMb(const llama_model* model, uint32_t n_ctx,
+                         ggml_type type_k, ggml_type type_v) {
+    if (model == nullptr) {
+        return 0.0;
+    }
+    int n_head = llama_model_n_head(model);
+    if (n_head <= 0) {
+        return 0.0;
+    }
+    double head_dim = static_cast<double>(llama_model_n_embd(model)) / n_head;
+    double per_cell = llama_model_n_layer(model) * llama_model_n_head_kv(model) * head_dim *
+                      (kvTypeBytes(type_k) + kvTypeBytes(type_v));
+    return per_cell * n_ctx / (1024.0 * 1024.0);
+}
+
+std::string MemoryBreakdown::toString() const {
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "MEM_RSS_MB=%.1f;MEM_PSS_MB=%.1f;MEM_PEAK_RSS_MB=%.1f;MEM_SWAP_MB=%.1f"
+             ";MEM_WEIGHTS_FILE_MB=%.1f;MEM_WEIGHTS_MAPPED_MB=%.1f;MEM_WEIGHTS_RESIDENT_MB=%.1f"
+             ";MEM_WEIGHTS_ANON_MB=%.1f;MEM_KV_MB=%.1f;MEM_KV_USED_MB=%.2f;MEM_STATE_MB=%.2f"
+             ";MEM_COMPUTE_MB=%.1f;MEM_OTHER_MB=%.1f;MEM_GROWTH_MB=%.2f",
+             rss_mb, pss_mb, peak_rss_mb, swap_mb,
+             weights_file_mb, weights_mapped_mb, weights_resident_mb,
+             weights_anon_mb, kv_cache_mb, kv_used_mb, state_mb,
+             compute_mb, other_mb, growth_mb);
+    return buf;
+}
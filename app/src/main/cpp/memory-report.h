@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "llama/llama.h"
+
+// ===============================================================
+// NATIVE MEMORY ACCOUNTING
+// Java/native heap deltas miss almost everything: weights are
+// mmap'd file pages and the KV cache is allocated once per context.
+// Snapshots read /proc/self/smaps_rollup (process totals) and the
+// /proc/self/smaps entries of the GGUF file, so memory can be split
+// into weights (mapped vs resident), KV cache, compute buffers and
+// the rest of the process.
+// ===============================================================
+
+struct MemorySnapshot {
+    long rss_kb = 0;
+    long pss_kb = 0;
+    long anon_kb = 0;
+    long swap_kb = 0;
+    long hwm_kb = 0;            // VmHWM: peak RSS so far
+    long model_size_kb = 0;     // mappings of the model file
+    long model_rss_kb = 0;
+    bool ok = false;
+};
+
+// model_path may be empty (no per-mapping pass)
+MemorySnapshot readMemorySnapshot(const std::string& model_path);
+
+// The name /proc/self/maps and smaps give the file at path (the
+// kernel shows the resolved path of mapped files)
+std::string mappedFileName(const std::string& path);
+// Whether a maps or smaps mapping line maps the file of that name
+bool mapsLineNames(const std::string& line, const std::string& mapped_name);
+
+// MemAvailable from /proc/meminfo, -1 when unreadable
+double readMemAvailableMb();
+
+// Bytes per element of a KV cache type, without linking ggml
+double kvTypeBytes(ggml_type type);
+
+// n_ctx x layers x KV heads x head dim for K and V; SWA and recurrent
+// models allocate less, so this is an upper bound for them
+double estimateKvCacheMb(const llama_model* model, uint32_t n_ctx,
+                         ggml_type type_k, ggml_type type_v);
+
+struct MemoryBreakdown {
+    double weights_file_mb = 0.0;       // llama_model_size
+    double weights_mapped_mb = 0.0;     // address space of the GGUF mappings (0 without mmap)
+    double weights_resident_mb = 0.0;   // GGUF pages in RAM now
+    double weights_anon_mb = 0.0;       // anonymous growth while loading (weights copied when not mmap'd)
+    double kv_cache_mb = 0.0;           // allocated for n_ctx cells
+    double kv_used_mb = 0.0;            // cells holding positions right now
+    double state_mb = 0.0;              // llama_state_get_size
+    double compute_mb = 0.0;            // context anonymous growth beyond the KV cache
+    double other_mb = 0.0;              // anonymous memory not attributed above (runtime + our allocations)
+    double growth_mb = 0.0;             // anonymous growth since the context was created
+
+    double rss_mb = 0.0;
+    double pss_mb = 0.0;
+    double swap_mb = 0.0;
+    double peak_rss_mb = 0.0;
+
+    // "MEM_RSS_MB=..;MEM_PSS_MB=..;MEM_WEIGHTS_RESIDENT_MB=..;..."
+    std::string toString() const;
+};
@@ -0,0 +1,1420 @@
+// ===============================================================
+// DETERMINISTIC MOCK LLAMA BACKEND
+// Drop-in stand-in for libllama covering the llama.h subset the
+// engine uses (tokenize, decode, logits, vocab, memory, state, perf).
+// Latencies are drawn from seeded distributions and answers come from
+// a script, so orchestration code can be benchmarked on a host in
+// seconds with bit-identical outputs between runs.
+//
+// The "model file" is a key=value spec (see mock/*.mock). Any other
+// existing file, e.g. a real .gguf, loads with the default spec.
+// SLM_MOCK_TIME_SCALE and SLM_MOCK_SEED override the spec at load.
+// LoRA adapters are *.lora.mock specs of their own: metadata, the
+// per-token cost they add and the label noise they bring the model to.
+// ===============================================================
+
+#include "../llama/llama.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+static ggml_log_callback g_log_callback = nullptr;
+static void* g_log_user_data = nullptr;
+
+static void mockLog(enum ggml_log_level level, const char* fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    if (g_log_callback != nullptr) {
+        g_log_callback(level, buf, g_log_user_data);
+    } else if (level >= GGML_LOG_LEVEL_WARN || getenv("SLM_MOCK_VERBOSE") != nullptr) {
+        fputs(buf, stderr);
+    }
+}
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sleep for the bulk of the delay, spin the tail for sub-ms accuracy
+static void busyWaitUs(double us) {
+    if (us <= 0.0) {
+        return;
+    }
+    const int64_t deadline = nowUs() + static_cast<int64_t>(us);
+    if (us > 2000.0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(us) - 1000));
+    }
+    while (nowUs() < deadline) {
+    }
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hashString(const std::string& s, uint64_t seed) {
+    uint64_t h = 1469598103934665603ULL ^ seed;
+    for (unsigned char c : s) {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    return mix64(h);
+}
+
+static std::string toLower(std::string s) {
+    for (char& c : s) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return s;
+}
+
+// ===============================================================
+// SPEC
+// ===============================================================
+struct MockRule {
+    std::string pattern;   // lowercase substring of the ingredients, "*" = any
+    std::string response;
+    float margin = -1.0f;  // < 0 = spec default
+};
+
+struct MockSpec {
+    std::string name = "mock";
+    int32_t n_vocab = 32000;
+    int32_t n_ctx_train = 32768;
+    int32_t n_embd = 1536;
+    int32_t n_layer = 28;
+    int32_t n_head = 12;
+    int32_t n_head_kv = 2;
+    uint64_t n_params = 1500000000ULL;
+    uint64_t size_bytes = 0;         // 0 = file size of a non-spec model path
+
+    uint64_t seed = 42;
+    double time_scale = 1.0;         // multiplies every simulated delay
+    double load_ms = 0.0;
+    double cold_ms = 0.0;            // extra cost of the first decode after load
+    double prefill_base_us = 0.0;    // per prompt batch
+    double prefill_us = 0.0;         // per prompt token
+    double decode_us = 0.0;          // per generated token
+    std::string dist = "fixed";      // fixed | uniform | normal | lognormal
+    double jitter = 0.0;             // relative spread (coefficient of variation)
+    double spike_prob = 0.0;         // chance a decode call is a latency spike
+    double spike_x = 10.0;           // spike multiplier
+
+    float margin = 8.0f;             // top1 - top2 logit gap of scripted tokens
+    float noise_margin = 1.0f;       // gap at tokens affected by label noise
+    double label_noise = 0.0;        // fraction of items with one label flipped
+    int fail_every = 0;              // every Nth llama_decode fails (0 = never)
+
+    std::vector<MockRule> rules;
+};
+
+static bool loadMockScript(const std::string& path, MockSpec& spec) {
+    std::ifstream in(path);
+    if (!in) {
+        mockLog(GGML_LOG_LEVEL_ERROR, "mock: cannot open script %s\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+
+        MockRule rule;
+        rule.pattern = toLower(line.substr(0, tab));
+        std::string rest = line.substr(tab + 1);
+        size_t tab2 = rest.find('\t');
+        if (tab2 != std::string::npos) {
+            rule.margin = strtof(rest.c_str() + tab2 + 1, nullptr);
+            rest.resize(tab2);
+        }
+        rule.response = rest;
+        spec.rules.push_back(rule);
+    }
+    return true;
+}
+
+static bool parseMockSpec(const std::string& path, MockSpec& spec) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+
+    std::string dir;
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos) dir = path.substr(0, slash + 1);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+
+        auto trim = [](std::string s) {
+            size_t b = s.find_first_not_of(" \t\r");
+            size_t e = s.find_last_not_of(" \t\r");
+            return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+        };
+        std::string key = trim(line.substr(0, eq));
+        std::string val = trim(line.substr(eq + 1));
+        const char* v = val.c_str();
+
+        if (key == "name") spec.name = val;
+        else if (key == "n_vocab") spec.n_vocab = atoi(v);
+        else if (key == "n_ctx_train") spec.n_ctx_train = atoi(v);
+        else if (key == "n_embd") spec.n_embd = atoi(v);
+        else if (key == "n_layer") spec.n_layer = atoi(v);
+        else if (key == "n_head") spec.n_head = atoi(v);
+        else if (key == "n_head_kv") spec.n_head_kv = atoi(v);
+        else if (key == "n_params") spec.n_params = strtoull(v, nullptr, 10);
+        else if (key == "size_mb") spec.size_bytes = static_cast<uint64_t>(atof(v) * 1024.0 * 1024.0);
+        else if (key == "seed") spec.seed = strtoull(v, nullptr, 10);
+        else if (key == "time_scale") spec.time_scale = atof(v);
+        else if (key == "load_ms") spec.load_ms = atof(v);
+        else if (key == "cold_ms") spec.cold_ms = atof(v);
+        else if (key == "prefill_base_us") spec.prefill_base_us = atof(v);
+        else if (key == "prefill_us") spec.prefill_us = atof(v);
+        else if (key == "decode_us") spec.decode_us = atof(v);
+        else if (key == "dist") spec.dist = val;
+        else if (key == "jitter") spec.jitter = atof(v);
+        else if (key == "spike_prob") spec.spike_prob = atof(v);
+        else if (key == "spike_x") spec.spike_x = atof(v);
+        else if (key == "margin") spec.margin = static_cast<float>(atof(v));
+        else if (key == "noise_margin") spec.noise_margin = static_cast<float>(atof(v));
+        else if (key == "label_noise") spec.label_noise = atof(v);
+        else if (key == "fail_every") spec.fail_every = atoi(v);
+        else if (key == "script") {
+            if (!loadMockScript(val[0] == '/' ? val : dir + val, spec)) return false;
+        } else {
+            mockLog(GGML_LOG_LEVEL_WARN, "mock: unknown spec key '%s'\n", key.c_str());
+        }
+    }
+
+    spec.n_vocab = std::max(spec.n_vocab, 1024);
+    if (spec.size_bytes == 0) {
+        spec.size_bytes = spec.n_params / 2;  // ~4 bits per weight
+    }
+    return true;
+}
+
+// ===============================================================
+// VOCAB
+// Bytes, a few control tokens, then whole words covering the prompt
+// template and the allergen labels; the rest is unused padding so
+// n_vocab (and the argmax scan over it) matches the real model.
+// ===============================================================
+struct llama_vocab {
+    std::vector<std::string> pieces;
+    std::vector<uint8_t> control;
+    std::unordered_map<std::string, llama_token> lookup;
+    size_t max_piece_len = 1;
+    int32_t n_words = 0;          // tokens the tokenizer can produce
+    llama_token bos = 256;
+    llama_token eos = 257;
+    llama_token eot = 258;
+    llama_token eot_gemma = 259;
+    llama_token nl = '\n';
+};
+
+static const char* const MOCK_WORDS[] = {
+        "milk", "egg", "peanut", "tree", "nut", "wheat", "soy", "fish", "shellfish", "sesame",
+        "none", "You", "are", "a", "food", "allergen", "detector", "Your", "task", "Analyze",
+        "the", "ingredients", "and", "detect", "which", "allergens", "present", "Allergen",
+        "categories", "to", "check", "Instructions", "Only", "output", "that", "actually",
+        "in", "Use", "lowercase", "letters", "Separate", "multiple", "with", "commas", "If",
+        "no", "found", "Ingredients", "Allergens", "Keyword", "hints", "may", "be", "incomplete",
+        "system", "user", "assistant", "model", "sugar", "salt", "water", "oil", "flour",
+        "butter", "cream", "cheese", "whey", "powder", "extract", "natural", "flavour", "flavor",
+        "contains", "may", "traces", "of", "lecithin", "starch", "syrup", "protein", "almond",
+        "almonds", "hazelnut", "hazelnuts", "cashew", "walnut", "pecan", "pistachio", "salmon",
+        "tuna", "cod", "anchovy", "shrimp", "prawn", "crab", "lobster", "tahini", "barley",
+        "oat", "oats", "rye", "gluten", "yeast", "vegetable", "palm", "cocoa", "chocolate",
+};
+
+static void buildMockVocab(llama_vocab& vocab, int32_t n_vocab) {
+    auto add = [&](const std::string& piece, bool control) {
+        llama_token id = static_cast<llama_token>(vocab.pieces.size());
+        vocab.pieces.push_back(piece);
+        vocab.control.push_back(control ? 1 : 0);
+        if (!control && !vocab.lookup.count(piece)) {
+            vocab.lookup[piece] = id;
+            vocab.max_piece_len = std::max(vocab.max_piece_len, piece.size());
+        }
+    };
+
+    for (int b = 0; b < 256; b++) {
+        add(std::string(1, static_cast<char>(b)), false);
+    }
+    add("<s>", true);
+    add("</s>", true);
+    add("<|im_end|>", true);
+    add("<end_of_turn>", true);
+
+    for (const char* word : MOCK_WORDS) {
+        add(word, false);
+        add(std::string(" ") + word, false);
+    }
+    for (const char* piece : {", ", ":\n", ".\n", "<|im_start|>", "<|im_end|>",
+                              "<start_of_turn>", "<end_of_turn>", "\n\n", "- "}) {
+        add(piece, false);
+    }
+    vocab.n_words = static_cast<int32_t>(vocab.pieces.size());
+
+    while (static_cast<int32_t>(vocab.pieces.size()) < n_vocab) {
+        add("<unused" + std::to_string(vocab.pieces.size()) + ">", true);
+    }
+}
+
+// Greedy longest match; every byte has a token so this never fails
+static void mockTokenize(const llama_vocab& vocab, const char* text, size_t len,
+                         std::vector<llama_token>& out) {
+    size_t i = 0;
+    while (i < len) {
+        size_t n = std::min(vocab.max_piece_len, len - i);
+        for (; n > 1; n--) {
+            auto it = vocab.lookup.find(std::string(text + i, n));
+            if (it != vocab.lookup.end()) {
+                out.push_back(it->second);
+                break;
+            }
+        }
+        if (n <= 1) {
+            out.push_back(static_cast<unsigned char>(text[i]));
+            n = 1;
+        }
+        i += n;
+    }
+}
+
+// ===============================================================
+// MODEL / CONTEXT
+// ===============================================================
+struct llama_model {
+    MockSpec spec;
+    llama_vocab vocab;
+    std::string path;
+    double load_ms = 0.0;
+    std::vector<llama_adapter_lora*> loras;     // freed with the model, as in llama.cpp
+};
+
+struct llama_adapter_lora {
+    llama_model* model = nullptr;
+    std::vector<std::pair<std::string, std::string>> meta;     // GGUF-style key / value
+    double prefill_overhead = 0.0;  // extra prompt time per token at scale 1, fraction of the base cost
+    double decode_overhead = 0.0;   // same per generated token
+    double label_noise = -1.0;      // the model's label noise at scale 1; < 0 = unchanged
+};
+
+struct MockCell {
+    llama_pos pos;
+    llama_token token;
+    uint64_t seq_mask;
+};
+
+static bool cellHasSeq(const MockCell& cell, llama_seq_id seq) {
+    return (cell.seq_mask >> seq) & 1u;
+}
+
+struct llama_memory_i {
+    llama_context* ctx;
+};
+
+struct llama_context {
+    const llama_model* model = nullptr;
+    llama_context_params params;
+    llama_memory_i memory;
+
+    std::vector<MockCell> cells;       // unified KV cache, one cell per token
+    std::vector<std::pair<llama_adapter_lora*, float>> loras;     // active adapters and scales
+    std::vector<float> logits;         // n_outputs * n_vocab
+    std::vector<int32_t> output_ids;   // batch index -> logits row, -1 = no output
+    int32_t n_outputs = 0;
+    std::vector<float> embd;           // n_outputs * n_embd
+    std::unordered_map<llama_seq_id, std::vector<float>> embd_seq;
+
+    std::mt19937_64 rng;
+    bool warmup = false;
+    bool cold = true;
+    long n_decode_calls = 0;
+
+    double t_start_ms = 0.0;
+    double t_p_eval_ms = 0.0;
+    double t_eval_ms = 0.0;
+    int32_t n_p_eval = 0;
+    int32_t n_eval = 0;
+};
+
+static double sampleLatencyUs(llama_context* ctx, double mean_us) {
+    const MockSpec& spec = ctx->model->spec;
+    if (mean_us <= 0.0) {
+        return 0.0;
+    }
+
+    double us = mean_us;
+    if (spec.jitter > 0.0) {
+        if (spec.dist == "uniform") {
+            std::uniform_real_distribution<double> d(mean_us * (1.0 - spec.jitter), mean_us * (1.0 + spec.jitter));
+            us = d(ctx->rng);
+        } else if (spec.dist == "normal") {
+            std::normal_distribution<double> d(mean_us, mean_us * spec.jitter);
+            us = d(ctx->rng);
+        } else if (spec.dist == "lognormal") {
+            double sigma2 = std::log(1.0 + spec.jitter * spec.jitter);
+            std::lognormal_distribution<double> d(std::log(mean_us) - sigma2 / 2.0, std::sqrt(sigma2));
+            us = d(ctx->rng);
+        }
+    }
+    return std::max(0.0, us);
+}
+
+// ===============================================================
+// SCRIPTED ANSWERS
+// The answer is a function of the ingredients line of the prompt:
+// the first matching script rule, else a keyword echo. Label noise
+// flips one label on a seeded fraction of items and lowers the logit
+// margin where the flip shows, like a genuinely unsure model.
+// ===============================================================
+static const struct {
+    const char* keyword;
+    int label;
+} MOCK_KEYWORDS[] = {
+        {"milk", 0}, {"butter", 0}, {"cheese", 0}, {"cream", 0}, {"whey", 0}, {"lactose", 0},
+        {"casein", 0}, {"yogurt", 0}, {"egg", 1}, {"albumin", 1}, {"peanut", 2}, {"groundnut", 2},
+        {"almond", 3}, {"hazelnut", 3}, {"cashew", 3}, {"walnut", 3}, {"pecan", 3}, {"pistachio", 3},
+        {"macadamia", 3}, {"wheat", 4}, {"flour", 4}, {"gluten", 4}, {"semolina", 4}, {"spelt", 4},
+        {"soy", 5}, {"soya", 5}, {"edamame", 5}, {"tofu", 5}, {"fish", 6}, {"salmon", 6}, {"tuna", 6},
+        {"cod", 6}, {"anchovy", 6}, {"shrimp", 7}, {"prawn", 7}, {"crab", 7}, {"lobster", 7},
+        {"shellfish", 7}, {"sesame", 8}, {"tahini", 8},
+};
+
+static const char* const MOCK_LABELS[9] = {
+        "milk", "egg", "peanut", "tree nut", "wheat", "soy", "fish", "shellfish", "sesame",
+};
+
+struct MockAnswer {
+    std::string text;
+    float margin = 0.0f;
+    std::vector<size_t> uncertain_at;  // byte offsets whose next token is unsure
+};
+
+static MockAnswer scriptAnswer(const MockSpec& spec, const std::string& ingredients, double label_noise) {
+    MockAnswer answer;
+    answer.margin = spec.margin;
+    const std::string lower = toLower(ingredients);
+
+    for (const MockRule& rule : spec.rules) {
+        if (rule.pattern == "*" || lower.find(rule.pattern) != std::string::npos) {
+            answer.text = rule.response;
+            if (rule.margin >= 0.0f) answer.margin = rule.margin;
+            return answer;
+        }
+    }
+
+    unsigned mask = 0;
+    for (const auto& kw : MOCK_KEYWORDS) {
+        if (lower.find(kw.keyword) != std::string::npos) mask |= 1u << kw.label;
+    }
+
+    int flipped = -1;
+    uint64_t h = hashString(lower, spec.seed);
+    if (label_noise > 0.0 && (h % 100000) < label_noise * 100000.0) {
+        flipped = static_cast<int>((h >> 20) % 9);
+        mask ^= 1u << flipped;
+    }
+
+    // Alphabetical, like the app's own label formatting
+    std::vector<std::string> labels;
+    for (int i = 0; i < 9; i++) {
+        if (mask & (1u << i)) labels.push_back(MOCK_LABELS[i]);
+    }
+    std::sort(labels.begin(), labels.end());
+
+    for (const std::string& label : labels) {
+        if (!answer.text.empty()) answer.text += ", ";
+        if (flipped >= 0 && label == MOCK_LABELS[flipped]) {
+            answer.uncertain_at.push_back(answer.text.size());
+        }
+        answer.text += label;
+    }
+    if (answer.text.empty()) {
+        answer.text = "none";
+    }
+    if (flipped >= 0 && !(mask & (1u << flipped))) {
+        // Dropped label: the doubt shows where the list ends
+        answer.uncertain_at.push_back(answer.text.size());
+    }
+    return answer;
+}
+
+static std::string sequenceText(const llama_context* ctx, llama_seq_id seq, llama_pos max_pos) {
+    std::vector<const MockCell*> cells;
+    for (const MockCell& cell : ctx->cells) {
+        if (cellHasSeq(cell, seq) && cell.pos <= max_pos) cells.push_back(&cell);
+    }
+    std::sort(cells.begin(), cells.end(), [](const MockCell* a, const MockCell* b) { return a->pos < b->pos; });
+
+    std::string text;
+    for (const MockCell* cell : cells) {
+        if (!ctx->model->vocab.control[cell->token]) text += ctx->model->vocab.pieces[cell->token];
+    }
+    return text;
+}
+
+// Next token the scripted model emits after the given sequence text
+static llama_token scriptedNextToken(const llama_context* ctx, const std::string& text, float& margin) {
+    const llama_model* model = ctx->model;
+    margin = model->spec.margin;
+
+    size_t ing = text.rfind("Ingredients:");
+    if (ing == std::string::npos) {
+        return model->vocab.eos;
+    }
+    size_t ing_start = text.find_first_not_of(' ', ing + 12);
+    size_t ing_end = text.find('\n', ing);
+    if (ing_end == std::string::npos) {
+        return model->vocab.eos;
+    }
+    std::string ingredients = text.substr(ing_start, ing_end - ing_start);
+
+    size_t answer_start = ing_end + 1;
+    for (const char* marker : {"assistant\n", "model\n"}) {
+        size_t at = text.find(marker, ing_end);
+        if (at != std::string::npos) {
+            answer_start = at + strlen(marker);
+            break;
+        }
+    }
+    std::string generated = text.substr(std::min(answer_start, text.size()));
+
+    // Active adapters move the label noise toward their own, by scale
+    double label_noise = model->spec.label_noise;
+    for (const auto& lora : ctx->loras) {
+        if (lora.first->label_noise >= 0.0) {
+            label_noise += (lora.first->label_noise - label_noise) * std::min(1.0f, std::fabs(lora.second));
+        }
+    }
+    MockAnswer answer = scriptAnswer(model->spec, ingredients, label_noise);
+    margin = answer.margin;
+    if (generated.size() > answer.text.size() || answer.text.compare(0, generated.size(), generated) != 0) {
+        return model->vocab.eos;
+    }
+
+    for (size_t at : answer.uncertain_at) {
+        if (generated.size() == at || (at >= 2 && generated.size() == at - 2)) {
+            margin = model->spec.noise_margin;
+        }
+    }
+
+    if (generated.size() == answer.text.size()) {
+        return model->vocab.eos;
+    }
+
+    std::vector<llama_token> rest;
+    const std::string remaining = answer.text.substr(generated.size());
+    mockTokenize(model->vocab, remaining.c_str(), remaining.size(), rest);
+    return rest.front();
+}
+
+static void fillLogits(const llama_context* ctx, float* row, llama_token target, float margin, uint64_t salt) {
+    const int32_t n_vocab = ctx->model->spec.n_vocab;
+    uint64_t state = mix64(ctx->model->spec.seed ^ salt);
+    float top = -INFINITY;
+    for (int32_t id = 0; id < n_vocab; id++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        row[id] = static_cast<float>((state >> 40) & 0xffff) / 65536.0f * 4.0f - 2.0f;
+        if (id != target) top = std::max(top, row[id]);
+    }
+    row[target] = top + margin;
+}
+
+static void tokenEmbedding(const llama_model* model, llama_token token, float* out, float weight) {
+    uint64_t state = mix64(model->spec.seed * 31 + static_cast<uint64_t>(token));
+    for (int32_t d = 0; d < model->spec.n_embd; d++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        out[d] += weight * (static_cast<float>((state >> 40) & 0xffff) / 32768.0f - 1.0f);
+    }
+}
+
+// ===============================================================
+// BACKEND / PARAMS
+// ===============================================================
+void llama_backend_init(void) {}
+void llama_backend_free(void) {}
+void llama_numa_init(enum ggml_numa_strategy) {}
+
+void llama_log_set(ggml_log_callback log_callback, void* user_data) {
+    g_log_callback = log_callback;
+    g_log_user_data = user_data;
+}
+
+int64_t llama_time_us(void) { return nowUs(); }
+size_t llama_max_devices(void) { return 1; }
+size_t llama_max_parallel_sequences(void) { return 64; }
+bool llama_supports_mmap(void) { return true; }
+bool llama_supports_mlock(void) { return true; }
+bool llama_supports_gpu_offload(void) { return false; }
+bool llama_supports_rpc(void) { return false; }
+
+const char* llama_print_system_info(void) {
+    return "MOCK = 1 | CPU : deterministic mock backend | ";
+}
+
+struct llama_model_params llama_model_default_params(void) {
+    llama_model_params params;
+    memset(&params, 0, sizeof(params));
+    params.n_gpu_layers = 999;
+    params.split_mode = LLAMA_SPLIT_MODE_LAYER;
+    params.use_mmap = true;
+    params.use_extra_bufts = true;
+    return params;
+}
+
+struct llama_context_params llama_context_default_params(void) {
+    llama_context_params params;
+    memset(&params, 0, sizeof(params));
+    params.n_ctx = 512;
+    params.n_batch = 2048;
+    params.n_ubatch = 512;
+    params.n_seq_max = 1;
+    params.n_threads = GGML_DEFAULT_N_THREADS;
+    params.n_threads_batch = GGML_DEFAULT_N_THREADS;
+    params.rope_scaling_type = LLAMA_ROPE_SCALING_TYPE_UNSPECIFIED;
+    params.pooling_type = LLAMA_POOLING_TYPE_UNSPECIFIED;
+    params.attention_type = LLAMA_ATTENTION_TYPE_UNSPECIFIED;
+    params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    params.yarn_ext_factor = -1.0f;
+    params.yarn_attn_factor = 1.0f;
+    params.yarn_beta_fast = 32.0f;
+    params.yarn_beta_slow = 1.0f;
+    params.type_k = GGML_TYPE_F16;
+    params.type_v = GGML_TYPE_F16;
+    params.offload_kqv = true;
+    params.no_perf = true;
+    params.op_offload = true;
+    params.swa_full = true;
+    return params;
+}
+
+// ===============================================================
+// MODEL
+// ===============================================================
+struct llama_model* llama_model_load_from_file(const char* path_model, struct llama_model_params params) {
+    (void) params;
+    auto* model = new llama_model();
+    model->path = path_model;
+
+    const int64_t t_start = nowUs();
+    const std::string path = path_model;
+    bool is_spec = path.size() >= 5 && path.compare(path.size() - 5, 5, ".mock") == 0;
+
+    if (is_spec) {
+        if (!parseMockSpec(path, model->spec)) {
+            mockLog(GGML_LOG_LEVEL_ERROR, "mock: failed to read spec %s\n", path_model);
+            delete model;
+            return nullptr;
+        }
+    } else {
+        FILE* f = fopen(path_model, "rb");
+        if (f == nullptr) {
+            mockLog(GGML_LOG_LEVEL_ERROR, "mock: failed to open %s\n", path_model);
+            delete model;
+            return nullptr;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fclose(f);
+        model->spec.size_bytes = size > 0 ? static_cast<uint64_t>(size) : model->spec.n_params / 2;
+        size_t slash = path.find_last_of('/');
+        model->spec.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    if (const char* scale = getenv("SLM_MOCK_TIME_SCALE")) model->spec.time_scale = atof(scale);
+    if (const char* seed = getenv("SLM_MOCK_SEED")) model->spec.seed = strtoull(seed, nullptr, 10);
+
+    buildMockVocab(model->vocab, model->spec.n_vocab);
+    busyWaitUs(model->spec.load_ms * 1000.0 * model->spec.time_scale);
+    model->load_ms = (nowUs() - t_start) / 1000.0;
+
+    mockLog(GGML_LOG_LEVEL_INFO, "mock: loaded '%s' (n_vocab=%d, seed=%llu, time_scale=%.3f, %zu rules)\n",
+            model->spec.name.c_str(), model->spec.n_vocab,
+            static_cast<unsigned long long>(model->spec.seed), model->spec.time_scale,
+            model->spec.rules.size());
+    return model;
+}
+
+void llama_model_free(struct llama_model* model) {
+    for (llama_adapter_lora* lora : model->loras) {
+        delete lora;
+    }
+    delete model;
+}
+
+const struct llama_vocab* llama_model_get_vocab(const struct llama_model* model) { return &model->vocab; }
+enum llama_rope_type llama_model_rope_type(const struct llama_model*) { return LLAMA_ROPE_TYPE_NEOX; }
+int32_t llama_model_n_ctx_train(const struct llama_model* model) { return model->spec.n_ctx_train; }
+int32_t llama_model_n_embd(const struct llama_model* model) { return model->spec.n_embd; }
+int32_t llama_model_n_layer(const struct llama_model* model) { return model->spec.n_layer; }
+int32_t llama_model_n_head(const struct llama_model* model) { return model->spec.n_head; }
+int32_t llama_model_n_head_kv(const struct llama_model* model) { return model->spec.n_head_kv; }
+int32_t llama_model_n_swa(const struct llama_model*) { return 0; }
+uint64_t llama_model_size(const struct llama_model* model) { return model->spec.size_bytes; }
+uint64_t llama_model_n_params(const struct llama_model* model) { return model->spec.n_params; }
+bool llama_model_has_encoder(const struct llama_model*) { return false; }
+bool llama_model_has_decoder(const struct llama_model*) { return true; }
+bool llama_model_is_recurrent(const struct llama_model*) { return false; }
+const char* llama_model_chat_template(const struct llama_model*, const char*) { return nullptr; }
+
+int32_t llama_model_desc(const struct llama_model* model, char* buf, size_t buf_size) {
+    return snprintf(buf, buf_size, "mock %s", model->spec.name.c_str());
+}
+
+int32_t llama_model_meta_val_str(const struct llama_model* model, const char* key, char* buf, size_t buf_size) {
+    if (strcmp(key, "general.name") == 0) {
+        return snprintf(buf, buf_size, "%s", model->spec.name.c_str());
+    }
+    if (buf_size > 0) buf[0] = '\0';
+    return -1;
+}
+
+// ===============================================================
+// LORA ADAPTERS
+// ===============================================================
+struct llama_adapter_lora* llama_adapter_lora_init(struct llama_model* model, const char* path_lora) {
+    const std::string path = path_lora;
+    std::ifstream in(path);
+    if (!in) {
+        mockLog(GGML_LOG_LEVEL_ERROR, "mock: failed to open adapter %s\n", path_lora);
+        return nullptr;
+    }
+
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    std::string alpha = "16", rank = "8", base;
+    double load_ms = 0.0;
+    auto* lora = new llama_adapter_lora();
+    lora->model = model;
+    lora->prefill_overhead = 0.05;
+    lora->decode_overhead = 0.05;
+
+    const bool is_spec = path.size() >= 5 && path.compare(path.size() - 5, 5, ".mock") == 0;
+    std::string line;
+    while (is_spec && std::getline(in, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+
+        auto trim = [](std::string s) {
+            size_t b = s.find_first_not_of(" \t\r");
+            size_t e = s.find_last_not_of(" \t\r");
+            return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+        };
+        std::string key = trim(line.substr(0, eq));
+        std::string val = trim(line.substr(eq + 1));
+
+        if (key == "name") name = val;
+        else if (key == "base") base = val;
+        else if (key == "alpha") alpha = val;
+        else if (key == "rank") rank = val;
+        else if (key == "load_ms") load_ms = atof(val.c_str());
+        else if (key == "prefill_overhead") lora->prefill_overhead = atof(val.c_str());
+        else if (key == "decode_overhead") lora->decode_overhead = atof(val.c_str());
+        else if (key == "label_noise") lora->label_noise = atof(val.c_str());
+        else mockLog(GGML_LOG_LEVEL_WARN, "mock: unknown adapter key '%s'\n", key.c_str());
+    }
+
+    // llama.cpp rejects an adapter trained for another architecture
+    if (!base.empty() && base != model->spec.name) {
+        mockLog(GGML_LOG_LEVEL_ERROR, "mock: adapter %s is for '%s', not '%s'\n",
+                path_lora, base.c_str(), model->spec.name.c_str());
+        delete lora;
+        return nullptr;
+    }
+
+    lora->meta = {
+            {"general.type", "adapter"},
+            {"general.name", name},
+            {"adapter.type", "lora"},
+            {"adapter.lora.alpha", alpha},
+            {"mock.rank", rank},
+    };
+    busyWaitUs(load_ms * 1000.0 * model->spec.time_scale);
+    model->loras.push_back(lora);
+    mockLog(GGML_LOG_LEVEL_INFO, "mock: loaded adapter '%s' (alpha=%s)\n", name.c_str(), alpha.c_str());
+    return lora;
+}
+
+static int32_t copyMeta(const std::string& value, char* buf, size_t buf_size) {
+    return snprintf(buf, buf_size, "%s", value.c_str());
+}
+
+int32_t llama_adapter_meta_val_str(const struct llama_adapter_lora* adapter, const char* key, char* buf, size_t buf_size) {
+    for (const auto& kv : adapter->meta) {
+        if (kv.first == key) return copyMeta(kv.second, buf, buf_size);
+    }
+    if (buf_size > 0) buf[0] = '\0';
+    return -1;
+}
+
+int32_t llama_adapter_meta_count(const struct llama_adapter_lora* adapter) {
+    return static_cast<int32_t>(adapter->meta.size());
+}
+
+int32_t llama_adapter_meta_key_by_index(const struct llama_adapter_lora* adapter, int32_t i, char* buf, size_t buf_size) {
+    if (i < 0 || i >= static_cast<int32_t>(adapter->meta.size())) {
+        if (buf_size > 0) buf[0] = '\0';
+        return -1;
+    }
+    return copyMeta(adapter->meta[i].first, buf, buf_size);
+}
+
+int32_t llama_adapter_meta_val_str_by_index(const struct llama_adapter_lora* adapter, int32_t i, char* buf, size_t buf_size) {
+    if (i < 0 || i >= static_cast<int32_t>(adapter->meta.size())) {
+        if (buf_size > 0) buf[0] = '\0';
+        return -1;
+    }
+    return copyMeta(adapter->meta[i].second, buf, buf_size);
+}
+
+void llama_adapter_lora_free(struct llama_adapter_lora* adapter) {
+    auto& loras = adapter->model->loras;
+    loras.erase(std::remove(loras.begin(), loras.end(), adapter), loras.end());
+    delete adapter;
+}
+
+uint64_t llama_adapter_get_alora_n_invocation_tokens(const struct llama_adapter_lora*) { return 0; }
+const llama_token* llama_adapter_get_alora_invocation_tokens(const struct llama_adapter_lora*) { return nullptr; }
+
+int32_t llama_set_adapter_lora(struct llama_context* ctx, struct llama_adapter_lora* adapter, float scale) {
+    for (auto& lora : ctx->loras) {
+        if (lora.first == adapter) {
+            lora.second = scale;
+            return 0;
+        }
+    }
+    ctx->loras.emplace_back(adapter, scale);
+    return 0;
+}
+
+int32_t llama_rm_adapter_lora(struct llama_context* ctx, struct llama_adapter_lora* adapter) {
+    for (auto it = ctx->loras.begin(); it != ctx->loras.end(); ++it) {
+        if (it->first == adapter) {
+            ctx->loras.erase(it);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void llama_clear_adapter_lora(struct llama_context* ctx) {
+    ctx->loras.clear();
+}
+
+// ===============================================================
+// VOCAB API
+// ===============================================================
+enum llama_vocab_type llama_vocab_type(const struct llama_vocab*) { return LLAMA_VOCAB_TYPE_BPE; }
+int32_t llama_vocab_n_tokens(const struct llama_vocab* vocab) { return static_cast<int32_t>(vocab->pieces.size()); }
+
+const char* llama_vocab_get_text(const struct llama_vocab* vocab, llama_token token) {
+    return vocab->pieces.at(token).c_str();
+}
+
+float llama_vocab_get_score(const struct llama_vocab*, llama_token) { return 0.0f; }
+
+enum llama_token_attr llama_vocab_get_attr(const struct llama_vocab* vocab, llama_token token) {
+    if (token >= vocab->n_words) return LLAMA_TOKEN_ATTR_UNUSED;
+    return vocab->control[token] ? LLAMA_TOKEN_ATTR_CONTROL : LLAMA_TOKEN_ATTR_NORMAL;
+}
+
+bool llama_vocab_is_eog(const struct llama_vocab* vocab, llama_token token) {
+    return token == vocab->eos || token == vocab->eot || token == vocab->eot_gemma;
+}
+
+bool llama_vocab_is_control(const struct llama_vocab* vocab, llama_token token) {
+    return token >= 0 && token < static_cast<llama_token>(vocab->control.size()) && vocab->control[token];
+}
+
+llama_token llama_vocab_bos(const struct llama_vocab* vocab) { return vocab->bos; }
+llama_token llama_vocab_eos(const struct llama_vocab* vocab) { return vocab->eos; }
+llama_token llama_vocab_eot(const struct llama_vocab* vocab) { return vocab->eot; }
+llama_token llama_vocab_sep(const struct llama_vocab*) { return LLAMA_TOKEN_NULL; }
+llama_token llama_vocab_nl(const struct llama_vocab* vocab) { return vocab->nl; }
+llama_token llama_vocab_pad(const struct llama_vocab*) { return LLAMA_TOKEN_NULL; }
+bool llama_vocab_get_add_bos(const struct llama_vocab*) { return true; }
+bool llama_vocab_get_add_eos(const struct llama_vocab*) { return false; }
+
+int32_t llama_tokenize(const struct llama_vocab* vocab, const char* text, int32_t text_len,
+                       llama_token* tokens, int32_t n_tokens_max, bool add_special, bool parse_special) {
+    std::vector<llama_token> out;
+    if (add_special) {
+        out.push_back(vocab->bos);
+    }
+
+    if (parse_special) {
+        // Control tokens in the text map to themselves
+        int32_t start = 0;
+        for (int32_t i = 0; i < text_len; i++) {
+            if (text[i] != '<') continue;
+            for (llama_token id : {vocab->eos, vocab->eot, vocab->eot_gemma, vocab->bos}) {
+                const std::string& piece = vocab->pieces[id];
+                if (piece.compare(0, piece.size(), text + i, std::min<size_t>(piece.size(), text_len - i)) == 0 &&
+                    static_cast<size_t>(text_len - i) >= piece.size()) {
+                    mockTokenize(*vocab, text + start, i - start, out);
+                    out.push_back(id);
+                    i += static_cast<int32_t>(piece.size()) - 1;
+                    start = i + 1;
+                    break;
+                }
+            }
+        }
+        mockTokenize(*vocab, text + start, text_len - start, out);
+    } else {
+        mockTokenize(*vocab, text, static_cast<size_t>(text_len), out);
+    }
+
+    const int32_t n = static_cast<int32_t>(out.size());
+    if (n > n_tokens_max) {
+        return -n;
+    }
+    std::copy(out.begin(), out.end(), tokens);
+    return n;
+}
+
+int32_t llama_token_to_piece(const struct llama_vocab* vocab, llama_token token, char* buf,
+                             int32_t length, int32_t lstrip, bool special) {
+    if (token < 0 || token >= static_cast<llama_token>(vocab->pieces.size())) {
+        return 0;
+    }
+    if (vocab->control[token] && !special) {
+        return 0;
+    }
+
+    const std::string& piece = vocab->pieces[token];
+    size_t skip = 0;
+    while (lstrip > 0 && skip < piece.size() && piece[skip] == ' ') {
+        skip++;
+        lstrip--;
+    }
+    const int32_t n = static_cast<int32_t>(piece.size() - skip);
+    if (n > length) {
+        return -n;
+    }
+    memcpy(buf, piece.data() + skip, n);
+    return n;
+}
+
+int32_t llama_detokenize(const struct llama_vocab* vocab, const llama_token* tokens, int32_t n_tokens,
+                         char* text, int32_t text_len_max, bool remove_special, bool unparse_special) {
+    std::string out;
+    for (int32_t i = 0; i < n_tokens; i++) {
+        llama_token t = tokens[i];
+        if (remove_special && (t == vocab->bos || t == vocab->eos)) continue;
+        if (vocab->control[t] && !unparse_special) continue;
+        out += vocab->pieces[t];
+    }
+    const int32_t n = static_cast<int32_t>(out.size());
+    if (n > text_len_max) {
+        return -n;
+    }
+    memcpy(text, out.data(), n);
+    return n;
+}
+
+// ===============================================================
+// CONTEXT
+// ===============================================================
+struct llama_context* llama_init_from_model(struct llama_model* model, struct llama_context_params params) {
+    auto* ctx = new llama_context();
+    ctx->model = model;
+    ctx->params = params;
+    if (ctx->params.n_ctx == 0) ctx->params.n_ctx = static_cast<uint32_t>(model->spec.n_ctx_train);
+    if (ctx->params.n_seq_max == 0) ctx->params.n_seq_max = 1;
+    ctx->memory.ctx = ctx;
+    ctx->rng.seed(model->spec.seed);
+    ctx->t_start_ms = nowUs() / 1000.0;
+    return ctx;
+}
+
+void llama_free(struct llama_context* ctx) {
+    delete ctx;
+}
+
+uint32_t llama_n_ctx(const struct llama_context* ctx) { return ctx->params.n_ctx; }
+uint32_t llama_n_batch(const struct llama_context* ctx) { return ctx->params.n_batch; }
+uint32_t llama_n_ubatch(const struct llama_context* ctx) { return ctx->params.n_ubatch; }
+uint32_t llama_n_seq_max(const struct llama_context* ctx) { return ctx->params.n_seq_max; }
+const struct llama_model* llama_get_model(const struct llama_context* ctx) { return ctx->model; }
+llama_memory_t llama_get_memory(const struct llama_context* ctx) { return const_cast<llama_memory_i*>(&ctx->memory); }
+
+enum llama_pooling_type llama_pooling_type(const struct llama_context* ctx) {
+    return ctx->params.pooling_type == LLAMA_POOLING_TYPE_UNSPECIFIED ? LLAMA_POOLING_TYPE_NONE
+                                                                       : ctx->params.pooling_type;
+}
+
+void llama_set_n_threads(struct llama_context* ctx, int32_t n_threads, int32_t n_threads_batch) {
+    ctx->params.n_threads = n_threads;
+    ctx->params.n_threads_batch = n_threads_batch;
+}
+
+int32_t llama_n_threads(struct llama_context* ctx) { return ctx->params.n_threads; }
+int32_t llama_n_threads_batch(struct llama_context* ctx) { return ctx->params.n_threads_batch; }
+void llama_set_embeddings(struct llama_context* ctx, bool embeddings) { ctx->params.embeddings = embeddings; }
+void llama_set_causal_attn(struct llama_context*, bool) {}
+void llama_set_warmup(struct llama_context* ctx, bool warmup) { ctx->warmup = warmup; }
+void llama_synchronize(struct llama_context*) {}
+
+// ===============================================================
+// MEMORY
+// ===============================================================
+static bool cellInRange(const MockCell& cell, llama_pos p0, llama_pos p1) {
+    return (p0 < 0 || cell.pos >= p0) && (p1 < 0 || cell.pos < p1);
+}
+
+static void dropEmptyCells(llama_context* ctx) {
+    ctx->cells.erase(std::remove_if(ctx->cells.begin(), ctx->cells.end(),
+                                    [](const MockCell& cell) { return cell.seq_mask == 0; }),
+                     ctx->cells.end());
+}
+
+void llama_memory_clear(llama_memory_t mem, bool data) {
+    (void) data;
+    mem->ctx->cells.clear();
+}
+
+bool llama_memory_seq_rm(llama_memory_t mem, llama_seq_id seq_id, llama_pos p0, llama_pos p1) {
+    for (MockCell& cell : mem->ctx->cells) {
+        if (!cellInRange(cell, p0, p1)) continue;
+        if (seq_id < 0) {
+            cell.seq_mask = 0;
+        } else {
+            cell.seq_mask &= ~(1ULL << seq_id);
+        }
+    }
+    dropEmptyCells(mem->ctx);
+    return true;
+}
+
+void llama_memory_seq_cp(llama_memory_t mem, llama_seq_id seq_id_src, llama_seq_id seq_id_dst,
+                         llama_pos p0, llama_pos p1) {
+    if (seq_id_src == seq_id_dst) return;
+    for (MockCell& cell : mem->ctx->cells) {
+        if (cellHasSeq(cell, seq_id_src) && cellInRange(cell, p0, p1)) {
+            cell.seq_mask |= 1ULL << seq_id_dst;
+        }
+    }
+}
+
+void llama_memory_seq_keep(llama_memory_t mem, llama_seq_id seq_id) {
+    for (MockCell& cell : mem->ctx->cells) {
+        cell.seq_mask &= 1ULL << seq_id;
+    }
+    dropEmptyCells(mem->ctx);
+}
+
+void llama_memory_seq_add(llama_memory_t mem, llama_seq_id seq_id, llama_pos p0, llama_pos p1, llama_pos delta) {
+    for (MockCell& cell : mem->ctx->cells) {
+        if (cellHasSeq(cell, seq_id) && cellInRange(cell, p0, p1)) cell.pos += delta;
+    }
+}
+
+void llama_memory_seq_div(llama_memory_t mem, llama_seq_id seq_id, llama_pos p0, llama_pos p1, int d) {
+    for (MockCell& cell : mem->ctx->cells) {
+        if (cellHasSeq(cell, seq_id) && cellInRange(cell, p0, p1)) cell.pos /= d;
+    }
+}
+
+llama_pos llama_memory_seq_pos_min(llama_memory_t mem, llama_seq_id seq_id) {
+    llama_pos result = -1;
+    for (const MockCell& cell : mem->ctx->cells) {
+        if (cellHasSeq(cell, seq_id) && (result < 0 || cell.pos < result)) result = cell.pos;
+    }
+    return result;
+}
+
+llama_pos llama_memory_seq_pos_max(llama_memory_t mem, llama_seq_id seq_id) {
+    llama_pos result = -1;
+    for (const MockCell& cell : mem->ctx->cells) {
+        if (cellHasSeq(cell, seq_id) && cell.pos > result) result = cell.pos;
+    }
+    return result;
+}
+
+bool llama_memory_can_shift(llama_memory_t) { return true; }
+
+// ===============================================================
+// STATE
+// Serialized cells plus zero padding up to the KV footprint the real
+// model would have, so size-based accounting sees realistic numbers.
+// ===============================================================
+static double kvTypeBytes(ggml_type type) {
+    switch (type) {
+        case GGML_TYPE_F32:  return 4.0;
+        case GGML_TYPE_Q8_0: return 34.0 / 32.0;
+        case GGML_TYPE_Q4_0: return 18.0 / 32.0;
+        case GGML_TYPE_Q4_1: return 20.0 / 32.0;
+        case GGML_TYPE_Q5_0: return 22.0 / 32.0;
+        case GGML_TYPE_Q5_1: return 24.0 / 32.0;
+        case GGML_TYPE_IQ4_NL: return 18.0 / 32.0;
+        default:             return 2.0;
+    }
+}
+
+static size_t kvBytesPerCell(const llama_context* ctx) {
+    const MockSpec& spec = ctx->model->spec;
+    const double n_embd_kv = static_cast<double>(spec.n_embd) / std::max(1, spec.n_head) * spec.n_head_kv;
+    return static_cast<size_t>(spec.n_layer * n_embd_kv *
+                               (kvTypeBytes(ctx->params.type_k) + kvTypeBytes(ctx->params.type_v)));
+}
+
+static const char MOCK_STATE_MAGIC[8] = {'M', 'O', 'C', 'K', 'K', 'V', '0', '1'};
+
+static size_t stateSize(const llama_context* ctx, size_t n_cells) {
+    return sizeof(MOCK_STATE_MAGIC) + sizeof(uint32_t) + n_cells * (sizeof(MockCell) + kvBytesPerCell(ctx));
+}
+
+static size_t writeState(const llama_context* ctx, uint8_t* dst, size_t size, llama_seq_id seq) {
+    std::vector<MockCell> cells;
+    for (const MockCell& cell : ctx->cells) {
+        if (seq < 0 || cellHasSeq(cell, seq)) cells.push_back(cell);
+    }
+    const size_t total = stateSize(ctx, cells.size());
+    if (size < total) {
+        return 0;
+    }
+
+    uint32_t n = static_cast<uint32_t>(cells.size());
+    memcpy(dst, MOCK_STATE_MAGIC, sizeof(MOCK_STATE_MAGIC));
+    memcpy(dst + sizeof(MOCK_STATE_MAGIC), &n, sizeof(n));
+    uint8_t* p = dst + sizeof(MOCK_STATE_MAGIC) + sizeof(n);
+    memcpy(p, cells.data(), cells.size() * sizeof(MockCell));
+    p += cells.size() * sizeof(MockCell);
+    memset(p, 0, total - (p - dst));
+    return total;
+}
+
+static size_t readState(llama_context* ctx, const uint8_t* src, size_t size, llama_seq_id dest_seq) {
+    uint32_t n = 0;
+    if (size < sizeof(MOCK_STATE_MAGIC) + sizeof(n) ||
+        memcmp(src, MOCK_STATE_MAGIC, sizeof(MOCK_STATE_MAGIC)) != 0) {
+        return 0;
+    }
+    memcpy(&n, src + sizeof(MOCK_STATE_MAGIC), sizeof(n));
+    const size_t total = stateSize(ctx, n);
+    if (size < total) {
+        return 0;
+    }
+
+    std::vector<MockCell> cells(n);
+    memcpy(cells.data(), src + sizeof(MOCK_STATE_MAGIC) + sizeof(n), n * sizeof(MockCell));
+    if (dest_seq < 0) {
+        ctx->cells = cells;
+    } else {
+        llama_memory_seq_rm(&ctx->memory, dest_seq, -1, -1);
+        for (MockCell& cell : cells) {
+            cell.seq_mask = 1ULL << dest_seq;
+            ctx->cells.push_back(cell);
+        }
+    }
+    return total;
+}
+
+size_t llama_state_get_size(struct llama_context* ctx) { return stateSize(ctx, ctx->cells.size()); }
+size_t llama_state_get_data(struct llama_context* ctx, uint8_t* dst, size_t size) { return writeState(ctx, dst, size, -1); }
+size_t llama_state_set_data(struct llama_context* ctx, const uint8_t* src, size_t size) { return readState(ctx, src, size, -1); }
+
+size_t llama_state_seq_get_size(struct llama_context* ctx, llama_seq_id seq_id) {
+    size_t n = 0;
+    for (const MockCell& cell : ctx->cells) {
+        if (cellHasSeq(cell, seq_id)) n++;
+    }
+    return stateSize(ctx, n);
+}
+
+size_t llama_state_seq_get_data(struct llama_context* ctx, uint8_t* dst, size_t size, llama_seq_id seq_id) {
+    return writeState(ctx, dst, size, seq_id);
+}
+
+size_t llama_state_seq_set_data(struct llama_context* ctx, const uint8_t* src, size_t size, llama_seq_id dest_seq_id) {
+    return readState(ctx, src, size, dest_seq_id);
+}
+
+// ===============================================================
+// BATCH / DECODE
+// ===============================================================
+struct llama_batch llama_batch_get_one(llama_token* tokens, int32_t n_tokens) {
+    llama_batch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.n_tokens = n_tokens;
+    batch.token = tokens;
+    return batch;
+}
+
+struct llama_batch llama_batch_init(int32_t n_tokens_alloc, int32_t embd, int32_t n_seq_max) {
+    llama_batch batch;
+    memset(&batch, 0, sizeof(batch));
+    if (embd) {
+        batch.embd = static_cast<float*>(malloc(sizeof(float) * n_tokens_alloc * embd));
+    } else {
+        batch.token = static_cast<llama_token*>(malloc(sizeof(llama_token) * n_tokens_alloc));
+    }
+    batch.pos = static_cast<llama_pos*>(malloc(sizeof(llama_pos) * n_tokens_alloc));
+    batch.n_seq_id = static_cast<int32_t*>(malloc(sizeof(int32_t) * n_tokens_alloc));
+    batch.seq_id = static_cast<llama_seq_id**>(malloc(sizeof(llama_seq_id*) * (n_tokens_alloc + 1)));
+    for (int32_t i = 0; i < n_tokens_alloc; i++) {
+        batch.seq_id[i] = static_cast<llama_seq_id*>(malloc(sizeof(llama_seq_id) * n_seq_max));
+    }
+    batch.seq_id[n_tokens_alloc] = nullptr;
+    batch.logits = static_cast<int8_t*>(malloc(sizeof(int8_t) * n_tokens_alloc));
+    return batch;
+}
+
+void llama_batch_free(struct llama_batch batch) {
+    if (batch.seq_id) {
+        for (int32_t i = 0; batch.seq_id[i] != nullptr; i++) free(batch.seq_id[i]);
+    }
+    free(batch.token);
+    free(batch.embd);
+    free(batch.pos);
+    free(batch.n_seq_id);
+    free(batch.seq_id);
+    free(batch.logits);
+}
+
+int32_t llama_decode(struct llama_context* ctx, struct llama_batch batch) {
+    const MockSpec& spec = ctx->model->spec;
+    const int32_t n = batch.n_tokens;
+
+    if (n <= 0 || batch.token == nullptr) {
+        mockLog(GGML_LOG_LEVEL_ERROR, "mock: llama_decode: empty or embedding batch\n");
+        return -1;
+    }
+    if (n > static_cast<int32_t>(ctx->params.n_batch)) {
+        mockLog(GGML_LOG_LEVEL_ERROR, "mock: llama_decode: n_tokens %d > n_batch %u\n", n, ctx->params.n_batch);
+        return -1;
+    }
+
+    ctx->n_decode_calls++;
+    if (spec.fail_every > 0 && ctx->n_decode_calls % spec.fail_every == 0) {
+        mockLog(GGML_LOG_LEVEL_WARN, "mock: injected decode failure (call %ld)\n", ctx->n_decode_calls);
+        return -3;
+    }
+
+    if (ctx->cells.size() + n > ctx->params.n_ctx) {
+        return 1;  // no KV slot, same as the real cache
+    }
+
+    // Resolve positions and sequences, validating continuity like llama.cpp
+    std::vector<llama_pos> pos(n);
+    std::vector<uint64_t> masks(n);
+    std::unordered_map<llama_seq_id, llama_pos> next_pos;
+    for (int32_t i = 0; i < n; i++) {
+        uint64_t mask = 0;
+        int32_t n_seq = batch.seq_id ? batch.n_seq_id[i] : 1;
+        for (int32_t s = 0; s < n_seq; s++) {
+            llama_seq_id seq = batch.seq_id ? batch.seq_id[i][s] : 0;
+            if (seq < 0 || seq >= static_cast<llama_seq_id>(ctx->params.n_seq_max) || seq >= 64) {
+                mockLog(GGML_LOG_LEVEL_ERROR, "mock: llama_decode: invalid seq_id %d\n", seq);
+                return -1;
+            }
+            mask |= 1ULL << seq;
+        }
+
+        llama_seq_id first_seq = batch.seq_id ? batch.seq_id[i][0] : 0;
+        auto it = next_pos.find(first_seq);
+        if (it == next_pos.end()) {
+            it = next_pos.emplace(first_seq, llama_memory_seq_pos_max(&ctx->memory, first_seq) + 1).first;
+        }
+        pos[i] = batch.pos ? batch.pos[i] : it->second;
+        if (pos[i] != it->second) {
+            mockLog(GGML_LOG_LEVEL_ERROR, "mock: llama_decode: seq %d expected pos %d, got %d\n",
+                    first_seq, it->second, pos[i]);
+            return -1;
+        }
+        it->second = pos[i] + 1;
+        masks[i] = mask;
+    }
+
+    const int64_t t_start = nowUs();
+    for (int32_t i = 0; i < n; i++) {
+        ctx->cells.push_back({pos[i], batch.token[i], masks[i]});
+    }
+
+    // Outputs: flagged tokens, or just the last one for llama_batch_get_one
+    ctx->output_ids.assign(n, -1);
+    ctx->n_outputs = 0;
+    for (int32_t i = 0; i < n; i++) {
+        if (batch.logits ? batch.logits[i] != 0 : i == n - 1) ctx->output_ids[i] = ctx->n_outputs++;
+    }
+
+    const int32_t n_vocab = spec.n_vocab;
+    ctx->logits.resize(static_cast<size_t>(ctx->n_outputs) * n_vocab);
+    for (int32_t i = 0; i < n; i++) {
+        if (ctx->output_ids[i] < 0) continue;
+        llama_seq_id seq = batch.seq_id ? batch.seq_id[i][0] : 0;
+        float margin = 0.0f;
+        llama_token next = scriptedNextToken(ctx, sequenceText(ctx, seq, pos[i]), margin);
+        fillLogits(ctx, ctx->logits.data() + static_cast<size_t>(ctx->output_ids[i]) * n_vocab, next, margin,
+                   (static_cast<uint64_t>(seq) << 32) ^ static_cast<uint64_t>(pos[i]));
+    }
+
+    if (ctx->params.embeddings) {
+        const int32_t n_embd = spec.n_embd;
+        ctx->embd.assign(static_cast<size_t>(ctx->n_outputs) * n_embd, 0.0f);
+        ctx->embd_seq.clear();
+        for (int32_t i = 0; i < n; i++) {
+            if (ctx->output_ids[i] >= 0) {
+                tokenEmbedding(ctx->model, batch.token[i], ctx->embd.data() + static_cast<size_t>(ctx->output_ids[i]) * n_embd, 1.0f);
+            }
+        }
+        // Mean pooling over every cell of each sequence in the batch
+        for (const auto& entry : next_pos) {
+            std::vector<float>& pooled = ctx->embd_seq[entry.first];
+            pooled.assign(n_embd, 0.0f);
+            for (const MockCell& cell : ctx->cells) {
+                if (cellHasSeq(cell, entry.first)) {
+                    tokenEmbedding(ctx->model, cell.token, pooled.data(), 1.0f);
+                }
+            }
+            double norm = 0.0;
+            for (float v : pooled) norm += static_cast<double>(v) * v;
+            norm = norm > 0.0 ? std::sqrt(norm) : 1.0;
+            for (float& v : pooled) v = static_cast<float>(v / norm);
+        }
+    }
+
+    // Simulated compute time
+    const bool prompt = n > 1;
+    double us = prompt ? sampleLatencyUs(ctx, spec.prefill_base_us) : 0.0;
+    for (int32_t i = 0; i < n; i++) {
+        us += sampleLatencyUs(ctx, prompt ? spec.prefill_us : spec.decode_us);
+    }
+    // Adapter matmuls on top of the base weights
+    for (const auto& lora : ctx->loras) {
+        us *= 1.0 + (prompt ? lora.first->prefill_overhead : lora.first->decode_overhead) * std::fabs(lora.second);
+    }
+    if (spec.spike_prob > 0.0) {
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        if (u(ctx->rng) < spec.spike_prob) us *= spec.spike_x;
+    }
+    if (ctx->cold) {
+        us += spec.cold_ms * 1000.0;
+        ctx->cold = false;
+    }
+    busyWaitUs(us * spec.time_scale);
+
+    const double elapsed_ms = (nowUs() - t_start) / 1000.0;
+    if (!ctx->params.no_perf) {
+        if (prompt) {
+            ctx->t_p_eval_ms += elapsed_ms;
+            ctx->n_p_eval += n;
+        } else {
+            ctx->t_eval_ms += elapsed_ms;
+            ctx->n_eval += n;
+        }
+    }
+    return 0;
+}
+
+int32_t llama_encode(struct llama_context* ctx, struct llama_batch batch) {
+    return llama_decode(ctx, batch);
+}
+
+float* llama_get_logits(struct llama_context* ctx) {
+    return ctx->logits.empty() ? nullptr : ctx->logits.data();
+}
+
+float* llama_get_logits_ith(struct llama_context* ctx, int32_t i) {
+    int32_t row = -1;
+    if (i < 0) {
+        row = ctx->n_outputs + i;
+    } else if (i < static_cast<int32_t>(ctx->output_ids.size())) {
+        row = ctx->output_ids[i];
+    }
+    if (row < 0 || row >= ctx->n_outputs) {
+        return nullptr;
+    }
+    return ctx->logits.data() + static_cast<size_t>(row) * ctx->model->spec.n_vocab;
+}
+
+float* llama_get_embeddings(struct llama_context* ctx) {
+    return ctx->embd.empty() ? nullptr : ctx->embd.data();
+}
+
+float* llama_get_embeddings_ith(struct llama_context* ctx, int32_t i) {
+    int32_t row = -1;
+    if (i < 0) {
+        row = ctx->n_outputs + i;
+    } else if (i < static_cast<int32_t>(ctx->output_ids.size())) {
+        row = ctx->output_ids[i];
+    }
+    if (ctx->embd.empty() || row < 0 || row >= ctx->n_outputs) {
+        return nullptr;
+    }
+    return ctx->embd.data() + static_cast<size_t>(row) * ctx->model->spec.n_embd;
+}
+
+float* llama_get_embeddings_seq(struct llama_context* ctx, llama_seq_id seq_id) {
+    if (llama_pooling_type(ctx) == LLAMA_POOLING_TYPE_NONE) {
+        return nullptr;
+    }
+    auto it = ctx->embd_seq.find(seq_id);
+    return it == ctx->embd_seq.end() ? nullptr : it->second.data();
+}
+
+// ===============================================================
+// PERF
+// ===============================================================
+struct llama_perf_context_data llama_perf_context(const struct llama_context* ctx) {
+    llama_perf_context_data data;
+    memset(&data, 0, sizeof(data));
+    if (ctx->params.no_perf) {
+        return data;
+    }
+    data.t_start_ms = ctx->t_start_ms;
+    data.t_load_ms = ctx->model->load_ms;
+    data.t_p_eval_ms = ctx->t_p_eval_ms;
+    data.t_eval_ms = ctx->t_eval_ms;
+    data.n_p_eval = std::max(1, ctx->n_p_eval);
+    data.n_eval = std::max(1, ctx->n_eval);
+    return data;
+}
+
+void llama_perf_context_print(const struct llama_context* ctx) {
+    const llama_perf_context_data data = llama_perf_context(ctx);
+    mockLog(GGML_LOG_LEVEL_INFO, "mock perf: load %.2f ms | prompt %.2f ms / %d tokens | eval %.2f ms / %d runs\n",
+            data.t_load_ms, data.t_p_eval_ms, data.n_p_eval, data.t_eval_ms, data.n_eval);
+}
+
+void llama_perf_context_reset(struct llama_context* ctx) {
+    ctx->t_start_ms = nowUs() / 1000.0;
+    ctx->t_p_eval_ms = 0.0;
+    ctx->t_eval_ms = 0.0;
+    ctx->n_p_eval = 0;
+    ctx->n_eval = 0;
+}
@@ -0,0 +1,203 @@
+#include "model-cascade.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+#include "slm-log.h"
+
+static long percentileMs(std::vector<long> values, double p) {
+    if (values.empty()) {
+        return -1;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(rank, values.size() - 1)];
+}
+
+static double microF1(long tp, long fp, long fn) {
+    long denom = 2 * tp + fp + fn;
+    return denom > 0 ? (2.0 * tp) / denom : 0.0;
+}
+
+static void scoreMask(AllergenMask predicted, AllergenMask truth, long& tp, long& fp, long& fn) {
+    tp += __builtin_popcount(predicted & truth);
+    fp += __builtin_popcount(predicted & ~truth & ALLERGEN_MASK_ALL);
+    fn += __builtin_popcount(~predicted & truth & ALLERGEN_MASK_ALL);
+}
+
+std::string CascadeItem::formatted() const {
+    const PredictionOutput& answer = escalated ? large : small;
+    if (!answer.ok) {
+        return answer.formatted();
+    }
+
+    char margins[64];
+    snprintf(margins, sizeof(margins), ";MIN_MARGIN=%.3f;MEAN_MARGIN=%.3f",
+             small.min_margin, small.mean_margin);
+
+    std::stringstream ss;
+    ss << "TTFT_MS=" << answer.ttft_ms
+       << ";ITPS=" << answer.itps
+       << ";OTPS=" << answer.otps
+       << ";OET_MS=" << answer.oet_ms
+       << ";" << answer.phaseMetricsString()
+       << ";TIER=" << (escalated ? "LARGE" : "SMALL")
+       << ";CASCADE_MS=" << total_ms
+       << margins
+       << "|" << answer.text;
+    return ss.str();
+}
+
+std::string CascadeStats::toString() const {
+    // The large model only stands for the large-model-alone baseline
+    // when it ran on every item (shadow_large); otherwise its metrics
+    // cover the escalated subset and are named for it
+    const bool every_item = items > 0 && large_compared == items;
+    const char* large = every_item ? "LARGE" : "ESCALATED_LARGE";
+
+    char buf[768];
+    snprintf(buf, sizeof(buf),
+             "ITEMS=%ld;ESCALATED=%ld;ESCALATION_RATE=%.4f"
+             ";P50_MS=%ld;P90_MS=%ld;P99_MS=%ld;LARGE_P50_MS=%ld;LARGE_P90_MS=%ld"
+             ";LABELED=%ld;CASCADE_EMR=%.4f;CASCADE_MICRO_F1=%.4f"
+             ";%s_ITEMS=%ld;%s_EMR=%.4f;%s_MICRO_F1=%.4f;AGREEMENT=%.4f",
+             items, escalated, items > 0 ? static_cast<double>(escalated) / items : 0.0,
+             percentileMs(latencies_ms, 0.50), percentileMs(latencies_ms, 0.90),
+             percentileMs(latencies_ms, 0.99),
+             percentileMs(large_latencies_ms, 0.50), percentileMs(large_latencies_ms, 0.90),
+             labeled, labeled > 0 ? static_cast<double>(cascade_exact) / labeled : 0.0,
+             microF1(cascade_tp, cascade_fp, cascade_fn),
+             large, large_labeled,
+             large, large_labeled > 0 ? static_cast<double>(large_exact) / large_labeled : 0.0,
+             large, microF1(large_tp, large_fp, large_fn),
+             large_compared > 0 ? static_cast<double>(agreements) / large_compared : 0.0);
+    return buf;
+}
+
+// ===============================================================
+// LOAD / UNLOAD
+// ===============================================================
+bool ModelCascade::load(const std::string& small_path, const std::string& large_path,
+                        const EngineConfig& config) {
+    unload();
+
+    LOGI("=== Loading Cascade ===");
+    LOGI("Small: %s", small_path.c_str());
+    LOGI("Large: %s", large_path.c_str());
+
+    if (!loadEngineSession(m_small, small_path, config)) {
+        LOGE("Cascade: small model failed to load");
+        return false;
+    }
+
+    if (!loadEngineSession(m_large, large_path, config)) {
+        LOGE("Cascade: large model failed to load");
+        freeEngineSession(m_small);
+        return false;
+    }
+
+    LOGI("✓ Cascade ready");
+    return true;
+}
+
+void ModelCascade::unload() {
+    freeEngineSession(m_small);
+    freeEngineSession(m_large);
+}
+
+// ===============================================================
+// PREDICT
+// ===============================================================
+bool ModelCascade::needsEscalation(const PredictionOutput& small) const {
+    if (!small.ok) {
+        return true;
+    }
+
+    if (small.decision_tokens > 0 && small.min_margin < m_config.min_margin) {
+        return true;
+    }
+
+    if (m_config.min_mean_margin > 0.0f && small.mean_margin < m_config.min_mean_margin) {
+        return true;
+    }
+
+    if (m_config.escalate_on_unparsed && small.unparsed) {
+        return true;
+    }
+
+    return false;
+}
+
+CascadeItem ModelCascade::predict(const std::string& ingredients, int ground_truth) {
+    CascadeItem item;
+
+    PredictionOptions options;
+    options.clear_memory = true;
+
+    auto t_start = std::chrono::steady_clock::now();
+
+    item.small = runAllergenPrediction(m_small, ingredients, options);
+    item.escalated = needsEscalation(item.small);
+
+    LOGI("Cascade small: min_margin=%.3f mean_margin=%.3f -> %s",
+         item.small.min_margin, item.small.mean_margin,
+         item.escalated ? "ESCALATE" : "ACCEPT");
+
+    if (item.escalated) {
+        auto t_large = std::chrono::steady_clock::now();
+        item.large = runAllergenPrediction(m_large, ingredients, options);
+        item.large_ran = true;
+        m_stats.large_latencies_ms.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - t_large).count());
+    }
+
+    item.total_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - t_start).count();
+
+    if (!item.escalated && m_config.shadow_large) {
+        auto t_large = std::chrono::steady_clock::now();
+        item.large = runAllergenPrediction(m_large, ingredients, options);
+        item.large_ran = true;
+        m_stats.large_latencies_ms.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - t_large).count());
+    }
+
+    const PredictionOutput& answer = item.escalated ? item.large : item.small;
+    item.mask = answer.ok ? answer.mask : 0;
+    item.large_mask = (item.large_ran && item.large.ok) ? item.large.mask : 0;
+
+    m_stats.items++;
+    if (item.escalated) {
+        m_stats.escalated++;
+    }
+    m_stats.latencies_ms.push_back(item.total_ms);
+
+    if (item.large_ran) {
+        m_stats.large_compared++;
+        if (item.mask == item.large_mask) {
+            m_stats.agreements++;
+        }
+    }
+
+    if (ground_truth >= 0) {
+        AllergenMask truth = static_cast<AllergenMask>(ground_truth) & ALLERGEN_MASK_ALL;
+
+        m_stats.labeled++;
+        if (item.mask == truth) {
+            m_stats.cascade_exact++;
+        }
+        scoreMask(item.mask, truth, m_stats.cascade_tp, m_stats.cascade_fp, m_stats.cascade_fn);
+
+        if (item.large_ran) {
+            m_stats.large_labeled++;
+            if (item.large_mask == truth) {
+                m_stats.large_exact++;
+            }
+            scoreMask(item.large_mask, truth, m_stats.large_tp, m_stats.large_fp, m_stats.large_fn);
+        }
+    }
+
+    return item;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "allergen-labels.h"
+#include "slm-engine.h"
+
+// ===============================================================
+// CONFIDENCE-GATED MODEL CASCADE
+// The small model answers first; the item is re-run on the large
+// model (kept resident alongside) only when the logit margin at the
+// label-decision tokens says the small model was unsure.
+// ===============================================================
+
+struct CascadeConfig {
+    float min_margin = 3.0f;          // escalate if any decision margin is below
+    float min_mean_margin = 0.0f;     // escalate if the mean margin is below (0 = off)
+    bool escalate_on_unparsed = true; // no known label and no "none" -> escalate
+    bool shadow_large = false;        // also run the large model on accepted items
+};
+
+struct CascadeItem {
+    PredictionOutput small;
+    PredictionOutput large;
+    bool escalated = false;
+    bool large_ran = false;
+    long total_ms = 0;                // end-to-end, shadow run excluded
+    AllergenMask mask = 0;            // cascade answer
+    AllergenMask large_mask = 0;
+
+    // predictAllergens format plus TIER, MIN_MARGIN and MEAN_MARGIN
+    std::string formatted() const;
+};
+
+struct CascadeStats {
+    long items = 0;
+    long escalated = 0;
+    std::vector<long> latencies_ms;
+    std::vector<long> large_latencies_ms;
+
+    // Against the ground truth mask, when the caller provides one
+    long labeled = 0;
+    long cascade_exact = 0;
+    long cascade_tp = 0, cascade_fp = 0, cascade_fn = 0;
+    long large_labeled = 0;
+    long large_exact = 0;
+    long large_tp = 0, large_fp = 0, large_fn = 0;
+    long large_compared = 0;
+    long agreements = 0;
+
+    // LARGE_EMR / LARGE_MICRO_F1 when the large model ran on every item
+    // (shadow_large), else ESCALATED_LARGE_EMR / ESCALATED_LARGE_MICRO_F1
+    // over the escalated items only
+    std::string toString() const;
+};
+
+class ModelCascade {
+public:
+    bool load(const std::string& small_path, const std::string& large_path, const EngineConfig& config);
+    void unload();
+    bool loaded() const { return m_small.loaded() && m_large.loaded(); }
+
+    void setConfig(const CascadeConfig& config) { m_config = config; }
+    const CascadeConfig& config() const { return m_config; }
+
+    // ground_truth < 0 when the item is unlabeled
+    CascadeItem predict(const std::string& ingredients, int ground_truth);
+
+    const CascadeStats& stats() const { return m_stats; }
+    void resetStats() { m_stats = CascadeStats(); }
+
+private:
+    bool needsEscalation(const PredictionOutput& small) const;
+
+    EngineSession m_small;
+    EngineSession m_large;
+    CascadeConfig m_config;
+    CascadeStats m_stats;
+};
@@ -0,0 +1,214 @@
+#include "model-preloader.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "memory-report.h"
+#include "model-warmup.h"
+#include "slm-log.h"
+#include "slm-trace.h"
+
+// ===============================================================
+// PRELOAD
+// ===============================================================
+bool ModelPreloader::start(const std::string& model_path, const PreloadConfig& config, std::string& error) {
+    if (pending()) {
+        error = "A preload is already pending";
+        return false;
+    }
+
+    struct stat st{};
+    if (stat(model_path.c_str(), &st) != 0) {
+        error = "Cannot stat " + model_path;
+        return false;
+    }
+
+    PreloadReport report;
+    report.model_path = model_path;
+    report.estimate_mb = st.st_size / (1024.0 * 1024.0);
+    report.available_mb = readMemAvailableMb();
+
+    if (report.available_mb >= 0.0 && report.estimate_mb + config.headroom_mb > report.available_mb) {
+        char buf[160];
+        snprintf(buf, sizeof(buf), "Preload needs %.0f MB + %.0f MB headroom, %.0f MB available",
+                 report.estimate_mb, config.headroom_mb, report.available_mb);
+        error = buf;
+        return false;
+    }
+    if (config.budget_mb > 0.0) {
+        double rss_mb = readMemorySnapshot("").rss_kb / 1024.0;
+        if (rss_mb + report.estimate_mb > config.budget_mb) {
+            char buf[160];
+            snprintf(buf, sizeof(buf), "Preload would take RSS to %.0f MB, budget %.0f MB",
+                     rss_mb + report.estimate_mb, config.budget_mb);
+            error = buf;
+            return false;
+        }
+    }
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_config = config;
+        m_report = report;
+        m_begin_us = traceNowUs();
+        m_end_us = 0;
+    }
+    m_state = State::LOADING;
+    m_thread = std::thread(&ModelPreloader::run, this);
+    return true;
+}
+
+void ModelPreloader::run() {
+    traceSetThreadName("model_preload");
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), m_config.nice);
+    SLM_TRACE_SCOPE("preload");
+
+    const int64_t t0 = traceNowUs();
+    EngineSession session;
+    bool ok = loadEngineSession(session, m_report.model_path, m_config.engine);
+    const int64_t t_loaded = traceNowUs();
+
+    std::string error;
+    if (!ok) {
+        error = "Failed to load " + m_report.model_path;
+    } else {
+        // Context buffers are only known now; back out if they ate the headroom
+        double available_mb = readMemAvailableMb();
+        if (available_mb >= 0.0 && available_mb < m_config.headroom_mb) {
+            char buf[128];
+            snprintf(buf, sizeof(buf), "Only %.0f MB available after preload, headroom %.0f MB",
+                     available_mb, m_config.headroom_mb);
+            error = buf;
+            freeEngineSession(session);
+            ok = false;
+        }
+    }
+
+    double prefetch_ms = 0.0;
+    if (ok && m_config.prefetch) {
+        // Inline: this thread already runs at low priority
+        WeightPrefetcher prefetcher;
+        prefetcher.start(findFileMappings(m_report.model_path));
+        prefetcher.join();
+        prefetch_ms = prefetcher.elapsedMs();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_session = session;
+        m_report.ok = ok;
+        m_report.error = error;
+        m_report.load_ms = (t_loaded - t0) / 1000.0;
+        m_report.prefetch_ms = prefetch_ms;
+        m_end_us = traceNowUs();
+        m_report.busy_ms = (m_end_us - m_begin_us) / 1000.0;
+    }
+    m_state = ok ? State::READY : State::FAILED;
+
+    if (ok) {
+        LOGI("Preloaded %s in %.0f ms (+%.0f ms prefetch)",
+             m_report.model_path.c_str(), m_report.load_ms, prefetch_ms);
+    } else {
+        LOGW("Preload failed: %s", error.c_str());
+    }
+}
+
+void ModelPreloader::noteForegroundItem(int64_t t_begin_us, int64_t t_end_us) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int64_t overlap = 0;
+    if (m_begin_us != 0) {
+        int64_t preload_end = m_end_us != 0 ? m_end_us : t_end_us;
+        overlap = std::min(t_end_us, preload_end) - std::max(t_begin_us, m_begin_us);
+    }
+    double item_ms = (t_end_us - t_begin_us) / 1000.0;
+
+    if (overlap > 0) {
+        m_overlap_ms += overlap / 1000.0;
+        m_fg_during++;
+        m_fg_during_ms += item_ms;
+    } else {
+        m_fg_outside++;
+        m_fg_outside_ms += item_ms;
+    }
+}
+
+bool ModelPreloader::swapInto(EngineSession& active, PreloadReport& report) {
+    if (!pending()) {
+        report = PreloadReport();
+        report.error = "No preload pending";
+        return false;
+    }
+
+    const int64_t t_wait = traceNowUs();
+    m_thread.join();
+    const int64_t t_swap = traceNowUs();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_report.wait_ms = (t_swap - t_wait) / 1000.0;
+    m_report.overlap_ms = m_overlap_ms;
+    m_report.fg_items_during = m_fg_during;
+    m_report.fg_items_outside = m_fg_outside;
+    m_report.fg_mean_ms_during = m_fg_during > 0 ? m_fg_during_ms / m_fg_during : 0.0;
+    m_report.fg_mean_ms_outside = m_fg_outside > 0 ? m_fg_outside_ms / m_fg_outside : 0.0;
+
+    bool ok = m_state.load() == State::READY;
+    if (ok) {
+        EngineSession previous = active;
+        active = m_session;
+        m_session = EngineSession();
+        m_report.swap_ms = (traceNowUs() - t_swap) / 1000.0;
+
+        const int64_t t_free = traceNowUs();
+        freeEngineSession(previous);
+        m_report.free_ms = (traceNowUs() - t_free) / 1000.0;
+    }
+
+    report = m_report;
+    m_begin_us = 0;
+    m_overlap_ms = m_fg_during_ms = m_fg_outside_ms = 0.0;
+    m_fg_during = m_fg_outside = 0;
+    m_state = State::IDLE;
+    return ok;
+}
+
+void ModelPreloader::cancel() {
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_session.model != nullptr) {
+        freeEngineSession(m_session);
+        m_session = EngineSession();
+    }
+    m_begin_us = 0;
+    m_state = State::IDLE;
+}
+
+double PreloadReport::contentionPct() const {
+    if (fg_items_during == 0 || fg_items_outside == 0 || fg_mean_ms_outside <= 0.0) {
+        return 0.0;
+    }
+    return (fg_mean_ms_during / fg_mean_ms_outside - 1.0) * 100.0;
+}
+
+std::string PreloadReport::toString() const {
+    if (!ok) {
+        return "ERROR|" + error;
+    }
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "PRELOAD_OK=1;PRELOAD_LOAD_MS=%.1f;PRELOAD_PREFETCH_MS=%.1f;PRELOAD_WAIT_MS=%.1f"
+             ";SWAP_MS=%.3f;FREE_MS=%.1f;OVERLAP_MS=%.1f;OVERLAP_PCT=%.1f"
+             ";FG_DURING=%d;FG_DURING_MS=%.1f;FG_OUTSIDE=%d;FG_OUTSIDE_MS=%.1f;CONTENTION_PCT=%.1f",
+             load_ms, prefetch_ms, wait_ms, swap_ms, free_ms, overlap_ms, overlapFraction() * 100.0,
+             fg_items_during, fg_mean_ms_during, fg_items_outside, fg_mean_ms_outside, contentionPct());
+    return buf;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "slm-engine.h"
+
+// ===============================================================
+// MODEL PRELOADER
+// Second session slot filled on a low-priority thread while the
+// active session keeps predicting: model load, weight prefetch and
+// context creation all happen off the critical path, so switching
+// is a pointer swap. Refuses to start (or drops the result) when
+// the load would leave less than headroom_mb available.
+// Foreground predictions report their windows so the overlap and
+// the slowdown they suffered while the preload ran can be measured.
+// ===============================================================
+
+struct PreloadConfig {
+    EngineConfig engine;
+    bool prefetch = true;           // page the weights in after load
+    double headroom_mb = 512.0;     // MemAvailable that must remain
+    double budget_mb = 0.0;         // cap on process RSS after the load, 0 = none
+    int nice = 10;
+};
+
+struct PreloadReport {
+    bool ok = false;
+    std::string error;
+    std::string model_path;
+
+    double estimate_mb = 0.0;       // GGUF size checked against the budget
+    double available_mb = 0.0;      // MemAvailable when the preload started
+    double load_ms = 0.0;           // model + context, on the preload thread
+    double prefetch_ms = 0.0;
+    double busy_ms = 0.0;           // preload thread start to finish
+    double wait_ms = 0.0;           // swap blocked on an unfinished preload
+    double swap_ms = 0.0;           // install the preloaded session
+    double free_ms = 0.0;           // free the previous one
+
+    // Contention with foreground predictions
+    double overlap_ms = 0.0;        // foreground prediction time inside the preload window
+    int fg_items_during = 0;
+    int fg_items_outside = 0;
+    double fg_mean_ms_during = 0.0;
+    double fg_mean_ms_outside = 0.0;
+
+    double overlapFraction() const { return busy_ms > 0.0 ? overlap_ms / busy_ms : 0.0; }
+    // Foreground slowdown while preloading, 0 without both populations
+    double contentionPct() const;
+
+    // "PRELOAD_OK=..;PRELOAD_LOAD_MS=..;PRELOAD_WAIT_MS=..;SWAP_MS=..;
+    //  OVERLAP_MS=..;OVERLAP_PCT=..;FG_DURING_MS=..;FG_OUTSIDE_MS=..;CONTENTION_PCT=.."
+    // or "ERROR|reason"
+    std::string toString() const;
+};
+
+class ModelPreloader {
+public:
+    ~ModelPreloader() { cancel(); }
+
+    // Checks the budget and starts the preload thread; false when one
+    // is already pending or the budget check fails
+    bool start(const std::string& model_path, const PreloadConfig& config, std::string& error);
+
+    bool pending() const { return m_state.load() != State::IDLE; }
+    bool ready() const { return m_state.load() == State::READY; }
+
+    // Foreground prediction window (traceNowUs stamps)
+    void noteForegroundItem(int64_t t_begin_us, int64_t t_end_us);
+
+    // Waits for the preload, then installs it as active and frees the
+    // previous session; active is untouched when the preload failed
+    bool swapInto(EngineSession& active, PreloadReport& report);
+
+    // Waits for the thread and frees whatever it loaded
+    void cancel();
+
+private:
+    enum class State { IDLE, LOADING, READY, FAILED };
+
+    void run();
+
+    PreloadConfig m_config;
+    EngineSession m_session;
+    std::thread m_thread;
+    std::atomic<State> m_state{State::IDLE};
+
+    std::mutex m_mutex;             // guards m_report, the window and the counters
+    PreloadReport m_report;
+    int64_t m_begin_us = 0;         // 0 when nothing is pending
+    int64_t m_end_us = 0;           // 0 while loading
+
+    // Since the last swap; items outside the window are the baseline
+    double m_overlap_ms = 0.0;
+    int m_fg_during = 0;
+    int m_fg_outside = 0;
+    double m_fg_during_ms = 0.0;
+    double m_fg_outside_ms = 0.0;
+};
@@ -0,0 +1,209 @@
+#include "model-residency.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "memory-report.h"
+#include "slm-log.h"
+#include "slm-trace.h"
+
+static double fileSizeMb(const std::string& path) {
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0 ? st.st_size / (1024.0 * 1024.0) : 0.0;
+}
+
+// Weights plus whichever is larger of the KV estimate and what the
+// context actually took from the heap
+static double sessionFootprintMb(const EngineSession& session) {
+    double weights_mb = llama_model_size(session.model) / (1024.0 * 1024.0);
+    double kv_mb = estimateKvCacheMb(session.model, llama_n_ctx(session.ctx),
+                                     session.config.type_k, session.config.type_v);
+    double ctx_mb = (session.mem_after_ctx.anon_kb - session.mem_before_ctx.anon_kb) / 1024.0;
+    return weights_mb + std::max(kv_mb, ctx_mb);
+}
+
+// ===============================================================
+// CONFIGURATION
+// ===============================================================
+void ModelResidency::setBudgetMb(double budget_mb) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget_mb = budget_mb;
+    while (!m_lru.empty() && residentMbLocked() > m_budget_mb) {
+        evictBack();
+    }
+}
+
+void ModelResidency::setEngineConfig(const EngineConfig& config) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+}
+
+void ModelResidency::registerModel(const std::string& id, const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_paths[id] = path;
+}
+
+// ===============================================================
+// LRU
+// ===============================================================
+double ModelResidency::residentMbLocked() const {
+    double total = 0.0;
+    for (const Resident& r : m_lru) {
+        total += r.size_mb;
+    }
+    return total;
+}
+
+void ModelResidency::evictBack() {
+    Resident& victim = m_lru.back();
+    LOGI("Residency: evicting %s (%.0f MB)", victim.id.c_str(), victim.size_mb);
+    freeEngineSession(victim.session);
+    m_lru.pop_back();
+    m_stats.evictions++;
+}
+
+EngineSession* ModelResidency::acquire(const std::string& id, std::string& error) {
+    m_stats.requests++;
+
+    for (auto it = m_lru.begin(); it != m_lru.end(); ++it) {
+        if (it->id == id) {
+            m_lru.splice(m_lru.begin(), m_lru, it);
+            m_stats.hits++;
+            return &m_lru.front().session;
+        }
+    }
+
+    auto path = m_paths.find(id);
+    if (path == m_paths.end()) {
+        m_stats.failures++;
+        error = "Unknown model id " + id;
+        return nullptr;
+    }
+
+    // Until it has been loaded once, the GGUF size stands in for the footprint
+    auto known = m_known_mb.find(id);
+    double estimate_mb = known != m_known_mb.end() ? known->second : fileSizeMb(path->second);
+    if (estimate_mb > m_budget_mb) {
+        m_stats.failures++;
+        char buf[160];
+        snprintf(buf, sizeof(buf), "%s needs ~%.0f MB, budget is %.0f MB",
+                 id.c_str(), estimate_mb, m_budget_mb);
+        error = buf;
+        return nullptr;
+    }
+    while (!m_lru.empty() && residentMbLocked() + estimate_mb > m_budget_mb) {
+        evictBack();
+    }
+
+    SLM_TRACE_SCOPE("residency_load");
+    const int64_t t0 = traceNowUs();
+    Resident resident;
+    resident.id = id;
+    if (!loadEngineSession(resident.session, path->second, m_config)) {
+        m_stats.failures++;
+        error = "Failed to load " + path->second;
+        return nullptr;
+    }
+    m_stats.load_ms += (traceNowUs() - t0) / 1000.0;
+    m_stats.loads++;
+
+    resident.size_mb = sessionFootprintMb(resident.session);
+    m_known_mb[id] = resident.size_mb;
+    m_lru.push_front(resident);
+
+    // The real footprint may exceed the estimate; never evict the new one
+    while (m_lru.size() > 1 && residentMbLocked() > m_budget_mb) {
+        evictBack();
+    }
+    m_stats.peak_resident_mb = std::max(m_stats.peak_resident_mb, residentMbLocked());
+
+    LOGI("Residency: loaded %s (%.0f MB), %zu resident, %.0f/%.0f MB",
+         id.c_str(), resident.size_mb, m_lru.size(), residentMbLocked(), m_budget_mb);
+    return &m_lru.front().session;
+}
+
+PredictionOutput ModelResidency::predict(const std::string& id, const std::string& ingredients,
+                                         const PredictionOptions& options) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string error;
+    EngineSession* session = acquire(id, error);
+    if (session == nullptr) {
+        PredictionOutput out;
+        out.error = error;
+        return out;
+    }
+    return runAllergenPrediction(*session, ingredients, options);
+}
+
+bool ModelResidency::evict(const std::string& id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_lru.begin(); it != m_lru.end(); ++it) {
+        if (it->id == id) {
+            m_lru.splice(m_lru.end(), m_lru, it);
+            evictBack();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ModelResidency::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Resident& r : m_lru) {
+        freeEngineSession(r.session);
+    }
+    m_lru.clear();
+}
+
+// ===============================================================
+// REPORTING
+// ===============================================================
+std::vector<std::string> ModelResidency::residentIds() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> ids;
+    for (const Resident& r : m_lru) {
+        ids.push_back(r.id);
+    }
+    return ids;
+}
+
+double ModelResidency::residentMb() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return residentMbLocked();
+}
+
+ResidencyStats ModelResidency::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void ModelResidency::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = ResidencyStats();
+}
+
+std::string ResidencyStats::toString() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "RES_REQUESTS=%ld;RES_HITS=%ld;RES_HIT_RATE=%.3f;RES_LOADS=%ld;RES_EVICTIONS=%ld"
+             ";RES_FAILURES=%ld;RES_LOAD_MS=%.0f;RES_PEAK_MB=%.0f",
+             requests, hits, requests > 0 ? static_cast<double>(hits) / requests : 0.0,
+             loads, evictions, failures, load_ms, peak_resident_mb);
+    return buf;
+}
+
+std::string ModelResidency::toString() const {
+    std::vector<std::string> ids = residentIds();
+    std::stringstream ss;
+    ss << "RES_MODELS=";
+    for (size_t i = 0; i < ids.size(); i++) {
+        ss << (i ? "," : "") << ids[i];
+    }
+    char buf[96];
+    snprintf(buf, sizeof(buf), ";RES_RESIDENT_MB=%.0f;RES_BUDGET_MB=%.0f;", residentMb(), m_budget_mb);
+    ss << buf << stats().toString();
+    return ss.str();
+}
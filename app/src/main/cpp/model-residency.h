@@ -0,0 +1,80 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "slm-engine.h"
+
+// ===============================================================
+// MODEL RESIDENCY
+// Several sessions kept loaded under a memory budget, addressed by
+// model id. A model's footprint is llama_model_size plus its context
+// (KV cache estimate or the anonymous growth of creating it, which
+// ever is larger). Requests for a resident model are hits; a miss
+// loads the model after evicting least-recently-used ones until the
+// estimate fits.
+// ===============================================================
+
+struct ResidencyStats {
+    long requests = 0;
+    long hits = 0;
+    long loads = 0;
+    long evictions = 0;
+    long failures = 0;          // unknown id, over budget or load failed
+    double load_ms = 0.0;       // total spent loading on misses
+    double peak_resident_mb = 0.0;
+
+    // "RES_REQUESTS=..;RES_HITS=..;RES_HIT_RATE=..;RES_LOADS=..;RES_EVICTIONS=..;
+    //  RES_FAILURES=..;RES_LOAD_MS=..;RES_PEAK_MB=.."
+    std::string toString() const;
+};
+
+class ModelResidency {
+public:
+    ~ModelResidency() { clear(); }
+
+    void setBudgetMb(double budget_mb);
+    void setEngineConfig(const EngineConfig& config);
+    void registerModel(const std::string& id, const std::string& path);
+
+    // Runs the prediction on model id, loading it first when needed
+    PredictionOutput predict(const std::string& id, const std::string& ingredients,
+                             const PredictionOptions& options);
+
+    bool evict(const std::string& id);
+    void clear();
+
+    // Most recently used first
+    std::vector<std::string> residentIds() const;
+    double residentMb() const;
+    double budgetMb() const { return m_budget_mb; }
+
+    ResidencyStats stats() const;
+    void resetStats();
+
+    // "RES_MODELS=a,b;RES_RESIDENT_MB=..;RES_BUDGET_MB=..;" + stats
+    std::string toString() const;
+
+private:
+    struct Resident {
+        std::string id;
+        EngineSession session;
+        double size_mb = 0.0;
+    };
+
+    // Caller holds m_mutex
+    EngineSession* acquire(const std::string& id, std::string& error);
+    void evictBack();
+    double residentMbLocked() const;
+
+    mutable std::mutex m_mutex;
+    double m_budget_mb = 2048.0;
+    EngineConfig m_config;
+    std::map<std::string, std::string> m_paths;
+    std::map<std::string, double> m_known_mb;   // measured footprint per id, for re-loads
+    std::list<Resident> m_lru;                  // front = most recently used
+    ResidencyStats m_stats;
+};
@@ -0,0 +1,116 @@
+#include "model-warmup.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "memory-report.h"
+#include "slm-log.h"
+#include "slm-trace.h"
+
+// ===============================================================
+// MAPPINGS
+// ===============================================================
+std::vector<MappedRange> findFileMappings(const std::string& path) {
+    std::vector<MappedRange> ranges;
+    if (path.empty()) {
+        return ranges;
+    }
+
+    const std::string target = mappedFileName(path);
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        if (!mapsLineNames(line, target)) {
+            continue;
+        }
+        unsigned long start = 0, end = 0;
+        char perms[8] = {};
+        if (sscanf(line.c_str(), "%lx-%lx %7s", &start, &end, perms) != 3 || perms[0] != 'r') {
+            continue;
+        }
+        MappedRange range;
+        range.start = start;
+        range.end = end;
+        ranges.push_back(range);
+    }
+    return ranges;
+}
+
+size_t mappedBytes(const std::vector<MappedRange>& ranges) {
+    size_t total = 0;
+    for (const MappedRange& r : ranges) {
+        total += r.end - r.start;
+    }
+    return total;
+}
+
+size_t residentBytes(const std::vector<MappedRange>& ranges) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t resident = 0;
+    std::vector<unsigned char> vec;
+    for (const MappedRange& r : ranges) {
+        size_t len = r.end - r.start;
+        vec.assign((len + page - 1) / page, 0);
+        if (mincore(reinterpret_cast<void*>(r.start), len, vec.data()) != 0) {
+            continue;
+        }
+        for (unsigned char v : vec) {
+            resident += (v & 1) ? page : 0;
+        }
+    }
+    return resident;
+}
+
+// ===============================================================
+// PREFETCHER
+// ===============================================================
+void WeightPrefetcher::start(const std::vector<MappedRange>& ranges) {
+    join();
+    m_pages = 0;
+    m_elapsed_ms = 0.0;
+    m_thread = std::thread(&WeightPrefetcher::run, this, ranges);
+}
+
+void WeightPrefetcher::join() {
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void WeightPrefetcher::run(std::vector<MappedRange> ranges) {
+    traceSetThreadName("weight_prefetch");
+    SLM_TRACE_SCOPE("prefetch");
+    const int64_t t0 = traceNowUs();
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    for (const MappedRange& r : ranges) {
+        if (madvise(reinterpret_cast<void*>(r.start), r.end - r.start, MADV_WILLNEED) != 0) {
+            LOGW("madvise(WILLNEED) failed for %zu bytes", static_cast<size_t>(r.end - r.start));
+        }
+    }
+
+    // WILLNEED only queues read-ahead; touching makes the pages present
+    unsigned char sink = 0;
+    for (const MappedRange& r : ranges) {
+        for (uintptr_t p = r.start; p < r.end; p += page) {
+            sink ^= *reinterpret_cast<volatile const unsigned char*>(p);
+            m_pages.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    (void) sink;
+
+    m_elapsed_ms = (traceNowUs() - t0) / 1000.0;
+}
+
+std::string WarmupReport::toString() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "WARMUP_MS=%.1f;WARMUP_ROUNDS=%d;WARMUP_DECODE_MS=%.1f;WARMUP_PREFETCH_MS=%.1f"
+             ";WARMUP_MAJFLT=%ld;WARMUP_MINFLT=%ld;WEIGHTS_RESIDENT_PCT=%.1f;MODEL_HOT=%d",
+             total_ms, rounds, decode_ms, prefetch_ms,
+             major_faults, minor_faults, residentFraction() * 100.0, hot ? 1 : 0);
+    return buf;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ===============================================================
+// MODEL WARMUP
+// The first prediction after load pays for page faults on the
+// mmap'd weights and for lazily allocated compute buffers. Warmup
+// runs synthetic predictions (llama_set_warmup) until one of them
+// completes without major faults, optionally while a thread pages
+// the GGUF mappings in with madvise(MADV_WILLNEED) + one read per
+// page. Residency is checked with mincore.
+// ===============================================================
+
+struct WarmupConfig {
+    bool decode = true;             // synthetic prompt + a few decode steps
+    int decode_steps = 4;
+    int max_rounds = 3;             // repeat until a round takes no major faults
+    bool prefetch = false;          // page the weights in on a background thread
+    double hot_fraction = 0.95;     // resident share of the mapped weights required
+};
+
+struct WarmupReport {
+    bool ok = false;                // warmup ran (model loaded, decode succeeded)
+    bool hot = false;               // last round fault-free and weights resident
+    int rounds = 0;
+    double total_ms = 0.0;
+    double decode_ms = 0.0;         // all rounds
+    double prefetch_ms = 0.0;
+    long major_faults = 0;          // process-wide, during warmup
+    long minor_faults = 0;
+    long last_round_major_faults = 0;
+    long pages_prefetched = 0;
+    double mapped_mb = 0.0;         // GGUF mappings (0 without mmap)
+    double resident_before_mb = 0.0;
+    double resident_after_mb = 0.0;
+
+    double residentFraction() const { return mapped_mb > 0.0 ? resident_after_mb / mapped_mb : 1.0; }
+
+    // "WARMUP_MS=..;WARMUP_ROUNDS=..;WARMUP_DECODE_MS=..;WARMUP_PREFETCH_MS=..;
+    //  WARMUP_MAJFLT=..;WARMUP_MINFLT=..;WEIGHTS_RESIDENT_PCT=..;MODEL_HOT=0|1"
+    std::string toString() const;
+};
+
+struct MappedRange {
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+};
+
+// Readable mappings of the file at path in this process
+std::vector<MappedRange> findFileMappings(const std::string& path);
+size_t mappedBytes(const std::vector<MappedRange>& ranges);
+// Bytes of ranges currently in RAM (mincore)
+size_t residentBytes(const std::vector<MappedRange>& ranges);
+
+class WeightPrefetcher {
+public:
+    ~WeightPrefetcher() { join(); }
+
+    // MADV_WILLNEED the ranges, then read one byte per page so the
+    // faults land on this thread instead of the first prediction
+    void start(const std::vector<MappedRange>& ranges);
+    void join();
+
+    double elapsedMs() const { return m_elapsed_ms; }
+    long pagesTouched() const { return m_pages.load(); }
+
+private:
+    void run(std::vector<MappedRange> ranges);
+
+    std::thread m_thread;
+    std::atomic<long> m_pages{0};
+    double m_elapsed_ms = 0.0;
+};
@@ -3,80 +3,134 @@
 #include <vector>
 #include <sstream>
 #include <algorithm>
-#include <android/log.h>
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 #include "llama/llama.h"
 #include "llama/ggml.h"
+#include "allergen-head.h"
+#include "allergen-lexicon.h"
+#include "allergen-metrics.h"
+#include "async-inference.h"
+#include "bench-harness.h"
+#include "embedding-index.h"
+#include "energy-meter.h"
+#include "hnsw-index.h"
+#include "ingredient-dedup.h"
+#include "model-cascade.h"
+#include "model-preloader.h"
+#include "model-residency.h"
+#include "results-journal.h"
+#include "slm-engine.h"
+#include "slm-log.h"
+#include "slm-trace.h"
+#include "thermal-sampler.h"
+#include <atomic>
 #include <chrono>
 #include <cmath>
-#include <android/log.h>
-
-#define TAG "SLM_NATIVE"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, TAG, __VA_ARGS__)
-
-static llama_model* g_model = nullptr;
-static llama_context* g_ctx = nullptr;
-static bool g_model_loaded = false;
-static std::string g_current_model = "";
-
-bool isGemmaModel() {
-    return g_current_model.find("Gemma") != std::string::npos ||
-           g_current_model.find("gemma") != std::string::npos ||
-           g_current_model.find("Vikhr") != std::string::npos;
-}
-
-// ===============================================================
-// PURE MINIMAL ZERO-SHOT PROMPT
-// NO definitions, NO examples, SAME format for all models
-// ===============================================================
-std::string createAllergenPrompt(const std::string& ingredients) {
-    std::stringstream ss;
-
-    if (isGemmaModel()) {
-        LOGI("Using Gemma pure zero-shot prompt");
-
-        ss << "<start_of_turn>user\n"
-           << "You are a food allergen detector.\n"
-           << "\n"
-           << "Your task: Analyze the ingredients and detect which allergens are present.\n"
-           << "\n"
-           << "Allergen categories to check: milk, egg, peanut, tree nut, wheat, soy, fish, shellfish, sesame\n"
-           << "\n"
-           << "Instructions:\n"
-           << "- Only output allergens that are actually present in the ingredients\n"
-           << "- Use lowercase letters\n"
-           << "- Separate multiple allergens with commas\n"
-           << "- If no allergens found, output: none\n"
-           << "\n"
-           << "Ingredients: " << ingredients << "\n"
-           << "Allergens:<end_of_turn>\n"
-           << "<start_of_turn>model\n";
-
-        return ss.str();
-    } else {
-        LOGI("Using ChatML pure zero-shot prompt");
-
-        ss << "<|im_start|>system\n"
-           << "You are a food allergen detector.\n"
-           << "\n"
-           << "Your task: Analyze the ingredients and detect which allergens are present.\n"
-           << "\n"
-           << "Allergen categories to check: milk, egg, peanut, tree nut, wheat, soy, fish, shellfish, sesame\n"
-           << "\n"
-           << "Instructions:\n"
-           << "- Only output allergens that are actually present in the ingredients\n"
-           << "- Use lowercase letters\n"
-           << "- Separate multiple allergens with commas\n"
-           << "- If no allergens found, output: none\n"
-           << "<|im_end|>\n"
-           << "<|im_start|>user\n"
-           << "Ingredients: " << ingredients << "\n"
-           << "Allergens:<|im_end|>\n"
-           << "<|im_start|>assistant\n";
-
-        return ss.str();
+#include <mutex>
+
+// The inference worker decodes on g_session while the JNI thread may
+// clear, reload or swap it, so every entry point that touches the
+// session (or the per-item settings runModelPrediction reads) holds
+// this for its whole call
+static std::mutex g_session_mutex;
+static EngineSession g_session;
+static std::atomic<bool> g_model_loaded{false};
+
+static AllergenLexicon g_lexicon;
+static LexiconGatePolicy g_lexicon_policy;
+static LexiconGateStats g_lexicon_stats;
+
+static ModelCascade g_cascade;
+
+static BenchHarness g_harness;
+
+static ThermalSampler g_thermal;
+
+static EnergyMeter g_energy;
+static EnergyTotals g_energy_totals;
+
+static bool g_memory_per_item = false;
+
+static bool g_raw_text = false;
+
+static ModelPreloader g_preloader;
+
+static ModelResidency g_residency;
+
+static AsyncInference g_async;
+
+static ResultsJournal g_journal;
+
+static std::vector<std::pair<std::string, std::string>> g_lora_paths;  // id, path
+static std::string g_adapter_id;       // "" = base model
+static float g_adapter_scale = 1.0f;
+
+static AllergenHead g_head;
+
+static EmbeddingIndex g_index;
+static HnswIndex g_hnsw;           // graph over g_index rows
+
+static PrefixCacheConfig g_prefix_config{1, 0};    // n_seq > 1 while enabled
+static PrefixCacheStats g_prefix_totals;           // of sessions already freed
+
+static std::string jstringToStd(JNIEnv* env, jstring value) {
+    SLM_TRACE_SCOPE("jni_string_in");
+    const char* chars = env->GetStringUTFChars(value, nullptr);
+    std::string out(chars);
+    env->ReleaseStringUTFChars(value, chars);
+    return out;
+}
+
+// Single token pieces can end mid code point, which NewStringUTF
+// rejects; replace any byte not part of a complete sequence with '?'
+static std::string completeUtf8(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+        bool ok = len > 0 && i + len <= text.size();
+        for (size_t k = 1; ok && k < len; k++) {
+            ok = (static_cast<unsigned char>(text[i + k]) & 0xC0) == 0x80;
+        }
+        if (ok) {
+            out.append(text, i, len);
+            i += len;
+        } else {
+            out += '?';
+            i++;
+        }
+    }
+    return out;
+}
+
+// Adapters belong to the model they were loaded against; a new
+// g_session model gets the remembered ones again
+static void reloadLoraAdapters() {
+    for (const auto& lora : g_lora_paths) {
+        LoraAdapterInfo info;
+        std::string error;
+        if (!g_session.adapters.load(g_session.model, lora.first, lora.second, info, error)) {
+            LOGW("LoRA adapter %s not reloaded: %s", lora.first.c_str(), error.c_str());
+        }
+    }
+    // Results must not be labelled with an adapter that is not there
+    if (!g_adapter_id.empty() && !g_session.adapters.has(g_adapter_id)) {
+        LOGW("Active LoRA adapter %s is gone; using the base model", g_adapter_id.c_str());
+        g_adapter_id.clear();
+        g_adapter_scale = 1.0f;
+    }
+}
+
+// The prefix cache lives in the session; a new g_session gets it again
+static void reapplyPrefixCache() {
+    if (g_prefix_config.n_seq <= 1) {
+        return;
+    }
+    std::string error;
+    if (!enablePrefixCache(g_session, g_prefix_config, error)) {
+        LOGW("Prefix cache not enabled: %s", error.c_str());
     }
 }
 
@@ -90,7 +144,9 @@ Java_edu_utem_ftmk_slm_MainActivity_loadModel(
         jobject thiz,
         jobject assetManager,
         jstring modelPath) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
 
+    SLM_TRACE_SCOPE("jni_loadModel");
     LOGI("=== Loading Model (Pure Zero-Shot) ===");
 
     if (g_model_loaded) {
@@ -98,47 +154,18 @@ Java_edu_utem_ftmk_slm_MainActivity_loadModel(
         return JNI_TRUE;
     }
 
-    const char* model_path_str = env->GetStringUTFChars(modelPath, nullptr);
-    LOGI("Model path: %s", model_path_str);
-
-    g_current_model = std::string(model_path_str);
-
-    if (isGemmaModel()) {
-        LOGI("✓ Detected: GEMMA model");
-    } else {
-        LOGI("✓ Detected: Llama/Qwen/Phi model");
-    }
-
-    llama_backend_init();
-
-    llama_model_params model_params = llama_model_default_params();
-    model_params.n_gpu_layers = 0;
-    model_params.use_mmap = true;
-    model_params.use_mlock = false;
-
-    g_model = llama_load_model_from_file(model_path_str, model_params);
-    env->ReleaseStringUTFChars(modelPath, model_path_str);
-
-    if (g_model == nullptr) {
-        LOGE("Failed to load model");
-        return JNI_FALSE;
-    }
-
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = 4096;
-    ctx_params.n_batch = 1024;
-    ctx_params.n_threads = 6;
-
-    g_ctx = llama_new_context_with_model(g_model, ctx_params);
+    std::string model_path = jstringToStd(env, modelPath);
+    LOGI("Model path: %s", model_path.c_str());
 
-    if (g_ctx == nullptr) {
-        LOGE("Failed to create context");
-        llama_free_model(g_model);
-        g_model = nullptr;
+    EngineConfig config;
+    config.n_seq_max = std::max(1, g_prefix_config.n_seq);
+    if (!loadEngineSession(g_session, model_path, config)) {
         return JNI_FALSE;
     }
 
     g_model_loaded = true;
+    reloadLoraAdapters();
+    reapplyPrefixCache();
     LOGI("✓ Model loaded with pure zero-shot prompt!");
 
     return JNI_TRUE;
@@ -147,209 +174,393 @@ Java_edu_utem_ftmk_slm_MainActivity_loadModel(
 // ===============================================================
 // PREDICT ALLERGENS
 // ===============================================================
+static std::string runModelPrediction(const std::string& ingredients, const PredictionOptions& options) {
+    PredictionOptions run_options = options;
+    run_options.raw_text = options.raw_text || g_raw_text;
+    run_options.adapter = g_adapter_id;
+    run_options.adapter_scale = g_adapter_scale;
+    PredictionOutput out = runAllergenPrediction(g_session, ingredients, run_options);
+    if (out.ok) {
+        g_preloader.noteForegroundItem(out.t_begin_us, out.t_end_us);
+    }
+
+    std::string result = out.formatted();
+    if (out.ok && g_thermal.running()) {
+        // Clocks and temperatures during this item, before the '|'
+        std::string thermal = g_thermal.window(out.t_begin_us, out.t_end_us).toString();
+        result.insert(result.find('|'), ";" + thermal);
+    }
+    if (out.ok && g_energy.running()) {
+        EnergyWindow window = g_energy.window(out.t_begin_us, out.t_end_us);
+        g_energy_totals.add(window, out.generated_tokens);
+        result.insert(result.find('|'), ";" + energyItemString(window, out.generated_tokens));
+    }
+    if (out.ok && g_memory_per_item) {
+        result.insert(result.find('|'), ";" + engineMemoryBreakdown(g_session).toString());
+    }
+    return result;
+}
+
 extern "C"
 JNIEXPORT jstring JNICALL
 Java_edu_utem_ftmk_slm_MainActivity_predictAllergens(
         JNIEnv* env,
         jobject thiz,
         jstring ingredients) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
 
-    auto t_start = std::chrono::high_resolution_clock::now();
-    bool first_token_seen = false;
+    SLM_TRACE_SCOPE("jni_predictAllergens");
+    std::string ingredients_copy = jstringToStd(env, ingredients);
 
-    long ttft_ms = -1;
-    long itps = -1;
-    long otps = -1;
-    long oet_ms = -1;
-    int generated_tokens = 0;
-    int prompt_tokens = 0;
+    std::string result = runModelPrediction(ingredients_copy, PredictionOptions());
 
-    if (!g_model_loaded || g_model == nullptr || g_ctx == nullptr) {
-        LOGE("Model not loaded!");
-        return env->NewStringUTF("ERROR|Model not loaded");
+    SLM_TRACE_SCOPE("jni_string_out");
+    return env->NewStringUTF(result.c_str());
+}
+
+// Results normally carry the labels decoded from the token ids
+// (LABELS=TOKEN); enabled, they carry the model's cleaned text instead
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setRawOutputText(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean enabled) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_raw_text = enabled == JNI_TRUE;
+}
+
+// ===============================================================
+// LEXICON FAST PATH
+// TRUST answers from the automaton, HINT adds the hits to the
+// prompt, FULL is plain predictAllergens. Adds PATH, LEX_MASK,
+// SCAN_US and EVIDENCE to the metric prefix.
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_predictAllergensGated(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+
+    std::string ingredients_copy = jstringToStd(env, ingredients);
+
+    LexiconScan scan = g_lexicon.scan(ingredients_copy);
+    LexiconDecision decision = decideLexiconGate(scan, g_lexicon_policy);
+    std::string evidence = formatLexiconEvidence(g_lexicon, scan, ingredients_copy);
+    std::replace(evidence.begin(), evidence.end(), ';', ' ');
+    std::replace(evidence.begin(), evidence.end(), '|', ' ');
+
+    LOGI("Lexicon: %s mask=%s in %ld us [%s]",
+         lexiconDecisionName(decision),
+         allergenMaskToString(scan.mask()).c_str(),
+         scan.scan_us,
+         evidence.c_str());
+
+    std::stringstream meta;
+    meta << "PATH=" << lexiconDecisionName(decision)
+         << ";LEX_MASK=" << scan.mask()
+         << ";SCAN_US=" << scan.scan_us
+         << ";EVIDENCE=" << evidence;
+
+    if (decision == LexiconDecision::TRUST) {
+        g_lexicon_stats.record(decision, scan.scan_us, 0);
+
+        std::stringstream final_result;
+        final_result << "TTFT_MS=0;ITPS=-1;OTPS=-1;OET_MS=0;"
+                     << meta.str()
+                     << "|" << allergenMaskToString(scan.strong_mask);
+        return env->NewStringUTF(final_result.str().c_str());
     }
 
-    const char* ingredients_str = env->GetStringUTFChars(ingredients, nullptr);
-    LOGI("=== Predicting (Pure Zero-Shot) ===");
-    LOGI("Ingredients: %s", ingredients_str);
+    PredictionOptions options;
+    if (decision == LexiconDecision::HINT) {
+        options.hints = formatLexiconHints(g_lexicon, scan, ingredients_copy);
+    }
 
-    std::string prompt = createAllergenPrompt(ingredients_str);
-    env->ReleaseStringUTFChars(ingredients, ingredients_str);
+    auto t_model = std::chrono::steady_clock::now();
+    std::string result = runModelPrediction(ingredients_copy, options);
+    long model_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - t_model
+    ).count();
 
-    LOGI("Prompt length: %zu chars", prompt.length());
+    if (result.rfind("ERROR|", 0) == 0) {
+        return env->NewStringUTF(result.c_str());
+    }
 
-    const llama_vocab * vocab = llama_model_get_vocab(g_model);
+    g_lexicon_stats.record(decision, scan.scan_us, model_ms);
 
-    const int n_prompt_tokens = -llama_tokenize(vocab, prompt.c_str(), prompt.length(), nullptr, 0, true, false);
-    std::vector<llama_token> tokens(n_prompt_tokens);
+    size_t sep = result.find('|');
+    std::string final_result = result.substr(0, sep) + ";" + meta.str()
+                               + result.substr(sep);
+    return env->NewStringUTF(final_result.c_str());
+}
 
-    int n_tokens = llama_tokenize(vocab, prompt.c_str(), prompt.length(), tokens.data(), tokens.size(), true, false);
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_scanIngredientLexicon(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients) {
 
-    if (n_tokens < 0) {
-        LOGE("Tokenization failed");
-        return env->NewStringUTF("ERROR|Tokenization failed");
-    }
+    std::string ingredients_copy = jstringToStd(env, ingredients);
 
-    LOGI("Tokenized: %d tokens", n_tokens);
-    prompt_tokens = n_tokens;
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    LexiconScan scan = g_lexicon.scan(ingredients_copy);
+    LexiconDecision decision = decideLexiconGate(scan, g_lexicon_policy);
 
-    int max_ctx = llama_n_ctx(g_ctx);
-    if (n_tokens >= max_ctx - 100) {
-        LOGE("Prompt too long!");
-        return env->NewStringUTF("ERROR|Prompt too long");
-    }
+    std::stringstream out;
+    out << "DECISION=" << lexiconDecisionName(decision)
+        << ";MASK=" << scan.mask()
+        << ";STRONG_MASK=" << scan.strong_mask
+        << ";WEAK_MASK=" << scan.weak_mask
+        << ";CAUTION=" << (scan.cautionary ? 1 : 0)
+        << ";SCAN_US=" << scan.scan_us
+        << "|" << allergenMaskToString(scan.mask())
+        << "|" << formatLexiconEvidence(g_lexicon, scan, ingredients_copy);
 
-    llama_batch batch = llama_batch_get_one(tokens.data(), n_tokens);
+    return env->NewStringUTF(out.str().c_str());
+}
 
-    if (llama_decode(g_ctx, batch) != 0) {
-        LOGE("Failed to decode");
-        return env->NewStringUTF("ERROR|Decoding failed");
-    }
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_loadLexiconDictionary(
+        JNIEnv* env,
+        jobject thiz,
+        jstring path) {
 
-    auto t_prefill_end = std::chrono::high_resolution_clock::now();
-    long prefill_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            t_prefill_end - t_start
-    ).count();
+    const char* path_str = env->GetStringUTFChars(path, nullptr);
+    std::string error;
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    bool ok = g_lexicon.loadFromFile(path_str, error);
+    env->ReleaseStringUTFChars(path, path_str);
 
-    if (prefill_ms > 0) {
-        itps = (prompt_tokens * 1000L) / prefill_ms;
+    if (!ok) {
+        LOGE("Lexicon load failed: %s", error.c_str());
+        return JNI_FALSE;
     }
-    LOGI("Prefill: %d tokens in %ld ms", prompt_tokens, prefill_ms);
-
-    std::string result;
-    int max_tokens = 40;
-    float temperature = 0.0;
 
-    LOGI("Generating...");
-    auto n_vocab_size = llama_vocab_n_tokens(vocab);
+    LOGI("✓ Lexicon loaded: %zu entries, %zu states",
+         g_lexicon.entries().size(), g_lexicon.stateCount());
+    return JNI_TRUE;
+}
 
-    for (int i = 0; i < max_tokens; i++) {
-        auto * logits = llama_get_logits_ith(g_ctx, -1);
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setLexiconPolicy(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean trustStrong,
+        jboolean trustEmpty,
+        jboolean hintOnWeak,
+        jint minStrongHits) {
+
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_lexicon_policy.trust_strong = trustStrong;
+    g_lexicon_policy.trust_empty = trustEmpty;
+    g_lexicon_policy.hint_on_weak = hintOnWeak;
+    g_lexicon_policy.min_strong_hits = minStrongHits;
+}
 
-        if (logits == nullptr) {
-            LOGE("Failed to get logits");
-            break;
-        }
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getLexiconStats(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    return env->NewStringUTF(g_lexicon_stats.toString().c_str());
+}
 
-        llama_token new_token_id = 0;
-        float max_logit = logits[0];
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_resetLexiconStats(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_lexicon_stats = LexiconGateStats();
+}
 
-        for (int id = 1; id < n_vocab_size; id++) {
-            if (logits[id] > max_logit) {
-                max_logit = logits[id];
-                new_token_id = id;
-            }
-        }
+// ===============================================================
+// MODEL CASCADE
+// Small model first, large model only for low-margin answers. Both
+// stay resident next to (and independent of) the loadModel session.
+// ===============================================================
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_loadCascade(
+        JNIEnv* env,
+        jobject thiz,
+        jstring smallModelPath,
+        jstring largeModelPath) {
 
-        if (llama_vocab_is_eog(vocab, new_token_id)) {
-            LOGI("EOS at token %d", i);
-            break;
-        }
+    std::string small_path = jstringToStd(env, smallModelPath);
+    std::string large_path = jstringToStd(env, largeModelPath);
 
-        if (!first_token_seen) {
-            auto t_first = std::chrono::high_resolution_clock::now();
-            ttft_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    t_first - t_start
-            ).count();
-            first_token_seen = true;
-            LOGI("TTFT: %ld ms", ttft_ms);
-        }
+    return g_cascade.load(small_path, large_path, EngineConfig()) ? JNI_TRUE : JNI_FALSE;
+}
 
-        char buf[256];
-        int n_chars = llama_token_to_piece(vocab, new_token_id, buf, sizeof(buf), 0, false);
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setCascadeThresholds(
+        JNIEnv* env,
+        jobject thiz,
+        jfloat minMargin,
+        jfloat minMeanMargin,
+        jboolean escalateOnUnparsed,
+        jboolean shadowLarge) {
+
+    CascadeConfig config;
+    config.min_margin = minMargin;
+    config.min_mean_margin = minMeanMargin;
+    config.escalate_on_unparsed = escalateOnUnparsed;
+    config.shadow_large = shadowLarge;
+    g_cascade.setConfig(config);
+}
 
-        if (n_chars < 0) {
-            LOGE("Failed to decode token");
-            break;
-        }
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_predictAllergensCascade(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients,
+        jstring groundTruth) {
 
-        std::string token_str(buf, n_chars);
-        result += token_str;
-        generated_tokens++;
+    if (!g_cascade.loaded()) {
+        LOGE("Cascade not loaded!");
+        return env->NewStringUTF("ERROR|Cascade not loaded");
+    }
 
-        // Log first 5 tokens
-        if (i < 5) {
-            LOGI("Token %d: '%s'", i, token_str.c_str());
-        }
+    std::string ingredients_copy = jstringToStd(env, ingredients);
+    std::string truth = jstringToStd(env, groundTruth);
+    int truth_mask = truth.empty() ? -1 : parseAllergenList(truth);
 
-        // Check for end markers
-        if (isGemmaModel()) {
-            if (result.find("<end_of_turn>") != std::string::npos) {
-                LOGI("Gemma end at token %d", i);
-                break;
-            }
-            if (result.find("<start_of_turn>") != std::string::npos) {
-                LOGI("Gemma start marker at token %d", i);
-                break;
-            }
-        } else {
-            if (result.find("<|im_end|>") != std::string::npos) {
-                LOGI("ChatML end at token %d", i);
-                break;
-            }
-        }
+    CascadeItem item = g_cascade.predict(ingredients_copy, truth_mask);
+    return env->NewStringUTF(item.formatted().c_str());
+}
 
-        if (result.find('\n') != std::string::npos) {
-            LOGI("Newline at token %d", i);
-            break;
-        }
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getCascadeStats(
+        JNIEnv* env,
+        jobject thiz) {
+    return env->NewStringUTF(g_cascade.stats().toString().c_str());
+}
 
-        batch = llama_batch_get_one(&new_token_id, 1);
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_resetCascadeStats(
+        JNIEnv* env,
+        jobject thiz) {
+    g_cascade.resetStats();
+}
 
-        if (llama_decode(g_ctx, batch) != 0) {
-            LOGE("Failed to decode next token");
-            break;
-        }
-    }
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_unloadCascade(
+        JNIEnv* env,
+        jobject thiz) {
+    LOGI("Unloading cascade...");
+    g_cascade.unload();
+}
 
-    auto t_gen_end = std::chrono::high_resolution_clock::now();
-    long gen_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            t_gen_end - t_start
-    ).count();
+// ===============================================================
+// BENCHMARK HARNESS
+// Warmup + N measured repetitions of one item on the loadModel
+// session. The usual TTFT/ITPS/OTPS/OET fields carry the medians.
+// ===============================================================
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setBenchmarkConfig(
+        JNIEnv* env,
+        jobject thiz,
+        jint warmupMin,
+        jint warmupMax,
+        jint repetitions,
+        jfloat steadyCv,
+        jint bootstrap) {
+
+    HarnessConfig config = g_harness.config();
+    config.warmup_min = warmupMin;
+    config.warmup_max = std::max(warmupMin, warmupMax);
+    config.repetitions = std::max(1, static_cast<int>(repetitions));
+    config.steady_cv = steadyCv;
+    config.bootstrap = bootstrap;
+    g_harness.setConfig(config);
+}
 
-    oet_ms = gen_ms;
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_benchmarkItem(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
 
-    if (gen_ms > 0 && generated_tokens > 0) {
-        otps = (generated_tokens * 1000L) / gen_ms;
+    if (!g_model_loaded || !g_session.loaded()) {
+        LOGE("Model not loaded!");
+        return env->NewStringUTF("ERROR|Model not loaded");
     }
 
-    LOGI("Generated %d tokens", generated_tokens);
-    LOGI("RAW: '%s'", result.c_str());
+    std::string ingredients_copy = jstringToStd(env, ingredients);
 
-    // Clean output
-    if (isGemmaModel()) {
-        size_t end_pos = result.find("<end_of_turn>");
-        if (end_pos != std::string::npos) {
-            result = result.substr(0, end_pos);
-        }
-        end_pos = result.find("<start_of_turn>");
-        if (end_pos != std::string::npos) {
-            result = result.substr(0, end_pos);
-        }
-    } else {
-        size_t end_pos = result.find("<|im_end|>");
-        if (end_pos != std::string::npos) {
-            result = result.substr(0, end_pos);
-        }
-    }
+    PredictionOptions options;
+    options.raw_text = g_raw_text;
+    options.clear_memory = true;
+    options.adapter = g_adapter_id;
+    options.adapter_scale = g_adapter_scale;
 
-    result.erase(0, result.find_first_not_of(" \n\r\t"));
-    result.erase(result.find_last_not_of(" \n\r\t") + 1);
+    HarnessItem item = g_harness.measure([&]() {
+        return runAllergenPrediction(g_session, ingredients_copy, options);
+    });
 
-    if (result.empty()) {
-        result = "none";
+    const PredictionOutput& first = item.runs.front();
+    if (item.samples.latency_ms.empty()) {
+        return env->NewStringUTF(first.formatted().c_str());
     }
 
-    LOGI("CLEANED: '%s'", result.c_str());
+    const PhaseSamples& s = item.samples;
+    long outliers = std::count(item.outlier.begin(), item.outlier.end(), true);
+
+    char meta[384];
+    snprintf(meta, sizeof(meta),
+             "TTFT_MS=%ld;ITPS=%ld;OTPS=%ld;OET_MS=%ld;SCHEMA=%d;WARMUP_RUNS=%d;STEADY=%d"
+             ";REPS=%zu;FAILED_RUNS=%d;REP_OUTLIERS=%ld;DRIFT=%.4f;LAT_P50_MS=%.3f;LAT_MAD_MS=%.3f",
+             std::lround(percentileOf(s.ttft_ms, 0.5)),
+             std::lround(percentileOf(s.prefill_tps, 0.5)),
+             std::lround(percentileOf(s.decode_tps, 0.5)),
+             std::lround(percentileOf(s.latency_ms, 0.5)),
+             BENCH_SCHEMA_VERSION, item.warmup_runs, item.steady ? 1 : 0,
+             item.runs.size(), item.failures, outliers, item.drift,
+             percentileOf(s.latency_ms, 0.5),
+             summarizeMetric(s.latency_ms, HarnessConfig()).mad);
+
+    std::string text;
+    for (const PredictionOutput& run : item.runs) {
+        if (run.ok) {
+            text = run.text;
+            break;
+        }
+    }
+    return env->NewStringUTF((std::string(meta) + "|" + text).c_str());
+}
 
-    std::stringstream final_result;
-    final_result << "TTFT_MS=" << ttft_ms
-                 << ";ITPS=" << itps
-                 << ";OTPS=" << otps
-                 << ";OET_MS=" << oet_ms
-                 << "|" << result;
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getBenchmarkSummary(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    return env->NewStringUTF(g_harness.summaryString().c_str());
+}
 
-    return env->NewStringUTF(final_result.str().c_str());
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_resetBenchmark(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_harness.reset();
 }
 
 extern "C"
@@ -357,7 +568,9 @@ JNIEXPORT void JNICALL
 Java_edu_utem_ftmk_slm_MainActivity_clearContext(
         JNIEnv* env,
         jobject thiz) {
-    __android_log_print(ANDROID_LOG_INFO, "SLM_NATIVE", "Context clear requested");
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    LOGI("Context clear requested");
+    clearEngineMemory(g_session);
 }
 
 extern "C"
@@ -365,57 +578,1025 @@ JNIEXPORT jboolean JNICALL
 Java_edu_utem_ftmk_slm_MainActivity_isModelHealthy(
         JNIEnv* env,
         jobject thiz) {
-    if (g_ctx != nullptr && g_model != nullptr) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (g_session.loaded()) {
         return JNI_TRUE;
     }
     return JNI_FALSE;
 }
 
 // ===============================================================
-// UTILITY FUNCTIONS
+// PHASE TRACE
+// Chrome trace JSON of every traced scope since the last enable;
+// open the file in ui.perfetto.dev
 // ===============================================================
 extern "C"
-JNIEXPORT jstring JNICALL
-Java_edu_utem_ftmk_slm_MainActivity_getModelInfo(
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setTraceEnabled(
         JNIEnv* env,
-        jobject thiz) {
+        jobject thiz,
+        jboolean enabled) {
+    if (enabled == JNI_TRUE) {
+        traceReset();
+        traceSetThreadName("predict");
+    }
+    traceSetEnabled(enabled == JNI_TRUE);
+}
 
-    if (!g_model_loaded || g_model == nullptr) {
-        return env->NewStringUTF("Model not loaded");
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_dumpTrace(
+        JNIEnv* env,
+        jobject thiz,
+        jstring path) {
+    std::string path_str = jstringToStd(env, path);
+    std::string error;
+    if (!traceWriteChromeJson(path_str, error)) {
+        LOGE("%s", error.c_str());
+        return JNI_FALSE;
     }
+    LOGI("Trace written to %s", path_str.c_str());
+    return JNI_TRUE;
+}
 
-    const llama_vocab * vocab = llama_model_get_vocab(g_model);
+// ===============================================================
+// THERMAL SAMPLER
+// predictAllergens results gain FREQ_*/TEMP_*/THROTTLED keys while
+// the sampler runs; stop writes every sample as JSONL
+// ===============================================================
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_startThermalSampler(
+        JNIEnv* env,
+        jobject thiz,
+        jint intervalMs) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    ThermalSamplerConfig config;
+    config.interval_ms = intervalMs;
+    std::string error;
+    if (!g_thermal.start(config, error)) {
+        LOGE("%s", error.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
 
-    std::stringstream info;
-    info << "Model loaded: Yes\n";
-    info << "Prompting: Pure Zero-Shot (No Examples)\n";
-    info << "Context size: " << llama_n_ctx(g_ctx) << "\n";
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_stopThermalSampler(
+        JNIEnv* env,
+        jobject thiz,
+        jstring samplesPath) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_thermal.stop();
+    std::string path = jstringToStd(env, samplesPath);
+    if (path.empty()) {
+        return JNI_TRUE;
+    }
+    std::string error;
+    if (!g_thermal.writeSamplesJsonl(path, error)) {
+        LOGE("%s", error.c_str());
+        return JNI_FALSE;
+    }
+    LOGI("Thermal samples written to %s", path.c_str());
+    return JNI_TRUE;
+}
 
-    return env->NewStringUTF(info.str().c_str());
+// ===============================================================
+// ENERGY METER
+// predictAllergens results gain ENERGY_J/J_PER_TOKEN/AVG_W while the
+// meter runs; stop returns the totals since start
+// ===============================================================
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_startEnergyMeter(
+        JNIEnv* env,
+        jobject thiz,
+        jint intervalMs) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    EnergyMeterConfig config;
+    config.source = EnergySource::BATTERY;
+    config.interval_ms = intervalMs;
+    std::string error;
+    if (!g_energy.start(config, error)) {
+        LOGE("%s", error.c_str());
+        return JNI_FALSE;
+    }
+    g_energy_totals = EnergyTotals();
+    return JNI_TRUE;
 }
 
 extern "C"
-JNIEXPORT void JNICALL
-Java_edu_utem_ftmk_slm_MainActivity_unloadModel(
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_stopEnergyMeter(
         JNIEnv* env,
         jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_energy.stop();
+    return env->NewStringUTF(g_energy_totals.toString().c_str());
+}
 
-    LOGI("Unloading model...");
-
-    if (g_ctx != nullptr) {
-        llama_free(g_ctx);
-        g_ctx = nullptr;
+// ===============================================================
+// NATIVE MEMORY
+// Weights / KV cache / compute split of the process; per item it
+// adds ~ms of /proc parsing, so it is opt-in
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getMemoryReport(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_model_loaded) {
+        return env->NewStringUTF("ERROR|Model not loaded");
     }
+    return env->NewStringUTF(engineMemoryBreakdown(g_session).toString().c_str());
+}
 
-    if (g_model != nullptr) {
-        llama_free_model(g_model);
-        g_model = nullptr;
-    }
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setMemoryReportPerItem(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean enabled) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_memory_per_item = enabled == JNI_TRUE;
+}
+
+// ===============================================================
+// MODEL WARMUP
+// Synthetic predictions until a round takes no major page faults;
+// returns WARMUP_*;MODEL_HOT=0|1 (see WarmupReport::toString)
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_warmupModel(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean prefetch) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_model_loaded) {
+        return env->NewStringUTF("ERROR|Model not loaded");
+    }
+    WarmupConfig config;
+    config.prefetch = prefetch == JNI_TRUE;
+    WarmupReport report = warmupEngineSession(g_session, config);
+    return env->NewStringUTF(report.toString().c_str());
+}
+
+// ===============================================================
+// MODEL PRELOAD
+// Second session loaded on a background thread while predictions
+// continue; swapToPreloadedModel replaces the loadModel session
+// with it and returns PRELOAD_*;SWAP_MS;OVERLAP_*;CONTENTION_PCT
+// ===============================================================
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_preloadModel(
+        JNIEnv* env,
+        jobject thiz,
+        jstring modelPath) {
+    std::string model_path = jstringToStd(env, modelPath);
+    std::string error;
+    if (!g_preloader.start(model_path, PreloadConfig(), error)) {
+        LOGW("Preload not started: %s", error.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_swapToPreloadedModel(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    PreloadReport report;
+    const PrefixCacheStats prefix = g_session.prefix_cache.stats();
+    if (g_preloader.swapInto(g_session, report)) {
+        g_model_loaded = true;
+        g_prefix_totals.merge(prefix);
+        reloadLoraAdapters();
+        reapplyPrefixCache();
+        LOGI("✓ Swapped to preloaded %s", report.model_path.c_str());
+    }
+    return env->NewStringUTF(report.toString().c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_cancelPreload(
+        JNIEnv* env,
+        jobject thiz) {
+    g_preloader.cancel();
+}
+
+// ===============================================================
+// LORA ADAPTERS
+// Loaded once on the loadModel session and kept across preload
+// swaps; setActiveAdapter picks the one predictions run with (""
+// = base model). Results then carry ADAPTER / ADAPTER_SCALE /
+// ADAPTER_SWITCH_MS after LABELS
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_loadLoraAdapter(
+        JNIEnv* env,
+        jobject thiz,
+        jstring adapterId,
+        jstring adapterPath) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_model_loaded || !g_session.loaded()) {
+        return env->NewStringUTF("ERROR|Model not loaded");
+    }
+    std::string id = jstringToStd(env, adapterId);
+    std::string path = jstringToStd(env, adapterPath);
+    LoraAdapterInfo info;
+    std::string error;
+    if (!g_session.adapters.load(g_session.model, id, path, info, error)) {
+        return env->NewStringUTF(("ERROR|" + error).c_str());
+    }
+    g_lora_paths.emplace_back(id, path);
+    return env->NewStringUTF(info.toString().c_str());
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setActiveAdapter(
+        JNIEnv* env,
+        jobject thiz,
+        jstring adapterId,
+        jfloat scale) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    std::string id = jstringToStd(env, adapterId);
+    if (!id.empty() && !g_session.adapters.has(id)) {
+        LOGW("Unknown LoRA adapter '%s'", id.c_str());
+        return JNI_FALSE;
+    }
+    g_adapter_id = id;
+    g_adapter_scale = scale;
+    return JNI_TRUE;
+}
+
+// One LoraAdapterInfo::toString per line
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getLoraAdapters(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    std::string lines;
+    for (const LoraAdapterInfo& info : g_session.adapters.list()) {
+        lines += (lines.empty() ? "" : "\n") + info.toString();
+    }
+    return env->NewStringUTF(lines.c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_unloadLoraAdapters(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (g_session.ctx != nullptr) {
+        bool switched = false;
+        double switch_ms = 0.0;
+        std::string error;
+        g_session.adapters.activate(g_session.ctx, "", 1.0f, switched, switch_ms, error);
+        if (switched) {
+            clearEngineMemory(g_session);
+        }
+    }
+    g_session.adapters.freeAll();
+    g_lora_paths.clear();
+    g_adapter_id.clear();
+    g_adapter_scale = 1.0f;
+}
+
+// ===============================================================
+// ALLERGEN HEAD
+// Linear sigmoid head over mean-pooled hidden states: one prefill
+// of the ingredient text instead of generation. Trained on the
+// loadModel session from labeled items and saved to a small file;
+// predictAllergensHead returns HEAD_MS / EMBED_MS / HEAD_US /
+// PROMPT_TOKENS and LABELS=HEAD before the labels
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_trainAllergenHead(
+        JNIEnv* env,
+        jobject thiz,
+        jobjectArray ingredients,
+        jshortArray truthMasks,
+        jstring headPath,
+        jint epochs) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_model_loaded || !g_session.loaded()) {
+        return env->NewStringUTF("ERROR|Model not loaded");
+    }
+    jsize n = env->GetArrayLength(ingredients);
+    if (env->GetArrayLength(truthMasks) != n) {
+        return env->NewStringUTF("ERROR|Ingredient and mask arrays differ in length");
+    }
+    std::vector<AllergenMask> truth(n), masks;
+    env->GetShortArrayRegion(truthMasks, 0, n, reinterpret_cast<jshort*>(truth.data()));
+
+    // Hidden states once, then training never touches the model
+    const int64_t t0 = traceNowUs();
+    std::vector<float> features, embedding;
+    std::string error;
+    for (jsize i = 0; i < n; i++) {
+        jstring text = static_cast<jstring>(env->GetObjectArrayElement(ingredients, i));
+        std::string item = jstringToStd(env, text);
+        env->DeleteLocalRef(text);
+        int n_tokens = 0;
+        if (!embedIngredients(g_session, item, embedding, n_tokens, error)) {
+            LOGW("Head item %d skipped: %s", static_cast<int>(i), error.c_str());
+            continue;
+        }
+        features.insert(features.end(), embedding.begin(), embedding.end());
+        masks.push_back(truth[i]);
+    }
+    const double embed_ms = (traceNowUs() - t0) / 1000.0;
+
+    HeadConfig config;
+    config.epochs = epochs;
+    config.n_threads = g_session.config.n_threads;
+    HeadTrainReport report;
+    char desc[128];
+    llama_model_desc(g_session.model, desc, sizeof(desc));
+    AllergenHead head;
+    if (!head.train(features, masks, llama_model_n_embd(g_session.model), config, report, error)
+        || !head.save(jstringToStd(env, headPath), desc, error)) {
+        return env->NewStringUTF(("ERROR|" + error).c_str());
+    }
+    g_head = head;
+
+    char buf[48];
+    snprintf(buf, sizeof(buf), ";EMBED_MS=%.1f", embed_ms);
+    return env->NewStringUTF((report.toString() + buf).c_str());
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_loadAllergenHead(
+        JNIEnv* env,
+        jobject thiz,
+        jstring headPath) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_model_loaded || !g_session.loaded()) {
+        return JNI_FALSE;
+    }
+    char desc[128];
+    llama_model_desc(g_session.model, desc, sizeof(desc));
+    std::string error;
+    if (!g_head.load(jstringToStd(env, headPath), desc, error)) {
+        LOGW("Allergen head not loaded: %s", error.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_predictAllergensHead(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    SLM_TRACE_SCOPE("jni_predictAllergensHead");
+    if (!g_model_loaded || !g_session.loaded()) {
+        return env->NewStringUTF("ERROR|Model not loaded");
+    }
+    HeadPrediction out = runHeadPrediction(g_session, g_head, jstringToStd(env, ingredients));
+    return env->NewStringUTF(out.formatted().c_str());
+}
+
+// ===============================================================
+// NEAREST NEIGHBOURS
+// Mapped int8 index of pooled embeddings with their ground-truth
+// masks (embedding-index.h); labeled items are added as they are
+// seen. predictAllergensKnn returns KNN_MS / EMBED_MS and the
+// neighbour stats with LABELS=KNN before the labels, or ERROR when
+// no neighbour is similar enough so the caller falls back
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_openEmbeddingIndex(
+        JNIEnv* env,
+        jobject thiz,
+        jstring indexPath) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_model_loaded || !g_session.loaded()) {
+        return env->NewStringUTF("ERROR|Model not loaded");
+    }
+    std::string error;
+    g_hnsw.close();
+    if (!g_index.open(jstringToStd(env, indexPath), llama_model_n_embd(g_session.model), error)) {
+        return env->NewStringUTF(("ERROR|" + error).c_str());
+    }
+    return env->NewStringUTF(g_index.stats().toString().c_str());
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_addToEmbeddingIndex(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients,
+        jshort truthMask) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_model_loaded || !g_session.loaded() || !g_index.isOpen()) {
+        return JNI_FALSE;
+    }
+    std::vector<float> embedding;
+    std::string error;
+    int n_tokens = 0;
+    if (!embedIngredients(g_session, jstringToStd(env, ingredients), embedding, n_tokens, error)
+        || !g_index.insert(embedding.data(), static_cast<AllergenMask>(truthMask), error)) {
+        LOGW("Index insert failed: %s", error.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_predictAllergensKnn(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients,
+        jint k,
+        jfloat minSimilarity) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    SLM_TRACE_SCOPE("jni_predictAllergensKnn");
+    if (!g_model_loaded || !g_session.loaded()) {
+        return env->NewStringUTF("ERROR|Model not loaded");
+    }
+    if (!g_index.isOpen() || g_index.rows() == 0) {
+        return env->NewStringUTF("ERROR|Embedding index is empty");
+    }
+
+    std::vector<float> embedding;
+    std::string error;
+    int n_tokens = 0;
+    const int64_t t0 = traceNowUs();
+    if (!embedIngredients(g_session, jstringToStd(env, ingredients), embedding, n_tokens, error)) {
+        return env->NewStringUTF(("ERROR|" + error).c_str());
+    }
+    const double embed_ms = (traceNowUs() - t0) / 1000.0;
+
+    KnnConfig config;
+    config.k = k;
+    config.min_similarity = minSimilarity;
+    KnnPrediction out = g_index.predict(embedding.data(), config);
+    if (out.empty()) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "ERROR|No neighbour above %.2f (best %.3f)", minSimilarity, out.top_similarity);
+        return env->NewStringUTF(buf);
+    }
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "KNN_MS=%.2f;EMBED_MS=%.2f;", embed_ms + out.scan_us / 1000.0, embed_ms);
+    std::string result = buf + out.toString() + ";LABELS=KNN|" + allergenMaskToString(out.mask);
+    return env->NewStringUTF(result.c_str());
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getEmbeddingIndexStats(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    return env->NewStringUTF(g_index.stats().toString().c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_closeEmbeddingIndex(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_hnsw.close();
+    g_index.close();
+}
+
+// ===============================================================
+// NEAR-DUPLICATE REUSE
+// HNSW graph over the open embedding index, mapped from a file when
+// it matches the index and rebuilt on the engine threads otherwise.
+// predictAllergensReuse returns the nearest item's verified labels
+// (REUSE_MS / EMBED_MS / HNSW_US / SIM / ROW, LABELS=REUSE) or ERROR
+// below minSimilarity so the caller generates instead
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_prepareHnswIndex(
+        JNIEnv* env,
+        jobject thiz,
+        jstring graphPath,
+        jint m) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    if (!g_index.isOpen() || g_index.rows() == 0) {
+        return env->NewStringUTF("ERROR|Embedding index is empty");
+    }
+    const std::string path = jstringToStd(env, graphPath);
+    std::string error;
+    const int64_t t0 = traceNowUs();
+    if (g_hnsw.load(path, error) && g_hnsw.matches(g_index)) {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "LOADED=1;ROWS=%u;LEVELS=%d;LOAD_MS=%.2f",
+                 g_hnsw.rows(), g_hnsw.maxLevel() + 1, (traceNowUs() - t0) / 1000.0);
+        return env->NewStringUTF(buf);
+    }
+
+    HnswConfig config;
+    config.m = m;
+    config.n_threads = g_session.config.n_threads;
+    HnswBuildReport report;
+    if (!g_hnsw.build(g_index, config, report, error) || !g_hnsw.save(path, error)) {
+        return env->NewStringUTF(("ERROR|" + error).c_str());
+    }
+    return env->NewStringUTF(("LOADED=0;" + report.toString()).c_str());
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_predictAllergensReuse(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients,
+        jfloat minSimilarity) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    SLM_TRACE_SCOPE("jni_predictAllergensReuse");
+    if (!g_model_loaded || !g_session.loaded()) {
+        return env->NewStringUTF("ERROR|Model not loaded");
+    }
+    if (!g_hnsw.ready()) {
+        return env->NewStringUTF("ERROR|HNSW graph not ready");
+    }
+
+    std::vector<float> embedding;
+    std::string error;
+    int n_tokens = 0;
+    const int64_t t0 = traceNowUs();
+    if (!embedIngredients(g_session, jstringToStd(env, ingredients), embedding, n_tokens, error)) {
+        return env->NewStringUTF(("ERROR|" + error).c_str());
+    }
+    const int64_t t1 = traceNowUs();
+    std::vector<KnnNeighbor> nearest = g_hnsw.search(g_index, embedding.data(), 1, HnswConfig().ef_search);
+    const int64_t t2 = traceNowUs();
+    if (nearest.empty() || nearest.front().similarity < minSimilarity) {
+        char buf[80];
+        snprintf(buf, sizeof(buf), "ERROR|No near duplicate above %.2f (best %.3f)", minSimilarity,
+                 nearest.empty() ? 0.0f : nearest.front().similarity);
+        return env->NewStringUTF(buf);
+    }
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "REUSE_MS=%.2f;EMBED_MS=%.2f;HNSW_US=%.1f;SIM=%.4f;ROW=%u;LABELS=REUSE|",
+             (t2 - t0) / 1000.0, (t1 - t0) / 1000.0, static_cast<double>(t2 - t1),
+             nearest.front().similarity, nearest.front().row);
+    return env->NewStringUTF((buf + allergenMaskToString(nearest.front().mask)).c_str());
+}
+
+// ===============================================================
+// MODEL RESIDENCY
+// Pool of sessions by model id under a MB budget, LRU evicted;
+// independent of the loadModel session
+// ===============================================================
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_registerResidentModel(
+        JNIEnv* env,
+        jobject thiz,
+        jstring modelId,
+        jstring modelPath) {
+    g_residency.registerModel(jstringToStd(env, modelId), jstringToStd(env, modelPath));
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_setResidencyBudget(
+        JNIEnv* env,
+        jobject thiz,
+        jint budgetMb) {
+    g_residency.setBudgetMb(budgetMb);
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_predictAllergensWith(
+        JNIEnv* env,
+        jobject thiz,
+        jstring modelId,
+        jstring ingredients) {
+    std::string model_id = jstringToStd(env, modelId);
+    PredictionOptions options;
+    options.raw_text = g_raw_text;
+    // Pool sessions are shared across items; start each from empty KV
+    options.clear_memory = true;
+    PredictionOutput out = g_residency.predict(model_id, jstringToStd(env, ingredients), options);
+    std::string result = out.formatted();
+    if (out.ok) {
+        result.insert(result.find('|'), ";MODEL_ID=" + model_id);
+    }
+    return env->NewStringUTF(result.c_str());
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getResidencyStats(
+        JNIEnv* env,
+        jobject thiz) {
+    return env->NewStringUTF(g_residency.toString().c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_clearResidency(
+        JNIEnv* env,
+        jobject thiz) {
+    g_residency.clear();
+    g_residency.resetStats();
+}
+
+// ===============================================================
+// ASYNC STREAMING
+// submitPrediction returns a handle at once; the persistent worker
+// runs requests in order on the loadModel session and publishes
+// FIRST_TOKEN / TOKEN / DONE events (see InferenceEvent::toString;
+// DONE carries the predictAllergens result). The worker holds
+// g_session_mutex per request, so blocking calls wait for the running
+// one; cancelPrediction returns once it has stopped.
+// ===============================================================
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_startInferenceWorker(
+        JNIEnv* env,
+        jobject thiz) {
+    return g_async.start([](const std::string& ingredients, const PredictionOptions& options) {
+        std::lock_guard<std::mutex> session_lock(g_session_mutex);
+        return runModelPrediction(ingredients, options);
+    }) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_stopInferenceWorker(
+        JNIEnv* env,
+        jobject thiz) {
+    g_async.stop();
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_submitPrediction(
+        JNIEnv* env,
+        jobject thiz,
+        jstring ingredients) {
+    if (!g_model_loaded) {
+        return -1;
+    }
+    return g_async.submit(jstringToStd(env, ingredients));
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_cancelPrediction(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle) {
+    return g_async.cancel(static_cast<long>(handle)) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Next event, or "" after timeoutMs without one
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_awaitInferenceEvent(
+        JNIEnv* env,
+        jobject thiz,
+        jint timeoutMs) {
+    InferenceEvent event;
+    if (!g_async.wait(event, timeoutMs)) {
+        return env->NewStringUTF("");
+    }
+    return env->NewStringUTF(completeUtf8(event.toString()).c_str());
+}
+
+// ===============================================================
+// QUALITY METRICS
+// MetricsCalculator's per-item metrics from 9-bit masks, and run
+// summaries (confusion matrix per label, micro / macro F1, the
+// dashboard's per-item means) over packed mask arrays.
+// ===============================================================
+extern "C"
+JNIEXPORT jint JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_parseAllergenMask(
+        JNIEnv* env,
+        jobject thiz,
+        jstring allergens) {
+    return parseAllergenList(jstringToStd(env, allergens));
+}
+
+// See ItemMetrics::toString for the keys
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_computeItemMetrics(
+        JNIEnv* env,
+        jobject thiz,
+        jstring groundTruth,
+        jstring predicted,
+        jstring ingredients) {
+    ItemMetrics m = computeItemMetrics(parseAllergenList(jstringToStd(env, groundTruth)),
+                                       parseAllergenList(jstringToStd(env, predicted)),
+                                       ingredientEvidenceMask(jstringToStd(env, ingredients)));
+    return env->NewStringUTF(m.toString().c_str());
+}
+
+// evidence may be null; see MetricsSummary::toString for the keys
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_computeMetricsSummary(
+        JNIEnv* env,
+        jobject thiz,
+        jshortArray groundTruth,
+        jshortArray predicted,
+        jshortArray evidence) {
+    jsize n = env->GetArrayLength(groundTruth);
+    if (env->GetArrayLength(predicted) != n || (evidence != nullptr && env->GetArrayLength(evidence) != n)) {
+        return env->NewStringUTF("ERROR|Mask arrays differ in length");
+    }
+
+    // jshort and AllergenMask are both 16 bits; masks never use the sign bit
+    std::vector<AllergenMask> truth(n), pred(n), evid(evidence != nullptr ? n : 0);
+    env->GetShortArrayRegion(groundTruth, 0, n, reinterpret_cast<jshort*>(truth.data()));
+    env->GetShortArrayRegion(predicted, 0, n, reinterpret_cast<jshort*>(pred.data()));
+    if (evidence != nullptr) {
+        env->GetShortArrayRegion(evidence, 0, n, reinterpret_cast<jshort*>(evid.data()));
+    }
+
+    MetricsSummary summary = computeMetricsSummary(truth.data(), pred.data(),
+                                                   evidence != nullptr ? evid.data() : nullptr, n);
+    return env->NewStringUTF(summary.toString().c_str());
+}
+
+// ===============================================================
+// DEDUPLICATION
+// Groups a dataset's items by canonical ingredient text before a
+// batch; the returned array maps every item to its group's first
+// item, so the caller predicts once per group and fans out
+// ===============================================================
+extern "C"
+JNIEXPORT jintArray JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_planIngredientGroups(
+        JNIEnv* env,
+        jobject thiz,
+        jobjectArray ingredients,
+        jboolean ignoreOrder) {
+    jsize n = env->GetArrayLength(ingredients);
+    std::vector<std::string> texts;
+    texts.reserve(n);
+    for (jsize i = 0; i < n; i++) {
+        jstring text = static_cast<jstring>(env->GetObjectArrayElement(ingredients, i));
+        texts.push_back(jstringToStd(env, text));
+        env->DeleteLocalRef(text);
+    }
+
+    DedupOptions options;
+    options.ignore_order = ignoreOrder;
+    DedupPlan plan = planDedup(texts, options);
+    LOGI("Dedup plan: %s", plan.toString().c_str());
+
+    std::vector<jint> representative(n);
+    for (jsize i = 0; i < n; i++) {
+        representative[i] = static_cast<jint>(plan.representative[plan.group[i]]);
+    }
+    jintArray out = env->NewIntArray(n);
+    env->SetIntArrayRegion(out, 0, n, representative.data());
+    return out;
+}
+
+// ===============================================================
+// PREFIX CACHE
+// Earlier prompts stay in the KV cache as branches of a radix tree
+// and each new prompt prefills only what follows its longest cached
+// prefix. Survives model reloads (the config is reapplied); stats
+// accumulate until the cache is enabled again
+// ===============================================================
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_enablePrefixCache(
+        JNIEnv* env,
+        jobject thiz,
+        jint sequences,
+        jint maxCells) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    g_prefix_config = PrefixCacheConfig{std::max(1, static_cast<int>(sequences)), std::max(0, static_cast<int>(maxCells))};
+    g_prefix_totals = PrefixCacheStats();
+    if (!g_model_loaded) {
+        return g_prefix_config.n_seq > 1 ? JNI_TRUE : JNI_FALSE;
+    }
+    std::string error;
+    if (!enablePrefixCache(g_session, g_prefix_config, error)) {
+        LOGE("Prefix cache: %s", error.c_str());
+        g_prefix_config = PrefixCacheConfig{1, 0};
+        g_model_loaded = g_session.loaded();
+        return JNI_FALSE;
+    }
+    g_session.prefix_cache.resetStats();
+    return g_prefix_config.n_seq > 1 ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getPrefixCacheStats(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+    PrefixCacheStats stats = g_prefix_totals;
+    stats.merge(g_session.prefix_cache.stats());
+    return env->NewStringUTF(stats.toString().c_str());
+}
+
+// ===============================================================
+// RESULTS JOURNAL
+// PredictionResults appended to a local columnar journal with group
+// commit instead of one Firestore write each. Rows carry the
+// PredictionResult fields in declaration order, split by type:
+// Strings, then Int / Long / Boolean as longs, then Doubles.
+// Uploads read pending rows from the sync cursor and acknowledge
+// them once the remote write succeeds.
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_openResultsJournal(
+        JNIEnv* env,
+        jobject thiz,
+        jstring path,
+        jint groupRows,
+        jint groupMs) {
+    JournalConfig config;
+    config.group_rows = groupRows;
+    config.group_ms = groupMs;
+    std::string error;
+    if (!g_journal.open(jstringToStd(env, path), predictionResultColumns(), config, error)) {
+        LOGE("Journal: %s", error.c_str());
+        return env->NewStringUTF(("ERROR|" + error).c_str());
+    }
+    return env->NewStringUTF(g_journal.stats().toString().c_str());
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_appendJournalResult(
+        JNIEnv* env,
+        jobject thiz,
+        jobjectArray texts,
+        jlongArray ints,
+        jdoubleArray reals) {
+    SLM_TRACE_SCOPE("jni_journal_append");
+    JournalRecord record;
+    const jsize n_texts = env->GetArrayLength(texts);
+    for (jsize i = 0; i < n_texts; i++) {
+        jstring text = static_cast<jstring>(env->GetObjectArrayElement(texts, i));
+        record.texts.push_back(text != nullptr ? jstringToStd(env, text) : std::string());
+        env->DeleteLocalRef(text);
+    }
+    std::vector<jlong> values(env->GetArrayLength(ints));
+    env->GetLongArrayRegion(ints, 0, values.size(), values.data());
+    record.ints.assign(values.begin(), values.end());
+    record.reals.resize(env->GetArrayLength(reals));
+    env->GetDoubleArrayRegion(reals, 0, record.reals.size(), record.reals.data());
+
+    std::string error;
+    if (!g_journal.append(record, error)) {
+        LOGE("Journal: %s", error.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_flushResultsJournal(
+        JNIEnv* env,
+        jobject thiz) {
+    std::string error;
+    if (!g_journal.flush(error)) {
+        LOGE("Journal: %s", error.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+// "FROM=..;TO=..|" + one JSON object per line for committed rows
+// [sync cursor, sync cursor + maxRows); acknowledge TO once uploaded
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_readPendingJournalRows(
+        JNIEnv* env,
+        jobject thiz,
+        jint maxRows) {
+    const uint64_t from = g_journal.syncCursor();
+    const uint64_t to = from + std::min<uint64_t>(g_journal.pendingSync(), std::max(maxRows, 0));
+    std::string out = "FROM=" + std::to_string(from) + ";TO=" + std::to_string(to) +
+                      ";JOURNAL=" + g_journal.journalId() + "|";
+    out += g_journal.jsonlRows(from, to);
+    return env->NewStringUTF(completeUtf8(out).c_str());
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_acknowledgeJournalSync(
+        JNIEnv* env,
+        jobject thiz,
+        jlong row) {
+    std::string error;
+    if (!g_journal.acknowledgeSync(static_cast<uint64_t>(row), error)) {
+        LOGE("Journal: %s", error.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_exportResultsJournal(
+        JNIEnv* env,
+        jobject thiz,
+        jstring path,
+        jboolean csv) {
+    std::string out_path = jstringToStd(env, path);
+    FILE* out = fopen(out_path.c_str(), "w");
+    if (out == nullptr) {
+        LOGE("Journal: cannot write %s", out_path.c_str());
+        return JNI_FALSE;
+    }
+    const uint64_t rows = g_journal.rows();
+    bool ok = csv == JNI_TRUE ? g_journal.exportCsv(out, 0, rows) : g_journal.exportJsonl(out, 0, rows);
+    fclose(out);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+// See JournalStats::toString; LATENCY_MEAN_MS comes from a column scan
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getJournalStats(
+        JNIEnv* env,
+        jobject thiz) {
+    if (!g_journal.isOpen()) {
+        return env->NewStringUTF("ERROR|Journal not open");
+    }
+    JournalColumnStats latency = g_journal.columnStats(g_journal.columnIndex("latencyMs"));
+    char buf[96];
+    snprintf(buf, sizeof(buf), ";LATENCY_MEAN_MS=%.1f;SCAN_US=%.0f", latency.mean(), latency.scan_us);
+    return env->NewStringUTF((g_journal.stats().toString() + buf).c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_closeResultsJournal(
+        JNIEnv* env,
+        jobject thiz) {
+    g_journal.close();
+}
+
+// ===============================================================
+// UTILITY FUNCTIONS
+// ===============================================================
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_getModelInfo(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+
+    if (!g_model_loaded || g_session.model == nullptr) {
+        return env->NewStringUTF("Model not loaded");
+    }
+
+    std::stringstream info;
+    info << "Model loaded: Yes\n";
+    info << "Prompting: Pure Zero-Shot (No Examples)\n";
+    info << "Context size: " << llama_n_ctx(g_session.ctx) << "\n";
+
+    return env->NewStringUTF(info.str().c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_edu_utem_ftmk_slm_MainActivity_unloadModel(
+        JNIEnv* env,
+        jobject thiz) {
+    std::lock_guard<std::mutex> session_lock(g_session_mutex);
+
+    LOGI("Unloading model...");
 
-    llama_backend_free();
+    g_prefix_totals.merge(g_session.prefix_cache.stats());
+    freeEngineSession(g_session);
 
     g_model_loaded = false;
-    g_current_model = "";
     LOGI("Model unloaded");
 }
 
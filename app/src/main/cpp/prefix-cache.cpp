@@ -0,0 +1,330 @@
+#include "prefix-cache.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "slm-trace.h"
+
+std::string PrefixCacheStats::toString() const {
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "PREFIX_LOOKUPS=%ld;PREFIX_HITS=%ld;PREFIX_PROMPT_TOKENS=%ld;PREFIX_REUSED_TOKENS=%ld;"
+             "PREFIX_REUSED_RATIO=%.4f;PREFIX_PREFILL_MS=%.2f;PREFIX_SAVED_MS=%.2f;PREFIX_EVICTIONS=%ld;"
+             "PREFIX_EVICTED_CELLS=%ld;PREFIX_BRANCHES=%d;PREFIX_CELLS=%d",
+             lookups, hits, prompt_tokens, reused_tokens, reusedRatio(), prefill_ms, savedMs(), evictions,
+             evicted_cells, branches, cells);
+    return buf;
+}
+
+void PrefixCacheStats::merge(const PrefixCacheStats& later) {
+    const long tokens = prefill_tokens + later.prefill_tokens;
+    if (tokens > 0) {
+        prefill_us_per_token = (prefill_us_per_token * prefill_tokens +
+                                later.prefill_us_per_token * later.prefill_tokens) / tokens;
+    }
+    lookups += later.lookups;
+    hits += later.hits;
+    prompt_tokens += later.prompt_tokens;
+    reused_tokens += later.reused_tokens;
+    prefill_tokens = tokens;
+    prefill_ms += later.prefill_ms;
+    evictions += later.evictions;
+    evicted_cells += later.evicted_cells;
+    branches = later.branches;
+    cells = later.cells;
+}
+
+// ===============================================================
+// TREE
+// ===============================================================
+void PrefixCache::configure(const PrefixCacheConfig& config) {
+    m_config = config;
+    reset(nullptr);
+}
+
+void PrefixCache::reset(llama_memory_t mem) {
+    if (mem != nullptr) {
+        for (const Node& node : m_nodes) {
+            if (node.children.empty() && node.seq >= 0) {
+                llama_memory_seq_rm(mem, node.seq, -1, -1);
+            }
+        }
+    }
+    m_nodes.assign(1, Node());
+    m_free_nodes.clear();
+    m_free_seqs.clear();
+    m_leases.clear();
+    for (int seq = m_config.n_seq - 1; seq >= 0; seq--) {
+        m_free_seqs.push_back(seq);
+    }
+    m_cells = 0;
+}
+
+int PrefixCache::findChild(int node, llama_token token) const {
+    for (int child : m_nodes[node].children) {
+        if (m_nodes[child].tokens.front() == token) {
+            return child;
+        }
+    }
+    return -1;
+}
+
+int PrefixCache::walk(const std::vector<llama_token>& tokens, int limit, int& matched) {
+    matched = 0;
+    int node = 0;
+    while (matched < limit) {
+        const int child = findChild(node, tokens[matched]);
+        if (child < 0) {
+            break;
+        }
+        const std::vector<llama_token>& edge = m_nodes[child].tokens;
+        size_t k = 0;
+        while (k < edge.size() && matched < limit && edge[k] == tokens[matched]) {
+            k++;
+            matched++;
+        }
+        node = child;
+        if (k < edge.size()) {
+            break;
+        }
+    }
+    return node;
+}
+
+int PrefixCache::newNode() {
+    if (!m_free_nodes.empty()) {
+        const int node = m_free_nodes.back();
+        m_free_nodes.pop_back();
+        return node;
+    }
+    m_nodes.emplace_back();
+    return static_cast<int>(m_nodes.size()) - 1;
+}
+
+void PrefixCache::freeSeq(llama_memory_t mem, llama_seq_id seq) {
+    llama_memory_seq_rm(mem, seq, -1, -1);
+    m_free_seqs.push_back(seq);
+}
+
+void PrefixCache::repointSeq(int node, llama_seq_id old_seq, llama_seq_id new_seq) {
+    for (; node > 0; node = m_nodes[node].parent) {
+        Node& n = m_nodes[node];
+        if (n.seq == old_seq) {
+            n.seq = new_seq >= 0 ? new_seq : m_nodes[n.children.front()].seq;
+        }
+    }
+}
+
+bool PrefixCache::evictLeaf(llama_memory_t mem, llama_seq_id keep) {
+    int victim = -1;
+    for (size_t i = 1; i < m_nodes.size(); i++) {
+        const Node& n = m_nodes[i];
+        if (n.children.empty() && n.seq >= 0 && n.seq != keep &&
+            (victim < 0 || n.last_used < m_nodes[victim].last_used)) {
+            victim = static_cast<int>(i);
+        }
+    }
+    if (victim < 0) {
+        return false;
+    }
+
+    SLM_TRACE_SCOPE("prefix_evict");
+    const llama_seq_id seq = m_nodes[victim].seq;
+    const int edge = static_cast<int>(m_nodes[victim].tokens.size());
+    freeSeq(mem, seq);
+    m_cells -= edge;
+    m_stats.evictions++;
+    m_stats.evicted_cells += edge;
+
+    const int parent = m_nodes[victim].parent;
+    std::vector<int>& siblings = m_nodes[parent].children;
+    siblings.erase(std::find(siblings.begin(), siblings.end(), victim));
+    m_nodes[victim] = Node();
+    m_free_nodes.push_back(victim);
+
+    // An inner node left with one child folds into it
+    int fix = parent;
+    if (parent != 0 && m_nodes[parent].children.size() == 1) {
+        const int only = m_nodes[parent].children.front();
+        const int grandparent = m_nodes[parent].parent;
+        Node& child = m_nodes[only];
+        child.tokens.insert(child.tokens.begin(), m_nodes[parent].tokens.begin(), m_nodes[parent].tokens.end());
+        child.parent = grandparent;
+        std::vector<int>& uncles = m_nodes[grandparent].children;
+        *std::find(uncles.begin(), uncles.end(), parent) = only;
+        m_nodes[parent] = Node();
+        m_free_nodes.push_back(parent);
+        fix = grandparent;
+    }
+    repointSeq(fix, seq, -1);
+    return true;
+}
+
+// ===============================================================
+// LEASES
+// ===============================================================
+PrefixLease PrefixCache::acquire(llama_memory_t mem, const std::vector<llama_token>& tokens) {
+    PrefixLease lease;
+    if (!enabled() || tokens.empty()) {
+        return lease;
+    }
+
+    SLM_TRACE_SCOPE("prefix_lookup");
+    const int limit = static_cast<int>(tokens.size()) - 1;
+    int matched = 0;
+    int node = walk(tokens, limit, matched);
+    if (m_free_seqs.empty()) {
+        // Keep the branch being forked unless it is the only one
+        llama_seq_id source = matched > 0 ? m_nodes[node].seq : -1;
+        if (!evictLeaf(mem, source)) {
+            evictLeaf(mem, -1);
+        }
+        node = walk(tokens, limit, matched);
+    }
+
+    lease.length = matched;
+    lease.source = matched > 0 ? m_nodes[node].seq : -1;
+    lease.work = m_free_seqs.back();
+    m_free_seqs.pop_back();
+
+    llama_memory_seq_rm(mem, lease.work, -1, -1);
+    if (matched > 0) {
+        llama_memory_seq_cp(mem, lease.source, lease.work, 0, matched);
+    }
+    m_leases.push_back(lease);
+
+    m_tick++;
+    for (int n = node; n > 0; n = m_nodes[n].parent) {
+        m_nodes[n].last_used = m_tick;
+    }
+
+    m_stats.lookups++;
+    m_stats.hits += matched > 0 ? 1 : 0;
+    m_stats.prompt_tokens += static_cast<long>(tokens.size());
+    m_stats.reused_tokens += matched;
+    return lease;
+}
+
+void PrefixCache::release(llama_memory_t mem, const PrefixLease& lease, const std::vector<llama_token>& tokens,
+                          double prefill_us) {
+    if (!lease.active()) {
+        return;
+    }
+
+    SLM_TRACE_SCOPE("prefix_insert");
+    dropLease(lease);
+    const int n = static_cast<int>(tokens.size());
+    // Generated tokens are this item's own
+    llama_memory_seq_rm(mem, lease.work, n, -1);
+
+    const double x = n - lease.length;
+    m_fit_n += 1.0;
+    m_fit_x += x;
+    m_fit_y += prefill_us;
+    m_fit_xx += x * x;
+    m_fit_xy += x * prefill_us;
+    m_stats.prefill_tokens += n - lease.length;
+    m_stats.prefill_ms += prefill_us / 1000.0;
+
+    int matched = 0;
+    int node = walk(tokens, n, matched);
+    int leaf = node;
+
+    if (matched == n) {
+        // The same prompt is cached already
+        freeSeq(mem, lease.work);
+    } else if (matched == m_nodes[node].depth && node != 0 && m_nodes[node].children.empty()) {
+        // Extends a leaf: work holds its whole path, so it takes over
+        Node& extended = m_nodes[node];
+        extended.tokens.insert(extended.tokens.end(), tokens.begin() + matched, tokens.end());
+        extended.depth = n;
+        const llama_seq_id old_seq = extended.seq;
+        extended.seq = lease.work;
+        repointSeq(extended.parent, old_seq, lease.work);
+        freeSeq(mem, old_seq);
+        m_cells += n - matched;
+    } else {
+        int parent = node;
+        if (matched < m_nodes[node].depth) {
+            // Ends inside node's edge: split it there
+            const int mid = newNode();
+            const int split = matched - (m_nodes[node].depth - static_cast<int>(m_nodes[node].tokens.size()));
+            Node& child = m_nodes[node];
+            Node& inner = m_nodes[mid];
+            inner.tokens.assign(child.tokens.begin(), child.tokens.begin() + split);
+            inner.parent = child.parent;
+            inner.depth = matched;
+            inner.seq = child.seq;
+            inner.children.assign(1, node);
+            std::vector<int>& siblings = m_nodes[child.parent].children;
+            *std::find(siblings.begin(), siblings.end(), node) = mid;
+            child.tokens.erase(child.tokens.begin(), child.tokens.begin() + split);
+            child.parent = mid;
+            parent = mid;
+        }
+        leaf = newNode();
+        Node& added = m_nodes[leaf];
+        added.tokens.assign(tokens.begin() + matched, tokens.end());
+        added.parent = parent;
+        added.depth = n;
+        added.seq = lease.work;
+        m_nodes[parent].children.push_back(leaf);
+        m_cells += n - matched;
+    }
+
+    m_tick++;
+    for (int i = leaf; i > 0; i = m_nodes[i].parent) {
+        m_nodes[i].last_used = m_tick;
+    }
+
+    while (m_cells > m_config.max_cells && evictLeaf(mem, -1)) {
+    }
+}
+
+void PrefixCache::discard(llama_memory_t mem, const PrefixLease& lease) {
+    if (lease.active()) {
+        dropLease(lease);
+        freeSeq(mem, lease.work);
+    }
+}
+
+void PrefixCache::dropLease(const PrefixLease& lease) {
+    for (size_t i = 0; i < m_leases.size(); i++) {
+        if (m_leases[i].work == lease.work) {
+            m_leases.erase(m_leases.begin() + i);
+            return;
+        }
+    }
+}
+
+PrefixCacheStats PrefixCache::stats() const {
+    PrefixCacheStats s = m_stats;
+    // Slope of prefill time over prefilled tokens, so the fixed cost
+    // of a decode call is not counted as saved
+    const double den = m_fit_n * m_fit_xx - m_fit_x * m_fit_x;
+    double slope = den > 0.0 ? (m_fit_n * m_fit_xy - m_fit_x * m_fit_y) / den : 0.0;
+    if (slope <= 0.0 && m_fit_x > 0.0) {
+        slope = m_fit_y / m_fit_x;
+    }
+    s.prefill_us_per_token = slope;
+    for (size_t i = 1; i < m_nodes.size(); i++) {
+        if (m_nodes[i].children.empty() && m_nodes[i].seq >= 0) {
+            s.branches++;
+        }
+    }
+    s.cells = m_cells;
+    return s;
+}
+
+int PrefixCache::cellsInUse(llama_memory_t mem) const {
+    int cells = m_cells;
+    for (const PrefixLease& lease : m_leases) {
+        cells += std::max(0, llama_memory_seq_pos_max(mem, lease.work) + 1 - lease.length);
+    }
+    return cells;
+}
+
+void PrefixCache::resetStats() {
+    m_stats = PrefixCacheStats();
+    m_fit_n = m_fit_x = m_fit_y = m_fit_xx = m_fit_xy = 0.0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llama/llama.h"
+
+// ===============================================================
+// PREFIX CACHE
+// Radix tree over the prompt token sequences of earlier items, each
+// path backed by a live KV sequence of a multi-sequence context.
+// Every prompt shares the system text and many ingredient lists
+// start alike ("Wheat flour, sugar, ..."), so a new prompt forks the
+// longest cached prefix onto a free sequence with llama_memory_seq_cp
+// and prefills only the rest.
+//
+// Leaves own one sequence each, holding the KV of their whole path;
+// inner nodes point at any leaf below them. The cells of a shared
+// prefix exist once (seq_cp only tags them with another sequence),
+// so the cells in use are the sum of the edge lengths. When they go
+// over the budget, or every sequence is taken, the least recently
+// used leaf is dropped with llama_memory_seq_rm, which frees exactly
+// its own edge.
+//
+// Needs a context with n_seq_max > 1 and a unified KV cache.
+// ===============================================================
+
+struct PrefixCacheConfig {
+    int n_seq = 16;             // context sequences: cached leaves plus the one in use
+    int max_cells = 2048;       // KV cells the cached branches may hold
+};
+
+struct PrefixCacheStats {
+    long lookups = 0;
+    long hits = 0;                  // reused at least one token
+    long prompt_tokens = 0;
+    long reused_tokens = 0;
+    long prefill_tokens = 0;        // tokens prefilled after the fork
+    double prefill_ms = 0.0;        // their llama_decode time
+    double prefill_us_per_token = 0.0;  // least squares slope over the prefills
+    long evictions = 0;
+    long evicted_cells = 0;
+    int branches = 0;
+    int cells = 0;
+
+    double reusedRatio() const { return prompt_tokens > 0 ? static_cast<double>(reused_tokens) / prompt_tokens : 0.0; }
+    // Reused tokens at the marginal prefill cost per token
+    double savedMs() const { return reused_tokens * prefill_us_per_token / 1000.0; }
+    // Totals with a later cache's stats (after a model reload); the
+    // rate is weighted by prefilled tokens, branches and cells are the
+    // later cache's
+    void merge(const PrefixCacheStats& later);
+
+    // "PREFIX_LOOKUPS=..;PREFIX_HITS=..;PREFIX_PROMPT_TOKENS=..;PREFIX_REUSED_TOKENS=..;
+    //  PREFIX_REUSED_RATIO=..;PREFIX_PREFILL_MS=..;PREFIX_SAVED_MS=..;PREFIX_EVICTIONS=..;
+    //  PREFIX_EVICTED_CELLS=..;PREFIX_BRANCHES=..;PREFIX_CELLS=.."
+    std::string toString() const;
+};
+
+// A prompt continuing from a cached prefix
+struct PrefixLease {
+    int length = 0;             // leading tokens already in work
+    llama_seq_id source = -1;   // sequence they were copied from, -1 on a miss
+    llama_seq_id work = -1;     // sequence the prompt runs on; -1 when the cache is off
+
+    bool active() const { return work >= 0; }
+};
+
+class PrefixCache {
+public:
+    // Clears the tree; enabled when config.n_seq > 1
+    void configure(const PrefixCacheConfig& config);
+    bool enabled() const { return m_config.n_seq > 1; }
+    const PrefixCacheConfig& config() const { return m_config; }
+
+    // Drops every branch; their sequences are removed from mem unless
+    // it is null (memory already cleared)
+    void reset(llama_memory_t mem);
+
+    // Forks the longest cached prefix of tokens, at most all but the
+    // last token (its logits are needed), onto a free sequence
+    PrefixLease acquire(llama_memory_t mem, const std::vector<llama_token>& tokens);
+    // Trims the work sequence back to the prompt and keeps it as a
+    // branch, then evicts down to the cell budget. prefill_us is the
+    // decode time of the tokens after lease.length
+    void release(llama_memory_t mem, const PrefixLease& lease, const std::vector<llama_token>& tokens,
+                 double prefill_us);
+    // Frees the work sequence without caching it (failed prompt)
+    void discard(llama_memory_t mem, const PrefixLease& lease);
+
+    PrefixCacheStats stats() const;
+    void resetStats();
+    // KV cells in use: the branches' plus what each prompt leased out
+    // right now added past its forked prefix
+    int cellsInUse(llama_memory_t mem) const;
+
+private:
+    struct Node {
+        std::vector<llama_token> tokens;    // edge from the parent
+        int parent = -1;
+        int depth = 0;                      // path length through this edge
+        std::vector<int> children;
+        llama_seq_id seq = -1;              // a live sequence holding the path
+        uint64_t last_used = 0;
+    };
+
+    // Deepest node along tokens[0, limit) and how many tokens match;
+    // the match may end inside that node's edge
+    int walk(const std::vector<llama_token>& tokens, int limit, int& matched);
+    int findChild(int node, llama_token token) const;
+    int newNode();
+    void freeSeq(llama_memory_t mem, llama_seq_id seq);
+    void dropLease(const PrefixLease& lease);
+    // Inner nodes from node up that point at old_seq move to new_seq,
+    // or to a child's sequence when new_seq is -1
+    void repointSeq(int node, llama_seq_id old_seq, llama_seq_id new_seq);
+    bool evictLeaf(llama_memory_t mem, llama_seq_id keep);
+
+    PrefixCacheConfig m_config{1, 0};
+    std::vector<Node> m_nodes;              // [0] is the root
+    std::vector<int> m_free_nodes;
+    std::vector<llama_seq_id> m_free_seqs;
+    std::vector<PrefixLease> m_leases;      // acquired, not yet released
+    int m_cells = 0;
+    uint64_t m_tick = 0;
+
+    PrefixCacheStats m_stats;
+    // Sums for the prefill time fit: tokens (x) against us (y)
+    double m_fit_n = 0.0, m_fit_x = 0.0, m_fit_y = 0.0, m_fit_xx = 0.0, m_fit_xy = 0.0;
+};
@@ -0,0 +1,854 @@
+#include "results-journal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <random>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+// ===============================================================
+// FILE LAYOUT
+// Page 0: FileHeader, the column descriptors, two CommitSlots.
+// Then segments of segment_rows rows, each column's values
+// contiguous inside the segment and every segment page-aligned.
+// ===============================================================
+static const char JOURNAL_MAGIC[8] = {'S', 'L', 'M', 'J', 'R', 'N', 'L', '1'};
+static const uint32_t JOURNAL_VERSION = 1;
+static const size_t JOURNAL_PAGE = 4096;
+static const size_t COLUMNS_OFFSET = 64;
+static const size_t MAX_COLUMNS = 48;
+static const size_t SLOTS_OFFSET = 2048;
+static const int TEXT_LENGTH_BITS = 24;     // text cell: offset << 24 | length
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t column_count;
+    uint32_t segment_rows;
+    uint32_t reserved;
+    uint64_t journal_id;        // 0 in files from before it existed
+};
+
+struct ColumnDesc {
+    char name[31];
+    uint8_t type;
+};
+
+struct CommitSlot {
+    uint64_t seq;
+    uint64_t rows;
+    uint64_t heap_bytes;
+    uint64_t sync_cursor;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(FileHeader) <= COLUMNS_OFFSET, "header overlaps columns");
+static_assert(COLUMNS_OFFSET + MAX_COLUMNS * sizeof(ColumnDesc) <= SLOTS_OFFSET, "column table overlaps slots");
+
+static uint64_t slotChecksum(const CommitSlot& slot) {
+    // FNV-1a over every field but the checksum
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&slot);
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < offsetof(CommitSlot, checksum); i++) {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t newJournalId() {
+    std::random_device device;
+    uint64_t id = (static_cast<uint64_t>(device()) << 32) ^ device() ^ static_cast<uint64_t>(traceNowUs());
+    return id != 0 ? id : 1;
+}
+
+static size_t columnWidth(JournalType type) {
+    return type == JournalType::INT32 || type == JournalType::BOOL ? 4 : 8;
+}
+
+const std::vector<JournalColumn>& predictionResultColumns() {
+    static const std::vector<JournalColumn> columns = {
+            {"dataId", JournalType::TEXT},
+            {"name", JournalType::TEXT},
+            {"ingredients", JournalType::TEXT},
+            {"allergensRaw", JournalType::TEXT},
+            {"allergensMapped", JournalType::TEXT},
+            {"predictedAllergens", JournalType::TEXT},
+            {"modelName", JournalType::TEXT},
+            {"truePositives", JournalType::INT32},
+            {"falsePositives", JournalType::INT32},
+            {"falseNegatives", JournalType::INT32},
+            {"trueNegatives", JournalType::INT32},
+            {"precision", JournalType::REAL},
+            {"recall", JournalType::REAL},
+            {"f1Score", JournalType::REAL},
+            {"accuracy", JournalType::REAL},
+            {"isExactMatch", JournalType::BOOL},
+            {"hammingLoss", JournalType::REAL},
+            {"falseNegativeRate", JournalType::REAL},
+            {"hallucinationCount", JournalType::INT32},
+            {"hallucinatedAllergens", JournalType::TEXT},
+            {"overPredictionCount", JournalType::INT32},
+            {"overPredictedAllergens", JournalType::TEXT},
+            {"isAbstentionCase", JournalType::BOOL},
+            {"isAbstentionCorrect", JournalType::BOOL},
+            {"latencyMs", JournalType::INT64},
+            {"ttftMs", JournalType::INT64},
+            {"itps", JournalType::INT64},
+            {"otps", JournalType::INT64},
+            {"oetMs", JournalType::INT64},
+            {"totalTimeMs", JournalType::INT64},
+            {"javaHeapKb", JournalType::INT64},
+            {"nativeHeapKb", JournalType::INT64},
+            {"totalPssKb", JournalType::INT64},
+            {"deviceModel", JournalType::TEXT},
+            {"androidVersion", JournalType::TEXT},
+            {"timestamp", JournalType::INT64},
+    };
+    return columns;
+}
+
+std::string JournalColumnStats::toString() const {
+    char buf[192];
+    snprintf(buf, sizeof(buf), "ROWS=%llu;SUM=%.6g;MEAN=%.6g;MIN=%.6g;MAX=%.6g;SCAN_US=%.0f",
+             static_cast<unsigned long long>(rows), sum, mean(), min, max, scan_us);
+    return buf;
+}
+
+std::string JournalStats::toString() const {
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "ROWS=%llu;COMMITTED=%llu;SYNC_CURSOR=%llu;PENDING_SYNC=%llu;HEAP_KB=%.1f;"
+             "RECOVERED=%llu;DROPPED_HEAP_BYTES=%llu;COMMITS=%ld;COMMIT_MEAN_US=%.0f;"
+             "COMMIT_MAX_US=%.0f;APPEND_MEAN_US=%.1f",
+             static_cast<unsigned long long>(rows),
+             static_cast<unsigned long long>(committed_rows),
+             static_cast<unsigned long long>(sync_cursor),
+             static_cast<unsigned long long>(committed_rows - sync_cursor),
+             heap_bytes / 1024.0,
+             static_cast<unsigned long long>(recovered_rows),
+             static_cast<unsigned long long>(dropped_heap_bytes),
+             commits, commits > 0 ? commit_us / commits : 0.0, commit_max_us,
+             rows > 0 ? append_us / rows : 0.0);
+    return buf;
+}
+
+// ===============================================================
+// OPEN / CLOSE
+// ===============================================================
+bool ResultsJournal::open(const std::string& path, const std::vector<JournalColumn>& columns,
+                          const JournalConfig& config, std::string& error) {
+    SLM_TRACE_SCOPE("journal_open");
+    close();
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (columns.empty() || columns.size() > MAX_COLUMNS) {
+        error = "Journal needs 1.." + std::to_string(MAX_COLUMNS) + " columns";
+        return false;
+    }
+    m_config = config;
+    m_config.group_rows = std::max(config.group_rows, 1);
+    m_path = path;
+    m_stats = JournalStats();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "Cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+    int heap_fd = ::open((path + ".heap").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (heap_fd < 0) {
+        error = "Cannot open " + path + ".heap: " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    struct stat st {};
+    fstat(fd, &st);
+    const bool fresh = st.st_size == 0;
+
+    FileHeader header {};
+    std::vector<ColumnDesc> descs(columns.size());
+    CommitSlot slots[2] {};
+    if (fresh) {
+        memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = JOURNAL_VERSION;
+        header.column_count = static_cast<uint32_t>(columns.size());
+        // Multiple of 64 keeps every column array 8-byte aligned
+        header.segment_rows = static_cast<uint32_t>((std::max(config.segment_rows, 64) + 63) / 64 * 64);
+        header.journal_id = newJournalId();
+        for (size_t c = 0; c < columns.size(); c++) {
+            strncpy(descs[c].name, columns[c].name.c_str(), sizeof(descs[c].name) - 1);
+            descs[c].type = static_cast<uint8_t>(columns[c].type);
+        }
+        slots[0].checksum = slotChecksum(slots[0]);
+
+        std::vector<uint8_t> page(JOURNAL_PAGE, 0);
+        memcpy(page.data(), &header, sizeof(header));
+        memcpy(page.data() + COLUMNS_OFFSET, descs.data(), descs.size() * sizeof(ColumnDesc));
+        memcpy(page.data() + SLOTS_OFFSET, slots, sizeof(slots));
+        if (pwrite(fd, page.data(), page.size(), 0) != static_cast<ssize_t>(page.size()) || fsync(fd) != 0) {
+            error = "Cannot initialise " + path + ": " + strerror(errno);
+            ::close(fd);
+            ::close(heap_fd);
+            return false;
+        }
+    } else {
+        bool valid = st.st_size >= static_cast<off_t>(JOURNAL_PAGE)
+                     && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+                     && memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0
+                     && header.version == JOURNAL_VERSION
+                     && header.column_count == columns.size()
+                     && pread(fd, descs.data(), descs.size() * sizeof(ColumnDesc), COLUMNS_OFFSET)
+                        == static_cast<ssize_t>(descs.size() * sizeof(ColumnDesc))
+                     && pread(fd, slots, sizeof(slots), SLOTS_OFFSET) == sizeof(slots);
+        for (size_t c = 0; valid && c < columns.size(); c++) {
+            valid = strncmp(descs[c].name, columns[c].name.c_str(), sizeof(descs[c].name)) == 0
+                    && descs[c].type == static_cast<uint8_t>(columns[c].type);
+        }
+        if (!valid) {
+            error = path + " is not a journal with these columns";
+            ::close(fd);
+            ::close(heap_fd);
+            return false;
+        }
+        if (header.journal_id == 0) {
+            header.journal_id = newJournalId();
+            if (pwrite(fd, &header.journal_id, sizeof(header.journal_id), offsetof(FileHeader, journal_id))
+                != sizeof(header.journal_id) || fsync(fd) != 0) {
+                error = "Cannot write the journal id of " + path + ": " + strerror(errno);
+                ::close(fd);
+                ::close(heap_fd);
+                return false;
+            }
+        }
+    }
+    char id[17];
+    snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(header.journal_id));
+    m_journal_id = id;
+
+    m_columns = columns;
+    m_config.segment_rows = static_cast<int>(header.segment_rows);
+    m_offsets.assign(columns.size(), 0);
+    m_value_index.assign(columns.size(), 0);
+    size_t offset = 0;
+    int n_text = 0, n_int = 0, n_real = 0;
+    for (size_t c = 0; c < columns.size(); c++) {
+        m_offsets[c] = offset;
+        offset += columnWidth(columns[c].type) * header.segment_rows;
+        m_value_index[c] = columns[c].type == JournalType::TEXT ? n_text++
+                         : columns[c].type == JournalType::REAL ? n_real++
+                         : n_int++;
+    }
+    m_segment_bytes = (offset + JOURNAL_PAGE - 1) / JOURNAL_PAGE * JOURNAL_PAGE;
+
+    // Newest slot whose checksum holds and whose counts fit the files
+    struct stat heap_st {};
+    fstat(heap_fd, &heap_st);
+    const uint64_t capacity = st.st_size > static_cast<off_t>(JOURNAL_PAGE)
+                              ? (st.st_size - JOURNAL_PAGE) / m_segment_bytes * header.segment_rows : 0;
+    const CommitSlot* best = nullptr;
+    for (const CommitSlot& slot : slots) {
+        bool ok = slot.checksum == slotChecksum(slot)
+                  && slot.rows <= capacity
+                  && slot.heap_bytes <= static_cast<uint64_t>(heap_st.st_size)
+                  && slot.sync_cursor <= slot.rows;
+        if (ok && (best == nullptr || slot.seq > best->seq)) {
+            best = &slot;
+        }
+    }
+    if (best == nullptr) {
+        error = path + ": no valid commit record";
+        ::close(fd);
+        ::close(heap_fd);
+        return false;
+    }
+
+    // Heap bytes past the commit belong to rows that never committed
+    if (static_cast<uint64_t>(heap_st.st_size) > best->heap_bytes) {
+        m_stats.dropped_heap_bytes = heap_st.st_size - best->heap_bytes;
+        if (ftruncate(heap_fd, best->heap_bytes) != 0) {
+            LOGW("Journal: cannot truncate heap tail: %s", strerror(errno));
+        }
+    }
+
+    m_fd = fd;
+    m_heap_fd = heap_fd;
+    m_seq = best->seq;
+    m_rows = m_committed_rows = best->rows;
+    m_heap_bytes = m_committed_heap = best->heap_bytes;
+    m_sync_cursor = best->sync_cursor;
+    m_oldest_pending_us = 0;
+    m_stats.recovered_rows = best->rows;
+
+    m_map_bytes = 0;
+    if (!mapRows(std::max<uint64_t>(m_rows, 1), error)) {
+        ::close(m_fd);
+        ::close(m_heap_fd);
+        m_fd = m_heap_fd = -1;
+        return false;
+    }
+
+    LOGI("Journal %s (%s): %llu rows (%llu unsynced), %zu columns, dropped %llu heap bytes",
+         path.c_str(), m_journal_id.c_str(), static_cast<unsigned long long>(m_rows),
+         static_cast<unsigned long long>(m_rows - m_sync_cursor), columns.size(),
+         static_cast<unsigned long long>(m_stats.dropped_heap_bytes));
+
+    if (m_config.group_ms > 0) {
+        m_stop_flusher = false;
+        m_flusher = std::thread(&ResultsJournal::runFlusher, this);
+    }
+    return true;
+}
+
+void ResultsJournal::close() {
+    stopFlusher();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0) {
+        return;
+    }
+    std::string error;
+    if (!commitLocked(error)) {
+        LOGE("Journal: final commit failed: %s", error.c_str());
+    }
+    if (m_map != nullptr) {
+        munmap(m_map, m_map_bytes);
+    }
+    ::close(m_fd);
+    ::close(m_heap_fd);
+    m_map = nullptr;
+    m_map_bytes = 0;
+    m_fd = m_heap_fd = -1;
+}
+
+void ResultsJournal::runFlusher() {
+    traceSetThreadName("journal_flusher");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop_flusher) {
+        if (m_oldest_pending_us == 0) {
+            m_flush_wake.wait(lock, [this]() { return m_stop_flusher || m_oldest_pending_us != 0; });
+            continue;
+        }
+        const int64_t due_us = m_oldest_pending_us + static_cast<int64_t>(m_config.group_ms) * 1000;
+        const int64_t now = traceNowUs();
+        if (now < due_us) {
+            m_flush_wake.wait_for(lock, std::chrono::microseconds(due_us - now));
+            continue;
+        }
+        std::string error;
+        if (!commitLocked(error)) {
+            LOGE("Journal: idle commit failed: %s", error.c_str());
+            // Retried with the next append
+            m_oldest_pending_us = 0;
+        }
+    }
+}
+
+void ResultsJournal::stopFlusher() {
+    if (!m_flusher.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop_flusher = true;
+    }
+    m_flush_wake.notify_all();
+    m_flusher.join();
+}
+
+// Grows the file by doubling its segment count and remaps it
+bool ResultsJournal::mapRows(uint64_t rows, std::string& error) {
+    const uint64_t segment_rows = m_config.segment_rows;
+    const uint64_t segments = (rows + segment_rows - 1) / segment_rows;
+    const size_t needed = JOURNAL_PAGE + segments * m_segment_bytes;
+    if (needed <= m_map_bytes) {
+        return true;
+    }
+
+    struct stat st {};
+    fstat(m_fd, &st);
+    size_t bytes = std::max(needed, static_cast<size_t>(st.st_size));
+    if (m_map_bytes > 0) {
+        const size_t current = (m_map_bytes - JOURNAL_PAGE) / m_segment_bytes;
+        bytes = std::max(bytes, JOURNAL_PAGE + current * 2 * m_segment_bytes);
+    }
+    if (bytes > static_cast<size_t>(st.st_size) && ftruncate(m_fd, bytes) != 0) {
+        error = "Cannot grow " + m_path + ": " + strerror(errno);
+        return false;
+    }
+
+    if (m_map != nullptr) {
+        munmap(m_map, m_map_bytes);
+        m_map = nullptr;
+    }
+    void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        error = "Cannot map " + m_path + ": " + strerror(errno);
+        m_map_bytes = 0;
+        return false;
+    }
+    m_map = static_cast<uint8_t*>(map);
+    m_map_bytes = bytes;
+    return true;
+}
+
+uint8_t* ResultsJournal::cell(int column, uint64_t row) const {
+    const uint64_t segment = row / m_config.segment_rows;
+    const uint64_t index = row % m_config.segment_rows;
+    return m_map + JOURNAL_PAGE + segment * m_segment_bytes + m_offsets[column]
+           + index * columnWidth(m_columns[column].type);
+}
+
+// ===============================================================
+// APPEND / COMMIT
+// ===============================================================
+bool ResultsJournal::append(const JournalRecord& record, std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0) {
+        error = "Journal not open";
+        return false;
+    }
+    const int64_t t0 = traceNowUs();
+
+    for (size_t c = 0; c < m_columns.size(); c++) {
+        const JournalType type = m_columns[c].type;
+        const size_t have = type == JournalType::TEXT ? record.texts.size()
+                          : type == JournalType::REAL ? record.reals.size()
+                          : record.ints.size();
+        if (static_cast<size_t>(m_value_index[c]) >= have) {
+            error = "Record has no value for " + m_columns[c].name;
+            return false;
+        }
+    }
+    if (!mapRows(m_rows + 1, error)) {
+        return false;
+    }
+
+    for (size_t c = 0; c < m_columns.size(); c++) {
+        uint8_t* dst = cell(static_cast<int>(c), m_rows);
+        const int v = m_value_index[c];
+        switch (m_columns[c].type) {
+            case JournalType::INT32:
+            case JournalType::BOOL: {
+                int32_t value = static_cast<int32_t>(record.ints[v]);
+                memcpy(dst, &value, sizeof(value));
+                break;
+            }
+            case JournalType::INT64:
+                memcpy(dst, &record.ints[v], sizeof(int64_t));
+                break;
+            case JournalType::REAL:
+                memcpy(dst, &record.reals[v], sizeof(double));
+                break;
+            case JournalType::TEXT: {
+                const std::string& text = record.texts[v];
+                const size_t length = std::min(text.size(), (size_t(1) << TEXT_LENGTH_BITS) - 1);
+                if (length > 0 && pwrite(m_heap_fd, text.data(), length, m_heap_bytes) != static_cast<ssize_t>(length)) {
+                    error = "Cannot write " + m_path + ".heap: " + strerror(errno);
+                    return false;
+                }
+                uint64_t ref = (m_heap_bytes << TEXT_LENGTH_BITS) | length;
+                memcpy(dst, &ref, sizeof(ref));
+                m_heap_bytes += length;
+                break;
+            }
+        }
+    }
+    m_rows++;
+
+    const int64_t now = traceNowUs();
+    m_stats.append_us += now - t0;
+    if (m_oldest_pending_us == 0) {
+        m_oldest_pending_us = now;
+        m_flush_wake.notify_all();
+    }
+    if (m_rows - m_committed_rows >= static_cast<uint64_t>(m_config.group_rows)
+        || now - m_oldest_pending_us >= static_cast<int64_t>(m_config.group_ms) * 1000) {
+        return commitLocked(error);
+    }
+    return true;
+}
+
+bool ResultsJournal::flush(std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0) {
+        error = "Journal not open";
+        return false;
+    }
+    return commitLocked(error);
+}
+
+// Data first, then the slot that makes it visible
+bool ResultsJournal::commitLocked(std::string& error) {
+    if (m_rows == m_committed_rows) {
+        return true;
+    }
+    SLM_TRACE_SCOPE("journal_commit");
+    const int64_t t0 = traceNowUs();
+
+    const uint64_t first_segment = m_committed_rows / m_config.segment_rows;
+    const uint64_t last_segment = (m_rows - 1) / m_config.segment_rows;
+    uint8_t* begin = m_map + JOURNAL_PAGE + first_segment * m_segment_bytes;
+    const size_t length = (last_segment - first_segment + 1) * m_segment_bytes;
+    if (msync(begin, length, MS_SYNC) != 0 || fdatasync(m_heap_fd) != 0) {
+        error = std::string("Journal sync failed: ") + strerror(errno);
+        return false;
+    }
+    if (!writeSlotLocked(error)) {
+        return false;
+    }
+    m_committed_rows = m_rows;
+    m_committed_heap = m_heap_bytes;
+    m_oldest_pending_us = 0;
+
+    const double us = static_cast<double>(traceNowUs() - t0);
+    m_stats.commits++;
+    m_stats.commit_us += us;
+    m_stats.commit_max_us = std::max(m_stats.commit_max_us, us);
+    return true;
+}
+
+// The slot not holding the current commit is overwritten, so a torn
+// write leaves the previous one intact
+bool ResultsJournal::writeSlotLocked(std::string& error) {
+    CommitSlot slot {};
+    slot.seq = m_seq + 1;
+    slot.rows = m_rows;
+    slot.heap_bytes = m_heap_bytes;
+    slot.sync_cursor = m_sync_cursor;
+    slot.checksum = slotChecksum(slot);
+
+    memcpy(m_map + SLOTS_OFFSET + (slot.seq & 1) * sizeof(CommitSlot), &slot, sizeof(slot));
+    if (msync(m_map, JOURNAL_PAGE, MS_SYNC) != 0) {
+        error = std::string("Journal commit failed: ") + strerror(errno);
+        return false;
+    }
+    m_seq = slot.seq;
+    return true;
+}
+
+// ===============================================================
+// READ / SCAN
+// ===============================================================
+uint64_t ResultsJournal::rows() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rows;
+}
+
+int ResultsJournal::columnIndex(const std::string& name) const {
+    for (size_t c = 0; c < m_columns.size(); c++) {
+        if (m_columns[c].name == name) {
+            return static_cast<int>(c);
+        }
+    }
+    return -1;
+}
+
+int64_t ResultsJournal::intAt(int column, uint64_t row) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint8_t* src = cell(column, row);
+    if (columnWidth(m_columns[column].type) == 4) {
+        int32_t value;
+        memcpy(&value, src, sizeof(value));
+        return value;
+    }
+    int64_t value;
+    memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+double ResultsJournal::realAt(int column, uint64_t row) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double value;
+    memcpy(&value, cell(column, row), sizeof(value));
+    return value;
+}
+
+std::string ResultsJournal::textAt(int column, uint64_t row) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return textAtLocked(column, row);
+}
+
+std::string ResultsJournal::textAtLocked(int column, uint64_t row) const {
+    uint64_t ref;
+    memcpy(&ref, cell(column, row), sizeof(ref));
+    std::string text(ref & ((uint64_t(1) << TEXT_LENGTH_BITS) - 1), '\0');
+    if (!text.empty() && pread(m_heap_fd, &text[0], text.size(), ref >> TEXT_LENGTH_BITS)
+                         != static_cast<ssize_t>(text.size())) {
+        return std::string();
+    }
+    return text;
+}
+
+void ResultsJournal::scan(int column, uint64_t from, uint64_t to,
+                          const std::function<void(const void*, size_t, uint64_t)>& fn) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    to = std::min(to, m_rows);
+    while (from < to) {
+        const uint64_t segment_end = (from / m_config.segment_rows + 1) * m_config.segment_rows;
+        const uint64_t end = std::min(to, segment_end);
+        fn(cell(column, from), static_cast<size_t>(end - from), from);
+        from = end;
+    }
+}
+
+template <typename T>
+static void accumulate(const T* values, size_t n, double& sum, double& lo, double& hi) {
+    // Separate reductions so the compiler can vectorise each loop
+    T mn = values[0], mx = values[0];
+    double s = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        s += static_cast<double>(values[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        mn = values[i] < mn ? values[i] : mn;
+        mx = values[i] > mx ? values[i] : mx;
+    }
+    sum += s;
+    lo = std::min(lo, static_cast<double>(mn));
+    hi = std::max(hi, static_cast<double>(mx));
+}
+
+JournalColumnStats ResultsJournal::columnStats(int column) const {
+    JournalColumnStats stats;
+    if (column < 0 || column >= static_cast<int>(m_columns.size())
+        || m_columns[column].type == JournalType::TEXT) {
+        return stats;
+    }
+    const int64_t t0 = traceNowUs();
+    const JournalType type = m_columns[column].type;
+    double lo = INFINITY, hi = -INFINITY;
+
+    uint64_t committed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        committed = m_committed_rows;
+    }
+    scan(column, 0, committed, [&](const void* values, size_t n, uint64_t) {
+        if (type == JournalType::REAL) {
+            accumulate(static_cast<const double*>(values), n, stats.sum, lo, hi);
+        } else if (type == JournalType::INT64) {
+            accumulate(static_cast<const int64_t*>(values), n, stats.sum, lo, hi);
+        } else {
+            accumulate(static_cast<const int32_t*>(values), n, stats.sum, lo, hi);
+        }
+        stats.rows += n;
+    });
+    if (stats.rows > 0) {
+        stats.min = lo;
+        stats.max = hi;
+    }
+    stats.scan_us = static_cast<double>(traceNowUs() - t0);
+    return stats;
+}
+
+// ===============================================================
+// EXPORT
+// ===============================================================
+static void appendJsonString(std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+static void appendCsvField(std::string& out, const std::string& s) {
+    if (s.find_first_of(",\"\n\r") == std::string::npos) {
+        out += s;
+        return;
+    }
+    out += '"';
+    for (char c : s) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+static void appendReal(std::string& out, double value, const char* non_finite) {
+    if (!std::isfinite(value)) {
+        out += non_finite;
+        return;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.10g", value);
+    out += buf;
+}
+
+std::string ResultsJournal::jsonRowLocked(uint64_t row) const {
+    std::string line = "{";
+    for (size_t c = 0; c < m_columns.size(); c++) {
+        if (c > 0) {
+            line += ',';
+        }
+        appendJsonString(line, m_columns[c].name);
+        line += ':';
+        const uint8_t* src = cell(static_cast<int>(c), row);
+        switch (m_columns[c].type) {
+            case JournalType::INT32: {
+                int32_t value;
+                memcpy(&value, src, sizeof(value));
+                line += std::to_string(value);
+                break;
+            }
+            case JournalType::BOOL: {
+                int32_t value;
+                memcpy(&value, src, sizeof(value));
+                line += value ? "true" : "false";
+                break;
+            }
+            case JournalType::INT64: {
+                int64_t value;
+                memcpy(&value, src, sizeof(value));
+                line += std::to_string(value);
+                break;
+            }
+            case JournalType::REAL: {
+                double value;
+                memcpy(&value, src, sizeof(value));
+                appendReal(line, value, "null");
+                break;
+            }
+            case JournalType::TEXT:
+                appendJsonString(line, textAtLocked(static_cast<int>(c), row));
+                break;
+        }
+    }
+    line += "}\n";
+    return line;
+}
+
+std::string ResultsJournal::jsonlRows(uint64_t from, uint64_t to) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string out;
+    for (uint64_t row = from; row < std::min(to, m_rows); row++) {
+        out += jsonRowLocked(row);
+    }
+    return out;
+}
+
+bool ResultsJournal::exportJsonl(FILE* out, uint64_t from, uint64_t to) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (uint64_t row = from; row < std::min(to, m_rows); row++) {
+        const std::string line = jsonRowLocked(row);
+        if (fwrite(line.data(), 1, line.size(), out) != line.size()) {
+            return false;
+        }
+    }
+    return fflush(out) == 0;
+}
+
+bool ResultsJournal::exportCsv(FILE* out, uint64_t from, uint64_t to) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string line;
+    for (size_t c = 0; c < m_columns.size(); c++) {
+        line += c > 0 ? "," : "";
+        appendCsvField(line, m_columns[c].name);
+    }
+    line += '\n';
+    if (fwrite(line.data(), 1, line.size(), out) != line.size()) {
+        return false;
+    }
+
+    for (uint64_t row = from; row < std::min(to, m_rows); row++) {
+        line.clear();
+        for (size_t c = 0; c < m_columns.size(); c++) {
+            line += c > 0 ? "," : "";
+            const uint8_t* src = cell(static_cast<int>(c), row);
+            switch (m_columns[c].type) {
+                case JournalType::INT32:
+                case JournalType::BOOL: {
+                    int32_t value;
+                    memcpy(&value, src, sizeof(value));
+                    line += std::to_string(value);
+                    break;
+                }
+                case JournalType::INT64: {
+                    int64_t value;
+                    memcpy(&value, src, sizeof(value));
+                    line += std::to_string(value);
+                    break;
+                }
+                case JournalType::REAL: {
+                    double value;
+                    memcpy(&value, src, sizeof(value));
+                    appendReal(line, value, "");
+                    break;
+                }
+                case JournalType::TEXT:
+                    appendCsvField(line, textAtLocked(static_cast<int>(c), row));
+                    break;
+            }
+        }
+        line += '\n';
+        if (fwrite(line.data(), 1, line.size(), out) != line.size()) {
+            return false;
+        }
+    }
+    return fflush(out) == 0;
+}
+
+// ===============================================================
+// SYNC CURSOR
+// ===============================================================
+uint64_t ResultsJournal::syncCursor() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sync_cursor;
+}
+
+uint64_t ResultsJournal::pendingSync() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_committed_rows - m_sync_cursor;
+}
+
+bool ResultsJournal::acknowledgeSync(uint64_t row, std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0) {
+        error = "Journal not open";
+        return false;
+    }
+    // Only committed rows can have been exported for upload
+    row = std::min(row, m_committed_rows);
+    if (row <= m_sync_cursor) {
+        return true;
+    }
+    m_sync_cursor = row;
+    if (m_rows != m_committed_rows) {
+        return commitLocked(error);
+    }
+    return writeSlotLocked(error);
+}
+
+JournalStats ResultsJournal::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    JournalStats stats = m_stats;
+    stats.rows = m_rows;
+    stats.committed_rows = m_committed_rows;
+    stats.sync_cursor = m_sync_cursor;
+    stats.heap_bytes = m_heap_bytes;
+    return stats;
+}
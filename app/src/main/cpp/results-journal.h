@@ -0,0 +1,187 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ===============================================================
+// RESULTS JOURNAL
+// Append-only store for per-item results, replacing one Firestore
+// write per item. The data file is memory-mapped and columnar: rows
+// are grouped into fixed-size segments, and inside a segment every
+// column is one contiguous fixed-width array, so a column scan is a
+// plain loop over int64 / double values. Text values live in a
+// separate append-only heap file; a text cell holds its heap offset
+// and length.
+//
+// Appends only touch the mapping. A group commit (every N rows, T ms
+// after the oldest uncommitted row even if no append follows, and on
+// flush/close) msyncs the dirty segments and fdatasyncs
+// the heap, then writes the row count into one of two checksummed
+// commit slots in the header page. Recovery picks the newest valid
+// slot, so a crash loses at most the rows since the last commit and
+// never a half-written row.
+//
+// A persisted sync cursor marks the rows an uploader has already
+// delivered; pending rows are exported as JSONL and acknowledged
+// once the remote write succeeds. The random journal id, fixed at
+// creation, plus a row index names a row remotely, so re-uploading
+// rows after a crash overwrites them instead of duplicating them.
+// ===============================================================
+
+enum class JournalType : uint8_t {
+    INT32 = 1,
+    INT64 = 2,
+    REAL = 3,       // double
+    TEXT = 4,       // heap reference
+    BOOL = 5,       // stored as int32, exported as true / false
+};
+
+struct JournalColumn {
+    std::string name;
+    JournalType type;
+};
+
+// PredictionResult's fields, in declaration order and named as
+// saveToFirebase names them
+const std::vector<JournalColumn>& predictionResultColumns();
+
+struct JournalConfig {
+    int group_rows = 32;        // commit after this many appends ...
+    int group_ms = 2000;        // ... or once the oldest uncommitted row is this old, appended to or not
+    int segment_rows = 1024;    // rows per columnar segment (new files only)
+};
+
+// One row, values in column order per type: texts for TEXT columns,
+// ints for INT32 / INT64 / BOOL columns, reals for REAL columns
+struct JournalRecord {
+    std::vector<std::string> texts;
+    std::vector<int64_t> ints;
+    std::vector<double> reals;
+};
+
+struct JournalColumnStats {
+    uint64_t rows = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double scan_us = 0.0;
+
+    double mean() const { return rows > 0 ? sum / rows : 0.0; }
+    // "ROWS=..;SUM=..;MEAN=..;MIN=..;MAX=..;SCAN_US=.."
+    std::string toString() const;
+};
+
+struct JournalStats {
+    uint64_t rows = 0;              // appended, committed or not
+    uint64_t committed_rows = 0;
+    uint64_t sync_cursor = 0;
+    uint64_t heap_bytes = 0;
+    uint64_t recovered_rows = 0;    // committed rows found at open
+    uint64_t dropped_heap_bytes = 0;    // uncommitted heap tail cut at open
+    long commits = 0;
+    double commit_us = 0.0;         // total
+    double commit_max_us = 0.0;
+    double append_us = 0.0;         // total
+
+    // "ROWS=..;COMMITTED=..;SYNC_CURSOR=..;PENDING_SYNC=..;HEAP_KB=..;
+    //  RECOVERED=..;DROPPED_HEAP_BYTES=..;COMMITS=..;COMMIT_MEAN_US=..;
+    //  COMMIT_MAX_US=..;APPEND_MEAN_US=.."
+    std::string toString() const;
+};
+
+class ResultsJournal {
+public:
+    ~ResultsJournal() { close(); }
+
+    // Creates path (and path + ".heap") with the given columns, or
+    // reopens and recovers an existing journal, which must have the
+    // same columns
+    bool open(const std::string& path, const std::vector<JournalColumn>& columns,
+              const JournalConfig& config, std::string& error);
+    // Commits pending rows and unmaps
+    void close();
+    bool isOpen() const { return m_fd >= 0; }
+    // Random, fixed when the file is created; 16 hex digits
+    std::string journalId() const { return m_journal_id; }
+
+    bool append(const JournalRecord& record, std::string& error);
+    // Group commit now
+    bool flush(std::string& error);
+
+    uint64_t rows() const;
+    const std::vector<JournalColumn>& columns() const { return m_columns; }
+    int columnIndex(const std::string& name) const;
+
+    // Cell reads; row < rows()
+    int64_t intAt(int column, uint64_t row) const;
+    double realAt(int column, uint64_t row) const;
+    std::string textAt(int column, uint64_t row) const;
+
+    // Calls fn once per segment with the column's contiguous values
+    // (int32_t, int64_t or double per the column type) for rows
+    // [from, to)
+    void scan(int column, uint64_t from, uint64_t to,
+              const std::function<void(const void* values, size_t count, uint64_t first_row)>& fn) const;
+    // Sum / min / max of a numeric column over committed rows
+    JournalColumnStats columnStats(int column) const;
+
+    // Rows [from, to) with a header line for CSV; to is clamped to rows()
+    bool exportCsv(FILE* out, uint64_t from, uint64_t to) const;
+    bool exportJsonl(FILE* out, uint64_t from, uint64_t to) const;
+    std::string jsonlRows(uint64_t from, uint64_t to) const;
+
+    // Committed rows not yet acknowledged by the uploader
+    uint64_t syncCursor() const;
+    uint64_t pendingSync() const;
+    // Marks rows below row as uploaded; persisted with the next
+    // commit slot, written immediately
+    bool acknowledgeSync(uint64_t row, std::string& error);
+
+    JournalStats stats() const;
+
+private:
+    bool mapRows(uint64_t rows, std::string& error);
+    // Commits rows group_ms after the oldest of them was appended
+    void runFlusher();
+    void stopFlusher();
+    bool commitLocked(std::string& error);
+    bool writeSlotLocked(std::string& error);
+    uint8_t* cell(int column, uint64_t row) const;
+    std::string textAtLocked(int column, uint64_t row) const;
+    std::string jsonRowLocked(uint64_t row) const;
+
+    std::vector<JournalColumn> m_columns;
+    std::vector<size_t> m_offsets;      // column start inside a segment
+    std::vector<int> m_value_index;     // index into the record's texts / ints / reals
+    JournalConfig m_config;
+    std::string m_path;
+    size_t m_segment_bytes = 0;
+
+    int m_fd = -1;
+    int m_heap_fd = -1;
+    uint8_t* m_map = nullptr;
+    size_t m_map_bytes = 0;
+
+    uint64_t m_rows = 0;
+    uint64_t m_committed_rows = 0;
+    uint64_t m_heap_bytes = 0;
+    uint64_t m_committed_heap = 0;
+    uint64_t m_sync_cursor = 0;
+    uint64_t m_seq = 0;
+    int64_t m_oldest_pending_us = 0;
+
+    std::string m_journal_id;
+
+    JournalStats m_stats;
+    mutable std::mutex m_mutex;
+
+    std::thread m_flusher;
+    std::condition_variable m_flush_wake;
+    bool m_stop_flusher = false;
+};
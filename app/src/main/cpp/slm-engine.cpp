@@ -0,0 +1,979 @@
+#include "slm-engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+#ifndef __ANDROID__
+bool g_slm_log_verbose = false;
+#endif
+
+static std::mutex g_backend_mutex;
+static int g_backend_refs = 0;
+
+bool isGemmaModelPath(const std::string& model_path) {
+    return model_path.find("Gemma") != std::string::npos ||
+           model_path.find("gemma") != std::string::npos ||
+           model_path.find("Vikhr") != std::string::npos;
+}
+
+static const struct {
+    const char* name;
+    ggml_type type;
+} KV_CACHE_TYPES[] = {
+        {"f32", GGML_TYPE_F32}, {"f16", GGML_TYPE_F16}, {"bf16", GGML_TYPE_BF16},
+        {"q8_0", GGML_TYPE_Q8_0}, {"q4_0", GGML_TYPE_Q4_0}, {"q4_1", GGML_TYPE_Q4_1},
+        {"q5_0", GGML_TYPE_Q5_0}, {"q5_1", GGML_TYPE_Q5_1}, {"iq4_nl", GGML_TYPE_IQ4_NL},
+};
+
+bool parseKvCacheType(const std::string& name, ggml_type& type) {
+    for (const auto& entry : KV_CACHE_TYPES) {
+        if (name == entry.name) {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* kvCacheTypeName(ggml_type type) {
+    for (const auto& entry : KV_CACHE_TYPES) {
+        if (entry.type == type) {
+            return entry.name;
+        }
+    }
+    return "?";
+}
+
+bool parseFlashAttnType(const std::string& name, llama_flash_attn_type& type) {
+    if (name == "auto") {
+        type = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    } else if (name == "on") {
+        type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    } else if (name == "off") {
+        type = LLAMA_FLASH_ATTN_TYPE_DISABLED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* flashAttnTypeName(llama_flash_attn_type type) {
+    switch (type) {
+        case LLAMA_FLASH_ATTN_TYPE_AUTO:     return "auto";
+        case LLAMA_FLASH_ATTN_TYPE_ENABLED:  return "on";
+        case LLAMA_FLASH_ATTN_TYPE_DISABLED: return "off";
+    }
+    return "?";
+}
+
+bool parseDecodeMode(const std::string& name, DecodeMode& mode) {
+    if (name == "newline") {
+        mode = DecodeMode::STOP_AT_NEWLINE;
+    } else if (name == "eog") {
+        mode = DecodeMode::UNTIL_EOG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* decodeModeName(DecodeMode mode) {
+    switch (mode) {
+        case DecodeMode::STOP_AT_NEWLINE: return "newline";
+        case DecodeMode::UNTIL_EOG:       return "eog";
+    }
+    return "?";
+}
+
+// ===============================================================
+// PURE MINIMAL ZERO-SHOT PROMPT
+// NO definitions, NO examples, SAME format for all models
+// ===============================================================
+std::string createAllergenPrompt(const std::string& ingredients, bool gemma, const std::string& hints) {
+    std::stringstream ss;
+
+    if (gemma) {
+        LOGI("Using Gemma pure zero-shot prompt");
+
+        ss << "<start_of_turn>user\n"
+           << "You are a food allergen detector.\n"
+           << "\n"
+           << "Your task: Analyze the ingredients and detect which allergens are present.\n"
+           << "\n"
+           << "Allergen categories to check: milk, egg, peanut, tree nut, wheat, soy, fish, shellfish, sesame\n"
+           << "\n"
+           << "Instructions:\n"
+           << "- Only output allergens that are actually present in the ingredients\n"
+           << "- Use lowercase letters\n"
+           << "- Separate multiple allergens with commas\n"
+           << "- If no allergens found, output: none\n"
+           << "\n";
+
+        if (!hints.empty()) {
+            ss << "Keyword hints (may be incomplete): " << hints << "\n";
+        }
+
+        ss << "Ingredients: " << ingredients << "\n"
+           << "Allergens:<end_of_turn>\n"
+           << "<start_of_turn>model\n";
+
+        return ss.str();
+    } else {
+        LOGI("Using ChatML pure zero-shot prompt");
+
+        ss << "<|im_start|>system\n"
+           << "You are a food allergen detector.\n"
+           << "\n"
+           << "Your task: Analyze the ingredients and detect which allergens are present.\n"
+           << "\n"
+           << "Allergen categories to check: milk, egg, peanut, tree nut, wheat, soy, fish, shellfish, sesame\n"
+           << "\n"
+           << "Instructions:\n"
+           << "- Only output allergens that are actually present in the ingredients\n"
+           << "- Use lowercase letters\n"
+           << "- Separate multiple allergens with commas\n"
+           << "- If no allergens found, output: none\n"
+           << "<|im_end|>\n"
+           << "<|im_start|>user\n";
+
+        if (!hints.empty()) {
+            ss << "Keyword hints (may be incomplete): " << hints << "\n";
+        }
+
+        ss << "Ingredients: " << ingredients << "\n"
+           << "Allergens:<|im_end|>\n"
+           << "<|im_start|>assistant\n";
+
+        return ss.str();
+    }
+}
+
+std::string PredictionOutput::formatted() const {
+    SLM_TRACE_SCOPE("format_result");
+    if (!ok) {
+        return "ERROR|" + error;
+    }
+
+    std::stringstream final_result;
+    final_result << "TTFT_MS=" << ttft_ms
+                 << ";ITPS=" << itps
+                 << ";OTPS=" << otps
+                 << ";OET_MS=" << oet_ms
+                 << ";" << phaseMetricsString()
+                 << ";LABELS=" << (!token_labels ? "TEXT" : label_fallback ? "FALLBACK" : "TOKEN");
+    if (!adapter.empty() || adapter_switched) {
+        char buf[96];
+        snprintf(buf, sizeof(buf), ";ADAPTER_SCALE=%.2f;ADAPTER_SWITCH_MS=%.3f", adapter_scale, adapter_switch_ms);
+        final_result << ";ADAPTER=" << (adapter.empty() ? "base" : adapter) << buf;
+    }
+    if (prefix_cached) {
+        final_result << ";PREFIX_REUSED=" << prefix_reused_tokens;
+    }
+    final_result << "|" << text;
+    return final_result.str();
+}
+
+std::string PredictionOutput::phaseMetricsString() const {
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "PREP_MS=%.2f;PREFILL_DECODE_MS=%.2f;GEN_MS=%.2f;PREFILL_TPS=%.2f;DECODE_TPS=%.2f;"
+             "LLAMA_LOAD_MS=%.2f;LLAMA_P_EVAL_MS=%.2f;LLAMA_N_P_EVAL=%d;LLAMA_EVAL_MS=%.2f;LLAMA_N_EVAL=%d",
+             prep_us / 1000.0, prefill_decode_us / 1000.0, gen_us / 1000.0, prefill_tps, decode_tps,
+             llama_load_ms, llama_p_eval_ms, llama_n_p_eval, llama_eval_ms, llama_n_eval);
+    return buf;
+}
+
+// ===============================================================
+// SESSION LIFETIME
+// ===============================================================
+void engineBackendAcquire() {
+    std::lock_guard<std::mutex> lock(g_backend_mutex);
+    if (g_backend_refs++ == 0) {
+        llama_backend_init();
+    }
+}
+
+void engineBackendRelease() {
+    std::lock_guard<std::mutex> lock(g_backend_mutex);
+    if (g_backend_refs > 0 && --g_backend_refs == 0) {
+        llama_backend_free();
+    }
+}
+
+bool loadEngineSession(EngineSession& session, const std::string& model_path,
+                       const EngineConfig& config) {
+    session.model_path = model_path;
+    session.gemma = isGemmaModelPath(model_path);
+
+    if (session.gemma) {
+        LOGI("✓ Detected: GEMMA model");
+    } else {
+        LOGI("✓ Detected: Llama/Qwen/Phi model");
+    }
+
+    SLM_TRACE_SCOPE("load_session");
+    {
+        SLM_TRACE_SCOPE("backend_init");
+        engineBackendAcquire();
+    }
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 0;
+    model_params.use_mmap = config.use_mmap;
+    model_params.use_mlock = config.use_mlock;
+
+    session.mem_before_model = readMemorySnapshot("");
+    {
+        SLM_TRACE_SCOPE("model_load");
+        session.model = llama_model_load_from_file(model_path.c_str(), model_params);
+    }
+    session.mem_after_model = readMemorySnapshot("");
+
+    if (session.model == nullptr) {
+        LOGE("Failed to load model");
+        engineBackendRelease();
+        return false;
+    }
+    session.labels.build(llama_model_get_vocab(session.model));
+
+    if (!recreateEngineContext(session, config)) {
+        llama_model_free(session.model);
+        session.model = nullptr;
+        engineBackendRelease();
+        return false;
+    }
+
+    return true;
+}
+
+bool recreateEngineContext(EngineSession& session, const EngineConfig& config) {
+    if (session.model == nullptr) {
+        return false;
+    }
+
+    SLM_TRACE_SCOPE("create_context");
+    if (session.ctx != nullptr) {
+        llama_free(session.ctx);
+        session.ctx = nullptr;
+    }
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = config.n_ctx;
+    ctx_params.n_batch = config.n_batch;
+    ctx_params.n_threads = config.n_threads;
+    if (config.n_ubatch > 0) {
+        ctx_params.n_ubatch = config.n_ubatch;
+    }
+    if (config.n_threads_batch > 0) {
+        ctx_params.n_threads_batch = config.n_threads_batch;
+    }
+    // One cache across the sequences, so forked prefixes share cells
+    ctx_params.n_seq_max = std::max(1, config.n_seq_max);
+    ctx_params.kv_unified = true;
+    ctx_params.type_k = config.type_k;
+    ctx_params.type_v = config.type_v;
+    ctx_params.flash_attn_type = config.flash_attn;
+    // llama_perf_context returns zeros unless timings are collected
+    ctx_params.no_perf = false;
+
+    session.mem_before_ctx = readMemorySnapshot("");
+    session.ctx = llama_init_from_model(session.model, ctx_params);
+    session.mem_after_ctx = readMemorySnapshot("");
+    session.prefix_cache.reset(nullptr);
+
+    if (session.ctx == nullptr) {
+        LOGE("Failed to create context");
+        return false;
+    }
+
+    if (!session.adapters.reapply(session.ctx)) {
+        LOGW("Could not reapply LoRA adapter '%s'", session.adapters.activeId().c_str());
+    }
+
+    session.config = config;
+    return true;
+}
+
+void freeEngineSession(EngineSession& session) {
+    SLM_TRACE_SCOPE("free_session");
+    bool had_model = session.model != nullptr;
+
+    if (session.embd_ctx != nullptr) {
+        llama_free(session.embd_ctx);
+        session.embd_ctx = nullptr;
+    }
+    if (session.ctx != nullptr) {
+        llama_free(session.ctx);
+        session.ctx = nullptr;
+    }
+
+    session.adapters.freeAll();
+    session.prefix_cache = PrefixCache();
+    if (session.model != nullptr) {
+        llama_model_free(session.model);
+        session.model = nullptr;
+    }
+
+    if (had_model) {
+        engineBackendRelease();
+    }
+
+    session.model_path.clear();
+    session.gemma = false;
+    session.labels = LabelDecoder();
+}
+
+void clearEngineMemory(EngineSession& session) {
+    SLM_TRACE_SCOPE("clear_memory");
+    if (session.ctx != nullptr) {
+        llama_memory_clear(llama_get_memory(session.ctx), true);
+    }
+    session.prefix_cache.reset(nullptr);
+}
+
+bool enablePrefixCache(EngineSession& session, const PrefixCacheConfig& config, std::string& error) {
+    if (!session.loaded()) {
+        error = "Model not loaded";
+        return false;
+    }
+    if (config.n_seq <= 1) {
+        session.prefix_cache.reset(llama_get_memory(session.ctx));
+        session.prefix_cache.configure(PrefixCacheConfig{1, 0});
+        return true;
+    }
+
+    if (session.config.n_seq_max < config.n_seq) {
+        EngineConfig engine = session.config;
+        engine.n_seq_max = config.n_seq;
+        if (!recreateEngineContext(session, engine)) {
+            error = "Could not create a context with " + std::to_string(config.n_seq) + " sequences";
+            return false;
+        }
+    }
+    if (static_cast<int>(llama_n_seq_max(session.ctx)) < config.n_seq) {
+        error = "Context has " + std::to_string(llama_n_seq_max(session.ctx)) + " sequences";
+        return false;
+    }
+
+    PrefixCacheConfig applied = config;
+    const int room = static_cast<int>(llama_n_ctx(session.ctx)) - static_cast<int>(llama_n_batch(session.ctx));
+    applied.max_cells = std::max(0, std::min(config.max_cells, room));
+    clearEngineMemory(session);
+    session.prefix_cache.configure(applied);
+    LOGI("Prefix cache: %d sequences, %d cells", applied.n_seq, applied.max_cells);
+    return true;
+}
+
+MemoryBreakdown engineMemoryBreakdown(EngineSession& session) {
+    const double MIB = 1024.0 * 1024.0;
+    MemoryBreakdown m;
+    if (!session.loaded()) {
+        return m;
+    }
+
+    MemorySnapshot now = readMemorySnapshot(session.model_path);
+    m.rss_mb = now.rss_kb / 1024.0;
+    m.pss_mb = now.pss_kb / 1024.0;
+    m.swap_mb = now.swap_kb / 1024.0;
+    m.peak_rss_mb = now.hwm_kb / 1024.0;
+
+    m.weights_file_mb = llama_model_size(session.model) / MIB;
+    m.weights_mapped_mb = now.model_size_kb / 1024.0;
+    m.weights_resident_mb = now.model_rss_kb / 1024.0;
+    long weights_anon_kb = std::max(0L, session.mem_after_model.anon_kb - session.mem_before_model.anon_kb);
+    m.weights_anon_mb = weights_anon_kb / 1024.0;
+
+    m.kv_cache_mb = estimateKvCacheMb(session.model, llama_n_ctx(session.ctx), session.config.type_k, session.config.type_v);
+    // Distinct cells: prefix cache branches share their prefix cells,
+    // so the tree counts them; otherwise items run on sequence 0
+    llama_memory_t mem = llama_get_memory(session.ctx);
+    const int cells = session.prefix_cache.enabled() ? session.prefix_cache.cellsInUse(mem)
+                                                     : llama_memory_seq_pos_max(mem, 0) + 1;
+    uint32_t n_ctx = llama_n_ctx(session.ctx);
+    if (cells > 0 && n_ctx > 0) {
+        m.kv_used_mb = m.kv_cache_mb * cells / n_ctx;
+    }
+    m.state_mb = llama_state_get_size(session.ctx) / MIB;
+
+    // llama clears the KV buffers at creation, so they are resident
+    // and part of the context's anonymous growth
+    long ctx_anon_kb = std::max(0L, session.mem_after_ctx.anon_kb - session.mem_before_ctx.anon_kb);
+    m.compute_mb = std::max(0.0, ctx_anon_kb / 1024.0 - m.kv_cache_mb);
+    m.other_mb = std::max(0L, now.anon_kb - weights_anon_kb - ctx_anon_kb) / 1024.0;
+    m.growth_mb = (now.anon_kb - session.mem_after_ctx.anon_kb) / 1024.0;
+    return m;
+}
+
+WarmupReport warmupEngineSession(EngineSession& session, const WarmupConfig& config) {
+    SLM_TRACE_SCOPE("warmup");
+    const double MIB = 1024.0 * 1024.0;
+    WarmupReport report;
+    if (!session.loaded()) {
+        return report;
+    }
+
+    const int64_t t0 = traceNowUs();
+    rusage usage_before{}, round_before{}, usage_after{};
+    getrusage(RUSAGE_SELF, &usage_before);
+
+    std::vector<MappedRange> ranges = findFileMappings(session.model_path);
+    report.mapped_mb = mappedBytes(ranges) / MIB;
+    report.resident_before_mb = residentBytes(ranges) / MIB;
+
+    WeightPrefetcher prefetcher;
+    if (config.prefetch && !ranges.empty()) {
+        prefetcher.start(ranges);
+    }
+
+    report.ok = true;
+    if (config.decode) {
+        // A real prompt through the normal path, so the graphs and
+        // buffers reserved are the ones timed runs will use
+        PredictionOptions options;
+        options.max_tokens = std::max(1, config.decode_steps);
+        options.clear_memory = true;
+        options.decode_mode = DecodeMode::UNTIL_EOG;
+
+        llama_set_warmup(session.ctx, true);
+        for (int round = 0; round < std::max(1, config.max_rounds); round++) {
+            getrusage(RUSAGE_SELF, &round_before);
+            PredictionOutput out = runAllergenPrediction(session, "wheat flour, water, salt", options);
+            getrusage(RUSAGE_SELF, &usage_after);
+            report.rounds++;
+            report.decode_ms += out.total_us / 1000.0;
+            report.last_round_major_faults = usage_after.ru_majflt - round_before.ru_majflt;
+            if (!out.ok) {
+                LOGW("Warmup prediction failed: %s", out.error.c_str());
+                report.ok = false;
+                break;
+            }
+            // Counters are process-wide: a round only proves the model
+            // hot once the prefetcher is done
+            prefetcher.join();
+            if (report.last_round_major_faults == 0 && (round > 0 || !config.prefetch)) {
+                break;
+            }
+        }
+        llama_set_warmup(session.ctx, false);
+        clearEngineMemory(session);
+    }
+
+    prefetcher.join();
+    report.prefetch_ms = prefetcher.elapsedMs();
+    report.pages_prefetched = prefetcher.pagesTouched();
+    getrusage(RUSAGE_SELF, &usage_after);
+    report.major_faults = usage_after.ru_majflt - usage_before.ru_majflt;
+    report.minor_faults = usage_after.ru_minflt - usage_before.ru_minflt;
+    report.resident_after_mb = residentBytes(ranges) / MIB;
+
+    bool resident = report.residentFraction() >= config.hot_fraction;
+    bool fault_free = !config.decode || report.last_round_major_faults == 0;
+    report.hot = report.ok && resident && fault_free;
+    report.total_ms = (traceNowUs() - t0) / 1000.0;
+
+    llama_perf_context_reset(session.ctx);
+    LOGI("Warmup: %s", report.toString().c_str());
+    return report;
+}
+
+// ===============================================================
+// EMBEDDINGS
+// ===============================================================
+static const int EMBED_CTX = 512;      // ingredient lists are far shorter
+
+bool embedIngredients(EngineSession& session, const std::string& ingredients,
+                      std::vector<float>& embedding, int& n_tokens, std::string& error) {
+    if (session.model == nullptr) {
+        error = "Model not loaded";
+        return false;
+    }
+
+    if (session.embd_ctx == nullptr) {
+        SLM_TRACE_SCOPE("create_embd_context");
+        llama_context_params params = llama_context_default_params();
+        params.n_ctx = EMBED_CTX;
+        params.n_batch = EMBED_CTX;
+        params.n_ubatch = EMBED_CTX;
+        params.n_threads = session.config.n_threads;
+        if (session.config.n_threads_batch > 0) {
+            params.n_threads_batch = session.config.n_threads_batch;
+        }
+        params.embeddings = true;
+        params.pooling_type = LLAMA_POOLING_TYPE_MEAN;
+        session.embd_ctx = llama_init_from_model(session.model, params);
+        if (session.embd_ctx == nullptr) {
+            error = "Failed to create embedding context";
+            return false;
+        }
+    }
+
+    SLM_TRACE_SCOPE("embed");
+    const llama_vocab* vocab = llama_model_get_vocab(session.model);
+    std::vector<llama_token> tokens(EMBED_CTX);
+    n_tokens = llama_tokenize(vocab, ingredients.c_str(), ingredients.length(), tokens.data(), EMBED_CTX, true, false);
+    if (n_tokens < 0) {
+        // Longer than the context: keep the head of the list
+        tokens.resize(-n_tokens);
+        llama_tokenize(vocab, ingredients.c_str(), ingredients.length(), tokens.data(), -n_tokens, true, false);
+        n_tokens = EMBED_CTX;
+    }
+    if (n_tokens == 0) {
+        error = "Empty ingredient text";
+        return false;
+    }
+
+    llama_memory_clear(llama_get_memory(session.embd_ctx), true);
+    if (llama_decode(session.embd_ctx, llama_batch_get_one(tokens.data(), n_tokens)) != 0) {
+        error = "Embedding decode failed";
+        return false;
+    }
+    const float* pooled = llama_get_embeddings_seq(session.embd_ctx, 0);
+    if (pooled == nullptr) {
+        error = "No pooled embedding";
+        return false;
+    }
+    embedding.assign(pooled, pooled + llama_model_n_embd(session.model));
+    return true;
+}
+
+// ===============================================================
+// PREDICT ALLERGENS
+// ===============================================================
+// Tokens at consecutive positions of one sequence, logits for the last
+static void fillSequenceBatch(llama_batch& batch, const llama_token* tokens, int n_tokens,
+                              llama_pos pos, llama_seq_id seq) {
+    batch.n_tokens = n_tokens;
+    for (int i = 0; i < n_tokens; i++) {
+        batch.token[i] = tokens[i];
+        batch.pos[i] = pos + i;
+        batch.n_seq_id[i] = 1;
+        batch.seq_id[i][0] = seq;
+        batch.logits[i] = i == n_tokens - 1;
+    }
+}
+
+// Prefix cache sequence of one prediction: cached once the prompt is
+// in, dropped on a failure, and its batch freed, on every return
+struct PrefixLeaseScope {
+    PrefixCache& cache;
+    llama_memory_t mem;
+    const std::vector<llama_token>& tokens;
+    PrefixLease lease;
+    llama_batch batch = {};
+    bool prefilled = false;
+    double prefill_us = 0.0;
+
+    PrefixLeaseScope(PrefixCache& cache, llama_memory_t mem, const std::vector<llama_token>& tokens)
+            : cache(cache), mem(mem), tokens(tokens) {
+        lease = cache.acquire(mem, tokens);
+        if (lease.active()) {
+            batch = llama_batch_init(static_cast<int32_t>(tokens.size()) - lease.length, 0, 1);
+        }
+    }
+
+    ~PrefixLeaseScope() {
+        if (!lease.active()) {
+            return;
+        }
+        if (prefilled) {
+            cache.release(mem, lease, tokens, prefill_us);
+        } else {
+            cache.discard(mem, lease);
+        }
+        llama_batch_free(batch);
+    }
+};
+
+PredictionOutput runAllergenPrediction(EngineSession& session, const std::string& ingredients,
+                                       const PredictionOptions& options) {
+
+    SLM_TRACE_SCOPE("predict");
+    auto t_start = std::chrono::high_resolution_clock::now();
+    bool first_token_seen = false;
+
+    PredictionOutput out;
+    out.t_begin_us = traceNowUs();
+
+    if (!session.loaded()) {
+        LOGE("Model not loaded!");
+        out.error = "Model not loaded";
+        return out;
+    }
+
+    std::string adapter_error;
+    if (!session.adapters.activate(session.ctx, options.adapter, options.adapter_scale,
+                                   out.adapter_switched, out.adapter_switch_ms, adapter_error)) {
+        LOGE("Adapter: %s", adapter_error.c_str());
+        out.error = "Adapter: " + adapter_error;
+        return out;
+    }
+    out.adapter = session.adapters.activeId();
+    out.adapter_scale = session.adapters.activeScale();
+
+    LOGI("=== Predicting (Pure Zero-Shot) ===");
+    LOGI("Ingredients: %s", ingredients.c_str());
+
+    // Cached prompt state was computed with the previous weights
+    if (out.adapter_switched || (options.clear_memory && !session.prefix_cache.enabled())) {
+        clearEngineMemory(session);
+    }
+    llama_perf_context_reset(session.ctx);
+
+    std::string prompt;
+    {
+        SLM_TRACE_SCOPE("prompt_build");
+        prompt = createAllergenPrompt(ingredients, session.gemma, options.hints);
+    }
+
+    LOGI("Prompt length: %zu chars", prompt.length());
+
+    const llama_vocab * vocab = llama_model_get_vocab(session.model);
+
+    std::vector<llama_token> tokens;
+    int n_tokens;
+    {
+        SLM_TRACE_SCOPE("tokenize");
+        const int n_prompt_tokens = -llama_tokenize(vocab, prompt.c_str(), prompt.length(), nullptr, 0, true, false);
+        tokens.resize(n_prompt_tokens);
+
+        n_tokens = llama_tokenize(vocab, prompt.c_str(), prompt.length(), tokens.data(), tokens.size(), true, false);
+    }
+
+    if (n_tokens < 0) {
+        LOGE("Tokenization failed");
+        out.error = "Tokenization failed";
+        return out;
+    }
+
+    LOGI("Tokenized: %d tokens", n_tokens);
+    out.prompt_tokens = n_tokens;
+
+    int max_ctx = llama_n_ctx(session.ctx);
+    if (n_tokens >= max_ctx - 100) {
+        LOGE("Prompt too long!");
+        out.error = "Prompt too long";
+        return out;
+    }
+
+    // With the prefix cache the prompt continues a cached prefix on a
+    // sequence of its own; only the rest is prefilled
+    PrefixLeaseScope prefix(session.prefix_cache, llama_get_memory(session.ctx), tokens);
+    const bool seq_batch = prefix.lease.active();
+    llama_pos next_pos = n_tokens;
+
+    llama_batch batch = llama_batch_get_one(tokens.data(), n_tokens);
+    if (seq_batch) {
+        const int reused = prefix.lease.length;
+        fillSequenceBatch(prefix.batch, tokens.data() + reused, n_tokens - reused, reused, prefix.lease.work);
+        batch = prefix.batch;
+        out.prefix_cached = true;
+        out.prefix_reused_tokens = reused;
+        LOGI("Prefix cache: %d of %d tokens reused", reused, n_tokens);
+    }
+
+    auto t_prefill_start = std::chrono::high_resolution_clock::now();
+    int prefill_status;
+    {
+        SLM_TRACE_SCOPE("prefill", batch.n_tokens);
+        prefill_status = llama_decode(session.ctx, batch);
+    }
+    if (prefill_status != 0) {
+        LOGE("Failed to decode");
+        out.error = "Decoding failed";
+        return out;
+    }
+
+    auto t_prefill_end = std::chrono::high_resolution_clock::now();
+    out.prefill_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            t_prefill_end - t_start
+    ).count();
+    out.prefill_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            t_prefill_end - t_start
+    ).count();
+
+    out.prep_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            t_prefill_start - t_start
+    ).count();
+    out.prefill_decode_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            t_prefill_end - t_prefill_start
+    ).count();
+
+    if (out.prefill_ms > 0) {
+        out.itps = (out.prompt_tokens * 1000L) / out.prefill_ms;
+    }
+    if (out.prefill_decode_us > 0) {
+        out.prefill_tps = out.prompt_tokens * 1e6 / out.prefill_decode_us;
+    }
+    prefix.prefilled = true;
+    prefix.prefill_us = static_cast<double>(out.prefill_decode_us);
+    LOGI("Prefill: %d tokens in %ld ms", out.prompt_tokens, out.prefill_ms);
+
+    std::string result;
+
+    LOGI("Generating...");
+    auto n_vocab_size = llama_vocab_n_tokens(vocab);
+
+    bool at_label_start = true;
+    float margin_sum = 0.0f;
+
+    // Label ids go straight into the mask; pieces are only rendered
+    // for raw_text or an on_token caller
+    const bool token_labels = session.labels.ready() && !options.raw_text;
+    LabelParseState label_state;
+
+    for (int i = 0; i < options.max_tokens; i++) {
+        SLM_TRACE_SCOPE("gen_step", i);
+        auto * logits = llama_get_logits_ith(session.ctx, -1);
+
+        if (logits == nullptr) {
+            LOGE("Failed to get logits");
+            break;
+        }
+
+        llama_token new_token_id = 0;
+        float max_logit = logits[0];
+        float second_logit = -INFINITY;
+
+        {
+            SLM_TRACE_SCOPE("sample");
+            for (int id = 1; id < n_vocab_size; id++) {
+                if (logits[id] > max_logit) {
+                    second_logit = max_logit;
+                    max_logit = logits[id];
+                    new_token_id = id;
+                } else if (logits[id] > second_logit) {
+                    second_logit = logits[id];
+                }
+            }
+        }
+
+        const float margin = max_logit - second_logit;
+        auto record_decision = [&]() {
+            if (out.decision_tokens == 0 || margin < out.min_margin) {
+                out.min_margin = margin;
+            }
+            margin_sum += margin;
+            out.decision_tokens++;
+        };
+
+        if (llama_vocab_is_eog(vocab, new_token_id)) {
+            record_decision();
+            LOGI("EOS at token %d", i);
+            break;
+        }
+
+        if (!first_token_seen) {
+            auto t_first = std::chrono::high_resolution_clock::now();
+            out.ttft_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    t_first - t_start
+            ).count();
+            out.ttft_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    t_first - t_start
+            ).count();
+            first_token_seen = true;
+            LOGI("TTFT: %ld ms", out.ttft_ms);
+        }
+
+        std::string token_str;
+        if (!token_labels || options.on_token) {
+            char buf[256];
+            int n_chars;
+            {
+                SLM_TRACE_SCOPE("detokenize");
+                n_chars = llama_token_to_piece(vocab, new_token_id, buf, sizeof(buf), 0, false);
+            }
+
+            if (n_chars < 0) {
+                LOGE("Failed to decode token");
+                break;
+            }
+            token_str.assign(buf, n_chars);
+        }
+        out.generated_tokens++;
+
+        const uint8_t token_class = token_labels ? session.labels.tokenClass(new_token_id) : 0;
+        bool has_alpha = false;
+        bool has_separator = false;
+        bool has_comma = false;
+        if (token_labels) {
+            session.labels.push(label_state, new_token_id);
+            has_alpha = token_class & TOKEN_ALPHA;
+            has_separator = token_class & (TOKEN_COMMA | TOKEN_NEWLINE | TOKEN_MARKER);
+            has_comma = token_class & TOKEN_COMMA;
+        } else {
+            result += token_str;
+            for (char c : token_str) {
+                if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) has_alpha = true;
+                if (c == ',' || c == '\n' || c == '<') has_separator = true;
+            }
+            has_comma = token_str.find(',') != std::string::npos;
+        }
+        if ((has_alpha && at_label_start) || has_separator) {
+            record_decision();
+        }
+        if (has_alpha) {
+            at_label_start = false;
+        }
+        if (has_comma) {
+            at_label_start = true;
+        }
+
+        // Log first 5 tokens
+        if (i < 5) {
+            if (token_labels) {
+                LOGI("Token %d: id %d", i, new_token_id);
+            } else {
+                LOGI("Token %d: '%s'", i, token_str.c_str());
+            }
+        }
+
+        if (options.on_token && !options.on_token(out.generated_tokens - 1, token_str, traceNowUs())) {
+            LOGI("Stopped by caller at token %d", i);
+            break;
+        }
+
+        // Check for end markers
+        if (token_labels) {
+            // No label contains '<', so a marker spelled out as text ends the answer
+            if (token_class & TOKEN_MARKER) {
+                LOGI("Marker at token %d", i);
+                break;
+            }
+            if (options.decode_mode == DecodeMode::STOP_AT_NEWLINE && (token_class & TOKEN_NEWLINE)) {
+                LOGI("Newline at token %d", i);
+                break;
+            }
+        } else if (session.gemma) {
+            if (result.find("<end_of_turn>") != std::string::npos) {
+                LOGI("Gemma end at token %d", i);
+                break;
+            }
+            if (result.find("<start_of_turn>") != std::string::npos) {
+                LOGI("Gemma start marker at token %d", i);
+                break;
+            }
+        } else {
+            if (result.find("<|im_end|>") != std::string::npos) {
+                LOGI("ChatML end at token %d", i);
+                break;
+            }
+        }
+
+        if (options.decode_mode == DecodeMode::STOP_AT_NEWLINE &&
+            result.find('\n') != std::string::npos) {
+            LOGI("Newline at token %d", i);
+            break;
+        }
+
+        if (seq_batch) {
+            fillSequenceBatch(prefix.batch, &new_token_id, 1, next_pos++, prefix.lease.work);
+            batch = prefix.batch;
+        } else {
+            batch = llama_batch_get_one(&new_token_id, 1);
+        }
+
+        int decode_status;
+        {
+            SLM_TRACE_SCOPE("decode");
+            decode_status = llama_decode(session.ctx, batch);
+        }
+        if (decode_status != 0) {
+            LOGE("Failed to decode next token");
+            break;
+        }
+        out.step_end_us.push_back(traceNowUs());
+    }
+
+    auto t_gen_end = std::chrono::high_resolution_clock::now();
+    out.t_end_us = traceNowUs();
+    long gen_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            t_gen_end - t_start
+    ).count();
+
+    out.oet_ms = gen_ms;
+    out.total_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            t_gen_end - t_start
+    ).count();
+
+    if (gen_ms > 0 && out.generated_tokens > 0) {
+        out.otps = (out.generated_tokens * 1000L) / gen_ms;
+    }
+
+    out.gen_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            t_gen_end - t_prefill_end
+    ).count();
+    if (out.gen_us > 0 && out.generated_tokens > 0) {
+        out.decode_tps = out.generated_tokens * 1e6 / out.gen_us;
+    }
+
+    const llama_perf_context_data perf = llama_perf_context(session.ctx);
+    out.llama_load_ms = perf.t_load_ms;
+    out.llama_p_eval_ms = perf.t_p_eval_ms;
+    out.llama_eval_ms = perf.t_eval_ms;
+    out.llama_n_p_eval = perf.n_p_eval;
+    out.llama_n_eval = perf.n_eval;
+    LOGI("llama perf: prompt %d tok / %.2f ms, eval %d tok / %.2f ms",
+         perf.n_p_eval, perf.t_p_eval_ms, perf.n_eval, perf.t_eval_ms);
+
+    if (out.decision_tokens > 0) {
+        out.mean_margin = margin_sum / out.decision_tokens;
+    }
+
+    LOGI("Generated %d tokens", out.generated_tokens);
+
+    if (token_labels) {
+        SLM_TRACE_SCOPE("label_finish");
+        out.token_labels = true;
+        out.mask = session.labels.finish(label_state, out.label_fallback);
+        out.unparsed = out.mask == 0 && !label_state.none && label_state.content;
+        out.text = allergenMaskToString(out.mask);
+        LOGI("LABELS: '%s'%s", out.text.c_str(), out.label_fallback ? " (parsed from text)" : "");
+        out.ok = true;
+        return out;
+    }
+
+    LOGI("RAW: '%s'", result.c_str());
+
+    // Clean output
+    SLM_TRACE_SCOPE("cleanup");
+    if (session.gemma) {
+        size_t end_pos = result.find("<end_of_turn>");
+        if (end_pos != std::string::npos) {
+            result = result.substr(0, end_pos);
+        }
+        end_pos = result.find("<start_of_turn>");
+        if (end_pos != std::string::npos) {
+            result = result.substr(0, end_pos);
+        }
+    } else {
+        size_t end_pos = result.find("<|im_end|>");
+        if (end_pos != std::string::npos) {
+            result = result.substr(0, end_pos);
+        }
+    }
+
+    result.erase(0, result.find_first_not_of(" \n\r\t"));
+    result.erase(result.find_last_not_of(" \n\r\t") + 1);
+
+    if (result.empty()) {
+        result = "none";
+    }
+
+    LOGI("CLEANED: '%s'", result.c_str());
+
+    out.text = result;
+    out.mask = parseAllergenList(result);
+    out.unparsed = out.mask == 0 && result.find("none") == std::string::npos;
+    out.ok = true;
+    return out;
+}
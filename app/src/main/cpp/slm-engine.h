@@ -0,0 +1,216 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "allergen-labels.h"
+#include "label-decoder.h"
+#include "llama/llama.h"
+#include "lora-adapters.h"
+#include "memory-report.h"
+#include "model-warmup.h"
+#include "prefix-cache.h"
+
+// ===============================================================
+// INFERENCE ENGINE
+// Model/context lifetime, prompt construction and the greedy
+// allergen decode loop, free of JNI so every entry point (the
+// MainActivity bindings, the cascade, host tools) runs the same code.
+// ===============================================================
+
+struct EngineConfig {
+    int n_ctx = 4096;
+    int n_batch = 1024;
+    int n_ubatch = 0;                   // 0 = llama default
+    int n_threads = 6;
+    int n_threads_batch = 0;            // 0 = llama default
+    int n_seq_max = 1;                  // > 1 for the prefix cache (unified KV cache)
+    ggml_type type_k = GGML_TYPE_F16;   // KV cache types
+    ggml_type type_v = GGML_TYPE_F16;
+    llama_flash_attn_type flash_attn = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    bool use_mmap = true;
+    bool use_mlock = false;
+
+    // Model-level params; anything else only needs a new context
+    bool sameModelParams(const EngineConfig& other) const {
+        return use_mmap == other.use_mmap && use_mlock == other.use_mlock;
+    }
+};
+
+enum class DecodeMode {
+    STOP_AT_NEWLINE,   // stop at EOG, chat end markers or the first newline
+    UNTIL_EOG          // ignore newlines, stop only at EOG / end markers
+};
+
+struct EngineSession {
+    llama_model* model = nullptr;
+    llama_context* ctx = nullptr;
+    llama_context* embd_ctx = nullptr;  // mean-pooled embeddings (embedIngredients), made on first use
+    std::string model_path;
+    bool gemma = false;
+    EngineConfig config;        // what the current context was built with
+
+    // Process memory around model load and context creation, the
+    // reference points engineMemoryBreakdown attributes against
+    MemorySnapshot mem_before_model;
+    MemorySnapshot mem_after_model;
+    MemorySnapshot mem_before_ctx;
+    MemorySnapshot mem_after_ctx;
+
+    LabelDecoder labels;        // built from the vocab at load
+    LoraAdapters adapters;      // loaded against model, freed with it
+    PrefixCache prefix_cache;   // off unless enablePrefixCache; reset with the KV cache
+
+    bool loaded() const { return model != nullptr && ctx != nullptr; }
+};
+
+struct PredictionOptions {
+    std::string hints;          // lexicon keywords for the prompt, may be empty
+    int max_tokens = 40;
+    // Drop the KV cache before the prompt. With the prefix cache on the
+    // prompt runs on a sequence of its own instead and the cached
+    // branches stay
+    bool clear_memory = false;
+    DecodeMode decode_mode = DecodeMode::STOP_AT_NEWLINE;
+    // Detokenize and clean the output text instead of decoding label
+    // token ids; for debugging the model's exact wording
+    bool raw_text = false;
+    // LoRA adapter id for this request (empty = base model) and its
+    // scale; switching clears the KV cache
+    std::string adapter;
+    float adapter_scale = 1.0f;
+
+    // Called after every generated token with its index, text piece and
+    // traceNowUs() stamp; returning false stops the generation
+    std::function<bool(int, const std::string&, long long)> on_token;
+};
+
+struct PredictionOutput {
+    bool ok = false;
+    std::string error;
+    std::string text;           // labels as allergenMaskToString, or the cleaned raw text
+    AllergenMask mask = 0;
+    bool unparsed = false;      // output had neither a label nor "none"
+    bool token_labels = false;      // mask decoded from the generated ids
+    bool label_fallback = false;    // ... which missed, so it was parsed from their text
+
+    long ttft_ms = -1;
+    long itps = -1;
+    long otps = -1;
+    long oet_ms = -1;
+    long prefill_ms = -1;
+    int prompt_tokens = 0;
+    int generated_tokens = 0;
+
+    // Same phases at microsecond resolution, for statistics
+    long long ttft_us = -1;
+    long long prefill_us = -1;
+    long long total_us = -1;
+
+    // Wall clock split per phase. ITPS/OTPS above keep their original
+    // definition (prefill_ms counts prompt build and tokenize, OTPS
+    // divides by the whole run); these do not overlap:
+    //   prep    = KV clear + prompt build + tokenize
+    //   prefill = the prompt llama_decode alone
+    //   gen     = first sample to the end of the decode loop
+    long long prep_us = -1;
+    long long prefill_decode_us = -1;
+    long long gen_us = -1;
+    double prefill_tps = 0.0;   // prompt_tokens / prefill
+    double decode_tps = 0.0;    // generated_tokens / gen
+
+    // llama_perf_context for this item alone (reset before the prompt)
+    double llama_load_ms = -1.0;
+    double llama_p_eval_ms = -1.0;
+    double llama_eval_ms = -1.0;
+    int llama_n_p_eval = 0;
+    int llama_n_eval = 0;
+
+    // Monotonic traceNowUs() stamps, comparable with sampler threads:
+    // the prediction window and the end of every generation step
+    long long t_begin_us = -1;
+    long long t_end_us = -1;
+    std::vector<long long> step_end_us;
+
+    // Logit margin (top1 - top2) at the label-decision tokens: the
+    // first token of every label and the token that ends the list
+    int decision_tokens = 0;
+    float min_margin = 0.0f;
+    float mean_margin = 0.0f;
+
+    // Adapter the item ran with (empty = base model)
+    std::string adapter;
+    float adapter_scale = 0.0f;
+    bool adapter_switched = false;  // this item changed the active adapter
+    double adapter_switch_ms = 0.0;
+
+    // Prefix cache: leading prompt tokens forked from a cached branch
+    // rather than prefilled (prompt_tokens still counts them)
+    bool prefix_cached = false;
+    int prefix_reused_tokens = 0;
+
+    // "TTFT_MS=..;ITPS=..;OTPS=..;OET_MS=..;PREP_MS=..;...;LABELS=..|text" or
+    // "ERROR|reason"; see phaseMetricsString for the extra keys. LABELS
+    // is TOKEN, FALLBACK or TEXT (raw_text). With an adapter, or after
+    // switching back to the base model, ";ADAPTER=..;ADAPTER_SCALE=..;
+    // ADAPTER_SWITCH_MS=.." follows LABELS; with the prefix cache,
+    // ";PREFIX_REUSED=.." after that
+    std::string formatted() const;
+
+    // "PREP_MS=..;PREFILL_DECODE_MS=..;GEN_MS=..;PREFILL_TPS=..;DECODE_TPS=..;
+    //  LLAMA_LOAD_MS=..;LLAMA_P_EVAL_MS=..;LLAMA_N_P_EVAL=..;LLAMA_EVAL_MS=..;LLAMA_N_EVAL=.."
+    std::string phaseMetricsString() const;
+};
+
+bool isGemmaModelPath(const std::string& model_path);
+
+// "f16", "q8_0", "q4_0", ... for the KV cache flags of host tools
+bool parseKvCacheType(const std::string& name, ggml_type& type);
+const char* kvCacheTypeName(ggml_type type);
+
+// "auto", "on", "off"
+bool parseFlashAttnType(const std::string& name, llama_flash_attn_type& type);
+const char* flashAttnTypeName(llama_flash_attn_type type);
+
+bool parseDecodeMode(const std::string& name, DecodeMode& mode);
+const char* decodeModeName(DecodeMode mode);
+
+std::string createAllergenPrompt(const std::string& ingredients, bool gemma,
+                                 const std::string& hints = "");
+
+// llama_backend_init/free are reference counted across sessions
+// (thread-safe: the preloader loads on its own thread)
+void engineBackendAcquire();
+void engineBackendRelease();
+
+bool loadEngineSession(EngineSession& session, const std::string& model_path,
+                       const EngineConfig& config);
+// Swap the context for one built from config, keeping the loaded
+// weights; only valid when config.sameModelParams(session.config)
+bool recreateEngineContext(EngineSession& session, const EngineConfig& config);
+void freeEngineSession(EngineSession& session);
+// Also drops the prefix cache's branches
+void clearEngineMemory(EngineSession& session);
+
+// Turns the prefix cache on, recreating the context when it has fewer
+// than config.n_seq sequences; n_seq <= 1 turns it off. max_cells is
+// capped at n_ctx - n_batch so the prompt in flight always fits
+bool enablePrefixCache(EngineSession& session, const PrefixCacheConfig& config, std::string& error);
+
+// Current process memory split into weights, KV cache, compute
+// buffers and everything else (reads /proc/self/smaps: ~ms)
+MemoryBreakdown engineMemoryBreakdown(EngineSession& session);
+
+// Synthetic predictions until the model is hot (see model-warmup.h);
+// leaves the KV cache empty and the perf counters reset
+WarmupReport warmupEngineSession(EngineSession& session, const WarmupConfig& config);
+
+// Mean-pooled hidden state of the ingredient text from
+// session.embd_ctx, a second context with embeddings = true; the
+// embedding predictors (allergen head, nearest neighbours) share it
+bool embedIngredients(EngineSession& session, const std::string& ingredients,
+                      std::vector<float>& embedding, int& n_tokens, std::string& error);
+
+PredictionOutput runAllergenPrediction(EngineSession& session, const std::string& ingredients,
+                                       const PredictionOptions& options);
@@ -0,0 +1,19 @@
+#pragma once
+
+// Logcat on device, stderr on a host build
+#ifdef __ANDROID__
+#include <android/log.h>
+
+#define TAG "SLM_NATIVE"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+
+extern bool g_slm_log_verbose;
+
+#define LOGI(...) do { if (g_slm_log_verbose) { fprintf(stderr, "I/SLM: "); fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } } while (0)
+#define LOGW(...) do { fprintf(stderr, "W/SLM: "); fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOGE(...) do { fprintf(stderr, "E/SLM: "); fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } while (0)
+#endif
@@ -0,0 +1,235 @@
+#include "slm-trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/trace.h>
+#endif
+
+struct TraceEvent {
+    const char* name;
+    int64_t start_us;
+    int64_t dur_us;
+    long arg;
+};
+
+// One ring slot as a seqlock: seq is the event index + 1 once the
+// fields hold that event and 0 while they are rewritten, so a dump
+// racing the owner drops the slot instead of reading a torn event
+struct TraceSlot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> start_us{0};
+    std::atomic<int64_t> dur_us{0};
+    std::atomic<long> arg{0};
+};
+
+// Written only by its owning thread; head is published with release
+// so a reader that acquires it sees every event before it. A reset
+// bumps the global generation and the owner restarts its ring the
+// next time it records, so head keeps a single writer
+struct TraceRing {
+    long tid = 0;
+    std::string thread_name;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<uint64_t> head{0};
+    std::vector<TraceSlot> slots;
+
+    TraceRing() : slots(TRACE_RING_CAPACITY) {}
+};
+
+// Rings outlive their threads so a dump after a worker exits still
+// has its events; one ring per thread that ever traced
+static std::mutex g_rings_mutex;
+static std::vector<std::unique_ptr<TraceRing>> g_rings;
+
+static std::atomic<bool> g_trace_enabled{false};
+static std::atomic<uint64_t> g_trace_generation{0};
+
+static TraceRing* threadRing() {
+    thread_local TraceRing* ring = nullptr;
+    if (ring == nullptr) {
+        std::unique_ptr<TraceRing> owned(new TraceRing());
+        owned->tid = static_cast<long>(syscall(SYS_gettid));
+        owned->generation.store(g_trace_generation.load(std::memory_order_acquire), std::memory_order_relaxed);
+        ring = owned.get();
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        g_rings.push_back(std::move(owned));
+    }
+    return ring;
+}
+
+static void jsonEscape(std::ostream& os, const std::string& s) {
+    for (char c : s) {
+        switch (c) {
+            case '"':  os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    os << buf;
+                } else {
+                    os << c;
+                }
+        }
+    }
+}
+
+int64_t traceNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceSetEnabled(bool enabled) {
+    g_trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool traceEnabled() {
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+void traceReset() {
+    g_trace_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void traceSetThreadName(const char* name) {
+    TraceRing* ring = threadRing();
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    ring->thread_name = name;
+}
+
+// ===============================================================
+// SCOPES
+// ===============================================================
+TraceScope::TraceScope(const char* name, long arg)
+        : m_name(name), m_arg(arg), m_start_us(0), m_active(traceEnabled()) {
+    if (!m_active) {
+        return;
+    }
+#ifdef __ANDROID__
+    ATrace_beginSection(name);
+#endif
+    m_start_us = traceNowUs();
+}
+
+TraceScope::~TraceScope() {
+    if (!m_active) {
+        return;
+    }
+    int64_t end_us = traceNowUs();
+#ifdef __ANDROID__
+    ATrace_endSection();
+#endif
+
+    TraceRing* ring = threadRing();
+    const uint64_t generation = g_trace_generation.load(std::memory_order_acquire);
+    if (ring->generation.load(std::memory_order_relaxed) != generation) {
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->generation.store(generation, std::memory_order_release);
+    }
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceSlot& slot = ring->slots[head % TRACE_RING_CAPACITY];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(m_name, std::memory_order_relaxed);
+    slot.start_us.store(m_start_us, std::memory_order_relaxed);
+    slot.dur_us.store(end_us - m_start_us, std::memory_order_relaxed);
+    slot.arg.store(m_arg, std::memory_order_relaxed);
+    slot.seq.store(head + 1, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+// The event at index i, false when the owner has moved past it or is
+// rewriting its slot
+static bool readSlot(const TraceRing& ring, uint64_t i, TraceEvent& e) {
+    const TraceSlot& slot = ring.slots[i % TRACE_RING_CAPACITY];
+    if (slot.seq.load(std::memory_order_acquire) != i + 1) {
+        return false;
+    }
+    e.name = slot.name.load(std::memory_order_relaxed);
+    e.start_us = slot.start_us.load(std::memory_order_relaxed);
+    e.dur_us = slot.dur_us.load(std::memory_order_relaxed);
+    e.arg = slot.arg.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == i + 1;
+}
+
+// ===============================================================
+// EXPORT
+// ===============================================================
+std::string traceToChromeJson() {
+    std::stringstream ss;
+    const long pid = static_cast<long>(getpid());
+    const char* sep = "";
+
+    ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    const uint64_t generation = g_trace_generation.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    for (const auto& ring : g_rings) {
+        // Events from before the last reset the owner has not noticed
+        if (ring->generation.load(std::memory_order_acquire) != generation) {
+            continue;
+        }
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        if (head == 0) {
+            continue;
+        }
+
+        if (!ring->thread_name.empty()) {
+            ss << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+               << ",\"tid\":" << ring->tid << ",\"args\":{\"name\":\"";
+            jsonEscape(ss, ring->thread_name);
+            ss << "\"}}";
+            sep = ",";
+        }
+
+        uint64_t first = head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+        for (uint64_t i = first; i < head; i++) {
+            TraceEvent e;
+            if (!readSlot(*ring, i, e)) {
+                continue;
+            }
+            ss << sep << "{\"name\":\"";
+            jsonEscape(ss, e.name);
+            ss << "\",\"cat\":\"slm\",\"ph\":\"X\",\"ts\":" << e.start_us
+               << ",\"dur\":" << e.dur_us
+               << ",\"pid\":" << pid
+               << ",\"tid\":" << ring->tid;
+            if (e.arg >= 0) {
+                ss << ",\"args\":{\"n\":" << e.arg << "}";
+            }
+            ss << "}";
+            sep = ",";
+        }
+    }
+
+    ss << "]}";
+    return ss.str();
+}
+
+bool traceWriteChromeJson(const std::string& path, std::string& error) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        error = "Cannot write " + path;
+        return false;
+    }
+    out << traceToChromeJson() << "\n";
+    if (!out.flush()) {
+        error = "Write failed for " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// ===============================================================
+// PHASE TRACING
+// Scoped events around every inference phase, recorded into a
+// per-thread ring buffer (single writer, no locks on the hot path)
+// and dumped as Chrome trace JSON, which Perfetto and
+// chrome://tracing open directly. On device each scope is also an
+// ATrace section, so a system trace lines up with llama's threads.
+// Disabled tracing costs one relaxed atomic load per scope.
+// ===============================================================
+
+constexpr size_t TRACE_RING_CAPACITY = 16384;   // events per thread, oldest overwritten
+
+// Monotonic microseconds; the clock every trace event is stamped with
+int64_t traceNowUs();
+
+void traceSetEnabled(bool enabled);
+bool traceEnabled();
+
+// Drops recorded events on every thread; each thread clears its ring
+// the next time it records, and dumps skip rings not cleared yet
+void traceReset();
+
+// Label for this thread's row in the viewer
+void traceSetThreadName(const char* name);
+
+// Chrome trace JSON ("traceEvents" array of complete events). Safe
+// while threads trace: a slot being overwritten is left out.
+std::string traceToChromeJson();
+bool traceWriteChromeJson(const std::string& path, std::string& error);
+
+class TraceScope {
+public:
+    // name must outlive the trace (string literal); arg < 0 is omitted
+    explicit TraceScope(const char* name, long arg = -1);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    long m_arg;
+    int64_t m_start_us;
+    bool m_active;
+};
+
+#define SLM_TRACE_CONCAT_(a, b) a##b
+#define SLM_TRACE_CONCAT(a, b) SLM_TRACE_CONCAT_(a, b)
+#define SLM_TRACE_SCOPE(...) TraceScope SLM_TRACE_CONCAT(slm_trace_scope_, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,161 @@
+// HNSW search against the exact scan on a fixed seed, the save/load
+// round trip, rows appended after the build and the fallbacks
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <set>
+
+#include <unistd.h>
+
+#include "../hnsw-index.h"
+#include "test-check.h"
+
+static const int DIM = 32;
+static const int ROWS = 2000;
+static const int QUERIES = 100;
+static const int K = 10;
+
+// Layout of the graph file (hnsw-index.cpp)
+static const int HEADER_WORDS = 16;
+static const int H_MAX_LEVEL = 5;
+
+static std::vector<float> randomVector(std::mt19937& rng, int dim) {
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> v(dim);
+    for (float& x : v) {
+        x = normal(rng);
+    }
+    return v;
+}
+
+static void fill(EmbeddingIndex& index, std::mt19937& rng, int rows) {
+    std::string error;
+    for (int r = 0; r < rows; r++) {
+        CHECK(index.insert(randomVector(rng, index.dim()).data(), static_cast<AllergenMask>(r & 0x1ff), error));
+    }
+}
+
+static std::vector<uint32_t> rowsOf(const std::vector<KnnNeighbor>& neighbors) {
+    std::vector<uint32_t> rows;
+    for (const KnnNeighbor& n : neighbors) {
+        rows.push_back(n.row);
+    }
+    return rows;
+}
+
+// A copy of the graph file with one word replaced
+static std::string corruptCopy(const std::string& path, const std::string& copy, size_t word, uint32_t value) {
+    std::ifstream in(path, std::ios::binary);
+    std::ofstream out(copy, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+    out.seekp(static_cast<std::streamoff>(word * sizeof(uint32_t)));
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    return copy;
+}
+
+static void checkRejected(const std::string& path) {
+    HnswIndex graph;
+    std::string error;
+    CHECK(!graph.load(path, error));
+    CHECK(error.find("Not an HNSW graph") != std::string::npos);
+    CHECK(!graph.ready());
+}
+
+// Share of the exact top k the graph found, over all queries
+static double recallAtK(const HnswIndex& hnsw, const EmbeddingIndex& index,
+                        const std::vector<std::vector<float>>& queries) {
+    int found = 0;
+    for (const std::vector<float>& q : queries) {
+        const std::vector<uint32_t> exact = rowsOf(index.search(q.data(), K));
+        const std::vector<uint32_t> approx = rowsOf(hnsw.search(index, q.data(), K, HnswConfig().ef_search));
+        CHECK(approx.size() == static_cast<size_t>(K));
+        const std::set<uint32_t> truth(exact.begin(), exact.end());
+        for (uint32_t r : approx) {
+            found += truth.count(r) > 0 ? 1 : 0;
+        }
+    }
+    return static_cast<double>(found) / (queries.size() * K);
+}
+
+int main() {
+    const std::string dir = testTempDir("hnsw-test");
+    const std::string path = dir + "/index.hnsw";
+    std::string error;
+
+    std::mt19937 rng(7);
+    EmbeddingIndex index;
+    CHECK(index.open("", DIM, error));
+    fill(index, rng, ROWS);
+    std::vector<std::vector<float>> queries;
+    for (int i = 0; i < QUERIES; i++) {
+        queries.push_back(randomVector(rng, DIM));
+    }
+
+    HnswConfig config;
+    config.seed = 11;
+    HnswBuildReport report;
+    HnswIndex built;
+    CHECK(built.build(index, config, report, error));
+    CHECK(report.rows == ROWS);
+    CHECK(built.rows() == ROWS);
+    CHECK(built.matches(index));
+
+    const double recall = recallAtK(built, index, queries);
+    fprintf(stderr, "recall@%d = %.3f\n", K, recall);
+    CHECK(recall >= 0.9);
+
+    // Round trip: the mapped file answers exactly like the built graph
+    CHECK(built.save(path, error));
+    HnswIndex loaded;
+    CHECK(loaded.load(path, error));
+    CHECK(loaded.rows() == built.rows());
+    CHECK(loaded.maxLevel() == built.maxLevel());
+    CHECK(loaded.bytes() == built.bytes());
+    CHECK(loaded.matches(index));
+    for (const std::vector<float>& q : queries) {
+        CHECK(rowsOf(loaded.search(index, q.data(), K, config.ef_search)) ==
+              rowsOf(built.search(index, q.data(), K, config.ef_search)));
+    }
+
+    // Damaged files are refused, so the caller rebuilds: a level past
+    // the cap, a node above the top level, a link to a missing row,
+    // and a cut file
+    const size_t level0 = HEADER_WORDS + 2 * static_cast<size_t>(ROWS);
+    checkRejected(corruptCopy(path, dir + "/level.hnsw", H_MAX_LEVEL, 99));
+    checkRejected(corruptCopy(path, dir + "/node.hnsw", HEADER_WORDS + 1, 40));
+    checkRejected(corruptCopy(path, dir + "/link.hnsw", level0 + 1, ROWS + 5));
+    const std::string cut = corruptCopy(path, dir + "/cut.hnsw", H_MAX_LEVEL, loaded.maxLevel());
+    CHECK(truncate(cut.c_str(), static_cast<off_t>(loaded.bytes() / 2)) == 0);
+    checkRejected(cut);
+
+    // A row appended after the build is still found
+    CHECK(index.insert(queries[0].data(), 0, error));
+    const std::vector<KnnNeighbor> appended = loaded.search(index, queries[0].data(), K, config.ef_search);
+    CHECK(!appended.empty() && appended.front().row == ROWS);
+    CHECK(loaded.matches(index));
+
+    // Same dim and row count, other rows: the graph does not match
+    std::mt19937 other_rng(8);
+    EmbeddingIndex other;
+    CHECK(other.open("", DIM, error));
+    fill(other, other_rng, ROWS);
+    CHECK(!loaded.matches(other));
+
+    // Other dim: search falls back to the exact scan
+    EmbeddingIndex wide;
+    CHECK(wide.open("", DIM * 2, error));
+    fill(wide, other_rng, 100);
+    const std::vector<float> wide_query = randomVector(other_rng, DIM * 2);
+    CHECK(!loaded.matches(wide));
+    CHECK(rowsOf(loaded.search(wide, wide_query.data(), K, config.ef_search)) ==
+          rowsOf(wide.search(wide_query.data(), K)));
+
+    loaded.close();
+    built.close();
+    std::string cleanup = "rm -rf '" + dir + "'";
+    if (system(cleanup.c_str()) != 0) {
+        fprintf(stderr, "cannot remove %s\n", dir.c_str());
+    }
+    return testResult("hnsw-test");
+}
@@ -0,0 +1,186 @@
+// Recovery of the results journal from torn commits, damaged commit
+// slots and truncated files, plus the idle group commit
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../results-journal.h"
+#include "test-check.h"
+
+// Layout of page 0 (results-journal.cpp)
+static const off_t SLOTS_OFFSET = 2048;
+static const size_t SLOT_BYTES = 40;
+
+static const std::vector<JournalColumn> COLUMNS = {
+        {"id", JournalType::TEXT},
+        {"n", JournalType::INT64},
+        {"x", JournalType::REAL},
+};
+
+static JournalRecord record(int i) {
+    JournalRecord r;
+    r.texts = {"row-" + std::to_string(i)};
+    r.ints = {i};
+    r.reals = {i * 0.5};
+    return r;
+}
+
+static void append(ResultsJournal& journal, int from, int to) {
+    std::string error;
+    for (int i = from; i < to; i++) {
+        CHECK(journal.append(record(i), error));
+    }
+}
+
+static void copyFile(const std::string& from, const std::string& to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+}
+
+// What a crash leaves: the files as they are now, committed or not
+static void snapshot(const std::string& path, const std::string& copy) {
+    copyFile(path, copy);
+    copyFile(path + ".heap", copy + ".heap");
+}
+
+static void damageSlot(const std::string& path, int slot) {
+    int fd = open(path.c_str(), O_RDWR);
+    uint8_t byte = 0;
+    const off_t at = SLOTS_OFFSET + slot * SLOT_BYTES + 8;      // rows field
+    CHECK(pread(fd, &byte, 1, at) == 1);
+    byte ^= 0x5a;
+    CHECK(pwrite(fd, &byte, 1, at) == 1);
+    close(fd);
+}
+
+static off_t fileSize(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return static_cast<off_t>(in.tellg());
+}
+
+// Rows [0, rows) read back as appended
+static void checkRows(ResultsJournal& journal, uint64_t rows) {
+    CHECK(journal.rows() == rows);
+    const int id = journal.columnIndex("id"), n = journal.columnIndex("n"), x = journal.columnIndex("x");
+    for (uint64_t i = 0; i < journal.rows(); i++) {
+        CHECK(journal.textAt(id, i) == "row-" + std::to_string(i));
+        CHECK(journal.intAt(n, i) == static_cast<int64_t>(i));
+        CHECK(journal.realAt(x, i) == i * 0.5);
+    }
+}
+
+int main() {
+    const std::string dir = testTempDir("journal-test");
+    const std::string path = dir + "/results.slj";
+    std::string error;
+
+    JournalConfig manual;
+    manual.group_rows = 1000;
+    manual.group_ms = 600000;
+    manual.segment_rows = 64;
+
+    // Two commits (slots 1 and 0), then 5 rows that never commit
+    ResultsJournal journal;
+    CHECK(journal.open(path, COLUMNS, manual, error));
+    const std::string journal_id = journal.journalId();
+    CHECK(journal_id.size() == 16);
+    append(journal, 0, 40);
+    CHECK(journal.flush(error));
+    append(journal, 40, 100);
+    CHECK(journal.flush(error));
+    append(journal, 100, 105);
+
+    const std::string crashed = dir + "/crashed.slj";
+    snapshot(path, crashed);
+    {
+        ResultsJournal reopened;
+        CHECK(reopened.open(crashed, COLUMNS, manual, error));
+        checkRows(reopened, 100);
+        CHECK(reopened.stats().recovered_rows == 100);
+        CHECK(reopened.stats().dropped_heap_bytes == 5 * strlen("row-10x"));
+        CHECK(reopened.journalId() == journal_id);
+        // Appends continue after the recovered rows
+        append(reopened, 100, 110);
+        CHECK(reopened.flush(error));
+        checkRows(reopened, 110);
+    }
+
+    // Newest slot (seq 2 lives in slot 0) damaged: back to the first commit
+    const std::string torn = dir + "/torn.slj";
+    snapshot(path, torn);
+    damageSlot(torn, 0);
+    {
+        ResultsJournal reopened;
+        CHECK(reopened.open(torn, COLUMNS, manual, error));
+        checkRows(reopened, 40);
+    }
+
+    // Heap cut below the newest commit: that slot no longer fits
+    const std::string short_heap = dir + "/short-heap.slj";
+    snapshot(path, short_heap);
+    CHECK(truncate((short_heap + ".heap").c_str(), 60 * strlen("row-10")) == 0);
+    {
+        ResultsJournal reopened;
+        CHECK(reopened.open(short_heap, COLUMNS, manual, error));
+        checkRows(reopened, 40);
+    }
+
+    // Data file cut to its first segment: only the first commit fits
+    const std::string short_data = dir + "/short-data.slj";
+    snapshot(path, short_data);
+    const off_t segment = (fileSize(path) - 4096) / 2;
+    CHECK(truncate(short_data.c_str(), 4096 + segment) == 0);
+    {
+        ResultsJournal reopened;
+        CHECK(reopened.open(short_data, COLUMNS, manual, error));
+        checkRows(reopened, 40);
+    }
+
+    // Both slots damaged: refuses to open rather than guess
+    const std::string lost = dir + "/lost.slj";
+    snapshot(path, lost);
+    damageSlot(lost, 0);
+    damageSlot(lost, 1);
+    {
+        ResultsJournal reopened;
+        error.clear();
+        CHECK(!reopened.open(lost, COLUMNS, manual, error));
+        CHECK(error.find("no valid commit") != std::string::npos);
+    }
+    journal.close();
+
+    // Idle group commit: one row, no further append
+    JournalConfig timed = manual;
+    timed.group_ms = 50;
+    const std::string idle = dir + "/idle.slj";
+    ResultsJournal idle_journal;
+    CHECK(idle_journal.open(idle, COLUMNS, timed, error));
+    append(idle_journal, 0, 1);
+    CHECK(idle_journal.stats().committed_rows == 0);
+    for (int wait = 0; wait < 100 && idle_journal.stats().committed_rows == 0; wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(idle_journal.stats().committed_rows == 1);
+    const std::string idle_crashed = dir + "/idle-crashed.slj";
+    snapshot(idle, idle_crashed);
+    {
+        ResultsJournal reopened;
+        CHECK(reopened.open(idle_crashed, COLUMNS, manual, error));
+        checkRows(reopened, 1);
+        CHECK(reopened.journalId() != journal_id);
+    }
+    idle_journal.close();
+
+    std::string cleanup = "rm -rf '" + dir + "'";
+    if (system(cleanup.c_str()) != 0) {
+        fprintf(stderr, "cannot remove %s\n", dir.c_str());
+    }
+    return testResult("journal-test");
+}
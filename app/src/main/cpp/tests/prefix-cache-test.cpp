@@ -0,0 +1,171 @@
+// Prefix cache radix tree against the mock backend: edge split,
+// leaf extension and repointing, eviction with folding, running out
+// of sequences, and the cell count the memory report uses
+
+#include <cmath>
+#include <vector>
+
+#include "../prefix-cache.h"
+#include "../slm-engine.h"
+#include "test-check.h"
+
+static std::vector<llama_token> range(llama_token from, llama_token to) {
+    std::vector<llama_token> tokens;
+    for (llama_token t = from; t <= to; t++) {
+        tokens.push_back(t);
+    }
+    return tokens;
+}
+
+static std::vector<llama_token> concat(std::vector<llama_token> a, const std::vector<llama_token>& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+// Decodes the tokens past the forked prefix onto the work sequence
+static void prefill(EngineSession& session, const PrefixLease& lease, const std::vector<llama_token>& tokens) {
+    const int n = static_cast<int>(tokens.size()) - lease.length;
+    llama_batch batch = llama_batch_init(n, 0, 1);
+    batch.n_tokens = n;
+    for (int i = 0; i < n; i++) {
+        batch.token[i] = tokens[lease.length + i];
+        batch.pos[i] = lease.length + i;
+        batch.n_seq_id[i] = 1;
+        batch.seq_id[i][0] = lease.work;
+        batch.logits[i] = i == n - 1;
+    }
+    CHECK(llama_decode(session.ctx, batch) == 0);
+    llama_batch_free(batch);
+}
+
+struct CacheProbe {
+    EngineSession& session;
+    size_t empty_state = 0;
+    size_t cell_bytes = 0;
+
+    llama_memory_t mem() const { return llama_get_memory(session.ctx); }
+
+    // Cells the backend holds, from the state size over an empty cache
+    int backendCells() const {
+        return static_cast<int>((llama_state_get_size(session.ctx) - empty_state) / cell_bytes);
+    }
+
+    // One prompt through the cache; returns the lease it ran on
+    PrefixLease run(const std::vector<llama_token>& tokens) {
+        PrefixLease lease = session.prefix_cache.acquire(mem(), tokens);
+        CHECK(lease.active());
+        CHECK(llama_memory_seq_pos_max(mem(), lease.work) == lease.length - 1);
+        prefill(session, lease, tokens);
+        session.prefix_cache.release(mem(), lease, tokens, 100.0 * (tokens.size() - lease.length));
+        return lease;
+    }
+
+    void checkCells(int cells, int branches) {
+        const PrefixCacheStats stats = session.prefix_cache.stats();
+        CHECK(stats.cells == cells);
+        CHECK(stats.branches == branches);
+        CHECK(session.prefix_cache.cellsInUse(mem()) == cells);
+        CHECK(backendCells() == cells);
+    }
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: prefix-cache-test <mock model>\n");
+        return 1;
+    }
+    EngineSession session;
+    EngineConfig config;
+    config.n_ctx = 4096;
+    CHECK(loadEngineSession(session, argv[1], config));
+    if (!session.loaded()) {
+        return testResult("prefix-cache-test");
+    }
+    std::string error;
+    PrefixCacheConfig cache;
+    cache.n_seq = 4;
+    cache.max_cells = 20;
+    CHECK(enablePrefixCache(session, cache, error));
+
+    CacheProbe probe{session};
+    probe.empty_state = llama_state_get_size(session.ctx);
+    const std::vector<llama_token> a = range(1, 10);
+
+    // Miss: one branch of ten cells
+    PrefixLease lease = probe.run(a);
+    CHECK(lease.length == 0 && lease.source < 0);
+    probe.cell_bytes = (llama_state_get_size(session.ctx) - probe.empty_state) / 10;
+    CHECK(probe.cell_bytes > 0);
+    probe.checkCells(10, 1);
+
+    // Shares six tokens: a's edge splits, only the new tail is added
+    const std::vector<llama_token> b = concat(range(1, 6), range(20, 23));
+    lease = probe.run(b);
+    CHECK(lease.length == 6);
+    probe.checkCells(14, 2);
+
+    // Same prompt again: forks all but the last token, adds nothing
+    lease = probe.run(a);
+    CHECK(lease.length == 9);
+    probe.checkCells(14, 2);
+
+    // Extends a's leaf: the work sequence takes over its path
+    const std::vector<llama_token> d = concat(a, {30, 31});
+    lease = probe.run(d);
+    CHECK(lease.length == 10);
+    probe.checkCells(16, 2);
+
+    // The split node was repointed from a's freed sequence to d's
+    const std::vector<llama_token> probe_inner = concat(range(1, 6), {99});
+    lease = session.prefix_cache.acquire(probe.mem(), probe_inner);
+    CHECK(lease.length == 6);
+    CHECK(llama_memory_seq_pos_max(probe.mem(), lease.source) >= 5);
+    CHECK(llama_memory_seq_pos_max(probe.mem(), lease.work) == 5);
+    // A prompt in flight counts only past its forked prefix
+    prefill(session, lease, probe_inner);
+    CHECK(session.prefix_cache.cellsInUse(probe.mem()) == 17);
+    CHECK(probe.backendCells() == 17);
+    session.prefix_cache.discard(probe.mem(), lease);
+    probe.checkCells(16, 2);
+
+    // Over the budget: b's leaf (least recently used) goes, and the
+    // split node folds into d's edge
+    lease = probe.run(range(50, 57));
+    CHECK(lease.length == 0);
+    PrefixCacheStats stats = session.prefix_cache.stats();
+    CHECK(stats.evictions == 1);
+    CHECK(stats.evicted_cells == 4);
+    probe.checkCells(20, 2);
+    lease = session.prefix_cache.acquire(probe.mem(), b);
+    CHECK(lease.length == 6);
+    CHECK(llama_memory_seq_pos_max(probe.mem(), lease.source) == 11);
+    session.prefix_cache.discard(probe.mem(), lease);
+
+    // Every sequence taken: a new prompt evicts the oldest branch
+    cache.n_seq = 3;
+    cache.max_cells = 1000;
+    CHECK(enablePrefixCache(session, cache, error));
+    session.prefix_cache.resetStats();
+    probe.empty_state = llama_state_get_size(session.ctx);
+    probe.run(range(100, 104));
+    probe.run(range(200, 204));
+    probe.run(range(300, 304));
+    probe.checkCells(15, 3);
+    lease = probe.run(range(400, 404));
+    CHECK(lease.length == 0);
+    CHECK(session.prefix_cache.stats().evictions == 1);
+    probe.checkCells(15, 3);
+    // The first prompt's branch went; forking it evicts the next one
+    lease = session.prefix_cache.acquire(probe.mem(), range(100, 104));
+    CHECK(lease.length == 0);
+    CHECK(session.prefix_cache.stats().evictions == 2);
+    session.prefix_cache.discard(probe.mem(), lease);
+    probe.checkCells(10, 2);
+
+    // The memory report counts the cells of every branch
+    MemoryBreakdown m = engineMemoryBreakdown(session);
+    CHECK(std::abs(m.kv_used_mb - m.kv_cache_mb * 10 / llama_n_ctx(session.ctx)) < 1e-9);
+
+    freeEngineSession(session);
+    return testResult("prefix-cache-test");
+}
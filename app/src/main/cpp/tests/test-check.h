@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// ===============================================================
+// TEST CHECKS
+// Minimal assertions for the host unit tests: a failed CHECK prints
+// where and keeps going, main returns testResult().
+// ===============================================================
+
+static int g_test_failures = 0;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            g_test_failures++;                                                      \
+        }                                                                           \
+    } while (0)
+
+// Fresh directory under TMPDIR (or /tmp) for a test's files
+inline std::string testTempDir(const char* name) {
+    const char* tmp = getenv("TMPDIR");
+    std::string dir = std::string(tmp != nullptr ? tmp : "/tmp") + "/" + name + "-XXXXXX";
+    if (mkdtemp(&dir[0]) == nullptr) {
+        fprintf(stderr, "cannot create %s\n", dir.c_str());
+        exit(1);
+    }
+    return dir;
+}
+
+inline int testResult(const char* name) {
+    if (g_test_failures > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, g_test_failures);
+        return 1;
+    }
+    fprintf(stderr, "%s: ok\n", name);
+    return 0;
+}
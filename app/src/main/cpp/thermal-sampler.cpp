@@ -0,0 +1,309 @@
+#include "thermal-sampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "slm-log.h"
+#include "slm-trace.h"
+
+// ===============================================================
+// SYSFS
+// ===============================================================
+
+// Entries of dir starting with prefix, ordered by their numeric suffix
+static std::vector<std::string> listNumbered(const std::string& dir, const std::string& prefix) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return names;
+    }
+    while (dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > prefix.size()) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+
+    std::sort(names.begin(), names.end(), [&](const std::string& a, const std::string& b) {
+        return atoi(a.c_str() + prefix.size()) < atoi(b.c_str() + prefix.size());
+    });
+    return names;
+}
+
+static std::string readLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// sysfs attributes are regenerated on every read from offset 0
+static int readIntFd(int fd) {
+    if (fd < 0) {
+        return 0;
+    }
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return 0;
+    }
+    buf[n] = '\0';
+    return atoi(buf);
+}
+
+// ===============================================================
+// SAMPLER
+// ===============================================================
+bool ThermalSampler::start(const ThermalSamplerConfig& config, std::string& error) {
+    stop();
+    m_config = config;
+    closeFiles();
+    m_samples.clear();
+
+    const std::string cpufreq = config.sysfs_root + "/devices/system/cpu/cpufreq";
+    for (const std::string& name : listNumbered(cpufreq, "policy")) {
+        std::string dir = cpufreq + "/" + name;
+        Policy policy;
+        policy.cur_fd = open((dir + "/scaling_cur_freq").c_str(), O_RDONLY | O_CLOEXEC);
+        if (policy.cur_fd < 0) {
+            continue;
+        }
+        policy.max_fd = open((dir + "/scaling_max_freq").c_str(), O_RDONLY | O_CLOEXEC);
+        policy.hw_max_khz = atoi(readLine(dir + "/cpuinfo_max_freq").c_str());
+        m_policies.push_back(policy);
+        m_cluster_names.push_back(name);
+    }
+
+    const std::string thermal = config.sysfs_root + "/class/thermal";
+    for (const std::string& name : listNumbered(thermal, "thermal_zone")) {
+        int fd = open((thermal + "/" + name + "/temp").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        std::string type = readLine(thermal + "/" + name + "/type");
+        m_zone_fds.push_back(fd);
+        m_zone_names.push_back(type.empty() ? name : type);
+    }
+    for (const std::string& name : listNumbered(thermal, "cooling_device")) {
+        int fd = open((thermal + "/" + name + "/cur_state").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            m_cooling_fds.push_back(fd);
+        }
+    }
+
+    if (m_policies.empty() && m_zone_fds.empty()) {
+        error = "No cpufreq policies or thermal zones under " + config.sysfs_root;
+        closeFiles();
+        return false;
+    }
+
+    LOGI("Thermal sampler: %zu clusters, %zu zones, %zu cooling devices every %d ms",
+         m_policies.size(), m_zone_fds.size(), m_cooling_fds.size(), config.interval_ms);
+
+    m_stop = false;
+    m_thread = std::thread(&ThermalSampler::run, this);
+    return true;
+}
+
+void ThermalSampler::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void ThermalSampler::closeFiles() {
+    for (const Policy& policy : m_policies) {
+        close(policy.cur_fd);
+        if (policy.max_fd >= 0) {
+            close(policy.max_fd);
+        }
+    }
+    for (int fd : m_zone_fds) close(fd);
+    for (int fd : m_cooling_fds) close(fd);
+    m_policies.clear();
+    m_zone_fds.clear();
+    m_cooling_fds.clear();
+    m_cluster_names.clear();
+    m_zone_names.clear();
+}
+
+ThermalSample ThermalSampler::readSample() const {
+    ThermalSample sample;
+    sample.t_us = traceNowUs();
+
+    sample.freq_khz.reserve(m_policies.size());
+    for (const Policy& policy : m_policies) {
+        sample.freq_khz.push_back(readIntFd(policy.cur_fd));
+        int cap = readIntFd(policy.max_fd);
+        if (policy.hw_max_khz > 0 && cap > 0 && cap < policy.hw_max_khz) {
+            sample.throttled = true;
+        }
+    }
+
+    sample.temp_mc.reserve(m_zone_fds.size());
+    for (int fd : m_zone_fds) {
+        sample.temp_mc.push_back(readIntFd(fd));
+    }
+
+    for (int fd : m_cooling_fds) {
+        sample.cooling_state += readIntFd(fd);
+    }
+    if (sample.cooling_state > 0) {
+        sample.throttled = true;
+    }
+    return sample;
+}
+
+void ThermalSampler::run() {
+    // Stay out of the way of the inference threads
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+
+    const auto interval = std::chrono::milliseconds(std::max(1, m_config.interval_ms));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        lock.unlock();
+        ThermalSample sample = readSample();
+        lock.lock();
+
+        m_samples.push_back(std::move(sample));
+        while (m_samples.size() > m_config.max_samples) {
+            m_samples.pop_front();
+        }
+        m_wake.wait_for(lock, interval, [this]() { return m_stop; });
+    }
+}
+
+void ThermalSampler::clearSamples() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_samples.clear();
+}
+
+// ===============================================================
+// WINDOWS
+// ===============================================================
+ThermalWindow ThermalSampler::window(int64_t from_us, int64_t to_us) const {
+    ThermalWindow w;
+    const size_t n_clusters = m_policies.size();
+    std::vector<double> freq_sum(n_clusters, 0.0);
+    w.freq_min_mhz.assign(n_clusters, 0);
+    double temp_sum = 0.0;
+    int throttled = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto first = std::lower_bound(m_samples.begin(), m_samples.end(), from_us,
+                                  [](const ThermalSample& s, int64_t t) { return s.t_us < t; });
+    if (first != m_samples.begin()) {
+        --first;
+    }
+
+    for (auto it = first; it != m_samples.end() && it->t_us <= to_us; ++it) {
+        const ThermalSample& s = *it;
+        for (size_t c = 0; c < n_clusters && c < s.freq_khz.size(); c++) {
+            int mhz = s.freq_khz[c] / 1000;
+            freq_sum[c] += mhz;
+            if (w.samples == 0 || mhz < w.freq_min_mhz[c]) {
+                w.freq_min_mhz[c] = mhz;
+            }
+        }
+
+        int hottest = 0;
+        for (size_t z = 0; z < s.temp_mc.size(); z++) {
+            hottest = z == 0 ? s.temp_mc[z] : std::max(hottest, s.temp_mc[z]);
+        }
+        double temp_c = hottest / 1000.0;
+        temp_sum += temp_c;
+        w.temp_max_c = w.samples == 0 ? temp_c : std::max(w.temp_max_c, temp_c);
+
+        throttled += s.throttled ? 1 : 0;
+        w.samples++;
+    }
+
+    if (w.samples > 0) {
+        for (double sum : freq_sum) {
+            w.freq_mean_mhz.push_back(sum / w.samples);
+        }
+        w.temp_mean_c = temp_sum / w.samples;
+        w.throttled_fraction = static_cast<double>(throttled) / w.samples;
+    }
+    return w;
+}
+
+std::string ThermalWindow::toString() const {
+    std::stringstream ss;
+    char buf[32];
+    ss << "THERMAL_SAMPLES=" << samples << ";FREQ_MEAN_MHZ=";
+    for (size_t i = 0; i < freq_mean_mhz.size(); i++) {
+        snprintf(buf, sizeof(buf), "%.0f", freq_mean_mhz[i]);
+        ss << (i ? "/" : "") << buf;
+    }
+    ss << ";FREQ_MIN_MHZ=";
+    for (size_t i = 0; i < freq_min_mhz.size(); i++) {
+        ss << (i ? "/" : "") << freq_min_mhz[i];
+    }
+    snprintf(buf, sizeof(buf), "%.1f", temp_mean_c);
+    ss << ";TEMP_MEAN_C=" << buf;
+    snprintf(buf, sizeof(buf), "%.1f", temp_max_c);
+    ss << ";TEMP_MAX_C=" << buf;
+    snprintf(buf, sizeof(buf), "%.3f", throttled_fraction);
+    ss << ";THROTTLED=" << buf;
+    return ss.str();
+}
+
+bool ThermalSampler::writeSamplesJsonl(const std::string& path, std::string& error) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        error = "Cannot write " + path;
+        return false;
+    }
+
+    auto list = [](const std::vector<int>& values) {
+        std::string s = "[";
+        for (size_t i = 0; i < values.size(); i++) {
+            s += (i ? "," : "") + std::to_string(values[i]);
+        }
+        return s + "]";
+    };
+    auto names = [](const std::vector<std::string>& values) {
+        std::string s = "[";
+        for (size_t i = 0; i < values.size(); i++) {
+            s += (i ? ",\"" : "\"") + values[i] + "\"";
+        }
+        return s + "]";
+    };
+
+    out << "{\"type\":\"thermal_header\",\"clusters\":" << names(m_cluster_names)
+        << ",\"zones\":" << names(m_zone_names)
+        << ",\"interval_ms\":" << m_config.interval_ms << "}\n";
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const ThermalSample& s : m_samples) {
+        out << "{\"t_us\":" << s.t_us
+            << ",\"freq_khz\":" << list(s.freq_khz)
+            << ",\"temp_mc\":" << list(s.temp_mc)
+            << ",\"cooling\":" << s.cooling_state
+            << ",\"throttled\":" << (s.throttled ? "true" : "false") << "}\n";
+    }
+    if (!out.flush()) {
+        error = "Write failed for " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ===============================================================
+// CPU FREQUENCY / THERMAL SAMPLER
+// Background thread polling per-cluster scaling_cur_freq, thermal
+// zone temperatures and cooling-device state from sysfs. Samples are
+// stamped with traceNowUs() (the clock PredictionOutput's step and
+// window timestamps use), so a prediction can be matched to the
+// frequency and temperature it actually ran at. The sysfs root is
+// configurable so a fake tree can stand in on a host.
+// ===============================================================
+
+struct ThermalSamplerConfig {
+    std::string sysfs_root = "/sys";
+    int interval_ms = 100;
+    size_t max_samples = 65536;     // oldest dropped beyond this
+};
+
+struct ThermalSample {
+    int64_t t_us = 0;
+    std::vector<int> freq_khz;      // per cpufreq policy (cluster)
+    std::vector<int> temp_mc;       // per thermal zone, millidegrees C
+    int cooling_state = 0;          // sum of cooling device cur_state
+    bool throttled = false;         // any cooling active or a policy capped below cpuinfo_max_freq
+};
+
+// Samples falling inside one prediction window
+struct ThermalWindow {
+    int samples = 0;
+    std::vector<double> freq_mean_mhz;  // per cluster
+    std::vector<int> freq_min_mhz;
+    double temp_mean_c = 0.0;           // hottest zone per sample
+    double temp_max_c = 0.0;
+    double throttled_fraction = 0.0;
+
+    // "THERMAL_SAMPLES=..;FREQ_MEAN_MHZ=a/b/c;FREQ_MIN_MHZ=..;TEMP_MEAN_C=..;TEMP_MAX_C=..;THROTTLED=.."
+    std::string toString() const;
+};
+
+class ThermalSampler {
+public:
+    ~ThermalSampler() { stop(); closeFiles(); }
+
+    // Finds policies, zones and cooling devices under the root and
+    // drops earlier samples; fails only when nothing is found
+    bool start(const ThermalSamplerConfig& config, std::string& error);
+    void stop();
+    bool running() const { return m_thread.joinable(); }
+
+    // Cluster names ("policy0", ...) and zone types, in sample order
+    const std::vector<std::string>& clusters() const { return m_cluster_names; }
+    const std::vector<std::string>& zones() const { return m_zone_names; }
+
+    // Nearest sample before from_us is included so short windows
+    // still see one reading
+    ThermalWindow window(int64_t from_us, int64_t to_us) const;
+
+    // One JSON object per sample: {"t_us":..,"freq_khz":[..],"temp_mc":[..],...}
+    bool writeSamplesJsonl(const std::string& path, std::string& error) const;
+    void clearSamples();
+
+private:
+    struct Policy {
+        int cur_fd = -1;
+        int max_fd = -1;            // scaling_max_freq
+        int hw_max_khz = 0;         // cpuinfo_max_freq, read once
+    };
+
+    void run();
+    ThermalSample readSample() const;
+    void closeFiles();
+
+    ThermalSamplerConfig m_config;
+    std::vector<Policy> m_policies;
+    std::vector<int> m_zone_fds;
+    std::vector<int> m_cooling_fds;
+    std::vector<std::string> m_cluster_names;
+    std::vector<std::string> m_zone_names;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    std::deque<ThermalSample> m_samples;
+    std::thread m_thread;
+};
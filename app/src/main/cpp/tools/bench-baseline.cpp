@@ -0,0 +1,365 @@
+#include "bench-baseline.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "../bench-harness.h"
+
+// ===============================================================
+// FINGERPRINT
+// ===============================================================
+
+// Lowercase, anything outside [a-z0-9.] collapsed to single '-'
+static std::string slug(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (isalnum(u) || c == '.') {
+            out += static_cast<char>(tolower(u));
+        } else if (!out.empty() && out.back() != '-') {
+            out += '-';
+        }
+    }
+    while (!out.empty() && out.back() == '-') {
+        out.pop_back();
+    }
+    return out;
+}
+
+static std::string cpuModelName() {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line, hardware, part;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+        std::string value = line.substr(std::min(line.size(), colon + 2));
+        if (key == "model name") {
+            return value;               // x86
+        }
+        if (key == "Hardware" && hardware.empty()) {
+            hardware = value;           // older arm kernels
+        }
+        if (key == "CPU part" && part.empty()) {
+            part = "part " + value;     // arm64: implementer-specific core id
+        }
+    }
+    return !hardware.empty() ? hardware : part;
+}
+
+static long memTotalGb() {
+    std::ifstream in("/proc/meminfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 9, "MemTotal:") == 0) {
+            return std::lround(atof(line.c_str() + 9) / (1024.0 * 1024.0));
+        }
+    }
+    return 0;
+}
+
+std::string deviceFingerprint() {
+    struct utsname uts {};
+    uname(&uts);
+
+    std::stringstream ss;
+    std::string cpu = slug(cpuModelName());
+    ss << (cpu.empty() ? "unknown-cpu" : cpu)
+       << "_" << sysconf(_SC_NPROCESSORS_ONLN) << "c"
+       << "_" << memTotalGb() << "g"
+       << "_" << slug(uts.machine);
+    return ss.str();
+}
+
+std::string baselineKey(const std::string& device, const std::string& model, const std::string& config) {
+    size_t slash = model.find_last_of('/');
+    std::string name = slash == std::string::npos ? model : model.substr(slash + 1);
+    return device + "|" + name + "|" + config;
+}
+
+// ===============================================================
+// STORAGE
+// ===============================================================
+static std::string joinSamples(const std::vector<double>& values) {
+    std::string out;
+    char buf[32];
+    for (size_t i = 0; i < values.size(); i++) {
+        snprintf(buf, sizeof(buf), "%.4f", values[i]);
+        out += (i ? "," : "") + std::string(buf);
+    }
+    return out;
+}
+
+static std::vector<double> splitSamples(const std::string& value) {
+    std::vector<double> values;
+    std::stringstream ss(value);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (!part.empty()) {
+            values.push_back(atof(part.c_str()));
+        }
+    }
+    return values;
+}
+
+std::string BaselineEntry::toLine() const {
+    char rss[32];
+    snprintf(rss, sizeof(rss), "%.1f", samples.peak_rss_mb);
+
+    std::stringstream ss;
+    ss << "KEY=" << key
+       << ";CREATED=" << created
+       << ";TTFT_MS=" << joinSamples(samples.ttft_ms)
+       << ";PREFILL_TPS=" << joinSamples(samples.prefill_tps)
+       << ";DECODE_TPS=" << joinSamples(samples.decode_tps)
+       << ";PEAK_RSS_MB=" << rss;
+    return ss.str();
+}
+
+bool BaselineEntry::fromLine(const std::string& line, BaselineEntry& entry) {
+    entry = BaselineEntry();
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ';')) {
+        size_t eq = field.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key = field.substr(0, eq);
+        std::string value = field.substr(eq + 1);
+
+        if (key == "KEY") entry.key = value;
+        else if (key == "CREATED") entry.created = atoll(value.c_str());
+        else if (key == "TTFT_MS") entry.samples.ttft_ms = splitSamples(value);
+        else if (key == "PREFILL_TPS") entry.samples.prefill_tps = splitSamples(value);
+        else if (key == "DECODE_TPS") entry.samples.decode_tps = splitSamples(value);
+        else if (key == "PEAK_RSS_MB") entry.samples.peak_rss_mb = atof(value.c_str());
+    }
+    return !entry.key.empty();
+}
+
+bool loadBaselines(const std::string& path, std::vector<BaselineEntry>& entries, std::string& error) {
+    entries.clear();
+    std::ifstream in(path);
+    if (!in) {
+        return true;
+    }
+
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        BaselineEntry entry;
+        if (!BaselineEntry::fromLine(line, entry)) {
+            error = path + ":" + std::to_string(line_no) + ": baseline line has no KEY";
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+const BaselineEntry* findBaseline(const std::vector<BaselineEntry>& entries, const std::string& key) {
+    for (const BaselineEntry& entry : entries) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool saveBaseline(const std::string& path, const BaselineEntry& entry, std::string& error) {
+    std::vector<BaselineEntry> entries;
+    if (!loadBaselines(path, entries, error)) {
+        return false;
+    }
+
+    bool replaced = false;
+    for (BaselineEntry& existing : entries) {
+        if (existing.key == entry.key) {
+            existing = entry;
+            replaced = true;
+        }
+    }
+    if (!replaced) {
+        entries.push_back(entry);
+    }
+
+    // Rename over the original so a crash never leaves a half-written file
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            error = "Cannot write " + tmp;
+            return false;
+        }
+        out << "# slm-bench baselines: one line per device|model|config\n";
+        for (const BaselineEntry& e : entries) {
+            out << e.toLine() << "\n";
+        }
+        if (!out.flush()) {
+            error = "Write failed for " + tmp;
+            return false;
+        }
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        error = "Cannot replace " + path;
+        return false;
+    }
+    return true;
+}
+
+// ===============================================================
+// COMPARISON
+// ===============================================================
+double mannWhitneyGreaterP(const std::vector<double>& a, const std::vector<double>& b) {
+    const size_t na = a.size(), nb = b.size();
+    if (na == 0 || nb == 0) {
+        return 1.0;
+    }
+
+    // Pool with group tags, rank with ties averaged
+    std::vector<std::pair<double, int>> pooled;
+    pooled.reserve(na + nb);
+    for (double v : a) pooled.emplace_back(v, 0);
+    for (double v : b) pooled.emplace_back(v, 1);
+    std::sort(pooled.begin(), pooled.end(),
+              [](const std::pair<double, int>& x, const std::pair<double, int>& y) { return x.first < y.first; });
+
+    const double n = static_cast<double>(na + nb);
+    double rank_sum_b = 0.0;
+    double tie_term = 0.0;
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) {
+            j++;
+        }
+        double avg_rank = (i + 1 + j) / 2.0;    // ranks i+1 .. j
+        for (size_t k = i; k < j; k++) {
+            if (pooled[k].second == 1) {
+                rank_sum_b += avg_rank;
+            }
+        }
+        double t = static_cast<double>(j - i);
+        tie_term += t * t * t - t;
+        i = j;
+    }
+
+    double u_b = rank_sum_b - nb * (nb + 1) / 2.0;
+    double mean = na * nb / 2.0;
+    double var = na * nb / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if (var <= 0.0) {
+        return 1.0;                             // every value tied
+    }
+
+    double z = (u_b - mean - 0.5) / std::sqrt(var);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+static MetricComparison compareMetric(const char* name, const std::vector<double>& base,
+                                      const std::vector<double>& cur, bool higher_is_better,
+                                      double tolerance, const RegressionPolicy& policy) {
+    MetricComparison c;
+    c.metric = name;
+    c.higher_is_better = higher_is_better;
+    c.n_base = static_cast<long>(base.size());
+    c.n_cur = static_cast<long>(cur.size());
+    c.tolerance = tolerance;
+    if (base.empty() || cur.empty()) {
+        return c;
+    }
+
+    c.base_median = percentileOf(base, 0.5);
+    c.cur_median = percentileOf(cur, 0.5);
+    c.change = c.base_median != 0.0 ? (c.cur_median - c.base_median) / std::fabs(c.base_median) : 0.0;
+
+    double worse = higher_is_better ? -c.change : c.change;
+    c.tested = c.n_base >= policy.min_samples && c.n_cur >= policy.min_samples;
+
+    double p_worse = 1.0, p_better = 1.0;
+    if (c.tested) {
+        p_worse = higher_is_better ? mannWhitneyGreaterP(cur, base) : mannWhitneyGreaterP(base, cur);
+        p_better = higher_is_better ? mannWhitneyGreaterP(base, cur) : mannWhitneyGreaterP(cur, base);
+    }
+    bool sig_worse = !c.tested || p_worse < policy.alpha;
+    bool sig_better = !c.tested || p_better < policy.alpha;
+
+    if (worse > tolerance && sig_worse) {
+        c.verdict = MetricVerdict::REGRESSED;
+        c.p_value = p_worse;
+    } else if (-worse > tolerance && sig_better) {
+        c.verdict = MetricVerdict::IMPROVED;
+        c.p_value = p_better;
+    } else {
+        c.verdict = MetricVerdict::PASS;
+        c.p_value = p_worse;
+    }
+    return c;
+}
+
+std::vector<MetricComparison> compareToBaseline(const BaselineSamples& base, const BaselineSamples& cur,
+                                                const RegressionPolicy& policy) {
+    std::vector<MetricComparison> results;
+    results.push_back(compareMetric("ttft_ms", base.ttft_ms, cur.ttft_ms, false, policy.ttft, policy));
+    results.push_back(compareMetric("prefill_tps", base.prefill_tps, cur.prefill_tps, true,
+                                    policy.prefill_tps, policy));
+    results.push_back(compareMetric("decode_tps", base.decode_tps, cur.decode_tps, true,
+                                    policy.decode_tps, policy));
+
+    std::vector<double> base_rss, cur_rss;
+    if (base.peak_rss_mb > 0.0) base_rss.push_back(base.peak_rss_mb);
+    if (cur.peak_rss_mb > 0.0) cur_rss.push_back(cur.peak_rss_mb);
+    results.push_back(compareMetric("peak_rss_mb", base_rss, cur_rss, false, policy.peak_rss, policy));
+    return results;
+}
+
+bool anyRegression(const std::vector<MetricComparison>& results) {
+    for (const MetricComparison& c : results) {
+        if (c.verdict == MetricVerdict::REGRESSED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* metricVerdictName(MetricVerdict verdict) {
+    switch (verdict) {
+        case MetricVerdict::PASS:      return "pass";
+        case MetricVerdict::IMPROVED:  return "improved";
+        case MetricVerdict::REGRESSED: return "REGRESSED";
+        case MetricVerdict::NO_DATA:   return "no-data";
+    }
+    return "?";
+}
+
+std::string formatRegressionReport(const std::vector<MetricComparison>& results) {
+    std::stringstream ss;
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%-12s %10s %10s %8s %6s %9s  %s\n",
+             "metric", "baseline", "current", "change", "tol", "p", "verdict");
+    ss << buf;
+    for (const MetricComparison& c : results) {
+        char p[16] = "-";           // too few samples: tolerance only
+        if (c.tested) {
+            snprintf(p, sizeof(p), "%.2g", c.p_value);
+        }
+        snprintf(buf, sizeof(buf), "%-12s %10.2f %10.2f %+7.1f%% %5.0f%% %9s  %s\n",
+                 c.metric.c_str(), c.base_median, c.cur_median, c.change * 100.0,
+                 c.tolerance * 100.0, p, metricVerdictName(c.verdict));
+        ss << buf;
+    }
+    return ss.str();
+}
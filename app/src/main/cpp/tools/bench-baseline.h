@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// ===============================================================
+// REGRESSION BASELINES
+// Stored per-rep samples of a known-good run, keyed by device
+// fingerprint, model and config. A new run is compared metric by
+// metric: a metric regresses only when its median moved the wrong
+// way by more than the tolerance AND a one-sided Mann-Whitney U test
+// says the two distributions really differ, so one noisy rep cannot
+// fail the gate and a real shift cannot hide behind a lucky mean.
+// ===============================================================
+
+struct BaselineSamples {
+    std::vector<double> ttft_ms;
+    std::vector<double> prefill_tps;
+    std::vector<double> decode_tps;
+    double peak_rss_mb = 0.0;           // one value per run: tolerance only
+};
+
+struct BaselineEntry {
+    std::string key;                    // device|model|config
+    long long created = 0;              // unix seconds
+    BaselineSamples samples;
+
+    // "KEY=..;CREATED=..;TTFT_MS=a,b,..;PREFILL_TPS=..;DECODE_TPS=..;PEAK_RSS_MB=.."
+    std::string toLine() const;
+    static bool fromLine(const std::string& line, BaselineEntry& entry);
+};
+
+// Relative tolerances (0.10 = 10% worse) and significance level
+struct RegressionPolicy {
+    double ttft = 0.10;
+    double prefill_tps = 0.10;
+    double decode_tps = 0.10;
+    double peak_rss = 0.05;
+    double alpha = 0.01;
+    int min_samples = 5;                // below this the test is skipped, tolerance alone decides
+};
+
+enum class MetricVerdict { PASS, IMPROVED, REGRESSED, NO_DATA };
+
+struct MetricComparison {
+    std::string metric;
+    bool higher_is_better = false;
+    long n_base = 0;
+    long n_cur = 0;
+    double base_median = 0.0;
+    double cur_median = 0.0;
+    double change = 0.0;                // relative, signed (+ = larger)
+    double tolerance = 0.0;
+    double p_value = 1.0;               // one-sided, in the regression direction
+    bool tested = false;                // false: too few samples for the U test
+    MetricVerdict verdict = MetricVerdict::NO_DATA;
+};
+
+// Host: CPU model, core count, RAM and kernel; override with --device
+std::string deviceFingerprint();
+
+std::string baselineKey(const std::string& device, const std::string& model, const std::string& config);
+
+// A missing file is an empty baseline set
+bool loadBaselines(const std::string& path, std::vector<BaselineEntry>& entries, std::string& error);
+const BaselineEntry* findBaseline(const std::vector<BaselineEntry>& entries, const std::string& key);
+
+// Replaces any entry with the same key; written to a temp file and renamed
+bool saveBaseline(const std::string& path, const BaselineEntry& entry, std::string& error);
+
+// One-sided p-value that `b` tends to be larger than `a` (normal
+// approximation with tie correction)
+double mannWhitneyGreaterP(const std::vector<double>& a, const std::vector<double>& b);
+
+std::vector<MetricComparison> compareToBaseline(const BaselineSamples& base, const BaselineSamples& cur,
+                                                const RegressionPolicy& policy);
+bool anyRegression(const std::vector<MetricComparison>& results);
+
+const char* metricVerdictName(MetricVerdict verdict);
+
+// Fixed-width table, one row per metric
+std::string formatRegressionReport(const std::vector<MetricComparison>& results);
@@ -0,0 +1,128 @@
+#include "bench-dataset.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+static std::string lowerCopy(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return s;
+}
+
+static std::string trimCopy(const std::string& s) {
+    size_t start = s.find_first_not_of(" \r\n\t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \r\n\t");
+    return s.substr(start, end - start + 1);
+}
+
+// RFC 4180 record reader; returns false at end of input
+static bool readRecord(std::istream& in, char delim, std::vector<std::string>& fields) {
+    fields.clear();
+    std::string field;
+    bool in_quotes = false;
+    bool any = false;
+    char c;
+
+    while (in.get(c)) {
+        any = true;
+        if (in_quotes) {
+            if (c == '"') {
+                if (in.peek() == '"') {
+                    in.get(c);
+                    field += '"';
+                } else {
+                    in_quotes = false;
+                }
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            in_quotes = true;
+        } else if (c == delim) {
+            fields.push_back(field);
+            field.clear();
+        } else if (c == '\n') {
+            fields.push_back(field);
+            return true;
+        } else if (c != '\r') {
+            field += c;
+        }
+    }
+
+    if (any) {
+        fields.push_back(field);
+    }
+    return any;
+}
+
+static int findColumn(const std::vector<std::string>& header, std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        for (size_t i = 0; i < header.size(); i++) {
+            if (lowerCopy(trimCopy(header[i])) == name) {
+                return static_cast<int>(i);
+            }
+        }
+    }
+    return -1;
+}
+
+bool loadBenchDataset(const std::string& path, std::vector<BenchItem>& items, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "Cannot open dataset " + path;
+        return false;
+    }
+
+    std::string first_line;
+    std::getline(in, first_line);
+    char delim = first_line.find('\t') != std::string::npos ? '\t' : ',';
+    in.clear();
+    in.seekg(0);
+
+    std::vector<std::string> header;
+    if (!readRecord(in, delim, header)) {
+        error = "Empty dataset " + path;
+        return false;
+    }
+
+    int col_id = findColumn(header, {"id", "data_id", "dataid"});
+    int col_name = findColumn(header, {"name", "product", "product_name"});
+    int col_ingredients = findColumn(header, {"ingredients", "ingredient"});
+    int col_allergens = findColumn(header, {"allergens_mapped", "allergensmapped", "mapped", "allergens"});
+
+    if (col_ingredients < 0) {
+        error = "Dataset has no 'ingredients' column";
+        return false;
+    }
+
+    std::vector<std::string> fields;
+    int row = 0;
+    while (readRecord(in, delim, fields)) {
+        row++;
+        if (fields.size() == 1 && trimCopy(fields[0]).empty()) {
+            continue;
+        }
+
+        auto field = [&](int col) {
+            return (col >= 0 && col < static_cast<int>(fields.size())) ? trimCopy(fields[col]) : std::string();
+        };
+
+        BenchItem item;
+        item.id = col_id >= 0 ? field(col_id) : std::to_string(row);
+        item.name = field(col_name);
+        item.ingredients = field(col_ingredients);
+        item.allergens_mapped = field(col_allergens);
+
+        if (!item.ingredients.empty()) {
+            items.push_back(item);
+        }
+    }
+
+    return true;
+}
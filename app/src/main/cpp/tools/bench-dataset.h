@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// ===============================================================
+// BENCHMARK DATASET
+// CSV/TSV export of foodpreprocessed.xlsx. Columns are found by
+// header name: id, name, ingredients, allergens_mapped (or
+// allergensMapped / allergens). Quoted fields may span lines.
+// ===============================================================
+
+struct BenchItem {
+    std::string id;
+    std::string name;
+    std::string ingredients;
+    std::string allergens_mapped;   // empty when the file has no label column
+};
+
+bool loadBenchDataset(const std::string& path, std::vector<BenchItem>& items, std::string& error);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+// ===============================================================
+// MINIMAL JSON WRITER
+// Flat objects only: enough for one JSONL record per line.
+// ===============================================================
+
+inline std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 2);
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    return out;
+}
+
+class JsonObject {
+public:
+    JsonObject& add(const char* key, const std::string& value) {
+        sep(key);
+        m_ss << '"' << jsonEscape(value) << '"';
+        return *this;
+    }
+    JsonObject& add(const char* key, const char* value) { return add(key, std::string(value)); }
+    JsonObject& add(const char* key, bool value) {
+        sep(key);
+        m_ss << (value ? "true" : "false");
+        return *this;
+    }
+    JsonObject& add(const char* key, long value) {
+        sep(key);
+        m_ss << value;
+        return *this;
+    }
+    JsonObject& add(const char* key, int value) { return add(key, static_cast<long>(value)); }
+    JsonObject& add(const char* key, double value) {
+        sep(key);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.6g", value);
+        m_ss << buf;
+        return *this;
+    }
+    JsonObject& add(const char* key, float value) { return add(key, static_cast<double>(value)); }
+    // Pre-serialised JSON (nested object or array)
+    JsonObject& raw(const char* key, const std::string& json) {
+        sep(key);
+        m_ss << json;
+        return *this;
+    }
+
+    std::string str() const { return "{" + m_ss.str() + "}"; }
+
+private:
+    void sep(const char* key) {
+        if (!m_first) {
+            m_ss << ',';
+        }
+        m_first = false;
+        m_ss << '"' << key << "\":";
+    }
+
+    std::stringstream m_ss;
+    bool m_first = true;
+};
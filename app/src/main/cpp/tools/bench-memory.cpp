@@ -0,0 +1,30 @@
+#include "bench-memory.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+bool resetPeakRss() {
+    // "5" resets VmHWM to the current RSS
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, "5", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+double readPeakRssMb() {
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return atof(line.c_str() + 6) / 1024.0;
+        }
+    }
+    return 0.0;
+}
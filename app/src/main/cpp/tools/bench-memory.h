@@ -0,0 +1,10 @@
+#pragma once
+
+// ===============================================================
+// PROCESS MEMORY
+// Peak RSS (VmHWM) of the benchmark process itself.
+// ===============================================================
+
+// Best effort: needs write access to /proc/self/clear_refs (Linux >= 4.0)
+bool resetPeakRss();
+double readPeakRssMb();
@@ -0,0 +1,377 @@
+#include "bench-sweep.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static std::string trimCopy(const std::string& s) {
+    size_t start = s.find_first_not_of(" \r\n\t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \r\n\t");
+    return s.substr(start, end - start + 1);
+}
+
+static std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> parts;
+    std::stringstream ss(value);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        part = trimCopy(part);
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+static bool parseBool(const std::string& s, int& value) {
+    if (s == "1" || s == "on" || s == "true" || s == "yes") {
+        value = 1;
+    } else if (s == "0" || s == "off" || s == "false" || s == "no") {
+        value = 0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ===============================================================
+// SPEC
+// ===============================================================
+bool loadSweepSpec(const std::string& path, SweepSpec& spec, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Cannot open sweep spec " + path;
+        return false;
+    }
+
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.resize(hash);
+        }
+        line = trimCopy(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            error = path + ":" + std::to_string(line_no) + ": expected key = value";
+            return false;
+        }
+        std::string key = trimCopy(line.substr(0, eq));
+        std::vector<std::string> values = splitList(line.substr(eq + 1));
+        if (values.empty()) {
+            error = path + ":" + std::to_string(line_no) + ": no value for " + key;
+            return false;
+        }
+
+        auto bad = [&](const std::string& v) {
+            error = path + ":" + std::to_string(line_no) + ": bad value '" + v + "' for " + key;
+            return false;
+        };
+        auto ints = [&](std::vector<int>& out) {
+            out.clear();
+            for (const std::string& v : values) {
+                out.push_back(atoi(v.c_str()));
+            }
+        };
+
+        if (key == "mode") {
+            if (values[0] != "grid" && values[0] != "random") return bad(values[0]);
+            spec.random = values[0] == "random";
+        } else if (key == "samples") {
+            spec.samples = atoi(values[0].c_str());
+        } else if (key == "seed") {
+            spec.seed = static_cast<unsigned>(strtoul(values[0].c_str(), nullptr, 10));
+        } else if (key == "items") {
+            spec.items = atoi(values[0].c_str());
+        } else if (key == "max_tokens") {
+            spec.max_tokens = atoi(values[0].c_str());
+        } else if (key == "models") {
+            spec.models = values;
+        } else if (key == "threads") {
+            ints(spec.threads);
+        } else if (key == "n_batch") {
+            ints(spec.n_batch);
+        } else if (key == "n_ubatch") {
+            ints(spec.n_ubatch);
+        } else if (key == "n_ctx") {
+            ints(spec.n_ctx);
+        } else if (key == "kv_type") {
+            spec.kv_type.clear();
+            for (const std::string& v : values) {
+                ggml_type type;
+                if (!parseKvCacheType(v, type)) return bad(v);
+                spec.kv_type.push_back(type);
+            }
+        } else if (key == "flash_attn") {
+            spec.flash_attn.clear();
+            for (const std::string& v : values) {
+                llama_flash_attn_type type;
+                if (!parseFlashAttnType(v, type)) return bad(v);
+                spec.flash_attn.push_back(type);
+            }
+        } else if (key == "mmap" || key == "mlock") {
+            std::vector<int>& out = key == "mmap" ? spec.mmap : spec.mlock;
+            out.clear();
+            for (const std::string& v : values) {
+                int b;
+                if (!parseBool(v, b)) return bad(v);
+                out.push_back(b);
+            }
+        } else if (key == "decode") {
+            spec.decode.clear();
+            for (const std::string& v : values) {
+                DecodeMode mode;
+                if (!parseDecodeMode(v, mode)) return bad(v);
+                spec.decode.push_back(mode);
+            }
+        } else {
+            error = path + ":" + std::to_string(line_no) + ": unknown key " + key;
+            return false;
+        }
+    }
+
+    if (spec.models.empty()) {
+        error = "Sweep spec has no models";
+        return false;
+    }
+    if (spec.random && spec.samples <= 0) {
+        error = "Random sweep needs samples > 0";
+        return false;
+    }
+    return true;
+}
+
+// ===============================================================
+// POINTS
+// ===============================================================
+std::string SweepPoint::key() const {
+    std::stringstream ss;
+    ss << model_path
+       << "|t" << engine.n_threads
+       << "|b" << engine.n_batch
+       << "|ub" << engine.n_ubatch
+       << "|c" << engine.n_ctx
+       << "|kv" << kvCacheTypeName(engine.type_k)
+       << "|fa" << flashAttnTypeName(engine.flash_attn)
+       << "|mmap" << (engine.use_mmap ? 1 : 0)
+       << "|mlock" << (engine.use_mlock ? 1 : 0)
+       << "|" << decodeModeName(decode_mode);
+    return ss.str();
+}
+
+std::vector<SweepPoint> expandSweep(const SweepSpec& spec) {
+    std::vector<SweepPoint> points;
+
+    // Load-level dimensions outermost so consecutive points share a model
+    for (const std::string& model : spec.models)
+    for (int mmap : spec.mmap)
+    for (int mlock : spec.mlock)
+    for (int ctx : spec.n_ctx)
+    for (ggml_type kv : spec.kv_type)
+    for (llama_flash_attn_type fa : spec.flash_attn)
+    for (int batch : spec.n_batch)
+    for (int ubatch : spec.n_ubatch)
+    for (int threads : spec.threads)
+    for (DecodeMode decode : spec.decode) {
+        if (ubatch > batch) {
+            continue;   // llama clamps n_ubatch to n_batch: duplicate point
+        }
+        SweepPoint point;
+        point.model_path = model;
+        point.engine.use_mmap = mmap != 0;
+        point.engine.use_mlock = mlock != 0;
+        point.engine.n_ctx = ctx;
+        point.engine.type_k = kv;
+        point.engine.type_v = kv;
+        point.engine.flash_attn = fa;
+        point.engine.n_batch = batch;
+        point.engine.n_ubatch = ubatch;
+        point.engine.n_threads = threads;
+        point.decode_mode = decode;
+        points.push_back(point);
+    }
+
+    if (spec.random && spec.samples < static_cast<int>(points.size())) {
+        std::mt19937 rng(spec.seed);
+        std::shuffle(points.begin(), points.end(), rng);
+        points.resize(spec.samples);
+
+        std::map<std::string, size_t> model_order;
+        for (size_t i = 0; i < spec.models.size(); i++) {
+            model_order.emplace(spec.models[i], i);
+        }
+        std::stable_sort(points.begin(), points.end(), [&](const SweepPoint& a, const SweepPoint& b) {
+            size_t ma = model_order[a.model_path], mb = model_order[b.model_path];
+            if (ma != mb) return ma < mb;
+            if (a.engine.use_mmap != b.engine.use_mmap) return a.engine.use_mmap > b.engine.use_mmap;
+            return a.engine.use_mlock < b.engine.use_mlock;
+        });
+    }
+
+    return points;
+}
+
+// ===============================================================
+// CHECKPOINT
+// ===============================================================
+std::string SweepResult::toCheckpointLine() const {
+    char metrics[512];
+    snprintf(metrics, sizeof(metrics),
+             ";OK=%d;ITEMS=%ld;FAILED=%ld;LOAD_MS=%ld;CTX_MS=%ld;P50_MS=%.3f;P90_MS=%.3f"
+             ";TTFT_P50_MS=%.3f;PREFILL_TPS=%.3f;DECODE_TPS=%.3f;PEAK_RSS_MB=%.3f"
+             ";LABELED=%ld;EMR=%.6f;MICRO_F1=%.6f",
+             ok ? 1 : 0, items, failed, load_ms, ctx_ms, p50_ms, p90_ms,
+             ttft_p50_ms, prefill_tps, decode_tps, peak_rss_mb,
+             labeled, exact_match_rate, micro_f1);
+
+    std::stringstream ss;
+    ss << "MODEL=" << point.model_path
+       << ";T=" << point.engine.n_threads
+       << ";B=" << point.engine.n_batch
+       << ";UB=" << point.engine.n_ubatch
+       << ";C=" << point.engine.n_ctx
+       << ";KV=" << kvCacheTypeName(point.engine.type_k)
+       << ";FA=" << flashAttnTypeName(point.engine.flash_attn)
+       << ";MMAP=" << (point.engine.use_mmap ? 1 : 0)
+       << ";MLOCK=" << (point.engine.use_mlock ? 1 : 0)
+       << ";DECODE=" << decodeModeName(point.decode_mode)
+       << metrics;
+    if (!error.empty()) {
+        std::string clean = error;
+        std::replace(clean.begin(), clean.end(), ';', ',');
+        std::replace(clean.begin(), clean.end(), '\n', ' ');
+        ss << ";ERROR=" << clean;
+    }
+    return ss.str();
+}
+
+bool SweepResult::fromCheckpointLine(const std::string& line, SweepResult& result) {
+    result = SweepResult();
+
+    std::stringstream ss(line);
+    std::string field;
+    int seen = 0;
+    while (std::getline(ss, field, ';')) {
+        size_t eq = field.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key = field.substr(0, eq);
+        std::string val = field.substr(eq + 1);
+        const char* v = val.c_str();
+        EngineConfig& e = result.point.engine;
+
+        if (key == "MODEL") { result.point.model_path = val; seen++; }
+        else if (key == "T") e.n_threads = atoi(v);
+        else if (key == "B") e.n_batch = atoi(v);
+        else if (key == "UB") e.n_ubatch = atoi(v);
+        else if (key == "C") e.n_ctx = atoi(v);
+        else if (key == "KV") { if (!parseKvCacheType(val, e.type_k)) return false; e.type_v = e.type_k; }
+        else if (key == "FA") { if (!parseFlashAttnType(val, e.flash_attn)) return false; }
+        else if (key == "MMAP") e.use_mmap = atoi(v) != 0;
+        else if (key == "MLOCK") e.use_mlock = atoi(v) != 0;
+        else if (key == "DECODE") { if (!parseDecodeMode(val, result.point.decode_mode)) return false; }
+        else if (key == "OK") { result.ok = atoi(v) != 0; seen++; }
+        else if (key == "ITEMS") result.items = atol(v);
+        else if (key == "FAILED") result.failed = atol(v);
+        else if (key == "LOAD_MS") result.load_ms = atol(v);
+        else if (key == "CTX_MS") result.ctx_ms = atol(v);
+        else if (key == "P50_MS") result.p50_ms = atof(v);
+        else if (key == "P90_MS") result.p90_ms = atof(v);
+        else if (key == "TTFT_P50_MS") result.ttft_p50_ms = atof(v);
+        else if (key == "PREFILL_TPS") result.prefill_tps = atof(v);
+        else if (key == "DECODE_TPS") result.decode_tps = atof(v);
+        else if (key == "PEAK_RSS_MB") result.peak_rss_mb = atof(v);
+        else if (key == "LABELED") result.labeled = atol(v);
+        else if (key == "EMR") result.exact_match_rate = atof(v);
+        else if (key == "MICRO_F1") result.micro_f1 = atof(v);
+        else if (key == "ERROR") result.error = val;
+    }
+    return seen == 2;
+}
+
+bool loadSweepCheckpoint(const std::string& path, std::vector<SweepResult>& results, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        return true;
+    }
+
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (trimCopy(line).empty()) {
+            continue;
+        }
+        SweepResult result;
+        if (!SweepResult::fromCheckpointLine(line, result)) {
+            // A torn final line from a killed run is expected; anything else is not
+            if (in.peek() == EOF) {
+                fprintf(stderr, "Ignoring incomplete checkpoint line %d\n", line_no);
+                break;
+            }
+            error = path + ":" + std::to_string(line_no) + ": malformed checkpoint line";
+            return false;
+        }
+        results.push_back(result);
+    }
+    return true;
+}
+
+bool appendSweepCheckpoint(const std::string& path, const SweepResult& result) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::string line = result.toCheckpointLine() + "\n";
+    bool ok = write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size());
+    ok = fsync(fd) == 0 && ok;
+    close(fd);
+    return ok;
+}
+
+// ===============================================================
+// PARETO FRONTIER
+// ===============================================================
+static bool dominates(const SweepResult& a, const SweepResult& b) {
+    bool no_worse = a.p50_ms <= b.p50_ms && a.peak_rss_mb <= b.peak_rss_mb &&
+                    a.decode_tps >= b.decode_tps && a.micro_f1 >= b.micro_f1;
+    bool better = a.p50_ms < b.p50_ms || a.peak_rss_mb < b.peak_rss_mb ||
+                  a.decode_tps > b.decode_tps || a.micro_f1 > b.micro_f1;
+    return no_worse && better;
+}
+
+void markParetoFrontier(std::vector<SweepResult>& results) {
+    for (SweepResult& r : results) {
+        r.frontier = false;
+        if (!r.ok) {
+            continue;
+        }
+        bool dominated = false;
+        for (const SweepResult& other : results) {
+            if (&other != &r && other.ok && other.point.model_path == r.point.model_path &&
+                dominates(other, r)) {
+                dominated = true;
+                break;
+            }
+        }
+        r.frontier = !dominated;
+    }
+}
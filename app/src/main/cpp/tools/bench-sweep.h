@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../slm-engine.h"
+
+// ===============================================================
+// CONFIGURATION SWEEP
+// Grid or random search over load, context and decode settings.
+// Points are ordered so a model is only reloaded when its file or
+// load params change (everything else just gets a new context), and
+// every finished point is appended to a checkpoint so a killed sweep
+// resumes where it stopped.
+// ===============================================================
+
+struct SweepSpec {
+    bool random = false;
+    int samples = 0;                // random mode: points drawn from the grid
+    unsigned seed = 1;
+    int items = -1;                 // dataset items per point, -1 = all
+    int max_tokens = 40;
+
+    std::vector<std::string> models;
+    std::vector<int> threads = {6};
+    std::vector<int> n_batch = {1024};
+    std::vector<int> n_ubatch = {0};
+    std::vector<int> n_ctx = {4096};
+    std::vector<ggml_type> kv_type = {GGML_TYPE_F16};
+    std::vector<llama_flash_attn_type> flash_attn = {LLAMA_FLASH_ATTN_TYPE_AUTO};
+    std::vector<int> mmap = {1};
+    std::vector<int> mlock = {0};
+    std::vector<DecodeMode> decode = {DecodeMode::STOP_AT_NEWLINE};
+};
+
+struct SweepPoint {
+    std::string model_path;
+    EngineConfig engine;
+    DecodeMode decode_mode = DecodeMode::STOP_AT_NEWLINE;
+
+    // Stable identity used by the checkpoint
+    std::string key() const;
+};
+
+struct SweepResult {
+    SweepPoint point;
+    bool ok = false;
+    std::string error;
+
+    long items = 0;
+    long failed = 0;
+    long load_ms = -1;              // -1 = model reused from the previous point
+    long ctx_ms = 0;
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double ttft_p50_ms = 0.0;
+    double prefill_tps = 0.0;
+    double decode_tps = 0.0;
+    double peak_rss_mb = 0.0;
+    long labeled = 0;
+    double exact_match_rate = 0.0;
+    double micro_f1 = 0.0;
+
+    bool frontier = false;          // not dominated within its model
+
+    // One "KEY=VAL;..." line, the same shape the app's result strings use
+    std::string toCheckpointLine() const;
+    static bool fromCheckpointLine(const std::string& line, SweepResult& result);
+};
+
+// key = value lines, list values comma separated
+bool loadSweepSpec(const std::string& path, SweepSpec& spec, std::string& error);
+
+// Deterministic for a given spec; grouped by model and load params
+std::vector<SweepPoint> expandSweep(const SweepSpec& spec);
+
+// A missing checkpoint is an empty one
+bool loadSweepCheckpoint(const std::string& path, std::vector<SweepResult>& results, std::string& error);
+bool appendSweepCheckpoint(const std::string& path, const SweepResult& result);
+
+// Per model: minimise p50 latency and peak RSS, maximise decode tok/s
+// and micro-F1
+void markParetoFrontier(std::vector<SweepResult>& results);
@@ -0,0 +1,1393 @@
+// ===============================================================
+// SLM-BENCH
+// Headless host benchmark for the allergen engine: same prompt,
+// decode loop and lexicon as the app, no JNI. Streams one JSONL
+// record per item (plus a run header and a summary) to stdout or -o.
+// With --baseline the run is gated against stored samples for this
+// device, model and config (exit 3 on a regression). --rescore
+// recomputes the quality metrics of stored runs without a model.
+// --journal appends every item to a results journal as the app
+// does; --export-journal dumps one as CSV or JSONL. --lora loads
+// adapters on the base model and --adapter-route switches them per
+// item, reporting the switch cost and the per-token overhead.
+// --dedup runs each group of canonically identical ingredient lists
+// once and fans the result out to the other members. --prefix-cache
+// keeps earlier prompts as KV branches and forks each new prompt from
+// its longest cached prefix, reporting the tokens and prefill saved.
+// ===============================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../allergen-labels.h"
+#include "../allergen-lexicon.h"
+#include "../allergen-metrics.h"
+#include "../bench-harness.h"
+#include "../energy-meter.h"
+#include "../ingredient-dedup.h"
+#include "../model-preloader.h"
+#include "../model-residency.h"
+#include "../results-journal.h"
+#include "../slm-engine.h"
+#include "../slm-log.h"
+#include "../slm-trace.h"
+#include "../thermal-sampler.h"
+#include "bench-baseline.h"
+#include "bench-dataset.h"
+#include "bench-json.h"
+#include "bench-memory.h"
+
+struct BenchArgs {
+    std::string model_path;
+    std::string dataset_path;
+    std::string out_path;
+    std::string lexicon_path;
+    std::string trace_path;
+    ThermalSamplerConfig thermal;
+    bool thermal_enabled = false;
+    std::string thermal_out;
+    EnergyMeterConfig energy;
+    bool energy_enabled = false;
+    bool memory_report = false;
+    WarmupConfig model_warmup;
+    bool model_warmup_enabled = false;
+    std::string preload_path;
+    int preload_lead = 3;
+    std::vector<std::pair<std::string, std::string>> resident_models;  // id, path
+    std::vector<std::string> route;
+    double residency_mb = 2048.0;
+    EngineConfig engine;
+    PredictionOptions predict;
+    HarnessConfig harness;
+    std::string baseline_path;
+    std::string device;
+    bool save_baseline = false;
+    RegressionPolicy regression;
+    bool lexicon_gate = false;
+    int offset = 0;
+    int limit = -1;
+    bool dedup = false;
+    DedupOptions dedup_options;
+    PrefixCacheConfig prefix_cache;
+    bool prefix_cache_enabled = false;
+    std::string rescore_path;
+    std::string journal_path;
+    JournalConfig journal;
+    std::string export_journal_path;
+    std::string export_format = "jsonl";
+    std::vector<std::pair<std::string, std::string>> lora_adapters;     // id, path
+    std::vector<std::pair<std::string, float>> adapter_route;           // id ("" = base), scale
+};
+
+// Per-adapter totals over every measured repetition
+struct AdapterUsage {
+    long items = 0;
+    long switches = 0;
+    double switch_ms = 0.0;
+    double switch_max_ms = 0.0;
+    long long prefill_us = 0;
+    long prompt_tokens = 0;
+    long long gen_us = 0;
+    long generated_tokens = 0;
+
+    double prefillMsPerToken() const { return prompt_tokens > 0 ? prefill_us / 1000.0 / prompt_tokens : 0.0; }
+    double decodeMsPerToken() const { return generated_tokens > 0 ? gen_us / 1000.0 / generated_tokens : 0.0; }
+};
+
+static void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s -m model.gguf -d dataset.csv [options]\n"
+            "       %s --rescore results.jsonl\n"
+            "       %s --export-journal results.slj [--format csv|jsonl] [-o PATH]\n"
+            "\n"
+            "  -m, --model PATH       GGUF model\n"
+            "  -d, --dataset PATH     CSV/TSV with id,name,ingredients,allergens_mapped\n"
+            "  -o, --out PATH         JSONL output (default: stdout)\n"
+            "  -t, --threads N        generation threads (default 6)\n"
+            "  -tb, --threads-batch N prefill threads (default: llama default)\n"
+            "  -c, --ctx N            n_ctx (default 4096)\n"
+            "  -b, --batch N          n_batch (default 1024)\n"
+            "  -ub, --ubatch N        n_ubatch (default: llama default)\n"
+            "  --kv-type T            K and V cache type: f16, q8_0, q4_0, ... (default f16)\n"
+            "  --flash-attn MODE      auto | on | off (default auto)\n"
+            "  --decode MODE          newline | eog (default newline)\n"
+            "  --max-tokens N         generation cap (default 40)\n"
+            "  --raw-text             detokenize and keep the model's text instead of decoding label ids\n"
+            "  --no-mmap              load weights with read() instead of mmap\n"
+            "  --mlock                lock weights in RAM\n"
+            "  --lexicon              gate items through the ingredient lexicon\n"
+            "  --lexicon-dict PATH    TSV dictionary replacing the built-in one\n"
+            "  --warmup N             unmeasured runs per item before timing (default 0)\n"
+            "  --warmup-max N         keep warming up until steady, at most N runs\n"
+            "  --model-warmup         synthetic predictions after load until the model is hot\n"
+            "  --prefetch             also page the weights in on a background thread\n"
+            "  --preload-next PATH    load PATH in the background during the last items, then swap\n"
+            "  --preload-lead N       start the preload N items before the end (default 3)\n"
+            "  --resident ID=PATH     add a model to the residency pool (repeatable); items\n"
+            "                         are then routed to pool models and --model is not loaded\n"
+            "  --route ID,ID,...      model id per item, cycled (default: pool order)\n"
+            "  --residency-mb N       pool budget: weights + contexts (default 2048)\n"
+            "  --lora ID=PATH         load a LoRA adapter on --model (repeatable)\n"
+            "  --adapter-route ID[@S],...\n"
+            "                         adapter and scale per item, cycled; \"base\" = none\n"
+            "  --reps N               measured repetitions per item (default 1)\n"
+            "  --steady-cv X          warmup is steady when the CV of the last runs <= X (default 0.05)\n"
+            "  --bootstrap N          bootstrap resamples for percentile CIs (default 1000)\n"
+            "  --seed N               bootstrap seed (default 1)\n"
+            "  --baseline PATH        compare against stored baselines, exit 3 on regression\n"
+            "  --save-baseline        store this run as the baseline instead of comparing\n"
+            "  --device NAME          baseline device key (default: CPU/RAM fingerprint)\n"
+            "  --tol-ttft X           allowed TTFT median increase (default 0.10 = 10%%)\n"
+            "  --tol-prefill X        allowed prefill tok/s drop (default 0.10)\n"
+            "  --tol-decode X         allowed decode tok/s drop (default 0.10)\n"
+            "  --tol-mem X            allowed peak RSS increase (default 0.05)\n"
+            "  --alpha P              Mann-Whitney significance level (default 0.01)\n"
+            "  --trace PATH           write a Chrome/Perfetto trace of every engine phase\n"
+            "  --thermal-ms N         sample CPU freq / thermal zones every N ms\n"
+            "  --thermal-root PATH    sysfs root for the sampler (default /sys)\n"
+            "  --thermal-out PATH     write every thermal sample as JSONL\n"
+            "  --energy SRC           meter energy per item: auto | battery | rapl\n"
+            "  --energy-ms N          energy sample interval (default 50)\n"
+            "  --energy-root PATH     sysfs root for the energy meter (default /sys)\n"
+            "  --memory               split RSS into weights / KV cache / compute at load and per item\n"
+            "  --offset N             skip the first N items\n"
+            "  --limit N              run at most N items\n"
+            "  --dedup                predict once per group of identical ingredient lists (case,\n"
+            "                         whitespace and punctuation folded) and fan the result out\n"
+            "  --dedup-unordered      same, also ignoring the order of the entries\n"
+            "  --prefix-cache N       fork prompts from cached prefixes on N KV sequences (default 16)\n"
+            "  --prefix-cells N       KV cells the cached prefixes may hold (default 2048)\n"
+            "  --rescore PATH         recompute quality metrics from the item records of PATH\n"
+            "  --journal PATH         also append every item to the results journal at PATH\n"
+            "  --journal-rows N       group commit every N rows (default 32)\n"
+            "  --journal-ms N         ... or once the oldest pending row is N ms old (default 2000)\n"
+            "  --export-journal PATH  write the rows of a results journal and exit\n"
+            "  --format F             export format: jsonl | csv (default jsonl)\n"
+            "  -v, --verbose          engine logs to stderr\n",
+            argv0, argv0, argv0);
+}
+
+static bool parseArgs(int argc, char** argv, BenchArgs& args) {
+    // Single timed run per item unless asked for more
+    args.harness.warmup_min = 0;
+    args.harness.warmup_max = 0;
+    args.harness.repetitions = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "missing value for %s\n", arg.c_str());
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-m" || arg == "--model") {
+            args.model_path = value();
+        } else if (arg == "-d" || arg == "--dataset") {
+            args.dataset_path = value();
+        } else if (arg == "-o" || arg == "--out") {
+            args.out_path = value();
+        } else if (arg == "-t" || arg == "--threads") {
+            args.engine.n_threads = atoi(value());
+        } else if (arg == "-tb" || arg == "--threads-batch") {
+            args.engine.n_threads_batch = atoi(value());
+        } else if (arg == "-c" || arg == "--ctx") {
+            args.engine.n_ctx = atoi(value());
+        } else if (arg == "-b" || arg == "--batch") {
+            args.engine.n_batch = atoi(value());
+        } else if (arg == "-ub" || arg == "--ubatch") {
+            args.engine.n_ubatch = atoi(value());
+        } else if (arg == "--kv-type") {
+            std::string name = value();
+            if (!parseKvCacheType(name, args.engine.type_k)) {
+                fprintf(stderr, "unknown KV cache type '%s'\n", name.c_str());
+                return false;
+            }
+            args.engine.type_v = args.engine.type_k;
+        } else if (arg == "--flash-attn") {
+            std::string name = value();
+            if (!parseFlashAttnType(name, args.engine.flash_attn)) {
+                fprintf(stderr, "unknown flash attention mode '%s'\n", name.c_str());
+                return false;
+            }
+        } else if (arg == "--decode") {
+            std::string name = value();
+            if (!parseDecodeMode(name, args.predict.decode_mode)) {
+                fprintf(stderr, "unknown decode mode '%s'\n", name.c_str());
+                return false;
+            }
+        } else if (arg == "--max-tokens") {
+            args.predict.max_tokens = atoi(value());
+        } else if (arg == "--raw-text") {
+            args.predict.raw_text = true;
+        } else if (arg == "--no-mmap") {
+            args.engine.use_mmap = false;
+        } else if (arg == "--mlock") {
+            args.engine.use_mlock = true;
+        } else if (arg == "--lexicon") {
+            args.lexicon_gate = true;
+        } else if (arg == "--lexicon-dict") {
+            args.lexicon_path = value();
+            args.lexicon_gate = true;
+        } else if (arg == "--warmup") {
+            args.harness.warmup_min = atoi(value());
+            args.harness.warmup_max = std::max(args.harness.warmup_max, args.harness.warmup_min);
+        } else if (arg == "--model-warmup") {
+            args.model_warmup_enabled = true;
+        } else if (arg == "--prefetch") {
+            args.model_warmup.prefetch = true;
+            args.model_warmup_enabled = true;
+        } else if (arg == "--preload-next") {
+            args.preload_path = value();
+        } else if (arg == "--preload-lead") {
+            args.preload_lead = atoi(value());
+        } else if (arg == "--resident") {
+            std::string spec = value();
+            size_t eq = spec.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                fprintf(stderr, "--resident expects ID=PATH\n");
+                return false;
+            }
+            args.resident_models.emplace_back(spec.substr(0, eq), spec.substr(eq + 1));
+        } else if (arg == "--route") {
+            std::stringstream list(value());
+            std::string id;
+            while (std::getline(list, id, ',')) {
+                if (!id.empty()) {
+                    args.route.push_back(id);
+                }
+            }
+        } else if (arg == "--lora") {
+            std::string spec = value();
+            size_t eq = spec.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                fprintf(stderr, "--lora expects ID=PATH\n");
+                return false;
+            }
+            args.lora_adapters.emplace_back(spec.substr(0, eq), spec.substr(eq + 1));
+        } else if (arg == "--adapter-route") {
+            std::stringstream list(value());
+            std::string entry;
+            while (std::getline(list, entry, ',')) {
+                size_t at = entry.find('@');
+                std::string id = entry.substr(0, at);
+                float scale = at == std::string::npos ? 1.0f : static_cast<float>(atof(entry.c_str() + at + 1));
+                if (!id.empty()) {
+                    args.adapter_route.emplace_back(id == "base" ? "" : id, scale);
+                }
+            }
+        } else if (arg == "--residency-mb") {
+            args.residency_mb = atof(value());
+        } else if (arg == "--warmup-max") {
+            args.harness.warmup_max = atoi(value());
+        } else if (arg == "--reps") {
+            args.harness.repetitions = std::max(1, atoi(value()));
+        } else if (arg == "--steady-cv") {
+            args.harness.steady_cv = atof(value());
+        } else if (arg == "--bootstrap") {
+            args.harness.bootstrap = atoi(value());
+        } else if (arg == "--seed") {
+            args.harness.seed = static_cast<unsigned>(strtoul(value(), nullptr, 10));
+        } else if (arg == "--baseline") {
+            args.baseline_path = value();
+        } else if (arg == "--save-baseline") {
+            args.save_baseline = true;
+        } else if (arg == "--device") {
+            args.device = value();
+        } else if (arg == "--tol-ttft") {
+            args.regression.ttft = atof(value());
+        } else if (arg == "--tol-prefill") {
+            args.regression.prefill_tps = atof(value());
+        } else if (arg == "--tol-decode") {
+            args.regression.decode_tps = atof(value());
+        } else if (arg == "--tol-mem") {
+            args.regression.peak_rss = atof(value());
+        } else if (arg == "--alpha") {
+            args.regression.alpha = atof(value());
+        } else if (arg == "--trace") {
+            args.trace_path = value();
+        } else if (arg == "--thermal-ms") {
+            args.thermal.interval_ms = atoi(value());
+            args.thermal_enabled = true;
+        } else if (arg == "--thermal-root") {
+            args.thermal.sysfs_root = value();
+            args.thermal_enabled = true;
+        } else if (arg == "--thermal-out") {
+            args.thermal_out = value();
+            args.thermal_enabled = true;
+        } else if (arg == "--energy") {
+            const char* name = value();
+            if (!parseEnergySource(name, args.energy.source)) {
+                fprintf(stderr, "unknown energy source '%s'\n", name);
+                return false;
+            }
+            args.energy_enabled = true;
+        } else if (arg == "--energy-ms") {
+            args.energy.interval_ms = atoi(value());
+            args.energy_enabled = true;
+        } else if (arg == "--energy-root") {
+            args.energy.sysfs_root = value();
+            args.energy_enabled = true;
+        } else if (arg == "--memory") {
+            args.memory_report = true;
+        } else if (arg == "--offset") {
+            args.offset = atoi(value());
+        } else if (arg == "--limit") {
+            args.limit = atoi(value());
+        } else if (arg == "--dedup") {
+            args.dedup = true;
+        } else if (arg == "--dedup-unordered") {
+            args.dedup = true;
+            args.dedup_options.ignore_order = true;
+        } else if (arg == "--prefix-cache") {
+            args.prefix_cache.n_seq = atoi(value());
+            args.prefix_cache_enabled = true;
+        } else if (arg == "--prefix-cells") {
+            args.prefix_cache.max_cells = atoi(value());
+            args.prefix_cache_enabled = true;
+        } else if (arg == "--rescore") {
+            args.rescore_path = value();
+        } else if (arg == "--journal") {
+            args.journal_path = value();
+        } else if (arg == "--journal-rows") {
+            args.journal.group_rows = atoi(value());
+        } else if (arg == "--journal-ms") {
+            args.journal.group_ms = atoi(value());
+        } else if (arg == "--export-journal") {
+            args.export_journal_path = value();
+        } else if (arg == "--format") {
+            args.export_format = value();
+        } else if (arg == "-v" || arg == "--verbose") {
+            g_slm_log_verbose = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", arg.c_str());
+            return false;
+        }
+    }
+
+    if (!args.rescore_path.empty()) {
+        return true;
+    }
+    if (!args.export_journal_path.empty()) {
+        return args.export_format == "jsonl" || args.export_format == "csv";
+    }
+    // A pool run needs no --model
+    if ((args.model_path.empty() && args.resident_models.empty()) || args.dataset_path.empty()) {
+        return false;
+    }
+    if (args.save_baseline && args.baseline_path.empty()) {
+        fprintf(stderr, "--save-baseline needs --baseline PATH\n");
+        return false;
+    }
+    return true;
+}
+
+// A dedup group member's copy of its leader's prediction: the labels
+// only, with every timing zero since nothing ran for it (the app's
+// fanned-out rows follow the same rule)
+static PredictionOutput fannedOutput(const PredictionOutput& leader) {
+    PredictionOutput out;
+    out.ok = leader.ok;
+    out.text = leader.text;
+    out.mask = leader.mask;
+    out.unparsed = leader.unparsed;
+    out.token_labels = leader.token_labels;
+    out.label_fallback = leader.label_fallback;
+    out.min_margin = leader.min_margin;
+    out.mean_margin = leader.mean_margin;
+    out.adapter = leader.adapter;
+    out.adapter_scale = leader.adapter_scale;
+    out.ttft_ms = out.itps = out.otps = out.oet_ms = out.prefill_ms = 0;
+    out.ttft_us = out.prefill_us = out.total_us = 0;
+    out.prep_us = out.prefill_decode_us = out.gen_us = 0;
+    out.llama_load_ms = out.llama_p_eval_ms = out.llama_eval_ms = 0.0;
+    return out;
+}
+
+// Everything that changes what the samples measure; the dataset slice
+// is part of it since TTFT depends on prompt length
+static std::string configKey(const BenchArgs& args) {
+    size_t slash = args.dataset_path.find_last_of('/');
+    std::string dataset = slash == std::string::npos ? args.dataset_path : args.dataset_path.substr(slash + 1);
+
+    std::stringstream ss;
+    ss << "t" << args.engine.n_threads
+       << ",tb" << args.engine.n_threads_batch
+       << ",c" << args.engine.n_ctx
+       << ",b" << args.engine.n_batch
+       << ",ub" << args.engine.n_ubatch
+       << ",kv" << kvCacheTypeName(args.engine.type_k)
+       << ",fa" << flashAttnTypeName(args.engine.flash_attn)
+       << ",mmap" << (args.engine.use_mmap ? 1 : 0)
+       << ",mlock" << (args.engine.use_mlock ? 1 : 0)
+       << "," << decodeModeName(args.predict.decode_mode)
+       << ",mt" << args.predict.max_tokens
+       << ",lex" << (args.lexicon_gate ? 1 : 0);
+    if (args.model_warmup_enabled) {
+        // First-item TTFT differs, so hot and cold runs never share a baseline
+        ss << ",mw" << (args.model_warmup.prefetch ? "p" : "");
+    }
+    if (args.predict.raw_text) {
+        ss << ",raw";
+    }
+    if (args.prefix_cache_enabled) {
+        ss << ",pc" << args.prefix_cache.n_seq << "x" << args.prefix_cache.max_cells;
+    }
+    if (args.dedup) {
+        // Fanned-out items report zero latency
+        ss << ",dd" << (args.dedup_options.ignore_order ? "u" : "");
+    }
+    // Adapters change the weights the items run on
+    for (const auto& lora : args.lora_adapters) {
+        size_t cut = lora.second.find_last_of('/');
+        ss << ",lora:" << lora.first << "=" << (cut == std::string::npos ? lora.second : lora.second.substr(cut + 1));
+    }
+    if (!args.adapter_route.empty()) {
+        ss << ",ar";
+        for (const auto& adapter : args.adapter_route) {
+            ss << ":" << (adapter.first.empty() ? "base" : adapter.first) << "@" << adapter.second;
+        }
+    }
+    ss << "," << dataset << "@" << args.offset << "+" << args.limit;
+    return ss.str();
+}
+
+static std::string metricJson(const MetricSummary& m) {
+    return JsonObject()
+            .add("n", m.n)
+            .add("mean", m.mean)
+            .add("sd", m.stddev)
+            .add("mad", m.mad)
+            .add("p50", m.p50)
+            .raw("p50_ci", "[" + std::to_string(m.p50_lo) + "," + std::to_string(m.p50_hi) + "]")
+            .add("p90", m.p90)
+            .raw("p90_ci", "[" + std::to_string(m.p90_lo) + "," + std::to_string(m.p90_hi) + "]")
+            .add("p99", m.p99)
+            .raw("p99_ci", "[" + std::to_string(m.p99_lo) + "," + std::to_string(m.p99_hi) + "]")
+            .add("outliers", m.outliers)
+            .str();
+}
+
+static std::string thermalJson(const ThermalWindow& w) {
+    std::string mean = "[", min = "[";
+    for (size_t i = 0; i < w.freq_mean_mhz.size(); i++) {
+        mean += (i ? "," : "") + std::to_string(std::lround(w.freq_mean_mhz[i]));
+        min += (i ? "," : "") + std::to_string(w.freq_min_mhz[i]);
+    }
+    return JsonObject()
+            .add("samples", w.samples)
+            .raw("freq_mean_mhz", mean + "]")
+            .raw("freq_min_mhz", min + "]")
+            .add("temp_mean_c", w.temp_mean_c)
+            .add("temp_max_c", w.temp_max_c)
+            .add("throttled", w.throttled_fraction)
+            .str();
+}
+
+static std::string memoryJson(const MemoryBreakdown& m) {
+    return JsonObject()
+            .add("rss_mb", m.rss_mb)
+            .add("pss_mb", m.pss_mb)
+            .add("peak_rss_mb", m.peak_rss_mb)
+            .add("swap_mb", m.swap_mb)
+            .add("weights_file_mb", m.weights_file_mb)
+            .add("weights_mapped_mb", m.weights_mapped_mb)
+            .add("weights_resident_mb", m.weights_resident_mb)
+            .add("weights_anon_mb", m.weights_anon_mb)
+            .add("kv_cache_mb", m.kv_cache_mb)
+            .add("kv_used_mb", m.kv_used_mb)
+            .add("state_mb", m.state_mb)
+            .add("compute_mb", m.compute_mb)
+            .add("other_mb", m.other_mb)
+            .add("growth_mb", m.growth_mb)
+            .str();
+}
+
+static std::string qualityJson(const MetricsSummary& q) {
+    std::string labels = "{";
+    for (int l = 0; l < ALLERGEN_COUNT; l++) {
+        labels += std::string(l ? ",\"" : "\"") + ALLERGEN_LABELS[l] + "\":" + JsonObject()
+                .add("tp", q.tp[l])
+                .add("fp", q.fp[l])
+                .add("fn", q.fn[l])
+                .add("tn", q.tn[l])
+                .add("f1", q.labelF1(l))
+                .str();
+    }
+    return JsonObject()
+            .add("items", q.items)
+            .add("micro_precision", q.microPrecision())
+            .add("micro_recall", q.microRecall())
+            .add("micro_f1", q.microF1())
+            .add("macro_f1", q.macroF1())
+            .add("mean_f1", q.mean_f1)
+            .add("mean_precision", q.mean_precision)
+            .add("mean_recall", q.mean_recall)
+            .add("hamming_loss", q.hamming_loss)
+            .add("mean_fnr", q.mean_fnr)
+            .add("hallucination_rate", q.items > 0 ? static_cast<double>(q.hallucination_items) / q.items : 0.0)
+            .add("over_prediction_rate", q.items > 0 ? static_cast<double>(q.over_prediction_items) / q.items : 0.0)
+            .add("abstentions", q.abstentions)
+            .add("abstentions_correct", q.abstentions_correct)
+            .add("compute_us", q.compute_us)
+            .raw("labels", labels + "}")
+            .str();
+}
+
+static long elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - since).count();
+}
+
+// Integer value of "key": in a flat record, or -1
+static long recordInt(const std::string& line, const char* key) {
+    std::string needle = std::string("\"") + key + "\":";
+    size_t pos = line.find(needle);
+    return pos == std::string::npos ? -1 : atol(line.c_str() + pos + needle.size());
+}
+
+// Labeled item records of earlier runs (every run in the file) -> one summary
+static int rescoreResults(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return 1;
+    }
+
+    auto t_read = std::chrono::steady_clock::now();
+    std::vector<AllergenMask> truth, pred, evidence;
+    bool have_evidence = true;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find("\"type\":\"item\"") == std::string::npos) {
+            continue;
+        }
+        long t = recordInt(line, "truth_mask");
+        long p = recordInt(line, "pred_mask");
+        if (t < 0 || p < 0) {
+            continue;
+        }
+        long e = recordInt(line, "evidence_mask");
+        have_evidence = have_evidence && e >= 0;
+        truth.push_back(static_cast<AllergenMask>(t));
+        pred.push_back(static_cast<AllergenMask>(p));
+        evidence.push_back(static_cast<AllergenMask>(e < 0 ? ALLERGEN_MASK_ALL : e));
+    }
+    long read_ms = elapsedMs(t_read);
+
+    MetricsSummary quality = computeMetricsSummary(truth.data(), pred.data(),
+                                                   have_evidence ? evidence.data() : nullptr, truth.size());
+    std::cout << JsonObject()
+            .add("type", "rescore")
+            .add("schema", BENCH_SCHEMA_VERSION)
+            .add("path", path)
+            .add("read_ms", read_ms)
+            .add("exact_match_rate", quality.items > 0 ? static_cast<double>(quality.exact_matches) / quality.items : 0.0)
+            .raw("quality", qualityJson(quality))
+            .str() << "\n";
+    fprintf(stderr, "Rescored %ld items in %.0f us (read %ld ms)\n", quality.items, quality.compute_us, read_ms);
+    return 0;
+}
+
+// One PredictionResult row, with the fields the app fills from the
+// device (heap, Android version) left empty
+static JournalRecord journalRecord(const BenchItem& item, const std::string& model, const PredictionOutput& pred,
+                                   AllergenMask mask, const ItemMetrics& m, long latency_ms) {
+    JournalRecord r;
+    r.texts = {item.id, item.name, item.ingredients, item.allergens_mapped, item.allergens_mapped,
+               allergenMaskToString(mask), model,
+               m.hallucinated ? allergenMaskToString(m.hallucinated) : "",
+               m.over_predicted ? allergenMaskToString(m.over_predicted) : "",
+               deviceFingerprint(), ""};
+    r.ints = {m.tp, m.fp, m.fn, m.tn, m.exact_match,
+              __builtin_popcount(m.hallucinated), __builtin_popcount(m.over_predicted),
+              m.abstention, m.abstention_correct,
+              latency_ms, pred.ttft_ms, pred.itps, pred.otps, pred.oet_ms,
+              pred.total_us >= 0 ? pred.total_us / 1000 : latency_ms,
+              0, 0, std::lround(readPeakRssMb() * 1024.0),
+              static_cast<int64_t>(time(nullptr)) * 1000};
+    r.reals = {m.precision, m.recall, m.f1, m.accuracy, m.hamming_loss, m.fnr};
+    return r;
+}
+
+static std::string journalJson(const JournalStats& j) {
+    return JsonObject()
+            .add("rows", static_cast<long>(j.rows))
+            .add("committed", static_cast<long>(j.committed_rows))
+            .add("pending_sync", static_cast<long>(j.committed_rows - j.sync_cursor))
+            .add("recovered", static_cast<long>(j.recovered_rows))
+            .add("heap_kb", j.heap_bytes / 1024.0)
+            .add("commits", j.commits)
+            .add("commit_mean_us", j.commits > 0 ? j.commit_us / j.commits : 0.0)
+            .add("commit_max_us", j.commit_max_us)
+            .add("append_mean_us", j.rows > 0 ? j.append_us / j.rows : 0.0)
+            .str();
+}
+
+static int exportJournal(const BenchArgs& args) {
+    ResultsJournal journal;
+    std::string error;
+    if (!journal.open(args.export_journal_path, predictionResultColumns(), JournalConfig(), error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    FILE* out = args.out_path.empty() ? stdout : fopen(args.out_path.c_str(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "Cannot write %s\n", args.out_path.c_str());
+        return 1;
+    }
+
+    auto t_export = std::chrono::steady_clock::now();
+    bool ok = args.export_format == "csv"
+              ? journal.exportCsv(out, 0, journal.rows())
+              : journal.exportJsonl(out, 0, journal.rows());
+    long export_ms = elapsedMs(t_export);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    JournalColumnStats latency = journal.columnStats(journal.columnIndex("latencyMs"));
+    fprintf(stderr, "Exported %llu rows in %ld ms; %s\nlatencyMs: %s\n",
+            static_cast<unsigned long long>(journal.rows()), export_ms,
+            journal.stats().toString().c_str(), latency.toString().c_str());
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    BenchArgs args;
+    if (!parseArgs(argc, argv, args)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (!args.rescore_path.empty()) {
+        return rescoreResults(args.rescore_path);
+    }
+    if (!args.export_journal_path.empty()) {
+        return exportJournal(args);
+    }
+    const bool pool = !args.resident_models.empty();
+    if (pool && (!args.lora_adapters.empty() || args.model_warmup_enabled || args.prefix_cache_enabled ||
+                 !args.preload_path.empty())) {
+        fprintf(stderr, "--lora, --model-warmup, --prefix-cache and --preload-next apply to --model, "
+                        "not to pool models\n");
+        return 2;
+    }
+    // Pool runs are labelled by their models, as --model is not loaded
+    std::string model_label = args.model_path;
+    if (pool) {
+        model_label = "pool";
+        for (size_t m = 0; m < args.resident_models.size(); m++) {
+            model_label += (m ? "+" : ":") + args.resident_models[m].first;
+        }
+    }
+
+    std::vector<BenchItem> items;
+    std::string error;
+    if (!loadBenchDataset(args.dataset_path, items, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    AllergenLexicon lexicon;
+    if (!args.lexicon_path.empty() && !lexicon.loadFromFile(args.lexicon_path, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    LexiconGatePolicy gate_policy;
+    LexiconGateStats gate_stats;
+
+    std::ofstream out_file;
+    if (!args.out_path.empty()) {
+        out_file.open(args.out_path);
+        if (!out_file) {
+            fprintf(stderr, "Cannot write %s\n", args.out_path.c_str());
+            return 1;
+        }
+    }
+    std::ostream& out = args.out_path.empty() ? std::cout : out_file;
+
+    ResultsJournal journal;
+    if (!args.journal_path.empty()
+        && !journal.open(args.journal_path, predictionResultColumns(), args.journal, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    if (!args.trace_path.empty()) {
+        traceSetThreadName("slm-bench");
+        traceSetEnabled(true);
+    }
+
+    ThermalSampler thermal;
+    if (args.thermal_enabled && !thermal.start(args.thermal, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    EnergyMeter energy;
+    EnergyTotals energy_totals;
+    if (args.energy_enabled && !energy.start(args.energy, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // Pool models load on demand inside the residency budget; a
+    // --model session next to them would be outside it
+    auto t_load = std::chrono::steady_clock::now();
+    EngineSession session;
+    if (pool && !args.model_path.empty()) {
+        fprintf(stderr, "note: %s is not loaded, items run on the --resident pool\n", args.model_path.c_str());
+    }
+    if (!pool && !loadEngineSession(session, args.model_path, args.engine)) {
+        fprintf(stderr, "Failed to load %s\n", args.model_path.c_str());
+        return 1;
+    }
+    long load_ms = elapsedMs(t_load);
+
+    WarmupReport warmup;
+    if (args.model_warmup_enabled) {
+        warmup = warmupEngineSession(session, args.model_warmup);
+        if (!warmup.hot) {
+            fprintf(stderr, "warning: model not hot after warmup (%s)\n", warmup.toString().c_str());
+        }
+    }
+
+    std::string adapters_json = "[";
+    for (const auto& lora : args.lora_adapters) {
+        LoraAdapterInfo info;
+        if (!session.adapters.load(session.model, lora.first, lora.second, info, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        adapters_json += (adapters_json.size() > 1 ? "," : "") + JsonObject()
+                .add("id", info.id)
+                .add("path", info.path)
+                .add("name", info.name)
+                .add("type", info.type)
+                .add("alpha", info.alpha)
+                .add("meta_keys", info.meta_keys)
+                .add("file_mb", info.file_mb)
+                .add("load_ms", info.load_ms)
+                .str();
+    }
+    adapters_json += "]";
+
+    if (args.prefix_cache_enabled && !enablePrefixCache(session, args.prefix_cache, error)) {
+        fprintf(stderr, "prefix cache: %s\n", error.c_str());
+        return 1;
+    }
+
+    JsonObject run;
+    run.add("type", "run")
+       .add("schema", BENCH_SCHEMA_VERSION)
+       .add("model", model_label)
+       .add("dataset", args.dataset_path)
+       .add("n_threads", args.engine.n_threads)
+       .add("n_threads_batch", args.engine.n_threads_batch)
+       .add("n_ctx", args.engine.n_ctx)
+       .add("n_batch", args.engine.n_batch)
+       .add("n_ubatch", args.engine.n_ubatch)
+       .add("kv_type", kvCacheTypeName(args.engine.type_k))
+       .add("flash_attn", flashAttnTypeName(args.engine.flash_attn))
+       .add("decode", decodeModeName(args.predict.decode_mode))
+       .add("max_tokens", args.predict.max_tokens)
+       .add("use_mmap", args.engine.use_mmap)
+       .add("use_mlock", args.engine.use_mlock)
+       .add("lexicon_gate", args.lexicon_gate)
+       .add("warmup_min", args.harness.warmup_min)
+       .add("warmup_max", args.harness.warmup_max)
+       .add("repetitions", args.harness.repetitions)
+       .add("steady_cv", args.harness.steady_cv)
+       .add("bootstrap", args.harness.bootstrap)
+       .add("load_ms", load_ms);
+    if (thermal.running()) {
+        auto names = [](const std::vector<std::string>& values) {
+            std::string list = "[";
+            for (size_t i = 0; i < values.size(); i++) {
+                list += (i ? ",\"" : "\"") + values[i] + "\"";
+            }
+            return list + "]";
+        };
+        run.add("thermal_ms", args.thermal.interval_ms)
+           .raw("thermal_clusters", names(thermal.clusters()))
+           .raw("thermal_zones", names(thermal.zones()));
+    }
+    if (energy.running()) {
+        run.add("energy_source", energySourceName(energy.source()))
+           .add("energy_device", energy.description())
+           .add("energy_ms", args.energy.interval_ms);
+    }
+    if (args.model_warmup_enabled) {
+        run.raw("model_warmup", JsonObject()
+                .add("ok", warmup.ok)
+                .add("hot", warmup.hot)
+                .add("rounds", warmup.rounds)
+                .add("total_ms", warmup.total_ms)
+                .add("decode_ms", warmup.decode_ms)
+                .add("prefetch_ms", warmup.prefetch_ms)
+                .add("pages_prefetched", warmup.pages_prefetched)
+                .add("major_faults", warmup.major_faults)
+                .add("minor_faults", warmup.minor_faults)
+                .add("last_round_major_faults", warmup.last_round_major_faults)
+                .add("mapped_mb", warmup.mapped_mb)
+                .add("resident_before_mb", warmup.resident_before_mb)
+                .add("resident_after_mb", warmup.resident_after_mb)
+                .str());
+    }
+    if (args.memory_report) {
+        run.raw("memory", memoryJson(engineMemoryBreakdown(session)));
+    }
+    if (!args.lora_adapters.empty()) {
+        run.raw("adapters", adapters_json);
+    }
+    if (session.prefix_cache.enabled()) {
+        run.raw("prefix_cache", JsonObject()
+                .add("n_seq", session.prefix_cache.config().n_seq)
+                .add("max_cells", session.prefix_cache.config().max_cells)
+                .str());
+    }
+    out << run.str() << "\n";
+    out.flush();
+
+    size_t begin = std::min(items.size(), static_cast<size_t>(std::max(args.offset, 0)));
+    size_t end = args.limit >= 0 ? std::min(items.size(), begin + args.limit) : items.size();
+
+    BenchHarness harness(args.harness);
+    std::vector<AllergenMask> run_truth, run_pred, run_evidence;
+    long run_failed = 0;
+    auto t_run = std::chrono::steady_clock::now();
+
+    ModelPreloader preloader;
+    std::map<std::string, AdapterUsage> adapter_usage;     // "" = base model
+
+    ModelResidency residency;
+    residency.setBudgetMb(args.residency_mb);
+    residency.setEngineConfig(args.engine);
+    for (const auto& model : args.resident_models) {
+        residency.registerModel(model.first, model.second);
+    }
+    std::vector<std::string> route = args.route;
+    if (route.empty()) {
+        for (const auto& model : args.resident_models) {
+            route.push_back(model.first);
+        }
+    }
+    const size_t preload_at = end - std::min(end - begin, static_cast<size_t>(std::max(args.preload_lead, 0)));
+
+    // Group by canonical ingredients; the first member to finish
+    // holds the result the rest of its group reuses
+    struct SharedResult {
+        PredictionOutput pred;
+        AllergenMask mask;
+        std::string id;
+    };
+    DedupPlan plan;
+    std::map<uint32_t, SharedResult> fanout;
+    long fanned_out = 0;
+    if (args.dedup) {
+        std::vector<std::string> texts;
+        for (size_t i = begin; i < end; i++) {
+            texts.push_back(items[i].ingredients);
+        }
+        plan = planDedup(texts, args.dedup_options);
+        fprintf(stderr, "dedup: %s\n", plan.toString().c_str());
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        const BenchItem& item = items[i];
+
+        if (!args.preload_path.empty() && i == preload_at) {
+            PreloadConfig preload;
+            preload.engine = args.engine;
+            if (!preloader.start(args.preload_path, preload, error)) {
+                fprintf(stderr, "preload not started: %s\n", error.c_str());
+            }
+        }
+
+        PredictionOptions options = args.predict;
+        options.clear_memory = true;
+        if (!args.adapter_route.empty()) {
+            const auto& adapter = args.adapter_route[(i - begin) % args.adapter_route.size()];
+            options.adapter = adapter.first;
+            options.adapter_scale = adapter.second;
+        }
+
+        const uint32_t group = args.dedup ? plan.group[i - begin] : 0;
+        auto shared = args.dedup ? fanout.find(group) : fanout.end();
+        const bool fanned = shared != fanout.end();
+
+        std::string path = fanned ? "DEDUP" : "MODEL";
+        LexiconScan scan;
+        LexiconDecision decision = LexiconDecision::FULL;
+        if (args.lexicon_gate && !fanned) {
+            scan = lexicon.scan(item.ingredients);
+            decision = decideLexiconGate(scan, gate_policy);
+            path = lexiconDecisionName(decision);
+            if (decision == LexiconDecision::HINT) {
+                options.hints = formatLexiconHints(lexicon, scan, item.ingredients);
+            }
+        }
+
+        auto t_item = std::chrono::steady_clock::now();
+        PredictionOutput pred;
+        AllergenMask mask;
+        HarnessItem measured;
+        std::string routed_id;
+        bool routed_hit = false;
+
+        if (fanned) {
+            pred = fannedOutput(shared->second.pred);
+            mask = shared->second.mask;
+            fanned_out++;
+        } else if (decision == LexiconDecision::TRUST) {
+            pred.ok = true;
+            pred.text = allergenMaskToString(scan.strong_mask);
+            mask = scan.strong_mask;
+        } else if (!route.empty()) {
+            const std::string& id = route[(i - begin) % route.size()];
+            long loads_before = residency.stats().loads;
+            measured = harness.measure([&]() {
+                return residency.predict(id, item.ingredients, options);
+            });
+            pred = measured.runs.front();
+            mask = pred.ok ? pred.mask : 0;
+            routed_id = id;
+            routed_hit = residency.stats().loads == loads_before;
+        } else {
+            measured = harness.measure([&]() {
+                return runAllergenPrediction(session, item.ingredients, options);
+            });
+            for (const PredictionOutput& run_out : measured.runs) {
+                preloader.noteForegroundItem(run_out.t_begin_us, run_out.t_end_us);
+            }
+            // Greedy decoding: every repetition gives the same text
+            pred = measured.runs.front();
+            mask = pred.ok ? pred.mask : 0;
+            if (!args.adapter_route.empty() && pred.ok) {
+                AdapterUsage& usage = adapter_usage[pred.adapter];
+                usage.items++;
+                for (const PredictionOutput& run_out : measured.runs) {
+                    if (run_out.adapter_switched) {
+                        usage.switches++;
+                        usage.switch_ms += run_out.adapter_switch_ms;
+                        usage.switch_max_ms = std::max(usage.switch_max_ms, run_out.adapter_switch_ms);
+                    }
+                    usage.prefill_us += run_out.prefill_decode_us;
+                    usage.prompt_tokens += run_out.prompt_tokens;
+                    usage.gen_us += run_out.gen_us;
+                    usage.generated_tokens += run_out.generated_tokens;
+                }
+            }
+        }
+        std::string model_name = routed_id.empty() ? model_label : routed_id;
+        if (!pred.adapter.empty()) {
+            char tag[32];
+            snprintf(tag, sizeof(tag), "@%.2f", pred.adapter_scale);
+            model_name += "+" + pred.adapter + tag;
+        }
+        if (fanned) {
+            model_name += "+dedup";
+        }
+        long latency_ms = fanned ? 0
+                          : measured.samples.latency_ms.empty()
+                          ? elapsedMs(t_item)
+                          : std::lround(percentileOf(measured.samples.latency_ms, 0.5));
+
+        if (args.dedup && !fanned && pred.ok) {
+            fanout[group] = SharedResult{pred, mask, item.id};
+        }
+        if (args.lexicon_gate && !fanned) {
+            gate_stats.record(decision, scan.scan_us, decision == LexiconDecision::TRUST ? 0 : latency_ms);
+        }
+
+        JsonObject rec;
+        rec.add("type", "item")
+           .add("index", static_cast<long>(i))
+           .add("id", item.id)
+           .add("name", item.name)
+           .add("ok", pred.ok)
+           .add("path", path)
+           .add("latency_ms", latency_ms)
+           .add("ttft_ms", pred.ttft_ms)
+           .add("prefill_ms", pred.prefill_ms)
+           .add("oet_ms", pred.oet_ms)
+           .add("itps", pred.itps)
+           .add("otps", pred.otps)
+           .add("prep_ms", pred.prep_us / 1000.0)
+           .add("prefill_decode_ms", pred.prefill_decode_us / 1000.0)
+           .add("gen_ms", pred.gen_us / 1000.0)
+           .add("prefill_tps", pred.prefill_tps)
+           .add("decode_tps", pred.decode_tps)
+           .raw("llama_perf", JsonObject()
+                   .add("load_ms", pred.llama_load_ms)
+                   .add("p_eval_ms", pred.llama_p_eval_ms)
+                   .add("n_p_eval", pred.llama_n_p_eval)
+                   .add("eval_ms", pred.llama_eval_ms)
+                   .add("n_eval", pred.llama_n_eval)
+                   .str())
+           .add("prompt_tokens", pred.prompt_tokens)
+           .add("generated_tokens", pred.generated_tokens)
+           .add("min_margin", pred.min_margin)
+           .add("mean_margin", pred.mean_margin)
+           .add("text", pred.ok ? pred.text : std::string())
+           .add("pred_mask", static_cast<int>(mask))
+           .add("labels", !pred.token_labels ? "text" : pred.label_fallback ? "fallback" : "token")
+           .add("pred_labels", allergenMaskToString(mask));
+        if (!routed_id.empty()) {
+            rec.add("model", routed_id)
+               .add("resident_hit", routed_hit);
+        }
+        if (args.dedup) {
+            rec.add("dedup_group", static_cast<long>(group));
+            if (fanned) {
+                rec.add("dedup_of", shared->second.id);
+            }
+        }
+        if (pred.prefix_cached) {
+            rec.add("prefix_reused_tokens", pred.prefix_reused_tokens);
+        }
+        if (!args.adapter_route.empty()) {
+            rec.add("adapter", pred.adapter.empty() ? "base" : pred.adapter)
+               .add("adapter_scale", pred.adapter_scale)
+               .add("adapter_switched", pred.adapter_switched)
+               .add("adapter_switch_ms", pred.adapter_switch_ms);
+        }
+
+        if (measured.runs.size() > 1 || measured.warmup_runs > 0) {
+            std::string reps = "[", flags = "[";
+            for (size_t r = 0; r < measured.runs.size(); r++) {
+                reps += (r ? "," : "") + std::to_string(measured.runs[r].total_us / 1000.0);
+                flags += (r ? "," : "") + std::string(measured.outlier[r] ? "true" : "false");
+            }
+            rec.add("warmup_runs", measured.warmup_runs)
+               .add("steady", measured.steady)
+               .add("drift", measured.drift)
+               .raw("rep_latency_ms", reps + "]")
+               .raw("rep_outlier", flags + "]");
+        }
+
+        if (thermal.running() && !measured.runs.empty()) {
+            // Per-token decode latency against the clocks it ran at
+            std::string steps = "[";
+            long long prev = pred.t_begin_us + pred.prep_us + pred.prefill_decode_us;
+            for (size_t s = 0; s < pred.step_end_us.size(); s++) {
+                steps += (s ? "," : "") + std::to_string((pred.step_end_us[s] - prev) / 1000.0);
+                prev = pred.step_end_us[s];
+            }
+            rec.raw("step_ms", steps + "]")
+               .raw("thermal", thermalJson(thermal.window(measured.runs.front().t_begin_us,
+                                                          measured.runs.back().t_end_us)));
+        }
+
+        if (energy.running() && !measured.runs.empty()) {
+            // One window per measured repetition, so the totals count
+            // predictions and the gaps between reps are left out; the
+            // item reports the mean repetition
+            EnergyWindow w;
+            int tokens = 0;
+            for (const PredictionOutput& r : measured.runs) {
+                EnergyWindow rep = energy.window(r.t_begin_us, r.t_end_us);
+                energy_totals.add(rep, r.generated_tokens);
+                w.joules += rep.joules;
+                w.seconds += rep.seconds;
+                w.samples += rep.samples;
+                tokens += r.generated_tokens;
+            }
+            const double reps = static_cast<double>(measured.runs.size());
+            rec.raw("energy", JsonObject()
+                    .add("joules", w.joules / reps)
+                    .add("j_per_token", tokens > 0 ? w.joules / tokens : 0.0)
+                    .add("avg_w", w.avgWatts())
+                    .add("samples", w.samples)
+                    .add("reps", static_cast<int>(measured.runs.size()))
+                    .str());
+        }
+
+        if (args.memory_report) {
+            // After the item, so KV usage reflects its prompt + output
+            rec.raw("memory", memoryJson(engineMemoryBreakdown(session)));
+        }
+
+        if (!pred.ok) {
+            rec.add("error", pred.error);
+            run_failed++;
+        }
+
+        if (!item.allergens_mapped.empty()) {
+            AllergenMask truth = parseAllergenList(item.allergens_mapped);
+            AllergenMask evidence = ingredientEvidenceMask(item.ingredients);
+            ItemMetrics m = computeItemMetrics(truth, mask, evidence);
+
+            rec.add("truth_mask", static_cast<int>(truth))
+               .add("evidence_mask", static_cast<int>(evidence))
+               .add("exact_match", m.exact_match)
+               .add("tp", m.tp)
+               .add("fp", m.fp)
+               .add("fn", m.fn)
+               .add("f1", m.f1)
+               .add("hallucinated", static_cast<int>(m.hallucinated));
+
+            run_truth.push_back(truth);
+            run_pred.push_back(mask);
+            run_evidence.push_back(evidence);
+
+            if (journal.isOpen() && pred.ok
+                && !journal.append(journalRecord(item, model_name, pred, mask, m, latency_ms), error)) {
+                fprintf(stderr, "journal: %s\n", error.c_str());
+            }
+        }
+
+        out << rec.str() << "\n";
+        out.flush();
+
+        fprintf(stderr, "[%zu/%zu] %s -> %s (%ld ms)\n",
+                i + 1, end, item.name.c_str(), allergenMaskToString(mask).c_str(), latency_ms);
+    }
+
+    MetricsSummary quality = computeMetricsSummary(run_truth.data(), run_pred.data(),
+                                                   run_evidence.data(), run_truth.size());
+    JsonObject summary;
+    summary.add("type", "summary")
+           .add("schema", BENCH_SCHEMA_VERSION)
+           .add("items", static_cast<long>(end - begin))
+           .add("failed", run_failed)
+           .add("wall_ms", elapsedMs(t_run))
+           .add("labeled", quality.items)
+           .add("exact_match_rate", quality.items > 0 ? static_cast<double>(quality.exact_matches) / quality.items : 0.0)
+           .add("micro_f1", quality.microF1())
+           .raw("quality", qualityJson(quality));
+    if (args.lexicon_gate) {
+        summary.add("lexicon", gate_stats.toString());
+    }
+    if (args.dedup) {
+        summary.raw("dedup", JsonObject()
+                .add("ignore_order", args.dedup_options.ignore_order)
+                .add("items", static_cast<long>(plan.items()))
+                .add("groups", static_cast<long>(plan.groups()))
+                .add("dedup_ratio", plan.dedupRatio())
+                .add("largest_group", static_cast<long>(plan.largestGroup()))
+                .add("fanned_out", fanned_out)
+                .add("plan_us", plan.plan_us)
+                .str());
+    }
+
+    const PhaseSamples& samples = harness.samples();
+    summary.add("harness_items", harness.items())
+           .add("steady_items", harness.steadyItems())
+           .add("rep_outliers", harness.outliers())
+           .raw("latency_ms", metricJson(summarizeMetric(samples.latency_ms, args.harness)))
+           .raw("ttft_ms", metricJson(summarizeMetric(samples.ttft_ms, args.harness)))
+           .raw("prep_ms", metricJson(summarizeMetric(samples.prep_ms, args.harness)))
+           .raw("prefill_ms", metricJson(summarizeMetric(samples.prefill_ms, args.harness)))
+           .raw("decode_ms", metricJson(summarizeMetric(samples.decode_ms, args.harness)))
+           .raw("prefill_tps", metricJson(summarizeMetric(samples.prefill_tps, args.harness)))
+           .raw("decode_tps", metricJson(summarizeMetric(samples.decode_tps, args.harness)));
+    double peak_rss_mb = readPeakRssMb();
+    summary.add("peak_rss_mb", peak_rss_mb);
+    if (!route.empty()) {
+        ResidencyStats res = residency.stats();
+        std::string resident = "[";
+        std::vector<std::string> ids = residency.residentIds();
+        for (size_t r = 0; r < ids.size(); r++) {
+            resident += (r ? ",\"" : "\"") + ids[r] + "\"";
+        }
+        summary.raw("residency", JsonObject()
+                .add("budget_mb", residency.budgetMb())
+                .add("requests", res.requests)
+                .add("hits", res.hits)
+                .add("hit_rate", res.requests > 0 ? static_cast<double>(res.hits) / res.requests : 0.0)
+                .add("loads", res.loads)
+                .add("evictions", res.evictions)
+                .add("failures", res.failures)
+                .add("load_ms", res.load_ms)
+                .add("peak_resident_mb", res.peak_resident_mb)
+                .raw("resident", resident + "]")
+                .str());
+    }
+    if (!adapter_usage.empty()) {
+        // Overhead is decode ms/token against the base model's items
+        auto base = adapter_usage.find("");
+        double base_decode = base != adapter_usage.end() ? base->second.decodeMsPerToken() : 0.0;
+        std::string adapters = "[";
+        for (const auto& entry : adapter_usage) {
+            const AdapterUsage& u = entry.second;
+            JsonObject a;
+            a.add("adapter", entry.first.empty() ? "base" : entry.first)
+             .add("items", u.items)
+             .add("switches", u.switches)
+             .add("switch_ms_mean", u.switches > 0 ? u.switch_ms / u.switches : 0.0)
+             .add("switch_ms_max", u.switch_max_ms)
+             .add("prefill_ms_per_token", u.prefillMsPerToken())
+             .add("decode_ms_per_token", u.decodeMsPerToken());
+            if (base_decode > 0.0 && !entry.first.empty()) {
+                a.add("decode_overhead_pct", (u.decodeMsPerToken() / base_decode - 1.0) * 100.0);
+            }
+            adapters += (adapters.size() > 1 ? "," : "") + a.str();
+        }
+        summary.raw("adapters", adapters + "]");
+    }
+    if (session.prefix_cache.enabled()) {
+        const PrefixCacheStats pc = session.prefix_cache.stats();
+        summary.raw("prefix_cache", JsonObject()
+                .add("lookups", pc.lookups)
+                .add("hits", pc.hits)
+                .add("prompt_tokens", pc.prompt_tokens)
+                .add("reused_tokens", pc.reused_tokens)
+                .add("reused_ratio", pc.reusedRatio())
+                .add("prefill_tokens", pc.prefill_tokens)
+                .add("prefill_ms", pc.prefill_ms)
+                .add("prefill_us_per_token", pc.prefill_us_per_token)
+                .add("saved_ms", pc.savedMs())
+                .add("evictions", pc.evictions)
+                .add("evicted_cells", pc.evicted_cells)
+                .add("branches", pc.branches)
+                .add("cells", pc.cells)
+                .str());
+        fprintf(stderr, "prefix cache: %s\n", pc.toString().c_str());
+    }
+    if (journal.isOpen()) {
+        if (!journal.flush(error)) {
+            fprintf(stderr, "journal: %s\n", error.c_str());
+        }
+        summary.raw("journal", journalJson(journal.stats()));
+    }
+    if (energy.running()) {
+        const EnergyTotals& e = energy_totals;
+        summary.raw("energy", JsonObject()
+                .add("items", e.items)
+                .add("joules", e.joules)
+                .add("j_per_item", e.items > 0 ? e.joules / e.items : 0.0)
+                .add("j_per_token", e.output_tokens > 0 ? e.joules / e.output_tokens : 0.0)
+                .add("avg_w", e.seconds > 0.0 ? e.joules / e.seconds : 0.0)
+                .str());
+        energy.stop();
+    }
+    out << summary.str() << "\n";
+
+    if (preloader.pending()) {
+        // The switch a multi-model sweep would make next
+        PreloadReport preload;
+        bool swapped = preloader.swapInto(session, preload);
+        JsonObject record;
+        record.add("type", "preload")
+              .add("model", args.preload_path)
+              .add("ok", swapped)
+              .add("estimate_mb", preload.estimate_mb)
+              .add("available_mb", preload.available_mb)
+              .add("load_ms", preload.load_ms)
+              .add("prefetch_ms", preload.prefetch_ms)
+              .add("busy_ms", preload.busy_ms)
+              .add("wait_ms", preload.wait_ms)
+              .add("swap_ms", preload.swap_ms)
+              .add("free_ms", preload.free_ms)
+              .add("cold_load_ms", load_ms)
+              .add("overlap_ms", preload.overlap_ms)
+              .add("overlap_fraction", preload.overlapFraction())
+              .add("fg_items_during", preload.fg_items_during)
+              .add("fg_mean_ms_during", preload.fg_mean_ms_during)
+              .add("fg_items_outside", preload.fg_items_outside)
+              .add("fg_mean_ms_outside", preload.fg_mean_ms_outside)
+              .add("contention_pct", preload.contentionPct());
+        if (!swapped) {
+            record.add("error", preload.error);
+        }
+        out << record.str() << "\n";
+        fprintf(stderr, "preload: %s\n", preload.toString().c_str());
+    }
+
+    freeEngineSession(session);
+    if (thermal.running()) {
+        thermal.stop();
+        if (!args.thermal_out.empty() && !thermal.writeSamplesJsonl(args.thermal_out, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+        }
+    }
+    if (!args.trace_path.empty()) {
+        traceSetEnabled(false);
+        if (!traceWriteChromeJson(args.trace_path, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+        }
+    }
+    if (run_failed > 0 && run_failed == static_cast<long>(end - begin)) {
+        return 1;
+    }
+    if (args.baseline_path.empty()) {
+        return 0;
+    }
+
+    // ---- Regression gate ----
+    BaselineEntry current;
+    current.key = baselineKey(args.device.empty() ? deviceFingerprint() : args.device,
+                              model_label, configKey(args));
+    current.created = static_cast<long long>(time(nullptr));
+    current.samples.ttft_ms = samples.ttft_ms;
+    current.samples.prefill_tps = samples.prefill_tps;
+    current.samples.decode_tps = samples.decode_tps;
+    current.samples.peak_rss_mb = peak_rss_mb;
+
+    if (args.save_baseline) {
+        if (!saveBaseline(args.baseline_path, current, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        fprintf(stderr, "Saved baseline %s\n", current.key.c_str());
+        return 0;
+    }
+
+    std::vector<BaselineEntry> baselines;
+    if (!loadBaselines(args.baseline_path, baselines, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const BaselineEntry* baseline = findBaseline(baselines, current.key);
+    if (baseline == nullptr) {
+        // First run on a new device/config: nothing to gate against yet
+        fprintf(stderr, "No baseline for %s (run with --save-baseline)\n", current.key.c_str());
+        out << JsonObject().add("type", "regression").add("key", current.key).add("baseline", false).str() << "\n";
+        return 0;
+    }
+
+    std::vector<MetricComparison> comparison = compareToBaseline(baseline->samples, current.samples, args.regression);
+    bool regressed = anyRegression(comparison);
+
+    JsonObject record;
+    record.add("type", "regression")
+          .add("key", current.key)
+          .add("baseline", true)
+          .add("baseline_created", static_cast<long>(baseline->created))
+          .add("alpha", args.regression.alpha)
+          .add("regressed", regressed);
+    for (const MetricComparison& c : comparison) {
+        record.raw(c.metric.c_str(), JsonObject()
+                .add("verdict", metricVerdictName(c.verdict))
+                .add("baseline_median", c.base_median)
+                .add("current_median", c.cur_median)
+                .add("change", c.change)
+                .add("tolerance", c.tolerance)
+                .add("p_value", c.p_value)
+                .add("tested", c.tested)
+                .add("n_baseline", c.n_base)
+                .add("n_current", c.n_cur)
+                .str());
+    }
+    out << record.str() << "\n";
+
+    fprintf(stderr, "\nBaseline %s\n%s", current.key.c_str(), formatRegressionReport(comparison).c_str());
+    return regressed ? 3 : 0;
+}
@@ -0,0 +1,593 @@
+// ===============================================================
+// SLM-HEAD
+// Trains the allergen classification head (allergen-head.h) on the
+// labeled items of a dataset, or loads a trained one, and evaluates
+// it on held-out items next to the generative path: accuracy,
+// per-item latency and the training cost. With --knn the same
+// training items also fill an embedding index (embedding-index.h)
+// and its neighbour vote is evaluated alongside; each test item is
+// embedded once and shared by both predictors. --hnsw adds an HNSW
+// graph (hnsw-index.h) over that index and measures its recall and
+// latency against the exact scan, and the near-duplicate reuse path.
+// ===============================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "../allergen-head.h"
+#include "../allergen-labels.h"
+#include "../allergen-metrics.h"
+#include "../embedding-index.h"
+#include "../hnsw-index.h"
+#include "../slm-engine.h"
+#include "../slm-log.h"
+#include "bench-dataset.h"
+#include "bench-json.h"
+
+struct HeadArgs {
+    std::string model_path;
+    std::string dataset_path;
+    std::string train_path;     // train and save here
+    std::string head_path;      // or load from here
+    std::string knn_path;       // embedding index, built from the training items
+    bool knn_reuse = false;     // keep the rows of an existing index
+    std::string hnsw_path;      // graph over the index, rebuilt unless it matches
+    float reuse_similarity = 0.95f;
+    std::string out_path;
+    float split = 0.8f;         // fraction of labeled items used for training
+    bool compare = false;
+    int max_tokens = 40;
+    EngineConfig engine;
+    HeadConfig head;
+    KnnConfig knn;
+    HnswConfig hnsw;
+};
+
+static void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s -m model.gguf -d dataset.csv --train head.bin [options]\n"
+            "       %s -m model.gguf -d dataset.csv --head head.bin [options]\n"
+            "       %s -m model.gguf -d dataset.csv --knn index.knn [options]\n"
+            "\n"
+            "  -m, --model PATH       GGUF model\n"
+            "  -d, --dataset PATH     CSV/TSV with id,name,ingredients,allergens_mapped\n"
+            "  --train PATH           extract embeddings, train a head and save it to PATH\n"
+            "  --head PATH            evaluate a saved head instead of training one\n"
+            "  --knn PATH             build an embedding index of the training items at PATH\n"
+            "                         and evaluate its k-NN vote (with or without a head)\n"
+            "  --knn-reuse            query an existing index at PATH instead of rebuilding\n"
+            "  --knn-k N              neighbours that vote (default 5)\n"
+            "  --knn-vote X           similarity-weighted share that predicts a label (default 0.5)\n"
+            "  --knn-min-sim X        neighbours below this cosine do not vote (default 0)\n"
+            "  --hnsw PATH            HNSW graph over the --knn index, loaded when it matches\n"
+            "                         the index and built (with -t threads) otherwise\n"
+            "  --hnsw-m N             links per node (default 16)\n"
+            "  --hnsw-ef N            search candidate list (default 64)\n"
+            "  --hnsw-ef-build N      build candidate list (default 100)\n"
+            "  --reuse-sim X          reuse the nearest item's labels at this cosine (default 0.95)\n"
+            "  --split X              fraction of labeled items to train on; the rest is\n"
+            "                         the test set (default 0.8, same shuffle for --head)\n"
+            "  --epochs N             training epochs (default 40)\n"
+            "  --batch N              items per optimizer step (default 16)\n"
+            "  --lr X                 AdamW learning rate (default 0.002)\n"
+            "  --val X                tail of the training items for the val loss (default 0.1)\n"
+            "  --threshold X          sigmoid output that counts as a label (default 0.5)\n"
+            "  --seed N               split and init seed (default 1)\n"
+            "  --compare              also run generation on the test items\n"
+            "  --max-tokens N         generation cap for --compare (default 40)\n"
+            "  -t, --threads N        threads (default 6)\n"
+            "  -o, --out PATH         JSONL output (default: stdout)\n"
+            "  -v, --verbose          engine logs to stderr\n",
+            argv0, argv0, argv0);
+}
+
+static bool parseArgs(int argc, char** argv, HeadArgs& args) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "missing value for %s\n", arg.c_str());
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-m" || arg == "--model") {
+            args.model_path = value();
+        } else if (arg == "-d" || arg == "--dataset") {
+            args.dataset_path = value();
+        } else if (arg == "--train") {
+            args.train_path = value();
+        } else if (arg == "--head") {
+            args.head_path = value();
+        } else if (arg == "--knn") {
+            args.knn_path = value();
+        } else if (arg == "--knn-reuse") {
+            args.knn_reuse = true;
+        } else if (arg == "--knn-k") {
+            args.knn.k = atoi(value());
+        } else if (arg == "--knn-vote") {
+            args.knn.vote = static_cast<float>(atof(value()));
+        } else if (arg == "--knn-min-sim") {
+            args.knn.min_similarity = static_cast<float>(atof(value()));
+        } else if (arg == "--hnsw") {
+            args.hnsw_path = value();
+        } else if (arg == "--hnsw-m") {
+            args.hnsw.m = atoi(value());
+        } else if (arg == "--hnsw-ef") {
+            args.hnsw.ef_search = atoi(value());
+        } else if (arg == "--hnsw-ef-build") {
+            args.hnsw.ef_construction = atoi(value());
+        } else if (arg == "--reuse-sim") {
+            args.reuse_similarity = static_cast<float>(atof(value()));
+        } else if (arg == "--split") {
+            args.split = static_cast<float>(atof(value()));
+        } else if (arg == "--epochs") {
+            args.head.epochs = atoi(value());
+        } else if (arg == "--batch") {
+            args.head.batch = atoi(value());
+        } else if (arg == "--lr") {
+            args.head.learning_rate = static_cast<float>(atof(value()));
+        } else if (arg == "--val") {
+            args.head.val_split = static_cast<float>(atof(value()));
+        } else if (arg == "--threshold") {
+            args.head.threshold = static_cast<float>(atof(value()));
+        } else if (arg == "--seed") {
+            args.head.seed = static_cast<unsigned>(atol(value()));
+        } else if (arg == "--compare") {
+            args.compare = true;
+        } else if (arg == "--max-tokens") {
+            args.max_tokens = atoi(value());
+        } else if (arg == "-t" || arg == "--threads") {
+            args.engine.n_threads = atoi(value());
+        } else if (arg == "-o" || arg == "--out") {
+            args.out_path = value();
+        } else if (arg == "-v" || arg == "--verbose") {
+            g_slm_log_verbose = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", arg.c_str());
+            return false;
+        }
+    }
+
+    args.head.n_threads = args.engine.n_threads;
+    args.hnsw.n_threads = args.engine.n_threads;
+    args.hnsw.seed = args.head.seed;
+    const bool with_head = !args.train_path.empty() || !args.head_path.empty();
+    return !args.model_path.empty() && !args.dataset_path.empty()
+           && (args.train_path.empty() || args.head_path.empty())
+           && (with_head || !args.knn_path.empty()) && args.knn.k > 0
+           && (args.hnsw_path.empty() || !args.knn_path.empty());
+}
+
+static double msSince(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(rank, values.size() - 1)];
+}
+
+static std::string pathJson(const std::vector<AllergenMask>& truth, const std::vector<AllergenMask>& pred,
+                            const std::vector<double>& latency_ms, long failed) {
+    MetricsSummary m = computeMetricsSummary(truth.data(), pred.data(), nullptr, truth.size());
+    double mean = 0.0;
+    for (double v : latency_ms) {
+        mean += v;
+    }
+    return JsonObject()
+            .add("items", m.items)
+            .add("failed", failed)
+            .add("exact_match_rate", m.items > 0 ? static_cast<double>(m.exact_matches) / m.items : 0.0)
+            .add("micro_f1", m.microF1())
+            .add("macro_f1", m.macroF1())
+            .add("hamming_loss", m.hamming_loss)
+            .add("latency_ms_mean", latency_ms.empty() ? 0.0 : mean / latency_ms.size())
+            .add("latency_ms_p50", percentile(latency_ms, 0.5))
+            .add("latency_ms_p95", percentile(latency_ms, 0.95))
+            .str();
+}
+
+int main(int argc, char** argv) {
+    HeadArgs args;
+    if (!parseArgs(argc, argv, args)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    std::vector<BenchItem> all;
+    std::string error;
+    if (!loadBenchDataset(args.dataset_path, all, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::vector<BenchItem> items;
+    for (const BenchItem& item : all) {
+        if (!item.allergens_mapped.empty()) {
+            items.push_back(item);
+        }
+    }
+    std::shuffle(items.begin(), items.end(), std::mt19937(args.head.seed));
+    const size_t n_train = std::min(items.size(), static_cast<size_t>(items.size() * args.split + 0.5));
+    if (n_train == 0 || n_train == items.size()) {
+        fprintf(stderr, "--split leaves no %s items (%zu labeled)\n",
+                n_train == 0 ? "training" : "test", items.size());
+        return 1;
+    }
+
+    std::ofstream out_file;
+    if (!args.out_path.empty()) {
+        out_file.open(args.out_path);
+        if (!out_file) {
+            fprintf(stderr, "Cannot write %s\n", args.out_path.c_str());
+            return 1;
+        }
+    }
+    std::ostream& out = args.out_path.empty() ? std::cout : out_file;
+
+    EngineSession session;
+    if (!loadEngineSession(session, args.model_path, args.engine)) {
+        fprintf(stderr, "Failed to load %s\n", args.model_path.c_str());
+        return 1;
+    }
+    char desc[128];
+    llama_model_desc(session.model, desc, sizeof(desc));
+
+    const int n_embd = llama_model_n_embd(session.model);
+    AllergenHead head;
+    EmbeddingIndex index;
+    bool build_index = false;
+    if (!args.knn_path.empty()) {
+        auto t_open = std::chrono::steady_clock::now();
+        if (!index.open(args.knn_path, n_embd, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        build_index = !args.knn_reuse || index.rows() == 0;
+        if (build_index && !index.clear(error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        if (!build_index) {
+            out << JsonObject()
+                    .add("type", "knn_build")
+                    .add("reused", true)
+                    .add("rows", static_cast<long>(index.rows()))
+                    .add("open_ms", msSince(t_open))
+                    .add("mapped_kb", index.stats().mapped_kb)
+                    .str() << "\n";
+        }
+    }
+
+    if (!args.train_path.empty() || build_index) {
+        // Embeddings once, then training and the index never touch the model
+        auto t_embed = std::chrono::steady_clock::now();
+        std::vector<float> features, embedding;
+        std::vector<AllergenMask> masks;
+        long tokens = 0;
+        for (size_t i = 0; i < n_train; i++) {
+            int n_tokens = 0;
+            if (!embedIngredients(session, items[i].ingredients, embedding, n_tokens, error)) {
+                fprintf(stderr, "%s: %s\n", items[i].id.c_str(), error.c_str());
+                continue;
+            }
+            features.insert(features.end(), embedding.begin(), embedding.end());
+            masks.push_back(parseAllergenList(items[i].allergens_mapped));
+            tokens += n_tokens;
+        }
+        double embed_ms = msSince(t_embed);
+
+        if (build_index) {
+            auto t_build = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < masks.size(); r++) {
+                if (!index.insert(features.data() + r * n_embd, masks[r], error)) {
+                    fprintf(stderr, "%s\n", error.c_str());
+                    return 1;
+                }
+            }
+            if (!index.flush(error)) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+            double build_ms = msSince(t_build);
+            EmbeddingIndexStats stats = index.stats();
+            struct stat st {};
+            stat(args.knn_path.c_str(), &st);
+            out << JsonObject()
+                    .add("type", "knn_build")
+                    .add("reused", false)
+                    .add("rows", static_cast<long>(stats.rows))
+                    .add("dim", stats.dim)
+                    .add("embed_ms", embed_ms)
+                    .add("build_ms", build_ms)
+                    .add("insert_us_mean", stats.inserts > 0 ? stats.insert_us / stats.inserts : 0.0)
+                    .add("inserts_per_s", build_ms > 0.0 ? stats.rows * 1000.0 / build_ms : 0.0)
+                    .add("index_path", args.knn_path)
+                    .add("file_kb", st.st_size / 1024.0)
+                    .str() << "\n";
+            out.flush();
+        }
+
+        if (!args.train_path.empty()) {
+            HeadTrainReport report;
+            if (!head.train(features, masks, n_embd, args.head, report, error)
+                || !head.save(args.train_path, desc, error)) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+            struct stat st {};
+            stat(args.train_path.c_str(), &st);
+
+            std::string losses = "[";
+            for (size_t e = 0; e < report.epoch_loss.size(); e++) {
+                losses += (e ? "," : "") + std::to_string(report.epoch_loss[e]);
+            }
+            out << JsonObject()
+                    .add("type", "train")
+                    .add("model", args.model_path)
+                    .add("backend", report.backend)
+                    .add("samples", report.samples)
+                    .add("train_samples", report.train_samples)
+                    .add("val_samples", report.val_samples)
+                    .add("epochs", report.epochs)
+                    .add("batch", args.head.batch)
+                    .add("learning_rate", args.head.learning_rate)
+                    .add("embed_ms", embed_ms)
+                    .add("embed_tokens", tokens)
+                    .add("train_ms", report.train_ms)
+                    .add("train_loss", report.train_loss)
+                    .add("val_loss", report.val_loss)
+                    .raw("epoch_loss", losses + "]")
+                    .add("head_path", args.train_path)
+                    .add("head_kb", st.st_size / 1024.0)
+                    .str() << "\n";
+            out.flush();
+        }
+    }
+    if (!args.head_path.empty() && !head.load(args.head_path, desc, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const bool with_head = head.ready();
+    const bool with_knn = index.isOpen();
+
+    HnswIndex graph;
+    if (!args.hnsw_path.empty()) {
+        auto t_load = std::chrono::steady_clock::now();
+        bool loaded = graph.load(args.hnsw_path, error) && graph.matches(index);
+        double load_ms = msSince(t_load);
+        HnswBuildReport report;
+        if (!loaded && (!graph.build(index, args.hnsw, report, error) || !graph.save(args.hnsw_path, error))) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        JsonObject rec;
+        rec.add("type", "hnsw_build")
+           .add("loaded", loaded)
+           .add("rows", static_cast<long>(graph.rows()))
+           .add("levels", graph.maxLevel() + 1)
+           .add("m", args.hnsw.m)
+           .add("file_kb", graph.bytes() / 1024.0);
+        if (loaded) {
+            rec.add("load_ms", load_ms);
+        } else {
+            rec.add("threads", report.threads)
+               .add("ef_construction", args.hnsw.ef_construction)
+               .add("degree_mean", report.degree_mean)
+               .add("build_ms", report.build_ms)
+               .add("rows_per_s", report.build_ms > 0.0 ? report.rows * 1000.0 / report.build_ms : 0.0);
+        }
+        out << rec.str() << "\n";
+        out.flush();
+    }
+    const bool with_hnsw = graph.ready();
+
+    PredictionOptions options;
+    options.clear_memory = true;
+    options.max_tokens = args.max_tokens;
+
+    std::vector<AllergenMask> truth, head_pred, knn_pred, gen_pred;
+    std::vector<double> head_ms, knn_ms, gen_ms;
+    long head_failed = 0, knn_failed = 0, gen_failed = 0;
+    // HNSW: recall against the exact scan, and the reuse path (nearest
+    // item's labels above --reuse-sim, else generation with --compare)
+    std::vector<double> hnsw_us, exact_us, recall;
+    std::vector<AllergenMask> reuse_truth, reuse_pred, fallback_pred;
+    std::vector<double> reuse_ms, fallback_ms;
+    long fallback_failed = 0;
+    std::vector<float> embedding;
+    for (size_t i = n_train; i < items.size(); i++) {
+        const BenchItem& item = items[i];
+        AllergenMask expected = parseAllergenList(item.allergens_mapped);
+        truth.push_back(expected);
+
+        // One prefill feeds both predictors
+        int prompt_tokens = 0;
+        auto t_embed = std::chrono::steady_clock::now();
+        bool embedded = embedIngredients(session, item.ingredients, embedding, prompt_tokens, error);
+        double embed_ms = msSince(t_embed);
+
+        JsonObject rec;
+        rec.add("type", "item")
+           .add("id", item.id)
+           .add("truth_mask", static_cast<int>(expected))
+           .add("embed_ms", embed_ms)
+           .add("prompt_tokens", prompt_tokens);
+        if (!embedded) {
+            rec.add("error", error);
+        }
+
+        AllergenMask shown = 0;
+        if (with_head) {
+            auto t_head = std::chrono::steady_clock::now();
+            AllergenMask mask = embedded ? head.predict(embedding.data()) : 0;
+            double head_us = msSince(t_head) * 1000.0;
+            head_pred.push_back(mask);
+            if (embedded) {
+                head_ms.push_back(embed_ms + head_us / 1000.0);
+            } else {
+                head_failed++;
+            }
+            rec.add("head_mask", static_cast<int>(mask))
+               .add("head_ms", embed_ms + head_us / 1000.0)
+               .add("head_us", head_us);
+            shown = mask;
+        }
+        if (with_knn) {
+            KnnPrediction kp;
+            if (embedded) {
+                kp = index.predict(embedding.data(), args.knn);
+            }
+            knn_pred.push_back(kp.mask);
+            if (!kp.empty()) {
+                knn_ms.push_back(embed_ms + kp.scan_us / 1000.0);
+            } else {
+                knn_failed++;
+            }
+            rec.add("knn_mask", static_cast<int>(kp.mask))
+               .add("knn_ms", embed_ms + kp.scan_us / 1000.0)
+               .add("knn_scan_us", kp.scan_us)
+               .add("knn_neighbors", static_cast<long>(kp.neighbors.size()))
+               .add("knn_top_sim", kp.top_similarity);
+            if (!with_head) {
+                shown = kp.mask;
+            }
+        }
+
+        double gen_latency = -1.0;     // failed or not run
+        if (args.compare) {
+            auto t_gen = std::chrono::steady_clock::now();
+            PredictionOutput pred = runAllergenPrediction(session, item.ingredients, options);
+            double latency = msSince(t_gen);
+            gen_pred.push_back(pred.ok ? pred.mask : 0);
+            if (pred.ok) {
+                gen_latency = latency;
+                gen_ms.push_back(latency);
+            } else {
+                gen_failed++;
+            }
+            rec.add("gen_mask", static_cast<int>(gen_pred.back()))
+               .add("gen_ms", latency)
+               .add("gen_tokens", pred.generated_tokens);
+        }
+
+        bool reused = false;
+        double lookup_ms = embed_ms;
+        AllergenMask reuse_mask = 0;
+        if (with_hnsw && embedded) {
+            const int k = args.knn.k;
+            auto t_exact = std::chrono::steady_clock::now();
+            std::vector<KnnNeighbor> exact = index.search(embedding.data(), k);
+            exact_us.push_back(msSince(t_exact) * 1000.0);
+            auto t_hnsw = std::chrono::steady_clock::now();
+            std::vector<KnnNeighbor> approx = graph.search(index, embedding.data(), k, args.hnsw.ef_search);
+            hnsw_us.push_back(msSince(t_hnsw) * 1000.0);
+
+            size_t hits = 0;
+            for (const KnnNeighbor& a : approx) {
+                for (const KnnNeighbor& e : exact) {
+                    hits += a.row == e.row;
+                }
+            }
+            recall.push_back(exact.empty() ? 1.0 : static_cast<double>(hits) / exact.size());
+
+            reused = !approx.empty() && approx.front().similarity >= args.reuse_similarity;
+            lookup_ms += hnsw_us.back() / 1000.0;
+            if (reused) {
+                reuse_mask = approx.front().mask;
+                reuse_truth.push_back(expected);
+                reuse_pred.push_back(reuse_mask);
+                reuse_ms.push_back(lookup_ms);
+            }
+            rec.add("exact_us", exact_us.back())
+               .add("hnsw_us", hnsw_us.back())
+               .add("recall", recall.back())
+               .add("nearest_sim", approx.empty() ? 0.0f : approx.front().similarity)
+               .add("reused", reused);
+            if (reused) {
+                rec.add("reuse_mask", static_cast<int>(reuse_mask));
+            }
+        }
+        if (with_hnsw && args.compare) {
+            fallback_pred.push_back(reused ? reuse_mask : gen_pred.back());
+            if (reused || gen_latency >= 0.0) {
+                fallback_ms.push_back(lookup_ms + (reused ? 0.0 : gen_latency));
+            } else {
+                fallback_failed++;
+            }
+        }
+
+        out << rec.str() << "\n";
+        fprintf(stderr, "[%zu/%zu] %s -> %s (%.1f ms)\n", i - n_train + 1, items.size() - n_train,
+                item.name.c_str(), allergenMaskToString(shown).c_str(), embed_ms);
+    }
+
+    JsonObject summary;
+    summary.add("type", "summary")
+           .add("train_items", static_cast<long>(n_train))
+           .add("test_items", static_cast<long>(items.size() - n_train));
+    if (with_head) {
+        summary.add("threshold", head.threshold())
+               .raw("head", pathJson(truth, head_pred, head_ms, head_failed));
+    }
+    if (with_knn) {
+        summary.add("knn_k", args.knn.k)
+               .add("knn_rows", static_cast<long>(index.rows()))
+               .raw("knn", pathJson(truth, knn_pred, knn_ms, knn_failed));
+    }
+    if (with_hnsw) {
+        double mean_recall = 0.0;
+        for (double r : recall) {
+            mean_recall += r;
+        }
+        summary.raw("hnsw", JsonObject()
+                .add("k", args.knn.k)
+                .add("ef", args.hnsw.ef_search)
+                .add("recall_at_k", recall.empty() ? 0.0 : mean_recall / recall.size())
+                .add("query_us_p50", percentile(hnsw_us, 0.5))
+                .add("query_us_p95", percentile(hnsw_us, 0.95))
+                .add("exact_us_p50", percentile(exact_us, 0.5))
+                .add("exact_us_p95", percentile(exact_us, 0.95))
+                .add("reuse_similarity", args.reuse_similarity)
+                .add("reuse_rate", truth.empty() ? 0.0 : static_cast<double>(reuse_pred.size()) / truth.size())
+                .str());
+        summary.raw("reused", pathJson(reuse_truth, reuse_pred, reuse_ms, 0));
+        if (args.compare) {
+            summary.raw("reuse_or_generate", pathJson(truth, fallback_pred, fallback_ms, fallback_failed));
+        }
+    }
+    if (args.compare) {
+        summary.raw("generative", pathJson(truth, gen_pred, gen_ms, gen_failed));
+        const double gen_p50 = percentile(gen_ms, 0.5);
+        if (with_head) {
+            double head_p50 = percentile(head_ms, 0.5);
+            summary.add("speedup_p50", head_p50 > 0.0 ? gen_p50 / head_p50 : 0.0);
+        }
+        if (with_knn) {
+            double knn_p50 = percentile(knn_ms, 0.5);
+            summary.add("knn_speedup_p50", knn_p50 > 0.0 ? gen_p50 / knn_p50 : 0.0);
+        }
+    }
+    out << summary.str() << "\n";
+
+    graph.close();
+    index.close();
+    freeEngineSession(session);
+    return 0;
+}
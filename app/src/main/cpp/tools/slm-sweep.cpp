@@ -0,0 +1,372 @@
+// ===============================================================
+// SLM-SWEEP
+// Runs the allergen engine over a grid (or random sample) of
+// deployment configurations, checkpointing each finished point so a
+// killed sweep resumes, then reports every point plus the per-model
+// Pareto frontier of latency, throughput, memory and accuracy.
+// ===============================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../allergen-labels.h"
+#include "../slm-engine.h"
+#include "../slm-log.h"
+#include "bench-dataset.h"
+#include "bench-json.h"
+#include "bench-memory.h"
+#include "bench-sweep.h"
+
+struct SweepArgs {
+    std::string spec_path;
+    std::string dataset_path;
+    std::string checkpoint_path;
+    std::string out_path;
+    bool fresh = false;
+};
+
+static void printUsage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s -s sweep.txt -d dataset.csv [options]\n"
+            "\n"
+            "  -s, --spec PATH        sweep spec (key = value, lists comma separated)\n"
+            "  -d, --dataset PATH     CSV/TSV with id,name,ingredients,allergens_mapped\n"
+            "  -k, --checkpoint PATH  completed points (default: <spec>.ckpt)\n"
+            "  -o, --out PATH         JSONL report (default: stdout)\n"
+            "  --fresh                ignore and truncate an existing checkpoint\n"
+            "  -v, --verbose          engine logs to stderr\n"
+            "\n"
+            "spec keys: mode (grid|random), samples, seed, items, max_tokens, models,\n"
+            "  threads, n_batch, n_ubatch, n_ctx, kv_type, flash_attn (auto|on|off),\n"
+            "  mmap, mlock, decode (newline|eog)\n",
+            argv0);
+}
+
+static bool parseArgs(int argc, char** argv, SweepArgs& args) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "missing value for %s\n", arg.c_str());
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-s" || arg == "--spec") {
+            args.spec_path = value();
+        } else if (arg == "-d" || arg == "--dataset") {
+            args.dataset_path = value();
+        } else if (arg == "-k" || arg == "--checkpoint") {
+            args.checkpoint_path = value();
+        } else if (arg == "-o" || arg == "--out") {
+            args.out_path = value();
+        } else if (arg == "--fresh") {
+            args.fresh = true;
+        } else if (arg == "-v" || arg == "--verbose") {
+            g_slm_log_verbose = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else {
+            fprintf(stderr, "unknown argument '%s'\n", arg.c_str());
+            return false;
+        }
+    }
+
+    if (args.spec_path.empty() || args.dataset_path.empty()) {
+        return false;
+    }
+    if (args.checkpoint_path.empty()) {
+        args.checkpoint_path = args.spec_path + ".ckpt";
+    }
+    return true;
+}
+
+static long elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - since).count();
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(rank, values.size() - 1)];
+}
+
+static void runPoint(EngineSession& session, const SweepPoint& point, const std::vector<BenchItem>& items,
+                     int max_tokens, SweepResult& result) {
+    PredictionOptions options;
+    options.clear_memory = true;
+    options.max_tokens = max_tokens;
+    options.decode_mode = point.decode_mode;
+
+    std::vector<double> latencies, ttfts;
+    long prompt_tokens = 0, generated_tokens = 0;
+    long long prefill_us = 0, decode_us = 0;
+    long tp = 0, fp = 0, fn = 0, exact = 0;
+
+    for (const BenchItem& item : items) {
+        auto t_item = std::chrono::steady_clock::now();
+        PredictionOutput pred = runAllergenPrediction(session, item.ingredients, options);
+        long latency_ms = elapsedMs(t_item);
+
+        result.items++;
+        if (!pred.ok) {
+            result.failed++;
+            continue;
+        }
+
+        latencies.push_back(static_cast<double>(latency_ms));
+        if (pred.ttft_ms >= 0) {
+            ttfts.push_back(static_cast<double>(pred.ttft_ms));
+        }
+        prompt_tokens += pred.prompt_tokens;
+        prefill_us += pred.prefill_decode_us;
+        generated_tokens += pred.generated_tokens;
+        decode_us += pred.gen_us;
+
+        if (!item.allergens_mapped.empty()) {
+            AllergenMask mask = pred.mask;
+            AllergenMask truth = parseAllergenList(item.allergens_mapped);
+            tp += __builtin_popcount(mask & truth);
+            fp += __builtin_popcount(mask & ~truth & ALLERGEN_MASK_ALL);
+            fn += __builtin_popcount(~mask & truth & ALLERGEN_MASK_ALL);
+            if (mask == truth) {
+                exact++;
+            }
+            result.labeled++;
+        }
+    }
+
+    result.ok = result.failed < result.items;
+    if (!result.ok) {
+        result.error = "every item failed";
+    }
+    result.p50_ms = percentile(latencies, 0.50);
+    result.p90_ms = percentile(latencies, 0.90);
+    result.ttft_p50_ms = percentile(ttfts, 0.50);
+    result.prefill_tps = prefill_us > 0 ? prompt_tokens * 1e6 / prefill_us : 0.0;
+    result.decode_tps = decode_us > 0 ? generated_tokens * 1e6 / decode_us : 0.0;
+    long denom = 2 * tp + fp + fn;
+    result.micro_f1 = denom > 0 ? 2.0 * tp / denom : 0.0;
+    result.exact_match_rate = result.labeled > 0 ? static_cast<double>(exact) / result.labeled : 0.0;
+}
+
+static std::string pointJson(const SweepResult& r) {
+    const EngineConfig& e = r.point.engine;
+    JsonObject rec;
+    rec.add("type", "point")
+       .add("key", r.point.key())
+       .add("model", r.point.model_path)
+       .add("n_threads", e.n_threads)
+       .add("n_batch", e.n_batch)
+       .add("n_ubatch", e.n_ubatch)
+       .add("n_ctx", e.n_ctx)
+       .add("kv_type", kvCacheTypeName(e.type_k))
+       .add("flash_attn", flashAttnTypeName(e.flash_attn))
+       .add("use_mmap", e.use_mmap)
+       .add("use_mlock", e.use_mlock)
+       .add("decode", decodeModeName(r.point.decode_mode))
+       .add("ok", r.ok)
+       .add("items", r.items)
+       .add("failed", r.failed)
+       .add("load_ms", r.load_ms)
+       .add("ctx_ms", r.ctx_ms)
+       .add("p50_ms", r.p50_ms)
+       .add("p90_ms", r.p90_ms)
+       .add("ttft_p50_ms", r.ttft_p50_ms)
+       .add("prefill_tps", r.prefill_tps)
+       .add("decode_tps", r.decode_tps)
+       .add("peak_rss_mb", r.peak_rss_mb)
+       .add("labeled", r.labeled)
+       .add("exact_match_rate", r.exact_match_rate)
+       .add("micro_f1", r.micro_f1)
+       .add("frontier", r.frontier);
+    if (!r.error.empty()) {
+        rec.add("error", r.error);
+    }
+    return rec.str();
+}
+
+int main(int argc, char** argv) {
+    SweepArgs args;
+    if (!parseArgs(argc, argv, args)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    SweepSpec spec;
+    std::string error;
+    if (!loadSweepSpec(args.spec_path, spec, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    std::vector<BenchItem> items;
+    if (!loadBenchDataset(args.dataset_path, items, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (spec.items >= 0 && static_cast<size_t>(spec.items) < items.size()) {
+        items.resize(spec.items);
+    }
+
+    if (args.fresh) {
+        std::ofstream truncate(args.checkpoint_path, std::ios::trunc);
+    }
+    std::vector<SweepResult> done;
+    if (!loadSweepCheckpoint(args.checkpoint_path, done, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::set<std::string> done_keys;
+    for (const SweepResult& r : done) {
+        done_keys.insert(r.point.key());
+    }
+
+    std::vector<SweepPoint> points = expandSweep(spec);
+    size_t pending = 0;
+    for (const SweepPoint& p : points) {
+        pending += done_keys.count(p.key()) ? 0 : 1;
+    }
+    fprintf(stderr, "Sweep: %zu points, %zu already in %s, %zu items per point\n",
+            points.size(), points.size() - pending, args.checkpoint_path.c_str(), items.size());
+
+    bool peak_reset = true;
+    EngineSession session;
+    size_t run = 0;
+
+    for (const SweepPoint& point : points) {
+        if (done_keys.count(point.key())) {
+            continue;
+        }
+        run++;
+
+        SweepResult result;
+        result.point = point;
+
+        bool reuse = session.loaded() && session.model_path == point.model_path &&
+                     point.engine.sameModelParams(session.config);
+        // Free what this point replaces before resetting VmHWM, so the
+        // peak is this point's alone
+        if (reuse) {
+            llama_free(session.ctx);
+            session.ctx = nullptr;
+        } else {
+            freeEngineSession(session);
+        }
+        peak_reset = resetPeakRss() && peak_reset;
+
+        bool ready;
+        if (reuse) {
+            auto t_ctx = std::chrono::steady_clock::now();
+            ready = recreateEngineContext(session, point.engine);
+            result.ctx_ms = elapsedMs(t_ctx);
+            if (!ready) {
+                result.error = "context creation failed";
+            }
+        } else {
+            auto t_load = std::chrono::steady_clock::now();
+            ready = loadEngineSession(session, point.model_path, point.engine);
+            result.load_ms = elapsedMs(t_load);
+            if (!ready) {
+                result.error = "model load failed";
+            }
+        }
+
+        if (ready) {
+            runPoint(session, point, items, spec.max_tokens, result);
+        } else {
+            // Keep the weights if only the context failed; next point may fit
+            if (!reuse) {
+                freeEngineSession(session);
+            }
+        }
+        result.peak_rss_mb = readPeakRssMb();
+
+        if (!appendSweepCheckpoint(args.checkpoint_path, result)) {
+            fprintf(stderr, "Cannot append to %s\n", args.checkpoint_path.c_str());
+            freeEngineSession(session);
+            return 1;
+        }
+        done.push_back(result);
+        done_keys.insert(point.key());
+
+        fprintf(stderr, "[%zu/%zu] %s -> %s p50=%.0fms decode=%.1ftok/s rss=%.0fMB f1=%.3f\n",
+                run, pending, point.key().c_str(), result.ok ? "ok" : result.error.c_str(),
+                result.p50_ms, result.decode_tps, result.peak_rss_mb, result.micro_f1);
+    }
+
+    freeEngineSession(session);
+
+    if (!peak_reset) {
+        fprintf(stderr, "Warning: could not reset peak RSS, memory figures are cumulative\n");
+    }
+
+    // Report only the points of this spec, in sweep order
+    std::vector<SweepResult> report;
+    for (const SweepPoint& point : points) {
+        const std::string key = point.key();
+        for (const SweepResult& r : done) {
+            if (r.point.key() == key) {
+                report.push_back(r);
+                break;
+            }
+        }
+    }
+    markParetoFrontier(report);
+
+    std::ofstream out_file;
+    if (!args.out_path.empty()) {
+        out_file.open(args.out_path);
+        if (!out_file) {
+            fprintf(stderr, "Cannot write %s\n", args.out_path.c_str());
+            return 1;
+        }
+    }
+    std::ostream& out = args.out_path.empty() ? std::cout : out_file;
+
+    out << JsonObject()
+            .add("type", "sweep")
+            .add("spec", args.spec_path)
+            .add("dataset", args.dataset_path)
+            .add("mode", spec.random ? "random" : "grid")
+            .add("points", static_cast<long>(points.size()))
+            .add("items_per_point", static_cast<long>(items.size()))
+            .add("peak_rss_reset", peak_reset)
+            .str() << "\n";
+
+    for (const SweepResult& r : report) {
+        out << pointJson(r) << "\n";
+    }
+
+    for (const std::string& model : spec.models) {
+        std::string keys = "[";
+        long count = 0;
+        for (const SweepResult& r : report) {
+            if (r.frontier && r.point.model_path == model) {
+                keys += (count++ > 0 ? ",\"" : "\"") + jsonEscape(r.point.key()) + "\"";
+            }
+        }
+        keys += "]";
+        out << JsonObject()
+                .add("type", "frontier")
+                .add("model", model)
+                .add("size", count)
+                .raw("points", keys)
+                .str() << "\n";
+    }
+
+    return 0;
+}
@@ -34,7 +34,10 @@ import android.provider.Settings
 import androidx.appcompat.app.AlertDialog
 import kotlinx.coroutines.TimeoutCancellationException
 import kotlinx.coroutines.withTimeout
+import kotlinx.coroutines.yield
+import kotlinx.coroutines.CancellationException
 import kotlinx.coroutines.tasks.await
+import org.json.JSONObject
 import android.app.ActivityManager
 import android.os.Debug
 import android.content.Context
@@ -52,6 +55,135 @@ class MainActivity : AppCompatActivity() {
         private const val CHANNEL_ID = "allergen_predictions"
         private const val NOTIFICATION_ID = 1
 
+        // Route batch items through the native ingredient lexicon first
+        // (TRUST skips the model, HINT adds keyword hints to the prompt)
+        private const val USE_LEXICON_GATE = false
+
+        // Measured repetitions per item through the native benchmark
+        // harness (warmup until steady, median timings); 1 = single run
+        private const val BENCH_REPETITIONS = 1
+
+        // Record native phase scopes during a batch and write a Chrome
+        // trace (open in ui.perfetto.dev) to the app's external files dir
+        private const val TRACE_EXPORT = false
+
+        // Poll CPU clocks / thermal zones every N ms during a batch and
+        // append them to each result; 0 = off
+        private const val THERMAL_SAMPLE_MS = 0
+
+        // Integrate battery current x voltage every N ms during a batch
+        // and append joules per item to each result; 0 = off. Only
+        // meaningful unplugged (charging current masks the draw)
+        private const val ENERGY_SAMPLE_MS = 0
+
+        // Log the native weights / KV cache / compute memory split at
+        // batch start and append MEM_* keys to each result
+        private const val NATIVE_MEMORY_REPORT = false
+
+        // Run synthetic predictions after every load until the weights
+        // are paged in, so the first timed item is not a cold outlier.
+        // WEIGHT_PREFETCH also reads the mmap'd weights on a native thread
+        private const val MODEL_WARMUP = false
+        private const val WEIGHT_PREFETCH = false
+
+        // Load the checkpoint-reload session on a native background thread
+        // during the PRELOAD_LEAD_ITEMS items before it, then swap instead
+        // of unload + gc + sleep + load. Needs RAM for a second context
+        private const val PRELOAD_CHECKPOINT_RELOAD = false
+        private const val PRELOAD_LEAD_ITEMS = 2
+
+        // Submit each item to a persistent native inference thread and
+        // consume its token events, so the first token is logged as it
+        // is decoded instead of after the whole answer
+        private const val ASYNC_STREAMING = false
+
+        // Score items with the native 9-bit mask engine instead of
+        // MetricsCalculator's string sets, and log a run summary
+        // (per-label confusion counts, micro / macro F1) at batch end
+        private const val NATIVE_METRICS = false
+
+        // Debug: return the model's cleaned text instead of the labels
+        // decoded from its token ids (LABELS=TEXT in the metric prefix)
+        private const val RAW_OUTPUT_TEXT = false
+
+        // Append batch and per-set results to the native results journal
+        // (group commit every JOURNAL_GROUP_ROWS rows, or JOURNAL_GROUP_MS
+        // ms after the oldest uncommitted one)
+        // and upload them to Firestore in batches at the end of the run,
+        // instead of one Firestore write per item. Rows not uploaded
+        // (crash, no network) go up with the next run.
+        private const val RESULTS_JOURNAL = true
+        private const val JOURNAL_GROUP_ROWS = 16
+        private const val JOURNAL_GROUP_MS = 5000
+        private const val JOURNAL_UPLOAD_ROWS = 400     // Firestore allows 500 writes per batch
+
+        // LoRA adapters (id to file next to the models in SLM_Models)
+        // loaded on the base model at batch start and switched without
+        // reloading it. ACTIVE_LORA_ADAPTER picks the one predictions
+        // run with ("" = base model); results record it in modelName
+        // as "<model>+<id>@<scale>"
+        private val LORA_ADAPTER_FILES = mapOf<String, String>()
+        private const val ACTIVE_LORA_ADAPTER = ""
+        private const val LORA_SCALE = 1.0f
+
+        // Predict with the native classification head (one prefill and
+        // a 9-output sigmoid layer over the pooled hidden states)
+        // instead of generating. The head is trained once per model on
+        // the HEAD_TRAIN_PERCENT of labeled items picked by id hash and
+        // saved next to the journal; batch runs then skip those items
+        // so every result is held out. modelName gets "+head"
+        private const val ALLERGEN_HEAD = false
+        private const val HEAD_TRAIN_PERCENT = 80
+        private const val HEAD_EPOCHS = 40
+
+        // Predict from the KNN_K most similar labeled items in a native
+        // embedding index (int8, memory mapped, one per model) when the
+        // best of them reaches KNN_MIN_SIMILARITY; otherwise the item is
+        // generated as usual. The index is filled once from the same
+        // HEAD_TRAIN_PERCENT split, which batch runs then skip.
+        // modelName gets "+knn" for answers taken from the index
+        private const val KNN_PREDICTOR = false
+        private const val KNN_K = 5
+        private const val KNN_MIN_SIMILARITY = 0.9f
+
+        // Reuse the verified labels of the nearest indexed item when it
+        // is a near duplicate (cosine >= REUSE_MIN_SIMILARITY), found
+        // through an HNSW graph over the embedding index that is built
+        // once per model and mapped from "<model>.hnsw" afterwards.
+        // Tried before the k-NN vote; modelName gets "+reuse"
+        private const val NEAR_DUPLICATE_REUSE = false
+        private const val REUSE_MIN_SIMILARITY = 0.95f
+        private const val HNSW_M = 16
+
+        // Predict once per group of items whose ingredient text matches
+        // after case, whitespace and punctuation folding (and entry
+        // order with DEDUP_IGNORE_ORDER); the other members get that
+        // prediction, scored against their own ground truth, with zero
+        // timings. modelName gets "+dedup"
+        private const val DEDUP_INGREDIENTS = false
+        private const val DEDUP_IGNORE_ORDER = false
+
+        // Keep earlier prompts in the KV cache as a radix tree of token
+        // prefixes on PREFIX_CACHE_SEQUENCES sequences (at most
+        // PREFIX_CACHE_CELLS cells) and prefill only what follows the
+        // longest cached one: the system prompt at least, often the
+        // first ingredients too. Batch items then skip clearContext, as
+        // each runs on a sequence of its own; reused tokens and the
+        // prefill time saved are logged when the batch ends
+        private const val PREFIX_CACHE = false
+        private const val PREFIX_CACHE_SEQUENCES = 16
+        private const val PREFIX_CACHE_CELLS = 2048
+
+        // Answer with the smallest model and escalate to the next larger
+        // one of its family (ModelRegistry.getCascadeModels) when the
+        // smallest label margin is under CASCADE_MIN_MARGIN or the output
+        // does not parse. With CASCADE_SHADOW_LARGE the large model also
+        // runs on kept items, so LARGE_EMR is the large-only baseline
+        // rather than ESCALATED_LARGE_EMR. modelName gets "+cascade"
+        private const val MODEL_CASCADE = false
+        private const val CASCADE_MIN_MARGIN = 3.0f
+        private const val CASCADE_SHADOW_LARGE = false
+
         private var isProcessingAll = false
         private var processedCount = 0
         private var totalToProcess = 0
@@ -73,10 +205,77 @@ class MainActivity : AppCompatActivity() {
     // ===== NATIVE FUNCTION DECLARATIONS =====
     external fun loadModel(assetManager: android.content.res.AssetManager, modelPath: String): Boolean
     external fun predictAllergens(ingredients: String): String
+    external fun setRawOutputText(enabled: Boolean)
     external fun getModelInfo(): String
     external fun unloadModel()
     external fun clearContext()
     external fun isModelHealthy(): Boolean
+    external fun predictAllergensGated(ingredients: String): String
+    external fun scanIngredientLexicon(ingredients: String): String
+    external fun loadLexiconDictionary(path: String): Boolean
+    external fun setLexiconPolicy(trustStrong: Boolean, trustEmpty: Boolean, hintOnWeak: Boolean, minStrongHits: Int)
+    external fun getLexiconStats(): String
+    external fun resetLexiconStats()
+    external fun loadCascade(smallModelPath: String, largeModelPath: String): Boolean
+    external fun setCascadeThresholds(minMargin: Float, minMeanMargin: Float, escalateOnUnparsed: Boolean, shadowLarge: Boolean)
+    external fun predictAllergensCascade(ingredients: String, groundTruth: String): String
+    external fun getCascadeStats(): String
+    external fun resetCascadeStats()
+    external fun unloadCascade()
+    external fun setBenchmarkConfig(warmupMin: Int, warmupMax: Int, repetitions: Int, steadyCv: Float, bootstrap: Int)
+    external fun benchmarkItem(ingredients: String): String
+    external fun getBenchmarkSummary(): String
+    external fun resetBenchmark()
+    external fun setTraceEnabled(enabled: Boolean)
+    external fun dumpTrace(path: String): Boolean
+    external fun startThermalSampler(intervalMs: Int): Boolean
+    external fun stopThermalSampler(samplesPath: String): Boolean
+    external fun startEnergyMeter(intervalMs: Int): Boolean
+    external fun stopEnergyMeter(): String
+    external fun getMemoryReport(): String
+    external fun setMemoryReportPerItem(enabled: Boolean)
+    external fun warmupModel(prefetch: Boolean): String
+    external fun preloadModel(modelPath: String): Boolean
+    external fun swapToPreloadedModel(): String
+    external fun cancelPreload()
+    external fun registerResidentModel(modelId: String, modelPath: String)
+    external fun setResidencyBudget(budgetMb: Int)
+    external fun predictAllergensWith(modelId: String, ingredients: String): String
+    external fun getResidencyStats(): String
+    external fun clearResidency()
+    external fun startInferenceWorker(): Boolean
+    external fun stopInferenceWorker()
+    external fun submitPrediction(ingredients: String): Long
+    external fun cancelPrediction(handle: Long): Boolean
+    external fun awaitInferenceEvent(timeoutMs: Int): String
+    external fun parseAllergenMask(allergens: String): Int
+    external fun computeItemMetrics(groundTruth: String, predicted: String, ingredients: String): String
+    external fun computeMetricsSummary(groundTruth: ShortArray, predicted: ShortArray, evidence: ShortArray?): String
+    external fun openResultsJournal(path: String, groupRows: Int, groupMs: Int): String
+    external fun appendJournalResult(texts: Array<String>, ints: LongArray, reals: DoubleArray): Boolean
+    external fun flushResultsJournal(): Boolean
+    external fun readPendingJournalRows(maxRows: Int): String
+    external fun acknowledgeJournalSync(row: Long): Boolean
+    external fun exportResultsJournal(path: String, csv: Boolean): Boolean
+    external fun getJournalStats(): String
+    external fun closeResultsJournal()
+    external fun loadLoraAdapter(adapterId: String, adapterPath: String): String
+    external fun setActiveAdapter(adapterId: String, scale: Float): Boolean
+    external fun getLoraAdapters(): String
+    external fun unloadLoraAdapters()
+    external fun trainAllergenHead(ingredients: Array<String>, truthMasks: ShortArray, headPath: String, epochs: Int): String
+    external fun loadAllergenHead(headPath: String): Boolean
+    external fun predictAllergensHead(ingredients: String): String
+    external fun openEmbeddingIndex(indexPath: String): String
+    external fun addToEmbeddingIndex(ingredients: String, truthMask: Short): Boolean
+    external fun predictAllergensKnn(ingredients: String, k: Int, minSimilarity: Float): String
+    external fun getEmbeddingIndexStats(): String
+    external fun closeEmbeddingIndex()
+    external fun prepareHnswIndex(graphPath: String, m: Int): String
+    external fun predictAllergensReuse(ingredients: String, minSimilarity: Float): String
+    external fun planIngredientGroups(ingredients: Array<String>, ignoreOrder: Boolean): IntArray
+    external fun enablePrefixCache(sequences: Int, maxCells: Int): Boolean
+    external fun getPrefixCacheStats(): String
 
     // ===== DATA CLASSES =====
     data class BatchStatistics(
@@ -119,6 +318,11 @@ class MainActivity : AppCompatActivity() {
 
     private var currentModelName: String = "Qwen 2.5 1.5B"
     private var currentModelFile: String = "qwen2.5-1.5b-instruct-q4_k_m.gguf"
+    private var adapterTag: String = ""     // "+<id>@<scale>" while a LoRA adapter is active
+    private var headReady = false           // batch items go to predictAllergensHead
+    private var knnReady = false            // batch items try predictAllergensKnn first
+    private var reuseReady = false          // batch items try predictAllergensReuse first
+    private var cascadeReady = false        // batch items go to predictAllergensCascade
     private val resultsByModel = mutableMapOf<String, MutableList<PredictionResult>>()
 
     // Firebase
@@ -399,6 +603,13 @@ class MainActivity : AppCompatActivity() {
             return false
         }
 
+        // Lexicon answers never touch the model and head or index
+        // answers skip generation, so the latency floor does not apply
+        if (parts[0].contains("PATH=TRUST") || parts[0].contains("LABELS=HEAD") ||
+            parts[0].contains("LABELS=KNN") || parts[0].contains("LABELS=REUSE")) {
+            return true
+        }
+
         if (actualLatency < 5000) {
             Log.e(TAG, "Invalid latency: ${actualLatency}ms (too fast)")
             return false
@@ -407,6 +618,296 @@ class MainActivity : AppCompatActivity() {
         return true
     }
 
+    private fun itemMetrics(groundTruth: String, predicted: String, ingredients: String): MetricsCalculator.Metrics {
+        return if (NATIVE_METRICS) {
+            MetricsCalculator.fromNative(computeItemMetrics(groundTruth, predicted, ingredients))
+        } else {
+            MetricsCalculator.calculateMetrics(groundTruth, predicted, ingredients)
+        }
+    }
+
+    // Loads LORA_ADAPTER_FILES not loaded yet and activates
+    // ACTIVE_LORA_ADAPTER; a missing file leaves the base model active
+    private fun applyLoraAdapters() {
+        val loaded = getLoraAdapters()
+        val modelsDir = File(
+            Environment.getExternalStoragePublicDirectory(Environment.DIRECTORY_DOCUMENTS), "SLM_Models"
+        )
+        LORA_ADAPTER_FILES.forEach { (id, fileName) ->
+            if (loaded.lineSequence().any { it.startsWith("ID=$id;") }) return@forEach
+            val file = File(modelsDir, fileName)
+            if (!file.exists()) {
+                Log.w(TAG, "LoRA adapter not found: ${file.absolutePath}")
+                return@forEach
+            }
+            Log.i(TAG_METRICS, "LoRA: ${loadLoraAdapter(id, file.absolutePath)}")
+        }
+        adapterTag = if (ACTIVE_LORA_ADAPTER.isNotEmpty() && setActiveAdapter(ACTIVE_LORA_ADAPTER, LORA_SCALE)) {
+            "+$ACTIVE_LORA_ADAPTER@${String.format("%.2f", LORA_SCALE)}"
+        } else {
+            setActiveAdapter("", 1.0f)
+            ""
+        }
+    }
+
+    private fun isHeadTrainingItem(item: FoodItem): Boolean {
+        return item.allergensMapped.isNotBlank() && (item.id.hashCode() and 0x7fffffff) % 100 < HEAD_TRAIN_PERCENT
+    }
+
+    // Loads the cascade pair from SLM_Models; both stay resident next to
+    // the batch model for the run
+    private fun prepareCascade(): Boolean {
+        val (small, large) = ModelRegistry.getCascadeModels()
+        val dirs = listOf(Environment.DIRECTORY_DOCUMENTS, Environment.DIRECTORY_DOWNLOADS).map {
+            File(Environment.getExternalStoragePublicDirectory(it), "SLM_Models")
+        }
+        val smallFile = dirs.map { File(it, small.fileName) }.firstOrNull { it.exists() }
+        val largeFile = dirs.map { File(it, large.fileName) }.firstOrNull { it.exists() }
+        if (smallFile == null || largeFile == null) {
+            Log.w(TAG, "Cascade models not found: ${small.fileName}, ${large.fileName}")
+            return false
+        }
+        setCascadeThresholds(CASCADE_MIN_MARGIN, 0.0f, true, CASCADE_SHADOW_LARGE)
+        if (!loadCascade(smallFile.absolutePath, largeFile.absolutePath)) {
+            Log.w(TAG, "Cascade failed to load; items use $currentModelFile")
+            return false
+        }
+        resetCascadeStats()
+        Log.i(TAG_METRICS, "Cascade: ${small.fileName} -> ${large.fileName}")
+        return true
+    }
+
+    // Loads this model's head, training it first if there is none
+    private fun prepareAllergenHead(): Boolean {
+        val headFile = File(getExternalFilesDir(null), "$currentModelFile.head")
+        if (!headFile.exists()) {
+            val training = allFoodItems.filter { isHeadTrainingItem(it) }
+            val report = trainAllergenHead(
+                training.map { it.ingredients }.toTypedArray(),
+                ShortArray(training.size) { parseAllergenMask(training[it].allergensMapped).toShort() },
+                headFile.absolutePath, HEAD_EPOCHS
+            )
+            Log.i(TAG_METRICS, "Allergen head [$currentModelFile]: $report")
+            if (report.startsWith("ERROR|")) return false
+        }
+        return loadAllergenHead(headFile.absolutePath)
+    }
+
+    // Opens this model's embedding index, filling it from the training
+    // split if it is empty
+    private fun prepareEmbeddingIndex(): Boolean {
+        val indexFile = File(getExternalFilesDir(null), "$currentModelFile.knn")
+        val report = openEmbeddingIndex(indexFile.absolutePath)
+        if (report.startsWith("ERROR|")) {
+            Log.w(TAG, "Embedding index unavailable: $report")
+            return false
+        }
+        if (report.startsWith("ROWS=0;")) {
+            allFoodItems.filter { isHeadTrainingItem(it) }.forEach {
+                addToEmbeddingIndex(it.ingredients, parseAllergenMask(it.allergensMapped).toShort())
+            }
+        }
+        Log.i(TAG_METRICS, "Embedding index [$currentModelFile]: ${getEmbeddingIndexStats()}")
+        return true
+    }
+
+    // Maps this model's HNSW graph over the open index, building it
+    // when missing or stale
+    private fun prepareNearDuplicateReuse(): Boolean {
+        val graphFile = File(getExternalFilesDir(null), "$currentModelFile.hnsw")
+        val report = prepareHnswIndex(graphFile.absolutePath, HNSW_M)
+        Log.i(TAG_METRICS, "HNSW [$currentModelFile]: $report")
+        return !report.startsWith("ERROR|")
+    }
+
+    // Index of each item's group leader, or null with dedup off
+    private fun planDedupGroups(items: List<FoodItem>): IntArray? {
+        if (!DEDUP_INGREDIENTS) return null
+        val groups = planIngredientGroups(items.map { it.ingredients }.toTypedArray(), DEDUP_IGNORE_ORDER)
+        val leaders = groups.distinct().size
+        Log.i(TAG_METRICS, "Dedup: ${items.size} items in $leaders groups " +
+                "(ratio ${String.format("%.3f", 1.0 - leaders.toDouble() / maxOf(items.size, 1))})")
+        return groups
+    }
+
+    // A group member's copy of the prediction made for its group.
+    // Nothing ran for it, so its timings and memory deltas are zero
+    // and modelName gets "+dedup" (slm-bench --dedup follows the same
+    // rule)
+    private fun fanOutResult(shared: PredictionResult, item: FoodItem): PredictionResult {
+        val metrics = itemMetrics(item.allergensMapped, shared.predictedAllergens, item.ingredients)
+        return shared.copy(
+            dataId = item.id,
+            name = item.name,
+            ingredients = item.ingredients,
+            allergensRaw = item.allergensRaw,
+            allergensMapped = item.allergensMapped,
+            modelName = shared.modelName + "+dedup",
+            truePositives = metrics.tp,
+            falsePositives = metrics.fp,
+            falseNegatives = metrics.fn,
+            trueNegatives = metrics.tn,
+            precision = metrics.precision,
+            recall = metrics.recall,
+            f1Score = metrics.f1Score,
+            accuracy = metrics.accuracy,
+            isExactMatch = metrics.isExactMatch,
+            hammingLoss = metrics.hammingLoss,
+            falseNegativeRate = metrics.fnr,
+            hallucinationCount = metrics.hallucinationCount,
+            hallucinatedAllergens = metrics.hallucinatedAllergens,
+            overPredictionCount = metrics.overPredictionCount,
+            overPredictedAllergens = metrics.overPredictedAllergens,
+            isAbstentionCase = metrics.isAbstentionCase,
+            isAbstentionCorrect = metrics.isAbstentionCorrect,
+            latencyMs = 0,
+            ttftMs = 0,
+            itps = 0,
+            otps = 0,
+            oetMs = 0,
+            totalTimeMs = 0,
+            javaHeapKb = 0,
+            nativeHeapKb = 0,
+            totalPssKb = 0,
+            timestamp = System.currentTimeMillis()
+        )
+    }
+
+    // Near-duplicate reuse, then the k-NN vote, then generation
+    private fun predictFromIndex(ingredients: String): String {
+        if (reuseReady) {
+            val reused = predictAllergensReuse(ingredients, REUSE_MIN_SIMILARITY)
+            if (!reused.startsWith("ERROR|")) return reused
+        }
+        if (knnReady) {
+            val voted = predictAllergensKnn(ingredients, KNN_K, KNN_MIN_SIMILARITY)
+            if (!voted.startsWith("ERROR|")) return voted
+        }
+        return predictAllergens(ingredients)
+    }
+
+    // PredictionResult fields in declaration order, split by type as
+    // the native journal stores them (see predictionResultColumns)
+    private fun appendToJournal(result: PredictionResult): Boolean {
+        val texts = arrayOf(
+            result.dataId, result.name, result.ingredients, result.allergensRaw,
+            result.allergensMapped, result.predictedAllergens, result.modelName,
+            result.hallucinatedAllergens, result.overPredictedAllergens,
+            result.deviceModel, result.androidVersion
+        )
+        val ints = longArrayOf(
+            result.truePositives.toLong(), result.falsePositives.toLong(),
+            result.falseNegatives.toLong(), result.trueNegatives.toLong(),
+            if (result.isExactMatch) 1L else 0L,
+            result.hallucinationCount.toLong(), result.overPredictionCount.toLong(),
+            if (result.isAbstentionCase) 1L else 0L, if (result.isAbstentionCorrect) 1L else 0L,
+            result.latencyMs, result.ttftMs, result.itps, result.otps, result.oetMs, result.totalTimeMs,
+            result.javaHeapKb, result.nativeHeapKb, result.totalPssKb,
+            result.timestamp
+        )
+        val reals = doubleArrayOf(
+            result.precision, result.recall, result.f1Score, result.accuracy,
+            result.hammingLoss, result.falseNegativeRate
+        )
+        return appendJournalResult(texts, ints, reals)
+    }
+
+    // Results journal for a run; false when RESULTS_JOURNAL is off or
+    // the file cannot be opened (results then go to Firestore directly)
+    private fun openJournal(): Boolean {
+        if (!RESULTS_JOURNAL) return false
+        val report = openResultsJournal(
+            File(getExternalFilesDir(null), "results.slj").absolutePath,
+            JOURNAL_GROUP_ROWS, JOURNAL_GROUP_MS
+        )
+        Log.i(TAG_METRICS, "Journal: $report")
+        return !report.startsWith("ERROR|")
+    }
+
+    // End of a run: commit, upload the pending rows, export the CSV
+    private suspend fun finishJournal() {
+        flushResultsJournal()
+        uploadJournal()
+        Log.i(TAG_METRICS, "Journal: ${getJournalStats()}")
+        val csvFile = File(getExternalFilesDir(null), "results.csv")
+        if (exportResultsJournal(csvFile.absolutePath, true)) {
+            Log.i(TAG_METRICS, "Journal CSV: ${csvFile.absolutePath}")
+        }
+        closeResultsJournal()
+    }
+
+    // Pending journal rows -> Firestore batches; each batch is
+    // acknowledged only after its commit succeeds
+    private suspend fun uploadJournal() {
+        while (true) {
+            val pending = readPendingJournalRows(JOURNAL_UPLOAD_ROWS)
+            val meta = pending.substringBefore('|')
+            val from = meta.substringAfter("FROM=").substringBefore(';').toLong()
+            val to = meta.substringAfter("TO=").substringBefore(';').toLong()
+            val journalId = meta.substringAfter("JOURNAL=")
+            if (to <= from) {
+                return
+            }
+            val batch = firestore.batch()
+            pending.substringAfter('|').lineSequence().filter { it.isNotBlank() }.forEachIndexed { i, line ->
+                val json = JSONObject(line)
+                // Non-finite doubles are exported as null
+                val data = json.keys().asSequence().associateWith { key ->
+                    json.get(key).takeUnless { it == JSONObject.NULL }
+                }
+                // Named by journal row: a batch sent again after a lost
+                // acknowledgement overwrites its documents
+                batch.set(firestore.collection("predictions").document("$journalId-${from + i}"), data)
+            }
+            try {
+                batch.commit().await()
+            } catch (e: Exception) {
+                Log.e(TAG, "✗ Journal upload stopped at row $from: ${e.message}", e)
+                return
+            }
+            acknowledgeJournalSync(to)
+            Log.i(TAG, "✓ Uploaded journal rows $from..${to - 1}")
+        }
+    }
+
+    // Same result string as predictAllergens, taken from the DONE event.
+    // Cancelling the coroutine (e.g. withTimeout) cancels the native request
+    private suspend fun predictStreaming(itemName: String, ingredients: String): String {
+        val handle = submitPrediction(ingredients)
+        if (handle < 0) {
+            return "ERROR|Inference worker not running"
+        }
+        try {
+            while (true) {
+                val event = awaitInferenceEvent(250)
+                if (event.isEmpty()) {
+                    yield()
+                    continue
+                }
+                val parts = event.split("|", limit = 2)
+                val meta = parts[0]
+                val text = parts.getOrElse(1) { "" }
+                if (!meta.startsWith("HANDLE=$handle;")) {
+                    continue
+                }
+                when {
+                    meta.contains(";EVENT=FIRST_TOKEN;") -> {
+                        val sinceSubmit = meta.substringAfter("SINCE_SUBMIT_MS=")
+                        Log.i(TAG_METRICS, "First token for $itemName after $sinceSubmit ms: '$text'")
+                        runOnUiThread {
+                            findViewById<TextView>(R.id.batchProgressText).append(" | first token $sinceSubmit ms")
+                        }
+                    }
+                    meta.contains(";EVENT=DONE;") -> return text
+                    meta.contains(";EVENT=CANCELLED;") -> return "ERROR|Prediction cancelled"
+                }
+            }
+        } catch (e: CancellationException) {
+            cancelPrediction(handle)
+            throw e
+        }
+    }
+
     private suspend fun predictWithRetryAndSafety(
         item: FoodItem,
         deviceInfo: String,
@@ -426,7 +927,9 @@ class MainActivity : AppCompatActivity() {
                     throw Exception("Model is unhealthy")
                 }
 
-                clearContext()
+                if (!PREFIX_CACHE) {
+                    clearContext()
+                }
                 Thread.sleep(100)
 
                 val safeIngredients = getSafeIngredients(item.ingredients)
@@ -435,7 +938,21 @@ class MainActivity : AppCompatActivity() {
                 val predStartTime = System.currentTimeMillis()
 
                 val rawResult = withTimeout(180000L) {
-                    predictAllergens(safeIngredients)
+                    if (headReady) {
+                        predictAllergensHead(safeIngredients)
+                    } else if (cascadeReady) {
+                        predictAllergensCascade(safeIngredients, item.allergensMapped)
+                    } else if (reuseReady || knnReady) {
+                        predictFromIndex(safeIngredients)
+                    } else if (USE_LEXICON_GATE) {
+                        predictAllergensGated(safeIngredients)
+                    } else if (BENCH_REPETITIONS > 1) {
+                        benchmarkItem(safeIngredients)
+                    } else if (ASYNC_STREAMING) {
+                        predictStreaming(item.name, safeIngredients)
+                    } else {
+                        predictAllergens(safeIngredients)
+                    }
                 }
 
                 val predEndTime = System.currentTimeMillis()
@@ -471,7 +988,7 @@ class MainActivity : AppCompatActivity() {
                     }
                 }
 
-                if (ttftMs == -1L) {
+                if (ttftMs == -1L && !metaString.contains("PATH=TRUST")) {
                     Log.w(TAG, "⚠️ Using actual latency for metrics")
                     ttftMs = actualLatency
                     oetMs = actualLatency
@@ -504,7 +1021,7 @@ class MainActivity : AppCompatActivity() {
                     throw Exception("No valid allergens in output: $modelOutput")
                 }
 
-                val metrics = MetricsCalculator.calculateMetrics(
+                val metrics = itemMetrics(
                     groundTruth = item.allergensMapped,
                     predicted = predicted,
                     ingredients = item.ingredients
@@ -517,7 +1034,13 @@ class MainActivity : AppCompatActivity() {
                     allergensRaw = item.allergensRaw,
                     allergensMapped = item.allergensMapped,
                     predictedAllergens = predicted,
-                    modelName = currentModelName,
+                    modelName = currentModelName + adapterTag + when {
+                        metaString.contains("LABELS=HEAD") -> "+head"
+                        metaString.contains("LABELS=KNN") -> "+knn"
+                        metaString.contains("LABELS=REUSE") -> "+reuse"
+                        metaString.contains("TIER=") -> "+cascade"
+                        else -> ""
+                    },
 
                     truePositives = metrics.tp,
                     falsePositives = metrics.fp,
@@ -584,6 +1107,16 @@ class MainActivity : AppCompatActivity() {
         return null
     }
 
+    // Blocking; call off the main thread right after a successful load
+    private fun warmUpLoadedModel() {
+        if (!MODEL_WARMUP) return
+        val report = warmupModel(WEIGHT_PREFETCH)
+        Log.i(TAG_METRICS, "Warmup [$currentModelFile]: $report")
+        if (!report.contains("MODEL_HOT=1")) {
+            Log.w(TAG, "⚠️ Model not fully hot after warmup; first timings may be inflated")
+        }
+    }
+
     private suspend fun reloadModelSafely(modelFilePath: String): Boolean {
         return withContext(Dispatchers.IO) {
             try {
@@ -608,6 +1141,7 @@ class MainActivity : AppCompatActivity() {
 
                 if (success) {
                     Log.i(TAG, "✓ Model reloaded successfully")
+                    warmUpLoadedModel()
                     Thread.sleep(2000)
                     return@withContext true
                 } else {
@@ -735,7 +1269,46 @@ class MainActivity : AppCompatActivity() {
 
             withContext(Dispatchers.IO) {
 
+                if (BENCH_REPETITIONS > 1) {
+                    setBenchmarkConfig(1, 5, BENCH_REPETITIONS, 0.05f, 1000)
+                    resetBenchmark()
+                }
+                if (TRACE_EXPORT) {
+                    setTraceEnabled(true)
+                }
+                if (THERMAL_SAMPLE_MS > 0 && !startThermalSampler(THERMAL_SAMPLE_MS)) {
+                    Log.w(TAG, "Thermal sampler unavailable on this device")
+                }
+                if (ENERGY_SAMPLE_MS > 0 && !startEnergyMeter(ENERGY_SAMPLE_MS)) {
+                    Log.w(TAG, "Battery energy meter unavailable on this device")
+                }
+                if (NATIVE_MEMORY_REPORT) {
+                    Log.i(TAG_METRICS, "Memory [$currentModelFile]: ${getMemoryReport()}")
+                    setMemoryReportPerItem(true)
+                }
+                setRawOutputText(RAW_OUTPUT_TEXT)
+                applyLoraAdapters()
+                if (PREFIX_CACHE && !enablePrefixCache(PREFIX_CACHE_SEQUENCES, PREFIX_CACHE_CELLS)) {
+                    Log.w(TAG, "Prefix cache unavailable; prompts are prefilled in full")
+                }
+                headReady = ALLERGEN_HEAD && prepareAllergenHead()
+                knnReady = KNN_PREDICTOR && !headReady && prepareEmbeddingIndex()
+                reuseReady = NEAR_DUPLICATE_REUSE && !headReady &&
+                        (knnReady || prepareEmbeddingIndex()) && prepareNearDuplicateReuse()
+                cascadeReady = MODEL_CASCADE && !headReady && prepareCascade()
+                val journalOpen = openJournal()
+                if (ASYNC_STREAMING && !startInferenceWorker()) {
+                    Log.w(TAG, "Inference worker failed to start")
+                }
+
+                val dedupGroups = planDedupGroups(allFoodItems)
+                val groupResults = HashMap<Int, PredictionResult>()
+                var fannedOut = 0
+
                 // 2. LOOP FROM START INDEX
+                var preloadPending = false
+                val runTruthMasks = ArrayList<Short>()
+                val runPredictedMasks = ArrayList<Short>()
                 for (i in startIndex until allFoodItems.size) {
 
                     if (!isProcessingAll) {
@@ -746,20 +1319,54 @@ class MainActivity : AppCompatActivity() {
                     val item = allFoodItems[i]
                     val itemNumber = i + 1  // e.g., 51
 
+                    if ((headReady || knnReady || reuseReady) && isHeadTrainingItem(item)) {
+                        continue
+                    }
+
                     Log.i(TAG, "Processing [$itemNumber/${stats.totalItems}]: ${item.name}")
 
                     // Checkpoint logic (Reload model every 10 items)
                     if (i > startIndex && i % 10 == 0) {
-                        reloadModelSafely(modelFilePath)
+                        val swapped = preloadPending && swapToPreloadedModel().let { report ->
+                            Log.i(TAG_METRICS, "Preload swap [$currentModelFile]: $report")
+                            !report.startsWith("ERROR|")
+                        }
+                        preloadPending = false
+                        if (swapped) {
+                            warmUpLoadedModel()
+                        } else {
+                            reloadModelSafely(modelFilePath)
+                        }
+                        // The new model has only the adapters that loaded
+                        // on it again; adapterTag follows what is active
+                        applyLoraAdapters()
                         stats.lastCheckpointTime = System.currentTimeMillis()
                     }
+                    if (PRELOAD_CHECKPOINT_RELOAD && !preloadPending && (i + PRELOAD_LEAD_ITEMS) % 10 == 0) {
+                        preloadPending = preloadModel(modelFilePath)
+                    }
 
-                    // Run Prediction
-                    val result = predictWithRetryAndSafety(item, deviceInfo, androidVersion, maxRetries = 3)
+                    // Run Prediction (once per dedup group)
+                    val shared = dedupGroups?.let { groupResults[it[i]] }
+                    val result = if (shared != null) {
+                        fannedOut++
+                        fanOutResult(shared, item)
+                    } else {
+                        predictWithRetryAndSafety(item, deviceInfo, androidVersion, maxRetries = 3)
+                    }
+                    if (result != null && shared == null && dedupGroups != null) {
+                        groupResults[dedupGroups[i]] = result
+                    }
 
                     if (result != null) {
-                        saveToFirebase(result)
+                        if (!journalOpen || !appendToJournal(result)) {
+                            saveToFirebase(result)
+                        }
                         stats.successCount++
+                        if (NATIVE_METRICS) {
+                            runTruthMasks.add(parseAllergenMask(result.allergensMapped).toShort())
+                            runPredictedMasks.add(parseAllergenMask(result.predictedAllergens).toShort())
+                        }
                     } else {
                         stats.failedItems.add(item)
                         stats.failCount++
@@ -798,7 +1405,67 @@ class MainActivity : AppCompatActivity() {
                 }
 
                 // 4. CLEANUP & FINISH
+                headReady = false
+                if (cascadeReady) {
+                    Log.i(TAG_METRICS, "Cascade: ${getCascadeStats()}")
+                    unloadCascade()
+                    cascadeReady = false
+                }
+                if (dedupGroups != null) {
+                    Log.i(TAG_METRICS, "Dedup: $fannedOut results fanned out")
+                }
+                if (PREFIX_CACHE) {
+                    Log.i(TAG_METRICS, "Prefix cache [$currentModelFile]: ${getPrefixCacheStats()}")
+                    enablePrefixCache(0, 0)
+                }
+                if (KNN_PREDICTOR || NEAR_DUPLICATE_REUSE) {
+                    Log.i(TAG_METRICS, "Embedding index: ${getEmbeddingIndexStats()}")
+                    closeEmbeddingIndex()
+                    knnReady = false
+                    reuseReady = false
+                }
+                if (USE_LEXICON_GATE) {
+                    Log.i(TAG_METRICS, "Lexicon gate: ${getLexiconStats()}")
+                }
+                if (BENCH_REPETITIONS > 1) {
+                    Log.i(TAG_METRICS, "Benchmark: ${getBenchmarkSummary()}")
+                }
+                if (NATIVE_MEMORY_REPORT) {
+                    Log.i(TAG_METRICS, "Memory [$currentModelFile]: ${getMemoryReport()}")
+                    setMemoryReportPerItem(false)
+                }
+                if (preloadPending) {
+                    cancelPreload()
+                }
+                if (NATIVE_METRICS && runTruthMasks.isNotEmpty()) {
+                    val summary = computeMetricsSummary(
+                        runTruthMasks.toShortArray(), runPredictedMasks.toShortArray(), null
+                    )
+                    Log.i(TAG_METRICS, "Quality [$currentModelFile]: $summary")
+                }
+                if (ASYNC_STREAMING) {
+                    stopInferenceWorker()
+                }
+                if (journalOpen) {
+                    finishJournal()
+                }
                 try { unloadModel() } catch (e: Exception) {}
+                if (TRACE_EXPORT) {
+                    setTraceEnabled(false)
+                    val traceFile = File(getExternalFilesDir(null), "slm-trace-${System.currentTimeMillis()}.json")
+                    if (dumpTrace(traceFile.absolutePath)) {
+                        Log.i(TAG_METRICS, "Trace: ${traceFile.absolutePath}")
+                    }
+                }
+                if (ENERGY_SAMPLE_MS > 0) {
+                    Log.i(TAG_METRICS, "Energy [$currentModelFile]: ${stopEnergyMeter()}")
+                }
+                if (THERMAL_SAMPLE_MS > 0) {
+                    val thermalFile = File(getExternalFilesDir(null), "slm-thermal-${System.currentTimeMillis()}.jsonl")
+                    if (stopThermalSampler(thermalFile.absolutePath)) {
+                        Log.i(TAG_METRICS, "Thermal samples: ${thermalFile.absolutePath}")
+                    }
+                }
 
                 withContext(Dispatchers.Main) {
                     isProcessingAll = false
@@ -957,7 +1624,7 @@ class MainActivity : AppCompatActivity() {
 
                 val startTime = System.currentTimeMillis()
                 val loaded = withContext(Dispatchers.IO) {
-                    loadModel(assets, modelFile.absolutePath)
+                    loadModel(assets, modelFile.absolutePath).also { if (it) warmUpLoadedModel() }
                 }
 
                 val loadTime = System.currentTimeMillis() - startTime
@@ -1088,9 +1755,29 @@ class MainActivity : AppCompatActivity() {
                     return@launch
                 }
 
+                val dedupGroups = planDedupGroups(foodItems)
+                val groupResults = HashMap<Int, PredictionResult>()
+                val journalOpen = openJournal()
+
                 withContext(Dispatchers.IO) {
                     for ((index, foodItem) in foodItems.withIndex()) {
 
+                        // A group already predicted needs no model load
+                        val shared = dedupGroups?.let { groupResults[it[index]] }
+                        if (shared != null) {
+                            val result = fanOutResult(shared, foodItem)
+                            if (!journalOpen || !appendToJournal(result)) {
+                                saveToFirebase(result)
+                            }
+                            withContext(Dispatchers.Main) {
+                                resultsAdapter.addResult(result)
+                                predictionProgress.progress = index + 1
+                            }
+                            successCount++
+                            Log.i(TAG, "✓ ${foodItem.name} → ${result.predictedAllergens} (dedup)")
+                            continue
+                        }
+
                         withContext(Dispatchers.Main) {
                             progressTitle.text = "Processing: ${foodItem.name} [${index + 1}/${foodItems.size}]"
                             progressText.text = "Loading model..."
@@ -1110,6 +1797,7 @@ class MainActivity : AppCompatActivity() {
                             }
 
                             Log.i(TAG, "✓ Model loaded")
+                            warmUpLoadedModel()
                             Thread.sleep(2000)
 
                             withContext(Dispatchers.Main) {
@@ -1209,7 +1897,7 @@ class MainActivity : AppCompatActivity() {
                                 predicted
                             }
 
-                            val metrics = MetricsCalculator.calculateMetrics(
+                            val metrics = itemMetrics(
                                 groundTruth = foodItem.allergensMapped,
                                 predicted = finalPredicted,
                                 ingredients = foodItem.ingredients
@@ -1222,7 +1910,7 @@ class MainActivity : AppCompatActivity() {
                                 allergensRaw = foodItem.allergensRaw,
                                 allergensMapped = foodItem.allergensMapped,
                                 predictedAllergens = finalPredicted,
-                                modelName = currentModelName,
+                                modelName = currentModelName + adapterTag,
 
                                 truePositives = metrics.tp,
                                 falsePositives = metrics.fp,
@@ -1258,7 +1946,10 @@ class MainActivity : AppCompatActivity() {
                                 androidVersion = androidVersion
                             )
 
-                            saveToFirebase(result)
+                            if (!journalOpen || !appendToJournal(result)) {
+                                saveToFirebase(result)
+                            }
+                            dedupGroups?.let { groupResults[it[index]] = result }
 
                             withContext(Dispatchers.Main) {
                                 resultsAdapter.addResult(result)  // ✅ ALWAYS add to UI
@@ -1309,6 +2000,10 @@ class MainActivity : AppCompatActivity() {
                             }
                         }
                     }
+
+                    if (journalOpen) {
+                        finishJournal()
+                    }
                 }
 
                 withContext(Dispatchers.Main) {
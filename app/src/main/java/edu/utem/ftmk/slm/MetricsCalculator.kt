@@ -124,6 +124,41 @@ object MetricsCalculator {
         )
     }
 
+    /**
+     * Metrics from MainActivity.computeItemMetrics ("TP=..;FP=..;...").
+     * Exact match there compares label masks, so order and spacing of
+     * the two lists do not matter.
+     */
+    fun fromNative(encoded: String): Metrics {
+        val values = encoded.split(";").associate { field ->
+            field.substringBefore("=") to field.substringAfter("=", "")
+        }
+        fun int(key: String) = values[key]?.toIntOrNull() ?: 0
+        fun double(key: String) = values[key]?.toDoubleOrNull() ?: 0.0
+        fun list(key: String) = values[key].orEmpty()
+        fun count(key: String) = list(key).split(",").count { it.isNotBlank() }
+
+        return Metrics(
+            tp = int("TP"),
+            fp = int("FP"),
+            fn = int("FN"),
+            tn = int("TN"),
+            precision = double("PRECISION"),
+            recall = double("RECALL"),
+            f1Score = double("F1"),
+            accuracy = double("ACCURACY"),
+            isExactMatch = int("EXACT") == 1,
+            hammingLoss = double("HAMMING"),
+            fnr = double("FNR"),
+            hallucinationCount = count("HALLUCINATED"),
+            hallucinatedAllergens = list("HALLUCINATED"),
+            overPredictionCount = count("OVER_PREDICTED"),
+            overPredictedAllergens = list("OVER_PREDICTED"),
+            isAbstentionCase = int("ABSTAIN") == 1,
+            isAbstentionCorrect = int("ABSTAIN_CORRECT") == 1
+        )
+    }
+
     private fun parseAllergens(allergens: String): Set<String> {
         if (allergens.trim().lowercase() == "none") return emptySet()
         return allergens.lowercase()
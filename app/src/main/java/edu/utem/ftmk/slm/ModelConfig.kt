@@ -97,6 +97,20 @@ object ModelRegistry {
         return MODELS.find { it.id == "qwen2.5-1.5b" }!!
     }
     
+    /**
+     * Get cascade pair: smallest model first, escalating to the next
+     * larger model of the same family (Llama 3.2 1B -> Llama 3.2 3B)
+     */
+    fun getCascadeModels(): Pair<ModelConfig, ModelConfig> {
+        val small = MODELS.minByOrNull { it.sizeGB }!!
+        val family = small.id.substringBeforeLast("-")
+        val large = MODELS
+            .filter { it.sizeGB > small.sizeGB }
+            .sortedBy { it.sizeGB }
+            .let { larger -> larger.firstOrNull { it.id.startsWith(family) } ?: larger.first() }
+        return Pair(small, large)
+    }
+
     /**
      * Get display names for spinner
      */